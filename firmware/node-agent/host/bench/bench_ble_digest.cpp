@@ -0,0 +1,165 @@
+// Bytes on the wire for raw ble.seen events versus ble.digest windows with
+// 50-400 devices in range over ten minutes. "every advert" is one ble.seen per
+// advert; "sampled" goes through the firmware's BleSampler admission, which
+// caps volume by dropping devices. Both use the firmware's event envelope;
+// sizes are before compression.
+
+#include <string.h>
+
+#include <random>
+#include <vector>
+
+#include "ble_digest.h"
+#include "ble_sampler.h"
+#include "bench_util.h"
+#include "json_writer.h"
+#include "lru_table.h"
+
+static const uint32_t kRunMs = 600000;
+static const uint32_t kWindowMs = 30000;
+
+struct Device {
+  uint8_t addr[6];
+  uint32_t intervalMs;
+  uint32_t phaseMs;
+};
+
+static std::vector<Device> makeDevices(size_t n) {
+  std::mt19937 rng(9);
+  std::vector<Device> out(n);
+  for (Device &d : out) {
+    for (uint8_t &b : d.addr) b = (uint8_t)rng();
+    // Mostly 1 Hz beacons, a tenth of them at 10 Hz.
+    d.intervalMs = rng() % 10 == 0 ? 100 : 1000;
+    d.phaseMs = rng() % d.intervalMs;
+  }
+  return out;
+}
+
+static void beginEvent(JsonWriter &w, const char *type, uint32_t seq, uint32_t ts) {
+  w.beginObject();
+  w.fieldUInt("v", 1);
+  w.fieldUInt("ts_ms", 1700000000000ULL + ts);
+  w.fieldStr("node_id", "lab-esp32-01");
+  w.fieldStr("type", type);
+  w.fieldStr("src", "lab-esp32-01");
+  w.fieldUInt("seq", seq);
+}
+
+static void run(size_t deviceCount) {
+  std::vector<Device> devices = makeDevices(deviceCount);
+  static LruHashTable<BleDeviceEntry, 512> rawTable;
+  static LruHashTable<BleDeviceEntry, 512> digestTable;
+  rawTable.clear();
+  digestTable.clear();
+  BleSampler sampler({10, 10, 2000, 2, 30, 10000});
+  static char buf[2048];
+  uint64_t everyBytes = 0, rawBytes = 0, digestBytes = 0;
+  uint32_t sampledDevices = 0;
+  uint32_t rawEvents = 0, digestEvents = 0, adverts = 0, seq = 0;
+  uint32_t windowStart = 0;
+  std::mt19937 rng(3);
+
+  for (uint32_t ms = 0; ms < kRunMs; ms += 10) {
+    for (const Device &d : devices) {
+      if ((ms + d.phaseMs) % d.intervalMs >= 10) continue;
+      adverts++;
+      int8_t rssi = (int8_t)(-55 - (int)(rng() % 40));
+      uint64_t key = bleAddrKey(d.addr, 1);
+      bool inserted;
+
+      BleDeviceEntry &r = *rawTable.upsert(key, inserted);
+      if (inserted) memcpy(r.addr, d.addr, 6);
+      bool admitted = sampler.admit(r, inserted, ms);
+      {
+        char addr[18];
+        size_t addrLen = formatMac(addr, d.addr, false);
+        JsonWriter w(buf, sizeof(buf));
+        beginEvent(w, "ble.seen", ++seq, ms);
+        w.fieldStr("mac", addr, addrLen);
+        w.fieldInt("rssi", rssi);
+        w.key("data");
+        w.beginObject();
+        w.fieldStr("addr", addr, addrLen);
+        w.fieldInt("rssi", rssi);
+        w.fieldStr("addr_type", "random");
+        w.fieldUInt("flags", 6);
+        w.endObject();
+        w.endObject();
+        everyBytes += w.size() + 1;  // plus the batch separator
+        if (admitted) {
+          rawBytes += w.size() + 1;
+          rawEvents++;
+          if (!r.win.count) sampledDevices++;
+          r.win.count = 1;  // marks the device as reported at least once
+        }
+      }
+
+      BleDeviceEntry &g = *digestTable.upsert(key, inserted);
+      if (inserted) memcpy(g.addr, d.addr, 6);
+      bleDigestObserve(g, rssi, 6, 1, ms);
+      g.adv_flags = 6;
+      g.svc_count = 1;
+      g.last_seen_ms = ms;
+    }
+
+    if (ms + 10 - windowStart >= kWindowMs) {
+      JsonWriter w(buf, sizeof(buf));
+      size_t inEvent = 0;
+      auto begin = [&]() {
+        w.reset();
+        beginEvent(w, "ble.digest", ++seq, ms);
+        w.key("data");
+        w.beginObject();
+        w.fieldUInt("window_start_ms", windowStart);
+        w.fieldUInt("window_ms", kWindowMs);
+        w.fieldUInt("part", digestEvents);
+        w.key("devices");
+        w.beginArray();
+      };
+      auto commit = [&]() {
+        w.endArray();
+        w.endObject();
+        w.endObject();
+        digestBytes += w.size() + 1;
+        digestEvents++;
+      };
+      for (uint16_t h = digestTable.front(); h != digestTable.npos; h = digestTable.next(h)) {
+        BleDeviceEntry &dev = digestTable.at(h);
+        if (!bleDigestPending(dev)) continue;
+        if (inEvent == 0) begin();
+        JsonWriter::Mark before = w.mark();
+        bleDigestWriteDevice(w, dev, windowStart);
+        if ((w.overflowed() || w.remaining() < 4) && inEvent > 0) {
+          w.rewind(before);
+          commit();
+          begin();
+          inEvent = 0;
+          bleDigestWriteDevice(w, dev, windowStart);
+        }
+        inEvent++;
+        bleDigestReset(dev);
+      }
+      if (inEvent > 0) commit();
+      windowStart = ms + 10;
+    }
+  }
+  double minutes = kRunMs / 60000.0;
+  printf("  %4zu devices  %6.0f adverts/min\n", deviceCount, adverts / minutes);
+  printf("    every advert %8.0f B/min\n", everyBytes / minutes);
+  printf("    sampled      %8.0f B/min  (%4.0f events/min, %u/%zu devices ever reported)\n",
+         rawBytes / minutes, rawEvents / minutes, sampledDevices, deviceCount);
+  printf("    digest       %8.0f B/min  (%4.0f events/min, all devices every window)  "
+         "%.1fx fewer than every advert\n",
+         digestBytes / minutes, digestEvents / minutes, double(everyBytes) / double(digestBytes));
+}
+
+int main() {
+  printf("bench_ble_digest (%u s run, %u s digest window, uncompressed JSON)\n", kRunMs / 1000,
+         kWindowMs / 1000);
+  run(50);
+  run(100);
+  run(200);
+  run(400);
+  return 0;
+}
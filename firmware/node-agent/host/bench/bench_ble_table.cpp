@@ -0,0 +1,114 @@
+// Per-advert cost of the BLE observation table: the old String ring with a
+// linear most-recent-first scan versus the LRU hash table, with as many
+// distinct devices in the air as the table holds.
+
+#include <string.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ble_adv.h"
+#include "bench_util.h"
+#include "json_writer.h"
+#include "lru_table.h"
+
+struct LegacyObservation {
+  std::string mac;
+  std::string name;
+  int rssi = 0;
+  uint32_t last_seen_ms = 0;
+  uint32_t seen_count = 0;
+};
+
+static std::vector<BleRawObservation> makeAdverts(size_t devices, size_t count) {
+  std::mt19937 rng(42);
+  std::vector<BleRawObservation> addrs(devices);
+  for (BleRawObservation &a : addrs) {
+    for (uint8_t &b : a.addr) b = (uint8_t)rng();
+    a.addr_type = 1;
+  }
+  std::vector<BleRawObservation> out(count);
+  for (size_t i = 0; i < count; i++) {
+    out[i] = addrs[rng() % devices];
+    out[i].ts_ms = (uint32_t)i;
+    out[i].rssi = (int8_t)(-40 - (int)(rng() % 50));
+  }
+  return out;
+}
+
+static void runLegacy(size_t capacity, const std::vector<BleRawObservation> &adverts) {
+  std::vector<LegacyObservation> ring(capacity);
+  size_t count = 0;
+  size_t head = 0;
+  uint64_t allocsBefore = benchAllocStats().count;
+  BenchTimer t;
+  for (const BleRawObservation &raw : adverts) {
+    char addr[18];
+    formatMac(addr, raw.addr, false);
+    std::string mac(addr);
+    bool found = false;
+    for (size_t i = 0; i < count; i++) {
+      LegacyObservation &obs = ring[(head + capacity - 1 - i) % capacity];
+      if (obs.mac == mac) {
+        obs.rssi = raw.rssi;
+        obs.last_seen_ms = raw.ts_ms;
+        obs.seen_count++;
+        found = true;
+        break;
+      }
+    }
+    if (found) continue;
+    LegacyObservation &slot = ring[head];
+    if (count < capacity) count++;
+    slot.mac = mac;
+    slot.name = "";
+    slot.rssi = raw.rssi;
+    slot.last_seen_ms = raw.ts_ms;
+    slot.seen_count = 1;
+    head = (head + 1) % capacity;
+  }
+  double sec = t.seconds();
+  benchSink(ring[0].seen_count);
+  printf("  %-12s %5zu devices  %8.1f ns/advert  %5.2f allocs/advert\n", "string ring", capacity,
+         sec * 1e9 / adverts.size(),
+         double(benchAllocStats().count - allocsBefore) / adverts.size());
+}
+
+template <size_t Capacity>
+static void runTable(const std::vector<BleRawObservation> &adverts) {
+  static LruHashTable<BleDeviceEntry, Capacity> table;
+  uint64_t allocsBefore = benchAllocStats().count;
+  BenchTimer t;
+  for (const BleRawObservation &raw : adverts) {
+    bool inserted;
+    BleDeviceEntry &e = *table.upsert(bleAddrKey(raw.addr, raw.addr_type), inserted);
+    if (inserted) {
+      memcpy(e.addr, raw.addr, sizeof(e.addr));
+      e.addr_type = raw.addr_type;
+    }
+    e.rssi = raw.rssi;
+    e.last_seen_ms = raw.ts_ms;
+    e.seen_count++;
+  }
+  double sec = t.seconds();
+  benchSink(table.at(table.front()).seen_count);
+  printf("  %-12s %5zu devices  %8.1f ns/advert  %5.2f allocs/advert  (%zu B of RAM)\n", "hash table",
+         Capacity, sec * 1e9 / adverts.size(),
+         double(benchAllocStats().count - allocsBefore) / adverts.size(), sizeof(table));
+}
+
+int main() {
+  const size_t kAdverts = 200000;
+  printf("bench_ble_table (%zu adverts, BleDeviceEntry %zu B)\n", kAdverts, sizeof(BleDeviceEntry));
+  std::vector<BleRawObservation> a128 = makeAdverts(128, kAdverts);
+  std::vector<BleRawObservation> a1k = makeAdverts(1024, kAdverts);
+  std::vector<BleRawObservation> a4k = makeAdverts(4096, kAdverts);
+  runLegacy(128, a128);
+  runTable<128>(a128);
+  runLegacy(1024, a1k);
+  runTable<1024>(a1k);
+  runLegacy(4096, a4k);
+  runTable<4096>(a4k);
+  return 0;
+}
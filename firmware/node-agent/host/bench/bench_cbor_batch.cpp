@@ -0,0 +1,92 @@
+// Body bytes per event for JSON and CBOR ingest batches of ble.seen events,
+// each with and without gzip (DeflateEncoder), plus the cost of transcoding
+// queued JSON to CBOR and of the reference decoder.
+
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "bench_util.h"
+#include "cbor_batch.h"
+#include "deflate.h"
+#include "node_events.h"
+
+static const char kNodeId[] = "lab-esp32-01";
+
+static std::string bleSeen(uint32_t seq) {
+  BleSeenEvent ev;
+  const uint8_t mac[6] = {0xc4, (uint8_t)(seq * 13), 0x1a, 0x9e, (uint8_t)(seq * 7), 0x7b};
+  memcpy(ev.addr.b, mac, 6);
+  ev.rssi = -40 - (int)(seq % 50);
+  ev.addr_type = EventText{"random", 6};
+  ev.vendor_id.setNull();
+  ev.flags = 6;
+  char buf[512];
+  JsonWriter w(buf, sizeof(buf));
+  EventEnvelope env = {1, 600000 + seq * 37, {kNodeId, sizeof(kNodeId) - 1}, seq, 1};
+  eventEncodeJson(w, env, ev);
+  return std::string(w.c_str(), w.size());
+}
+
+int main() {
+  static DeflateEncoder encoder;
+  static uint8_t cbor[65536];
+  static uint8_t gz[65536];
+  static char decoded[65536];
+  const size_t sizes[] = {1, 8, 32, 64};
+  printf("bench_cbor_batch (ble.seen, body bytes per event)\n");
+  printf("  %5s  %6s  %6s  %9s  %9s  %12s  %12s\n", "batch", "json", "cbor", "json+gzip", "cbor+gzip",
+         "encode ns/ev", "decode ns/ev");
+  for (size_t batch : sizes) {
+    std::vector<std::string> events;
+    std::string body = batch > 1 ? "[" : "";
+    for (size_t i = 0; i < batch; i++) {
+      events.push_back(bleSeen((uint32_t)(i + 1)));
+      if (i) body += ",";
+      body += events.back();
+    }
+    if (batch > 1) body += "]";
+
+    CborBatchEncoder enc(cbor, sizeof(cbor));
+    const int iters = (int)(2000000 / batch) + 1;
+    size_t cborBytes = 0;
+    BenchTimer encodeTimer;
+    for (int it = 0; it < iters; it++) {
+      enc.begin(batch);
+      for (const std::string &e : events) enc.add(e.data(), e.size());
+      cborBytes = enc.finish();
+      benchSink(cbor);
+    }
+    double encodeSec = encodeTimer.seconds();
+    if (cborBytes == 0) {
+      fprintf(stderr, "encode failed\n");
+      return 1;
+    }
+
+    BenchTimer decodeTimer;
+    for (int it = 0; it < iters; it++) {
+      JsonWriter w(decoded, sizeof(decoded));
+      if (!cborBatchDecode(cbor, cborBytes, w)) {
+        fprintf(stderr, "decode failed\n");
+        return 1;
+      }
+      benchSink(decoded);
+    }
+    double decodeSec = decodeTimer.seconds();
+    // A bare object for one event, as the firmware sends it.
+    std::string array = batch > 1 ? body : "[" + body + "]";
+    if (array != decoded) {
+      fprintf(stderr, "round trip mismatch\n");
+      return 1;
+    }
+
+    size_t jsonGz = encoder.gzip(reinterpret_cast<const uint8_t *>(body.data()), body.size(), gz, sizeof(gz));
+    size_t cborGz = encoder.gzip(cbor, cborBytes, gz, sizeof(gz));
+    double perEvent = (double)iters * batch;
+    printf("  %5zu  %6.1f  %6.1f  %9.1f  %9.1f  %12.0f  %12.0f\n", batch, (double)body.size() / batch,
+           (double)cborBytes / batch, (double)jsonGz / batch, (double)cborGz / batch,
+           encodeSec * 1e9 / perEvent, decodeSec * 1e9 / perEvent);
+  }
+  return 0;
+}
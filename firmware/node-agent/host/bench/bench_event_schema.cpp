@@ -0,0 +1,116 @@
+// Compares the hand-written JsonWriter builder plus the runtime envelope scan
+// it used to need with the descriptor-driven encoders for a ble.seen event.
+
+#include <string.h>
+
+#include "bench_util.h"
+#include "json_writer.h"
+#include "node_events.h"
+
+static const char kNodeId[] = "lab-esp32-01";
+
+static bool legacyValid(const char *json) {
+  return strstr(json, "\"v\"") != nullptr && strstr(json, "\"ts_ms\"") != nullptr &&
+         strstr(json, "\"node_id\"") != nullptr && strstr(json, "\"type\"") != nullptr &&
+         strstr(json, "\"src\"") != nullptr && strstr(json, "\"data\"") != nullptr;
+}
+
+static size_t legacyBleSeen(char *buf, size_t cap, const uint8_t mac[6], int rssi, uint32_t seq) {
+  char addr[18];
+  size_t addrLen = formatMac(addr, mac, false);
+  JsonWriter w(buf, cap);
+  w.beginObject();
+  w.fieldUInt("v", 1);
+  w.fieldUInt("ts_ms", 1000 + seq);
+  w.fieldStr("node_id", kNodeId);
+  w.fieldStr("type", "ble.seen");
+  w.fieldStr("src", kNodeId);
+  w.fieldUInt("seq", seq);
+  w.fieldUInt("epoch", 1);
+  w.fieldStr("mac", addr, addrLen);
+  w.fieldInt("rssi", rssi);
+  w.key("data");
+  w.beginObject();
+  w.fieldStr("addr", addr, addrLen);
+  w.fieldInt("rssi", rssi);
+  w.fieldStr("addr_type", "random");
+  w.fieldNull("vendor_id");
+  w.fieldUInt("flags", 6);
+  w.endObject();
+  w.endObject();
+  return legacyValid(buf) ? w.size() : 0;
+}
+
+static BleSeenEvent schemaEvent(const uint8_t mac[6], int rssi) {
+  BleSeenEvent ev;
+  memcpy(ev.addr.b, mac, 6);
+  ev.rssi = rssi;
+  ev.addr_type = EventText{"random", 6};
+  ev.vendor_id.setNull();
+  ev.flags = 6;
+  return ev;
+}
+
+static EventEnvelope envelope(uint32_t seq) {
+  return EventEnvelope{1, 1000 + seq, {kNodeId, sizeof(kNodeId) - 1}, seq, 1};
+}
+
+int main() {
+  const int kEvents = 1000000;
+  uint8_t macs[16][6];
+  for (int i = 0; i < 16; i++) {
+    const uint8_t m[6] = {0xc4, (uint8_t)(i * 13), 0x1a, 0x9e, (uint8_t)(i * 7), 0x7b};
+    memcpy(macs[i], m, 6);
+  }
+
+  // Output parity check before timing.
+  {
+    char a[512];
+    char b[512];
+    legacyBleSeen(a, sizeof(a), macs[3], -71, 9);
+    JsonWriter w(b, sizeof(b));
+    eventEncodeJson(w, envelope(9), schemaEvent(macs[3], -71));
+    if (strcmp(a, b) != 0) {
+      fprintf(stderr, "output mismatch:\n  legacy: %s\n  schema: %s\n", a, b);
+      return 1;
+    }
+  }
+
+  char buf[512];
+  BenchTimer legacyTimer;
+  size_t legacyBytes = 0;
+  for (int i = 0; i < kEvents; i++) {
+    legacyBytes += legacyBleSeen(buf, sizeof(buf), macs[i & 15], -40 - (i % 50), (uint32_t)i);
+    benchSink(buf);
+  }
+  double legacySec = legacyTimer.seconds();
+
+  BenchTimer jsonTimer;
+  size_t jsonBytes = 0;
+  for (int i = 0; i < kEvents; i++) {
+    JsonWriter w(buf, sizeof(buf));
+    eventEncodeJson(w, envelope((uint32_t)i), schemaEvent(macs[i & 15], -40 - (i % 50)));
+    jsonBytes += w.size();
+    benchSink(buf);
+  }
+  double jsonSec = jsonTimer.seconds();
+
+  uint8_t bin[256];
+  BenchTimer binTimer;
+  size_t binBytes = 0;
+  for (int i = 0; i < kEvents; i++) {
+    binBytes += eventEncodeBinary(bin, sizeof(bin), envelope((uint32_t)i),
+                                  schemaEvent(macs[i & 15], -40 - (i % 50)));
+    benchSink(bin);
+  }
+  double binSec = binTimer.seconds();
+
+  printf("bench_event_schema (ble.seen, %d events)\n", kEvents);
+  printf("  hand-written + scan : %10.0f events/s  %4zu B/event\n", kEvents / legacySec,
+         legacyBytes / kEvents);
+  printf("  descriptor JSON     : %10.0f events/s  %4zu B/event (max %zu)\n", kEvents / jsonSec,
+         jsonBytes / kEvents, eventJsonMax(kBleSeenEvent));
+  printf("  descriptor binary   : %10.0f events/s  %4zu B/event (max %zu)\n", kEvents / binSec,
+         binBytes / kEvents, eventBinaryMax(kBleSeenEvent));
+  return 0;
+}
@@ -0,0 +1,106 @@
+// Per-record cost of the seqlock Histogram on the hot paths it instruments,
+// against the max-only tracking it supplements and a mutex-guarded
+// histogram, plus the FIFO residence sampler and rendering /metrics/prom.
+
+#include <atomic>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "bench_util.h"
+#include "histogram.h"
+#include "prom_writer.h"
+
+struct MutexHistogram {
+  std::mutex mu;
+  uint32_t counts[Histogram::kBuckets] = {};
+  uint64_t sum = 0;
+  void record(uint32_t v) {
+    std::lock_guard<std::mutex> lock(mu);
+    counts[Histogram::bucketFor(v)]++;
+    sum += v;
+  }
+};
+
+static std::vector<uint32_t> makeValues(size_t n) {
+  std::mt19937 rng(5);
+  std::vector<uint32_t> out(n);
+  // Mostly short loops with a long tail, like loop time in microseconds.
+  for (uint32_t &v : out) v = rng() % 100 < 95 ? 50 + rng() % 400 : 1000 + rng() % 200000;
+  return out;
+}
+
+template <typename Fn>
+static void run(const char *label, const std::vector<uint32_t> &values, int rounds, Fn &&record) {
+  BenchTimer t;
+  for (int r = 0; r < rounds; r++) {
+    for (uint32_t v : values) record(v);
+  }
+  double sec = t.seconds();
+  double n = double(values.size()) * rounds;
+  printf("  %-34s %6.2f ns/record  %7.1f M records/s\n", label, sec / n * 1e9, n / sec / 1e6);
+}
+
+int main() {
+  const std::vector<uint32_t> values = makeValues(1 << 16);
+  const int kRounds = 200;
+  printf("bench_histogram (%zu values x %d rounds)\n", values.size(), kRounds);
+
+  uint32_t maxOnly = 0;
+  run("max only (loop_max_ms style)", values, kRounds, [&](uint32_t v) {
+    if (v > maxOnly) maxOnly = v;
+    benchSink(maxOnly);
+  });
+  Histogram h;
+  run("Histogram::record", values, kRounds, [&](uint32_t v) { h.record(v); });
+
+  std::atomic<bool> stop{false};
+  uint64_t snapshots = 0;
+  std::thread reader([&] {
+    Histogram::Snapshot s;
+    while (!stop.load(std::memory_order_relaxed)) {
+      h.snapshot(s);
+      benchSink(s.count);
+      snapshots++;
+    }
+  });
+  run("Histogram::record + busy reader", values, kRounds, [&](uint32_t v) { h.record(v); });
+  stop = true;
+  reader.join();
+  printf("  %-34s %llu snapshots\n", "  (reader completed)", (unsigned long long)snapshots);
+
+  MutexHistogram m;
+  run("mutex histogram", values, kRounds, [&](uint32_t v) { m.record(v); });
+
+  FifoResidence<32> residence;
+  Histogram rh;
+  uint32_t now = 0;
+  run("FifoResidence push+pop", values, kRounds, [&](uint32_t v) {
+    residence.onPush(now);
+    now += v & 7;
+    residence.onPop(now, rh);
+  });
+
+  Histogram::Snapshot s;
+  h.snapshot(s);
+  char buf[1024];
+  size_t bytes = 0;
+  BenchTimer t;
+  const int kRenders = 20000;
+  for (int i = 0; i < kRenders; i++) {
+    PromWriter p(buf, sizeof(buf));
+    p.setSink(
+        [](void *ctx, const char *, size_t len) {
+          *static_cast<size_t *>(ctx) += len;
+          return true;
+        },
+        &bytes);
+    for (int k = 0; k < 4; k++) p.histogram("node_loop_seconds", "Loop time.", s, 6);
+    p.flush();
+  }
+  double sec = t.seconds();
+  printf("  %-34s %6.1f us/render  (%zu B)\n", "render 4 histograms", sec / kRenders * 1e6,
+         bytes / kRenders);
+  return 0;
+}
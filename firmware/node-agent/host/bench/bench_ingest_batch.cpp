@@ -0,0 +1,82 @@
+// Wire bytes per event for ingest batches of different sizes, raw vs gzip
+// (DeflateEncoder), plus compression throughput. HTTP request/response
+// framing is approximated as a fixed per-POST overhead.
+
+#include <string>
+#include <vector>
+
+#include "bench_util.h"
+#include "deflate.h"
+#include "json_writer.h"
+
+#if HOST_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+static const size_t kHttpOverheadBytes = 320;
+
+static size_t bleSeen(char *buf, size_t cap, uint32_t seq) {
+  char addr[18];
+  snprintf(addr, sizeof(addr), "c4:%02x:1a:9e:%02x:7b", (seq * 13) & 0xFF, (seq * 7) & 0xFF);
+  int rssi = -40 - (int)(seq % 50);
+  JsonWriter w(buf, cap);
+  w.beginObject();
+  w.fieldUInt("v", 1);
+  w.fieldUInt("ts_ms", 1700000000000ULL + seq * 37);
+  w.fieldStr("node_id", "lab-esp32-01");
+  w.fieldStr("type", "ble.seen");
+  w.fieldStr("src", "lab-esp32-01");
+  w.fieldUInt("seq", seq);
+  w.fieldStr("mac", addr);
+  w.fieldInt("rssi", rssi);
+  w.key("data");
+  w.beginObject();
+  w.fieldStr("addr", addr);
+  w.fieldInt("rssi", rssi);
+  w.fieldStr("addr_type", "random");
+  w.fieldUInt("flags", 6);
+  w.endObject();
+  w.endObject();
+  return w.size();
+}
+
+int main() {
+  static DeflateEncoder encoder;
+  static uint8_t out[65536];
+  const size_t sizes[] = {1, 8, 32, 64};
+  printf("bench_ingest_batch (ble.seen, HTTP overhead %zu B/POST)\n", kHttpOverheadBytes);
+  for (size_t batch : sizes) {
+    std::string body = "[";
+    char ev[512];
+    for (size_t i = 0; i < batch; i++) {
+      if (i) body += ",";
+      body.append(ev, bleSeen(ev, sizeof(ev), (uint32_t)(i + 1)));
+    }
+    body += "]";
+    const uint8_t *in = reinterpret_cast<const uint8_t *>(body.data());
+
+    const int iters = (int)(2000000 / body.size()) + 1;
+    size_t gz = 0;
+    BenchTimer timer;
+    for (int i = 0; i < iters; i++) {
+      gz = encoder.gzip(in, body.size(), out, sizeof(out));
+      benchSink(out[0]);
+    }
+    double sec = timer.seconds();
+
+    double rawPerEvent = double(body.size() + kHttpOverheadBytes) / batch;
+    double gzPerEvent = double(gz + kHttpOverheadBytes) / batch;
+    printf("  batch %3zu: raw %6zu B  gzip %6zu B (%.2fx)  wire/event raw %6.1f gzip %6.1f  %6.1f MB/s",
+           batch, body.size(), gz, double(body.size()) / gz, rawPerEvent, gzPerEvent,
+           body.size() * (double)iters / sec / 1e6);
+#if HOST_HAVE_ZLIB
+    uLongf z1 = sizeof(out);
+    uLongf z6 = sizeof(out);
+    compress2(out, &z1, in, body.size(), 1);
+    compress2(out, &z6, in, body.size(), 6);
+    printf("  (zlib -1 %lu B, -6 %lu B)", (unsigned long)z1, (unsigned long)z6);
+#endif
+    printf("\n");
+  }
+  return 0;
+}
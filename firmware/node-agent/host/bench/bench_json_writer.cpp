@@ -0,0 +1,143 @@
+// Compares the legacy String-concatenation event builder with JsonWriter for
+// a ble.seen event: events/sec and heap bytes allocated per event.
+
+#include <string>
+
+#include "bench_util.h"
+#include "json_writer.h"
+
+namespace legacy {
+
+// Faithful port of the pre-JsonWriter helpers (Arduino String -> std::string;
+// both use small-string buffers, so allocation counts are comparable).
+typedef std::string String;
+
+static String jsonEscape(const String &input) {
+  String out;
+  out.reserve(input.length() + 8);
+  for (size_t i = 0; i < input.length(); i++) {
+    char c = input[i];
+    if (c == '"') out += "\\\"";
+    else if (c == '\\') out += "\\\\";
+    else if (c == '\n') out += "\\n";
+    else if (c == '\r') out += "\\r";
+    else if (c == '\t') out += "\\t";
+    else out += c;
+  }
+  return out;
+}
+
+static String jsonKV(const String &key, const String &value, bool quote = true) {
+  if (quote) return String("\"") + key + "\":\"" + jsonEscape(value) + "\"";
+  return String("\"") + key + "\":" + value;
+}
+
+static uint32_t eventSeq = 0;
+
+static String buildEvent(const String &nodeId, const String &type, const String &dataJson,
+                         const String &extraJson, unsigned long ts) {
+  String json = "{";
+  json += jsonKV("v", std::to_string(1), false);
+  json += "," + jsonKV("ts_ms", std::to_string(ts), false);
+  json += "," + jsonKV("node_id", nodeId);
+  json += "," + jsonKV("type", type);
+  json += "," + jsonKV("src", nodeId);
+  json += "," + jsonKV("seq", std::to_string(++eventSeq), false);
+  if (extraJson.length() > 0) json += "," + extraJson;
+  json += ",\"data\":" + dataJson;
+  json += "}";
+  return json;
+}
+
+static String bleSeen(const String &nodeId, const String &addr, int rssi, uint8_t flags,
+                      unsigned long ts) {
+  String data = "{";
+  data += jsonKV("addr", addr);
+  data += "," + jsonKV("rssi", std::to_string(rssi), false);
+  data += "," + jsonKV("addr_type", "random");
+  data += "," + jsonKV("flags", std::to_string(flags), false);
+  data += "}";
+  String extra = jsonKV("mac", addr) + "," + jsonKV("rssi", std::to_string(rssi), false);
+  return buildEvent(nodeId, "ble.seen", data, extra, ts);
+}
+
+}  // namespace legacy
+
+static uint32_t writerSeq = 0;
+
+static size_t writerBleSeen(char *buf, size_t cap, const char *nodeId, const char *addr,
+                            int rssi, uint8_t flags, unsigned long ts) {
+  JsonWriter w(buf, cap);
+  w.beginObject();
+  w.fieldUInt("v", 1);
+  w.fieldUInt("ts_ms", ts);
+  w.fieldStr("node_id", nodeId);
+  w.fieldStr("type", "ble.seen");
+  w.fieldStr("src", nodeId);
+  w.fieldUInt("seq", ++writerSeq);
+  w.fieldStr("mac", addr);
+  w.fieldInt("rssi", rssi);
+  w.key("data");
+  w.beginObject();
+  w.fieldStr("addr", addr);
+  w.fieldInt("rssi", rssi);
+  w.fieldStr("addr_type", "random");
+  w.fieldUInt("flags", flags);
+  w.endObject();
+  w.endObject();
+  return w.size();
+}
+
+int main() {
+  const int kEvents = 500000;
+  const char *nodeId = "lab-esp32-01";
+  char addrs[16][18];
+  for (int i = 0; i < 16; i++) {
+    snprintf(addrs[i], sizeof(addrs[i]), "c4:%02x:1a:9e:%02x:7b", i * 13, i * 7);
+  }
+
+  // Output parity check before timing.
+  {
+    legacy::eventSeq = 0;
+    writerSeq = 0;
+    std::string a = legacy::bleSeen(nodeId, addrs[0], -71, 6, 123456);
+    char buf[512];
+    writerBleSeen(buf, sizeof(buf), nodeId, addrs[0], -71, 6, 123456);
+    if (a != buf) {
+      fprintf(stderr, "output mismatch:\n  legacy: %s\n  writer: %s\n", a.c_str(), buf);
+      return 1;
+    }
+  }
+
+  BenchAllocStats before = benchAllocStats();
+  BenchTimer legacyTimer;
+  size_t legacyBytes = 0;
+  for (int i = 0; i < kEvents; i++) {
+    std::string ev = legacy::bleSeen(nodeId, addrs[i & 15], -40 - (i % 50), 6, 1000 + i);
+    legacyBytes += ev.size();
+    benchSink(ev);
+  }
+  double legacySec = legacyTimer.seconds();
+  BenchAllocStats legacyAlloc = benchAllocStats();
+
+  char buf[512];
+  BenchTimer writerTimer;
+  size_t writerBytes = 0;
+  for (int i = 0; i < kEvents; i++) {
+    writerBytes += writerBleSeen(buf, sizeof(buf), nodeId, addrs[i & 15], -40 - (i % 50), 6,
+                                 1000 + i);
+    benchSink(buf);
+  }
+  double writerSec = writerTimer.seconds();
+  BenchAllocStats writerAlloc = benchAllocStats();
+
+  printf("bench_json_writer (ble.seen, %d events)\n", kEvents);
+  printf("  legacy String : %10.0f events/s  %6.1f allocs/event  %7.1f alloc bytes/event  (%zu B out)\n",
+         kEvents / legacySec, double(legacyAlloc.count - before.count) / kEvents,
+         double(legacyAlloc.bytes - before.bytes) / kEvents, legacyBytes / kEvents);
+  printf("  JsonWriter    : %10.0f events/s  %6.1f allocs/event  %7.1f alloc bytes/event  (%zu B out)\n",
+         kEvents / writerSec, double(writerAlloc.count - legacyAlloc.count) / kEvents,
+         double(writerAlloc.bytes - legacyAlloc.bytes) / kEvents, writerBytes / kEvents);
+  printf("  speedup       : %.1fx\n", legacySec / writerSec);
+  return 0;
+}
@@ -0,0 +1,89 @@
+// OUI vendor index: flash footprint of the generated blobs against the source
+// text and a flat sorted table, and lookup / name decode rates.
+
+#include <algorithm>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench_util.h"
+#include "oui_index.h"
+
+#ifdef HOST_OUI_DIR
+
+static std::vector<uint8_t> readFile(const std::string &path) {
+  std::ifstream f(path, std::ios::binary);
+  return std::vector<uint8_t>((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+}
+
+static std::vector<uint32_t> knownOuis(const OuiIndex &idx) {
+  std::vector<uint32_t> out;
+  for (uint32_t oui = 0; oui < 0x1000000; oui++) {
+    if (idx.lookup(oui) != OuiIndex::kNone) out.push_back(oui);
+  }
+  return out;
+}
+
+static void runLookups(const char *label, const OuiIndex &idx, const std::vector<uint32_t> &keys) {
+  const int kRounds = 20;
+  uint32_t hits = 0;
+  BenchTimer t;
+  for (int r = 0; r < kRounds; r++) {
+    for (uint32_t k : keys) hits += idx.lookup(k) != OuiIndex::kNone;
+  }
+  double sec = t.seconds();
+  double n = double(keys.size()) * kRounds;
+  printf("  %-28s %8.2f M lookups/s  %6.1f ns/lookup  (%.0f%% hits)\n", label, n / sec / 1e6,
+         sec / n * 1e9, 100.0 * hits / n);
+}
+
+int main() {
+  std::vector<uint8_t> named = readFile(std::string(HOST_OUI_DIR) + "/oui.idx");
+  std::vector<uint8_t> ids = readFile(std::string(HOST_OUI_DIR) + "/oui-ids.idx");
+  OuiIndex idx, idsIdx;
+  if (!idx.begin(named.data(), named.size()) || !idsIdx.begin(ids.data(), ids.size())) {
+    printf("bench_oui_index: bad index\n");
+    return 1;
+  }
+  std::string self = __FILE__;
+  std::string src = self.substr(0, self.rfind("/firmware/node-agent/")) + "/OUI/oui_combined.txt";
+  size_t srcBytes = readFile(src).size();
+
+  printf("bench_oui_index (%u OUIs, %u vendors, index id %08x)\n", (unsigned)idx.entryCount(),
+         (unsigned)idx.vendorCount(), (unsigned)idx.indexId());
+  printf("  size: source text %zu B, flat u32+u16 table %zu B, ids-only %zu B (%.2f B/OUI), "
+         "with names %zu B\n",
+         srcBytes, (size_t)idx.entryCount() * 6, idsIdx.sizeBytes(),
+         double(idsIdx.sizeBytes()) / idsIdx.entryCount(), idx.sizeBytes());
+
+  std::vector<uint32_t> known = knownOuis(idsIdx);
+  std::mt19937 rng(11);
+  std::shuffle(known.begin(), known.end(), rng);
+  std::vector<uint32_t> random(known.size());
+  for (uint32_t &k : random) k = rng() & 0xFFFFFF;
+  runLookups("registered OUIs (shuffled)", idsIdx, known);
+  runLookups("random 24-bit", idsIdx, random);
+
+  std::vector<uint16_t> vendorIds;
+  for (size_t i = 0; i < 100000; i++) vendorIds.push_back(idx.lookup(known[i % known.size()]));
+  char name[64];
+  size_t chars = 0;
+  BenchTimer t;
+  for (uint16_t id : vendorIds) chars += idx.vendorName(id, name, sizeof(name));
+  double sec = t.seconds();
+  benchSink(chars);
+  printf("  %-28s %8.2f M names/s    %6.1f ns/name    (avg %.1f chars)\n", "vendor name decode",
+         vendorIds.size() / sec / 1e6, sec / vendorIds.size() * 1e9,
+         double(chars) / vendorIds.size());
+  return 0;
+}
+
+#else
+
+int main() {
+  printf("bench_oui_index: skipped (needs python3 to generate the index)\n");
+  return 0;
+}
+
+#endif
@@ -0,0 +1,116 @@
+// Sustained SpillLog write throughput on file-backed segments (the host
+// stand-in for LittleFS), with and without the RAM write buffer, and replay
+// throughput.
+
+#include <dirent.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "bench_util.h"
+#include "spill_log.h"
+
+class FileStorage : public SpillStorage {
+ public:
+  explicit FileStorage(const std::string &dir) : dir_(dir) {}
+
+  size_t list(uint32_t *ids, size_t max) override {
+    size_t n = 0;
+    DIR *d = opendir(dir_.c_str());
+    if (!d) return 0;
+    while (struct dirent *e = readdir(d)) {
+      unsigned id;
+      if (n < max && sscanf(e->d_name, "%08x.seg", &id) == 1) ids[n++] = id;
+    }
+    closedir(d);
+    return n;
+  }
+  bool append(uint32_t id, const uint8_t *data, size_t len) override {
+    FILE *f = fopen(path(id).c_str(), "ab");
+    if (!f) return false;
+    bool ok = fwrite(data, 1, len, f) == len;
+    return fclose(f) == 0 && ok;
+  }
+  size_t read(uint32_t id, size_t offset, uint8_t *out, size_t len) override {
+    if (id != readId_ || !readFile_) {
+      if (readFile_) fclose(readFile_);
+      readFile_ = fopen(path(id).c_str(), "rb");
+      readId_ = id;
+      if (!readFile_) return 0;
+    }
+    fseek(readFile_, (long)offset, SEEK_SET);
+    return fread(out, 1, len, readFile_);
+  }
+  size_t size(uint32_t id) override {
+    FILE *f = fopen(path(id).c_str(), "rb");
+    if (!f) return 0;
+    fseek(f, 0, SEEK_END);
+    long n = ftell(f);
+    fclose(f);
+    return (size_t)n;
+  }
+  bool remove(uint32_t id) override {
+    if (readFile_ && readId_ == id) {
+      fclose(readFile_);
+      readFile_ = nullptr;
+    }
+    return unlink(path(id).c_str()) == 0;
+  }
+
+ private:
+  std::string path(uint32_t id) const {
+    char name[16];
+    snprintf(name, sizeof(name), "%08x.seg", (unsigned)id);
+    return dir_ + "/" + name;
+  }
+
+  std::string dir_;
+  FILE *readFile_ = nullptr;
+  uint32_t readId_ = 0;
+};
+
+static void run(const char *label, size_t bufBytes, int records) {
+  char tmpl[] = "/tmp/spill-bench-XXXXXX";
+  std::string dir = mkdtemp(tmpl);
+  FileStorage st(dir);
+  static uint8_t buf[8192];
+  SpillLog log(st, buf, bufBytes, 16384, 4096);
+  log.begin();
+
+  std::string ev =
+      "{\"v\":1,\"ts_ms\":1700000000000,\"node_id\":\"lab-esp32-01\",\"type\":\"ble.seen\","
+      "\"src\":\"lab-esp32-01\",\"seq\":1,\"mac\":\"c4:0d:1a:9e:07:7b\",\"rssi\":-71,"
+      "\"data\":{\"addr\":\"c4:0d:1a:9e:07:7b\",\"rssi\":-71,\"addr_type\":\"random\",\"flags\":6}}";
+  BenchTimer wt;
+  for (int i = 0; i < records; i++) log.append(ev.data(), ev.size());
+  log.flush();
+  double wsec = wt.seconds();
+
+  char out[1024];
+  size_t len;
+  uint8_t kind;
+  int replayed = 0;
+  BenchTimer rt;
+  while (log.peek(out, sizeof(out), len, kind)) {
+    benchSink(out[0]);
+    log.pop();
+    replayed++;
+  }
+  double rsec = rt.seconds();
+  double mb = double(log.stats().writtenBytes) / 1e6;
+  printf("  %-18s write %9.0f rec/s %7.1f MB/s   replay %9.0f rec/s  (%d/%d replayed, %u crc errors)\n",
+         label, records / wsec, mb / wsec, replayed / rsec, replayed, records,
+         log.stats().crcErrors);
+  rmdir(dir.c_str());
+}
+
+int main() {
+  const int kRecords = 100000;
+  printf("bench_spill_log (%d ble.seen records, 16 KB segments)\n", kRecords);
+  run("unbuffered", 0, kRecords);
+  run("512 B buffer", 512, kRecords);
+  run("2 KB buffer", 2048, kRecords);
+  run("8 KB buffer", 8192, kRecords);
+  return 0;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <new>
+
+// Shared helpers for host benchmarks: a wall clock and a global allocation
+// counter so each benchmark can report heap traffic per operation.
+
+struct BenchAllocStats {
+  uint64_t count = 0;
+  uint64_t bytes = 0;
+  uint64_t live = 0;
+  uint64_t peak = 0;
+};
+
+inline BenchAllocStats &benchAllocStats() {
+  static BenchAllocStats stats;
+  return stats;
+}
+
+inline void *benchAlloc(size_t n) {
+  size_t *p = static_cast<size_t *>(malloc(n + sizeof(size_t) * 2));
+  if (!p) throw std::bad_alloc();
+  p[0] = n;
+  BenchAllocStats &s = benchAllocStats();
+  s.count++;
+  s.bytes += n;
+  s.live += n;
+  if (s.live > s.peak) s.peak = s.live;
+  return p + 2;
+}
+
+inline void benchFree(void *ptr) {
+  if (!ptr) return;
+  size_t *p = static_cast<size_t *>(ptr) - 2;
+  benchAllocStats().live -= p[0];
+  free(p);
+}
+
+void *operator new(size_t n) { return benchAlloc(n); }
+void *operator new[](size_t n) { return benchAlloc(n); }
+void operator delete(void *p) noexcept { benchFree(p); }
+void operator delete[](void *p) noexcept { benchFree(p); }
+void operator delete(void *p, size_t) noexcept { benchFree(p); }
+void operator delete[](void *p, size_t) noexcept { benchFree(p); }
+
+class BenchTimer {
+ public:
+  BenchTimer() : start_(std::chrono::steady_clock::now()) {}
+  double seconds() const {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+  }
+
+ private:
+  std::chrono::steady_clock::time_point start_;
+};
+
+// Keeps the optimizer from discarding benchmark results.
+template <typename T>
+inline void benchSink(const T &value) {
+  asm volatile("" : : "g"(&value) : "memory");
+}
@@ -0,0 +1,116 @@
+// UDP telemetry collector: the replay harness's UdpCollector on a fixed
+// port, for a node on the bench with /udp pointed at it. Prints loss and
+// reorder figures per interval and a per-node summary on Ctrl-C. Built by
+// tools/host-collector.sh.
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+
+#include "udp_collector.h"
+#include "udp_telemetry.h"
+
+namespace {
+
+volatile sig_atomic_t stopRequested = 0;
+
+void onSignal(int) { stopRequested = 1; }
+
+void usage() {
+  fprintf(stderr,
+          "usage: collector [--port N] [--local] [--drop-pct N] [--reorder-pct N] [--seed N]\n"
+          "                 [--stats-ms N]\n");
+}
+
+void printSources(const UdpCollector::Stats &s) {
+  printf("%-24s %6s %6s %10s %8s %8s %8s %10s %10s %8s %8s\n", "node_id", "epoch", "boots",
+         "datagrams", "lost", "reorder", "dups", "obs", "obs_miss", "age_p99", "age_max");
+  for (const auto &src : s.sources) {
+    const UdpCollector::Source &n = src.second;
+    printf("%-24s %6u %6u %10llu %8u %8llu %8llu %10llu %10llu %8u %8u\n", src.first.c_str(),
+           (unsigned)n.epoch, (unsigned)n.epochs, (unsigned long long)n.datagrams, (unsigned)n.lost(),
+           (unsigned long long)n.reordered, (unsigned long long)n.duplicates,
+           (unsigned long long)n.observations, (unsigned long long)n.obsMissing(),
+           (unsigned)n.ageQuantile(0.99), (unsigned)n.ageMax);
+  }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  UdpCollector::Config cfg;
+  cfg.port = kUdpCollectorDefaultPort;
+  cfg.listenAll = true;
+  uint32_t statsMs = 10000;
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    const char *v = i + 1 < argc ? argv[i + 1] : nullptr;
+    auto num = [&](uint32_t max) -> uint32_t {
+      i++;
+      return std::min<uint32_t>((uint32_t)strtoul(v, nullptr, 10), max);
+    };
+    if (a == "--port" && v) {
+      cfg.port = (uint16_t)num(65535);
+    } else if (a == "--local") {
+      cfg.listenAll = false;
+    } else if (a == "--drop-pct" && v) {
+      cfg.dropPct = (uint8_t)num(100);
+    } else if (a == "--reorder-pct" && v) {
+      cfg.reorderPct = (uint8_t)num(100);
+    } else if (a == "--seed" && v) {
+      cfg.seed = num(0xFFFFFFFFu);
+    } else if (a == "--stats-ms" && v) {
+      statsMs = std::max<uint32_t>(num(3600000), 100);
+    } else {
+      usage();
+      return 2;
+    }
+  }
+
+  UdpCollector collector(cfg);
+  uint16_t port = collector.start();
+  if (port == 0) {
+    fprintf(stderr, "collector: cannot bind UDP port %u\n", (unsigned)cfg.port);
+    return 1;
+  }
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+  printf("collector: POST /udp?collector=%s:%u on the node\n", cfg.listenAll ? "<this-host>" : "127.0.0.1",
+         (unsigned)port);
+  fflush(stdout);
+
+  UdpCollector::Stats last;
+  uint32_t waitedMs = 0;
+  while (!stopRequested) {
+    usleep(100 * 1000);
+    waitedMs += 100;
+    if (waitedMs < statsMs) continue;
+    waitedMs = 0;
+    UdpCollector::Stats s = collector.stats();
+    uint64_t obs = 0, lastObs = 0, missing = 0, reordered = 0, dups = 0;
+    uint32_t lost = 0;
+    for (const auto &src : s.sources) {
+      obs += src.second.observations;
+      missing += src.second.obsMissing();
+      lost += src.second.lost();
+      reordered += src.second.reordered;
+      dups += src.second.duplicates;
+    }
+    for (const auto &src : last.sources) lastObs += src.second.observations;
+    printf("collector: %llu datagrams (+%llu), %llu observations (+%llu), %u lost, %llu reordered, "
+           "%llu duplicates, %llu observations missing, %llu malformed\n",
+           (unsigned long long)s.datagrams, (unsigned long long)(s.datagrams - last.datagrams),
+           (unsigned long long)obs, (unsigned long long)(obs - lastObs), (unsigned)lost,
+           (unsigned long long)reordered, (unsigned long long)dups, (unsigned long long)missing,
+           (unsigned long long)s.malformed);
+    fflush(stdout);
+    last = s;
+  }
+  collector.stop();
+  printSources(collector.stats());
+  return 0;
+}
@@ -0,0 +1,453 @@
+#include "ingest_sink.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+
+#include "cbor_batch.h"
+
+#if HOST_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace {
+
+struct SinkEvent {
+  std::string type;
+  std::string node;
+  uint32_t epoch = 0;
+  uint32_t seq = 0;
+  bool hasSeq = false;
+};
+
+// Reads the top-level "type", "node_id", "epoch" and "seq" of each event in
+// a JSON object or array of objects. Not a validator: the firmware already
+// checks.
+void scanEvents(const std::string &body, std::vector<SinkEvent> &events) {
+  size_t i = body.find_first_not_of(" \t\r\n");
+  if (i == std::string::npos) return;
+  const int eventDepth = body[i] == '[' ? 2 : 1;
+  int depth = 0;
+  std::string lastKey;
+  bool expectValue = false;
+  while (i < body.size()) {
+    char c = body[i];
+    if (c == '"') {
+      size_t start = ++i;
+      while (i < body.size() && body[i] != '"') i += body[i] == '\\' ? 2 : 1;
+      std::string s = body.substr(start, i - start);
+      i++;
+      if (depth != eventDepth) continue;
+      size_t next = body.find_first_not_of(" \t\r\n", i);
+      if (!expectValue && next != std::string::npos && body[next] == ':') {
+        lastKey = s;
+        expectValue = true;
+        i = next + 1;
+        continue;
+      }
+      if (expectValue && lastKey == "type") events.back().type = s;
+      if (expectValue && lastKey == "node_id") events.back().node = s;
+      expectValue = false;
+      continue;
+    }
+    if (c == '{' || c == '[') {
+      depth++;
+      if (c == '{' && depth == eventDepth) events.emplace_back();
+      expectValue = false;
+    } else if (c == '}' || c == ']') {
+      depth--;
+    } else if (c == ',') {
+      expectValue = false;
+    } else if (expectValue && depth == eventDepth && c >= '0' && c <= '9') {
+      uint32_t n = (uint32_t)strtoul(body.c_str() + i, nullptr, 10);
+      if (lastKey == "epoch") events.back().epoch = n;
+      if (lastKey == "seq") {
+        events.back().seq = n;
+        events.back().hasSeq = true;
+      }
+      expectValue = false;
+      while (i + 1 < body.size() && body[i + 1] >= '0' && body[i + 1] <= '9') i++;
+    }
+    i++;
+  }
+}
+
+#if HOST_HAVE_ZLIB
+bool gunzip(const std::string &in, std::string &out) {
+  z_stream zs = {};
+  if (inflateInit2(&zs, 16 + MAX_WBITS) != Z_OK) return false;
+  zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(in.data()));
+  zs.avail_in = (uInt)in.size();
+  char buf[16384];
+  int rc = Z_OK;
+  while (rc == Z_OK) {
+    zs.next_out = reinterpret_cast<Bytef *>(buf);
+    zs.avail_out = sizeof(buf);
+    rc = inflate(&zs, Z_NO_FLUSH);
+    out.append(buf, sizeof(buf) - zs.avail_out);
+  }
+  inflateEnd(&zs);
+  return rc == Z_STREAM_END;
+}
+#endif
+
+// Renders a CBOR batch as the JSON array it was transcoded from.
+bool decodeCbor(const std::string &in, std::string &out) {
+  std::vector<char> buf(in.size() * 8 + 4096);
+  JsonWriter w(buf.data(), buf.size());
+  if (!cborBatchDecode(reinterpret_cast<const uint8_t *>(in.data()), in.size(), w)) return false;
+  out.assign(w.c_str(), w.size());
+  return true;
+}
+
+// Value of header `name` in `head`, or "" when absent.
+std::string header(const std::string &head, const char *name) {
+  size_t nameLen = strlen(name);
+  for (size_t pos = head.find("\r\n"); pos != std::string::npos; pos = head.find("\r\n", pos + 2)) {
+    size_t line = pos + 2;
+    if (strncasecmp(head.c_str() + line, name, nameLen) == 0 && head[line + nameLen] == ':') {
+      size_t v = head.find_first_not_of(' ', line + nameLen + 1);
+      size_t end = head.find("\r\n", line);
+      return head.substr(v, end - v);
+    }
+  }
+  return "";
+}
+
+}  // namespace
+
+// Replies on one connection, each held until rttMs after its request
+// arrived. Reading goes on meanwhile, so a long round trip delays replies
+// without holding up the requests behind them, as on a real link.
+class SinkOutbox {
+ public:
+  SinkOutbox(int fd, uint32_t rttMs) : fd_(fd), rtt_(rttMs) {}
+
+  void add(const void *data, size_t len) {
+    queue_.emplace_back(Clock::now() + rtt_, std::string(static_cast<const char *>(data), len));
+  }
+  // Sends the replies that are due, or all of them, waiting for each, with
+  // `all`. False when the connection failed.
+  bool flush(bool all = false) {
+    while (!queue_.empty()) {
+      if (all) std::this_thread::sleep_until(queue_.front().first);
+      else if (queue_.front().first > Clock::now()) return true;
+      const std::string &r = queue_.front().second;
+      if (send(fd_, r.data(), r.size(), MSG_NOSIGNAL) != (ssize_t)r.size()) return false;
+      queue_.pop_front();
+    }
+    return true;
+  }
+  // Poll timeout: until the next reply is due, at most `maxMs`.
+  int waitMs(int maxMs) const {
+    if (queue_.empty()) return maxMs;
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(queue_.front().first - Clock::now());
+    return (int)std::max<long long>(0, std::min<long long>(ms.count(), maxMs));
+  }
+
+ private:
+  using Clock = std::chrono::steady_clock;
+  int fd_;
+  std::chrono::milliseconds rtt_;
+  std::deque<std::pair<Clock::time_point, std::string>> queue_;
+};
+
+uint16_t IngestSink::start() {
+  listenFd_ = socket(AF_INET, SOCK_STREAM, 0);
+  if (listenFd_ < 0) return 0;
+  int on = 1;
+  setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(cfg_.listenAll ? INADDR_ANY : INADDR_LOOPBACK);
+  addr.sin_port = htons(cfg_.port);
+  socklen_t len = sizeof(addr);
+  if (bind(listenFd_, reinterpret_cast<sockaddr *>(&addr), len) != 0 || listen(listenFd_, 4) != 0 ||
+      getsockname(listenFd_, reinterpret_cast<sockaddr *>(&addr), &len) != 0) {
+    close(listenFd_);
+    listenFd_ = -1;
+    return 0;
+  }
+  rng_ = cfg_.seed;
+  thread_ = std::thread([this] { run(); });
+  return ntohs(addr.sin_port);
+}
+
+void IngestSink::stop() {
+  stop_ = true;
+  if (thread_.joinable()) thread_.join();
+  if (listenFd_ >= 0) close(listenFd_);
+  listenFd_ = -1;
+}
+
+IngestSink::Stats IngestSink::stats() {
+  std::lock_guard<std::mutex> lock(mu_);
+  Stats out = stats_;
+  for (auto &src : out.sources) {
+    auto it = seen_.find(std::make_pair(src.first, src.second.epoch));
+    if (it == seen_.end()) continue;
+    uint32_t gaps = 0;
+    for (uint32_t seq = 1; seq <= src.second.maxSeq; seq++) {
+      if (cfg_.poisonEvery > 0 && seq % cfg_.poisonEvery == 0) continue;
+      gaps += it->second[seq] ? 0 : 1;
+    }
+    src.second.gaps = gaps;
+  }
+  return out;
+}
+
+// Records one event; false when (node, epoch, seq) was stored before.
+bool IngestSink::store(const std::string &node, uint32_t epoch, uint32_t seq) {
+  Source &src = stats_.sources[node];
+  std::vector<bool> &seen = seen_[std::make_pair(node, epoch)];
+  if (seen.empty()) src.epochs++;
+  if (epoch > src.epoch) {
+    src.epoch = epoch;
+    src.maxSeq = 0;
+  }
+  if (epoch == src.epoch && seq > src.maxSeq) src.maxSeq = seq;
+  if (seq >= seen.size()) seen.resize(std::max<size_t>(seq + 1, seen.size() * 2));
+  if (seen[seq]) {
+    src.duplicates++;
+    stats_.duplicates++;
+    return false;
+  }
+  seen[seq] = true;
+  src.events++;
+  return true;
+}
+
+void IngestSink::run() {
+  while (!stop_) {
+    pollfd p = {listenFd_, POLLIN, 0};
+    if (poll(&p, 1, 50) != 1) continue;
+    int fd = accept(listenFd_, nullptr, nullptr);
+    if (fd < 0) continue;
+    // Back-to-back PUBACKs and pipelined responses would otherwise wait
+    // for the node's delayed ACK.
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    serve(fd);
+    close(fd);
+  }
+}
+
+void IngestSink::serve(int fd) {
+  std::string buf;
+  char chunk[16384];
+  SinkOutbox out(fd, cfg_.rttMs);
+  while (!stop_) {
+    if (!out.flush()) return;
+    if (!buf.empty() && (uint8_t)buf[0] == 0x10) {
+      serveMqtt(fd, buf);
+      return;
+    }
+    size_t headEnd = buf.find("\r\n\r\n");
+    if (headEnd != std::string::npos) {
+      std::string head = buf.substr(0, headEnd + 2);
+      size_t bodyLen = strtoul(header(head, "Content-Length").c_str(), nullptr, 10);
+      if (buf.size() >= headEnd + 4 + bodyLen) {
+        std::string body = buf.substr(headEnd + 4, bodyLen);
+        buf.erase(0, headEnd + 4 + bodyLen);
+        if (!handle(out, head, body)) {
+          out.flush(true);
+          return;
+        }
+        continue;
+      }
+    }
+    pollfd p = {fd, POLLIN, 0};
+    if (poll(&p, 1, out.waitMs(50)) != 1) continue;
+    ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+    if (n <= 0) return;
+    buf.append(chunk, (size_t)n);
+  }
+}
+
+bool IngestSink::handle(SinkOutbox &out, const std::string &head, const std::string &body) {
+  rng_ = rng_ * 1103515245u + 12345u;
+  bool fail = cfg_.failPct > 0 && (rng_ >> 16) % 100 < cfg_.failPct;
+  rng_ = rng_ * 1103515245u + 12345u;
+  const bool drop = cfg_.dropPct > 0 && (rng_ >> 16) % 100 < cfg_.dropPct;
+  rng_ = rng_ * 1103515245u + 12345u;
+  const uint32_t partialRoll = rng_ >> 16;
+  const bool cbor = header(head, "Content-Type") == "application/cbor";
+  const bool reject = cbor && cfg_.rejectCbor;
+  char ack[64] = "";
+  bool poison = false;
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    stats_.requests++;
+    stats_.bodyBytes += body.size();
+    std::string plain = body;
+    bool decoded = true;
+    if (fail || reject) {
+      stats_.failed++;
+      decoded = false;
+    } else if (header(head, "Content-Encoding") == "gzip") {
+#if HOST_HAVE_ZLIB
+      plain.clear();
+      decoded = gunzip(body, plain);
+#else
+      decoded = false;
+#endif
+      if (!decoded) stats_.undecoded++;
+    }
+    if (decoded && cbor) {
+      std::string json;
+      decoded = decodeCbor(plain, json);
+      plain.swap(json);
+      if (decoded) stats_.cbor++;
+      else stats_.undecoded++;
+    }
+    std::vector<SinkEvent> events;
+    if (decoded) scanEvents(plain, events);
+    for (const SinkEvent &ev : events) {
+      poison |= cfg_.poisonEvery > 0 && ev.hasSeq && ev.seq % cfg_.poisonEvery == 0;
+    }
+    if (poison) {
+      stats_.poisoned++;
+      events.clear();
+    }
+    size_t keep = events.size();
+    if (keep > 1 && cfg_.partialPct > 0 && partialRoll % 100 < cfg_.partialPct) {
+      keep = 1 + (partialRoll / 100) % (keep - 1);
+      stats_.partial++;
+    }
+    for (size_t i = 0; i < keep; i++) {
+      const SinkEvent &ev = events[i];
+      if (ev.hasSeq && !store(ev.node, ev.epoch, ev.seq)) continue;
+      stats_.events++;
+      stats_.byType[ev.type]++;
+    }
+    if (keep > 0 && events[keep - 1].hasSeq) {
+      snprintf(ack, sizeof(ack), ",\"ack_epoch\":%u,\"ack_seq\":%u", (unsigned)events[keep - 1].epoch,
+               (unsigned)events[keep - 1].seq);
+    }
+    if (drop && !fail && !reject && !poison) stats_.dropped++;
+  }
+  if (cfg_.delayMs > 0) std::this_thread::sleep_for(std::chrono::milliseconds(cfg_.delayMs));
+  if (drop && !fail && !reject && !poison) return false;
+  static const char kFail[] =
+      "HTTP/1.1 503 Service Unavailable\r\nContent-Type: application/json\r\nContent-Length: "
+      "12\r\n\r\n{\"ok\":false}";
+  static const char kUnsupported[] =
+      "HTTP/1.1 415 Unsupported Media Type\r\nContent-Type: application/json\r\nContent-Length: "
+      "12\r\n\r\n{\"ok\":false}";
+  static const char kBadEvent[] =
+      "HTTP/1.1 400 Bad Request\r\nContent-Type: application/json\r\nContent-Length: "
+      "12\r\n\r\n{\"ok\":false}";
+  char ok[256];
+  char okBody[96];
+  int bodyLen = snprintf(okBody, sizeof(okBody), "{\"ok\":true%s}", ack);
+  snprintf(ok, sizeof(ok),
+           "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: %d\r\n\r\n%s",
+           bodyLen, okBody);
+  const char *resp = reject ? kUnsupported : fail ? kFail : poison ? kBadEvent : ok;
+  out.add(resp, strlen(resp));
+  return true;
+}
+
+void IngestSink::serveMqtt(int fd, std::string &buf) {
+  char chunk[16384];
+  SinkOutbox out(fd, cfg_.rttMs);
+  while (!stop_) {
+    if (!out.flush()) return;
+    // Fixed header: type and flags, then up to four bytes of length.
+    size_t len = 0;
+    size_t bodyAt = 0;
+    for (size_t i = 1; i < buf.size() && i <= 4; i++) {
+      len |= size_t((uint8_t)buf[i] & 0x7F) << (7 * (i - 1));
+      if (((uint8_t)buf[i] & 0x80) == 0) {
+        bodyAt = i + 1;
+        break;
+      }
+      if (i == 4) return;
+    }
+    if (bodyAt > 0 && buf.size() >= bodyAt + len) {
+      const uint8_t header = (uint8_t)buf[0];
+      std::string body = buf.substr(bodyAt, len);
+      buf.erase(0, bodyAt + len);
+      if (!handleMqtt(out, header, body)) {
+        out.flush(true);
+        return;
+      }
+      continue;
+    }
+    pollfd p = {fd, POLLIN, 0};
+    if (poll(&p, 1, out.waitMs(50)) != 1) continue;
+    ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+    if (n <= 0) return;
+    buf.append(chunk, (size_t)n);
+  }
+}
+
+bool IngestSink::handleMqtt(SinkOutbox &out, uint8_t header, const std::string &body) {
+  switch (header >> 4) {
+    case 1: {  // CONNECT
+      {
+        std::lock_guard<std::mutex> lock(mu_);
+        stats_.mqttSessions++;
+      }
+      static const uint8_t kConnack[] = {0x20, 2, 0, 0};
+      out.add(kConnack, sizeof(kConnack));
+      return true;
+    }
+    case 12: {  // PINGREQ
+      static const uint8_t kPingresp[] = {0xD0, 0};
+      out.add(kPingresp, sizeof(kPingresp));
+      return true;
+    }
+    case 3:  // PUBLISH
+      break;
+    default:  // DISCONNECT, or nothing a publisher sends
+      return false;
+  }
+  const uint8_t qos = (header >> 1) & 3;
+  size_t pos = body.size() >= 2 ? 2 + ((uint8_t)body[0] << 8 | (uint8_t)body[1]) : body.size() + 1;
+  uint16_t packetId = 0;
+  if (qos > 0 && pos + 2 <= body.size()) {
+    packetId = (uint16_t)((uint8_t)body[pos] << 8 | (uint8_t)body[pos + 1]);
+    pos += 2;
+  }
+  if (pos > body.size()) return false;
+  rng_ = rng_ * 1103515245u + 12345u;
+  const bool fail = cfg_.failPct > 0 && (rng_ >> 16) % 100 < cfg_.failPct;
+  rng_ = rng_ * 1103515245u + 12345u;
+  const bool drop = cfg_.dropPct > 0 && (rng_ >> 16) % 100 < cfg_.dropPct;
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    stats_.requests++;
+    stats_.mqttPublishes++;
+    stats_.bodyBytes += body.size() - pos;
+    if (fail) {
+      stats_.failed++;
+    } else {
+      std::vector<SinkEvent> events;
+      scanEvents(body.substr(pos), events);
+      for (const SinkEvent &ev : events) {
+        if (ev.hasSeq && !store(ev.node, ev.epoch, ev.seq)) continue;
+        stats_.events++;
+        stats_.byType[ev.type]++;
+      }
+      if (drop) stats_.dropped++;
+    }
+  }
+  if (cfg_.delayMs > 0) std::this_thread::sleep_for(std::chrono::milliseconds(cfg_.delayMs));
+  if (fail || drop) return false;
+  if (qos == 0) return true;
+  const uint8_t puback[] = {0x40, 2, (uint8_t)(packetId >> 8), (uint8_t)(packetId & 0xFF)};
+  out.add(puback, sizeof(puback));
+  return true;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Minimal HTTP/1.1 ingest endpoint for replay runs and as a stand-in for the
+// spine (tools/host-sink.sh). Accepts keep-alive connections and pipelined
+// POSTs, reads the events in each body (a JSON object or an array of
+// objects, or a CBOR batch read with the reference decoder; gzip bodies when
+// built with zlib) and answers 200 with ack_epoch/ack_seq for the last event
+// stored (lib/node-core/ingest_ack.h), or 503 for a configurable share of
+// requests, or 400 for any batch holding a "poison" event. Events are
+// deduplicated by (node_id, epoch, seq).
+//
+// A connection that opens with an MQTT CONNECT is served as a broker
+// instead: PUBLISH payloads are read as JSON batches, QoS 1 ones are
+// acknowledged with PUBACK, in order, and PINGREQ is answered. failPct and
+// dropPct apply to PUBLISHes: a failed one is not stored, and either closes
+// the connection without a PUBACK.
+class SinkOutbox;
+
+class IngestSink {
+ public:
+  struct Config {
+    uint32_t delayMs = 0;  // per response, real time
+    // Round trip stand-in: each reply goes out this long after its request
+    // arrived, while later requests are read and answered on their own
+    // schedule. A pipelined client pays it once per window, not per request.
+    uint32_t rttMs = 0;
+    uint8_t failPct = 0;
+    // Share of multi-event batches of which only a random prefix is stored
+    // and acknowledged.
+    uint8_t partialPct = 0;
+    // Share of requests stored but never answered: the connection is closed
+    // instead, as when a response is lost.
+    uint8_t dropPct = 0;
+    bool rejectCbor = false;  // answer CBOR bodies with 415
+    // When set, events whose seq is a multiple of it are poison: a batch
+    // holding one is refused whole with 400 and none of it stored. Their
+    // seqs do not count as gaps.
+    uint32_t poisonEvery = 0;
+    uint32_t seed = 1;
+    uint16_t port = 0;        // 0 picks an ephemeral port
+    bool listenAll = false;   // all interfaces instead of 127.0.0.1
+  };
+
+  // Events from one node_id; the seq figures cover its latest epoch.
+  struct Source {
+    uint32_t epoch = 0;
+    uint32_t epochs = 0;  // distinct epochs seen
+    uint64_t events = 0;
+    uint64_t duplicates = 0;
+    uint32_t maxSeq = 0;
+    uint32_t gaps = 0;  // seqs in 1..maxSeq never received
+  };
+
+  struct Stats {
+    uint64_t requests = 0;
+    uint64_t failed = 0;
+    uint64_t poisoned = 0;  // batches refused with 400
+    uint64_t mqttSessions = 0;
+    uint64_t mqttPublishes = 0;  // also counted in requests
+    uint64_t partial = 0;  // batches stored and acknowledged in part
+    uint64_t dropped = 0;  // responses withheld
+    uint64_t events = 0;   // stored, not counting duplicates
+    uint64_t duplicates = 0;
+    uint64_t bodyBytes = 0;
+    uint64_t cbor = 0;       // CBOR bodies decoded
+    uint64_t undecoded = 0;  // gzip bodies without zlib, malformed CBOR
+    std::map<std::string, uint64_t> byType;
+    std::map<std::string, Source> sources;
+  };
+
+  explicit IngestSink(const Config &cfg) : cfg_(cfg) {}
+  ~IngestSink() { stop(); }
+
+  // Binds Config::port; returns the port, or 0 on failure.
+  uint16_t start();
+  void stop();
+  Stats stats();
+
+ private:
+  void run();
+  void serve(int fd);
+  bool handle(SinkOutbox &out, const std::string &head, const std::string &body);
+  void serveMqtt(int fd, std::string &buf);
+  bool handleMqtt(SinkOutbox &out, uint8_t header, const std::string &body);
+  bool store(const std::string &node, uint32_t epoch, uint32_t seq);
+
+  Config cfg_;
+  int listenFd_ = -1;
+  std::thread thread_;
+  std::atomic<bool> stop_{false};
+  std::mutex mu_;
+  Stats stats_;
+  // Seqs received per (node_id, epoch), as a bitmap.
+  std::map<std::pair<std::string, uint32_t>, std::vector<bool>> seen_;
+  uint32_t rng_ = 0;
+};
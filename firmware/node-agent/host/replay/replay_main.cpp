@@ -0,0 +1,451 @@
+// Replays a BLE advert trace through the firmware's AdvertisedCallback and
+// loop(), with ingest going to a local HTTP sink (or MQTT broker) and UDP
+// telemetry to a local collector, and reports throughput, drops, heap and
+// ingest latency. Built by tools/host-replay.sh or the PlatformIO `native`
+// environment.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <Arduino.h>
+
+#include "host_hooks.h"
+#include "ingest_sink.h"
+#include "replay_trace.h"
+#include "udp_collector.h"
+
+void setup();
+void loop();
+
+namespace {
+
+struct Options {
+  const char *trace = nullptr;
+  const char *writeTracePath = nullptr;
+  SyntheticTraceConfig synthetic;
+  IngestSink::Config sink;
+  UdpCollector::Config collector;
+  bool udp = false;
+  bool threaded = false;
+  bool realtime = false;
+  bool json = false;
+  uint32_t drainMs = 30000;
+  const char *mode = nullptr;
+  const char *uplink = "http";
+  const char *mqttUrl = nullptr;  // an outside broker instead of the sink
+  uint32_t httpClients = 0;
+  uint32_t httpSlowMs = 0;
+};
+
+void usage() {
+  fprintf(stderr,
+          "usage: replay [--trace FILE] [--devices N] [--duration-ms N] [--seed N]\n"
+          "              [--rotating-pct N] [--write-trace FILE] [--sink-delay-ms N] [--sink-rtt-ms N]\n"
+          "              [--sink-fail-pct N] [--sink-partial-pct N] [--sink-drop-pct N]\n"
+          "              [--sink-reject-cbor] [--sink-poison-every N] [--mode raw|digest]\n"
+          "              [--uplink http|mqtt] [--mqtt-url URL]\n"
+          "              [--udp] [--udp-drop-pct N] [--udp-reorder-pct N]\n"
+          "              [--drain-ms N] [--threaded] [--realtime] [--json]\n"
+          "              [--http-clients N] [--http-slow-ms N]\n");
+}
+
+bool parseArgs(int argc, char **argv, Options &o) {
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    const char *v = i + 1 < argc ? argv[i + 1] : nullptr;
+    auto num = [&](uint32_t &out) {
+      if (!v) return false;
+      out = (uint32_t)strtoul(v, nullptr, 10);
+      i++;
+      return true;
+    };
+    uint32_t n = 0;
+    if (a == "--trace" && v) {
+      o.trace = v;
+      i++;
+    } else if (a == "--write-trace" && v) {
+      o.writeTracePath = v;
+      i++;
+    } else if (a == "--mode" && v) {
+      o.mode = v;
+      i++;
+    } else if (a == "--uplink" && v && (strcmp(v, "http") == 0 || strcmp(v, "mqtt") == 0)) {
+      o.uplink = v;
+      i++;
+    } else if (a == "--mqtt-url" && v) {
+      o.mqttUrl = v;
+      o.uplink = "mqtt";
+      i++;
+    } else if (a == "--udp") {
+      o.udp = true;
+    } else if (a == "--udp-drop-pct" && num(n)) {
+      o.collector.dropPct = (uint8_t)std::min<uint32_t>(n, 100);
+      o.udp = true;
+    } else if (a == "--udp-reorder-pct" && num(n)) {
+      o.collector.reorderPct = (uint8_t)std::min<uint32_t>(n, 100);
+      o.udp = true;
+    } else if (a == "--devices" && num(o.synthetic.devices)) {
+    } else if (a == "--duration-ms" && num(o.synthetic.durationMs)) {
+    } else if (a == "--seed" && num(o.synthetic.seed)) {
+    } else if (a == "--rotating-pct" && num(n)) {
+      o.synthetic.rotatingPct = (uint8_t)std::min<uint32_t>(n, 100);
+    } else if (a == "--sink-delay-ms" && num(o.sink.delayMs)) {
+    } else if (a == "--sink-rtt-ms" && num(o.sink.rttMs)) {
+    } else if (a == "--sink-fail-pct" && num(n)) {
+      o.sink.failPct = (uint8_t)std::min<uint32_t>(n, 100);
+    } else if (a == "--sink-partial-pct" && num(n)) {
+      o.sink.partialPct = (uint8_t)std::min<uint32_t>(n, 100);
+    } else if (a == "--sink-drop-pct" && num(n)) {
+      o.sink.dropPct = (uint8_t)std::min<uint32_t>(n, 100);
+    } else if (a == "--sink-reject-cbor") {
+      o.sink.rejectCbor = true;
+    } else if (a == "--sink-poison-every" && num(o.sink.poisonEvery)) {
+    } else if (a == "--drain-ms" && num(o.drainMs)) {
+    } else if (a == "--http-clients" && num(o.httpClients)) {
+    } else if (a == "--http-slow-ms" && num(o.httpSlowMs)) {
+    } else if (a == "--threaded") {
+      o.threaded = true;
+    } else if (a == "--realtime") {
+      o.realtime = true;
+    } else if (a == "--json") {
+      o.json = true;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Numeric field from a flat JSON object such as the /metrics body.
+double jsonNumber(const std::string &body, const char *key) {
+  std::string needle = std::string("\"") + key + "\":";
+  size_t p = body.find(needle);
+  return p == std::string::npos ? 0 : strtod(body.c_str() + p + needle.size(), nullptr);
+}
+
+// A number inside the /metrics pipeline object for one stage.
+double stageNumber(const std::string &body, const char *stage, const char *key) {
+  size_t p = body.find(std::string("\"") + stage + "\":{", body.find("\"pipeline\":"));
+  return p == std::string::npos ? 0 : jsonNumber(body.substr(p, body.find('}', p) - p), key);
+}
+
+std::string fetch(const char *uri, const char *query = "") {
+  HostHttpResponse resp;
+  if (!hostHttpRequest("GET", uri, query, "", resp)) return "";
+  return resp.body;
+}
+
+void deliver(const TraceAdvert &a) { hostBleAdvert(a.addr, a.addrType, a.rssi, a.payload, a.len); }
+
+// The firmware's tasks never return, so leave without running static
+// destructors under them.
+[[noreturn]] void exitRun() {
+  fflush(stdout);
+  std::quick_exit(0);
+}
+
+double percentile(std::vector<uint32_t> v, double p) {
+  if (v.empty()) return 0;
+  size_t i = (size_t)(p * (v.size() - 1));
+  std::nth_element(v.begin(), v.begin() + i, v.end());
+  return v[i];
+}
+
+// Status requests a dashboard would make, in a loop on each client thread
+// while the trace plays; one in 64 is a probe.
+struct HttpLoad {
+  std::atomic<bool> stop{false};
+  std::vector<std::thread> threads;
+  std::vector<std::vector<uint32_t>> latencyUs;
+  std::atomic<uint64_t> errors{0};
+
+  void start(uint32_t clients) {
+    latencyUs.resize(clients);
+    for (uint32_t c = 0; c < clients; c++) {
+      threads.emplace_back([this, c] {
+        static const char *const kUris[] = {"/metrics", "/metrics/prom", "/ble/latest", "/ble/stats",
+                                            "/health", "/config", "/wifi"};
+        for (uint32_t n = 0; !stop; n++) {
+          HostHttpResponse resp;
+          auto t0 = std::chrono::steady_clock::now();
+          bool ok = n % 64 == 63 ? hostHttpRequest("POST", "/probe", "", "{\"emit\":false}", resp)
+                               : hostHttpRequest("GET", kUris[(n + c) % 7], "", "", resp);
+          auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+              std::chrono::steady_clock::now() - t0);
+          latencyUs[c].push_back((uint32_t)us.count());
+          // 503: a probe refused while earlier ones still run.
+          if (!ok || (resp.code >= 500 && resp.code != 503)) errors++;
+        }
+      });
+    }
+  }
+
+  void finish() {
+    stop = true;
+    for (std::thread &t : threads) t.join();
+  }
+
+  std::vector<uint32_t> all() const {
+    std::vector<uint32_t> v;
+    for (const auto &l : latencyUs) v.insert(v.end(), l.begin(), l.end());
+    return v;
+  }
+};
+
+// Work the firmware still holds: queued events, adverts not yet drained
+// and spilled events waiting for replay.
+bool firmwareIdle() {
+  std::string m = fetch("/metrics");
+  return jsonNumber(m, "event_queue_depth") == 0 && jsonNumber(m, "spill_pending_bytes") == 0 &&
+         fetch("/ble/stats").find("\"raw_depth\":0") != std::string::npos;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  Options opt;
+  if (!parseArgs(argc, argv, opt)) {
+    usage();
+    return 2;
+  }
+
+  std::vector<TraceAdvert> trace;
+  if (opt.trace) {
+    std::string err;
+    if (!loadTrace(opt.trace, trace, err)) {
+      fprintf(stderr, "replay: %s\n", err.c_str());
+      return 1;
+    }
+  } else {
+    makeSyntheticTrace(opt.synthetic, trace);
+  }
+  if (opt.writeTracePath) {
+    if (!writeTrace(opt.writeTracePath, trace)) {
+      fprintf(stderr, "replay: cannot write %s\n", opt.writeTracePath);
+      return 1;
+    }
+    return 0;
+  }
+
+  IngestSink sink(opt.sink);
+  uint16_t port = sink.start();
+  if (port == 0) {
+    fprintf(stderr, "replay: cannot start ingest sink\n");
+    return 1;
+  }
+  UdpCollector collector(opt.collector);
+  uint16_t udpPort = opt.udp ? collector.start() : 0;
+  if (opt.udp && udpPort == 0) {
+    fprintf(stderr, "replay: cannot start UDP collector\n");
+    return 1;
+  }
+  char collectorSpec[32] = "";
+  if (opt.udp) snprintf(collectorSpec, sizeof(collectorSpec), "127.0.0.1:%u", udpPort);
+  char url[64];
+  snprintf(url, sizeof(url), "http://127.0.0.1:%u/v1/ingest", port);
+  char brokerUrl[64];
+  snprintf(brokerUrl, sizeof(brokerUrl), "mqtt://127.0.0.1:%u/replay", port);
+  const bool mqtt = strcmp(opt.uplink, "mqtt") == 0;
+  hostPrefsSet("wifi", "node_id", "replay-node");
+  hostPrefsSet("wifi", "ingest_url", url);
+  hostPrefsSet("uplink", "mqtt", mqtt ? "1" : "0");
+  hostPrefsSet("uplink", "mqtt_url", opt.mqttUrl ? opt.mqttUrl : brokerUrl);
+  hostPrefsSet("udp", "collector", collectorSpec);
+  hostPrefsSet("wifi", "ssid", "replay");
+  hostPrefsSet("wifi", "pass", "replay");
+  if (opt.mode) hostPrefsSet("ble", "digest", strcmp(opt.mode, "digest") == 0 ? "1" : "0");
+  hostSetRealtime(opt.realtime);
+
+  hostHeapTrack(true);
+  setup();
+  hostWifiPoll();
+
+  hostHttpSetSendDelayMs(opt.httpSlowMs);
+  HttpLoad load;
+  load.start(opt.httpClients);
+
+  auto wallStart = std::chrono::steady_clock::now();
+  const unsigned long base = millis();
+  uint64_t loops = 0;
+  size_t next = 0;
+  // Wall time of each loop() pass while the trace plays.
+  std::vector<uint32_t> loopUs;
+
+  std::atomic<bool> feederDone{false};
+  std::thread feeder;
+  if (opt.threaded) {
+    // Adverts arrive from a second thread, as from the NimBLE host task.
+    feeder = std::thread([&] {
+      hostHeapTrack(true);
+      for (const TraceAdvert &a : trace) {
+        while (millis() - base < a.tsMs) std::this_thread::yield();
+        deliver(a);
+      }
+      feederDone = true;
+    });
+  }
+
+  while (opt.threaded ? !feederDone : next < trace.size()) {
+    if (!opt.threaded) {
+      unsigned long now = millis() - base;
+      while (next < trace.size() && trace[next].tsMs <= now) deliver(trace[next++]);
+    }
+    hostWifiPoll();
+    auto t0 = std::chrono::steady_clock::now();
+    loop();
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0);
+    // The harness's own buffers stay out of the heap numbers.
+    hostHeapTrack(false);
+    loopUs.push_back((uint32_t)us.count());
+    hostHeapTrack(true);
+    loops++;
+  }
+  if (feeder.joinable()) feeder.join();
+  load.finish();
+  hostHttpSetSendDelayMs(0);
+  const unsigned long replayEnd = millis();
+  auto replayWall = std::chrono::steady_clock::now();
+
+  // Let the firmware drain what it holds.
+  while (millis() - replayEnd < opt.drainMs) {
+    for (int i = 0; i < 200; i++) {
+      hostWifiPoll();
+      loop();
+      loops++;
+    }
+    if (firmwareIdle()) break;
+  }
+  auto wallEnd = std::chrono::steady_clock::now();
+  const double wallSec = std::chrono::duration<double>(wallEnd - wallStart).count();
+  const double replaySec = std::chrono::duration<double>(replayWall - wallStart).count();
+  const double traceSec = trace.empty() ? 0 : trace.back().tsMs / 1000.0;
+
+  hostHeapTrack(false);
+  std::string m = fetch("/metrics");
+  HostHeapStats heap = hostHeapStats();
+  sink.stop();
+  IngestSink::Stats s = sink.stats();
+  collector.stop();
+  UdpCollector::Stats u = collector.stats();
+  const UdpCollector::Source udp =
+      u.sources.count("replay-node") ? u.sources["replay-node"] : UdpCollector::Source();
+
+  const double advertRate = replaySec > 0 ? trace.size() / replaySec : 0;
+  const double eventRate = wallSec > 0 ? s.events / wallSec : 0;
+  const double speedup = replaySec > 0 ? traceSec / replaySec : 0;
+  const uint64_t bleSeen = s.byType.count("ble.seen") ? s.byType["ble.seen"] : 0;
+  const uint64_t bleDigest = s.byType.count("ble.digest") ? s.byType["ble.digest"] : 0;
+  const std::vector<uint32_t> httpUs = load.all();
+  uint32_t seqGaps = 0;
+  for (const auto &src : s.sources) seqGaps += src.second.gaps;
+
+  if (opt.json) {
+    printf("{\"uplink\":\"%s\",\"acked_events\":%.0f,\"adverts\":%zu,\"trace_s\":%.3f,\"wall_s\":%.3f,\"speedup\":%.1f,"
+           "\"adverts_per_s\":%.0f,\"events\":%llu,\"events_per_s\":%.0f,\"ble_seen\":%llu,"
+           "\"ble_digest\":%llu,\"ble_coalesced\":%.0f,\"posts\":%llu,\"posts_failed\":%llu,"
+           "\"posts_cbor\":%llu,\"posts_partial\":%llu,\"posts_unanswered\":%llu,"
+           "\"duplicates\":%llu,\"seq_gaps\":%u,\"posts_poisoned\":%llu,\"quarantined\":%.0f,"
+           "\"scan_drops\":%u,"
+           "\"ble_raw_drops\":%.0f,\"ble_suppressed\":%.0f,\"event_drops\":%.0f,"
+           "\"spill_appended\":%.0f,\"heap_peak_bytes\":%zu,\"heap_live_bytes\":%zu,"
+           "\"ingest_latency_avg_ms\":%.0f,\"ingest_post_avg_ms\":%.0f,\"ingest_post_p99_ms\":%.0f,"
+           "\"queue_residence_p99_ms\":%.0f,\"ble_callback_p99_us\":%.0f,\"loop_p99_us\":%.0f,"
+           "\"loop_wall_p50_us\":%.0f,\"loop_wall_p99_us\":%.0f,\"http_requests\":%zu,"
+           "\"http_errors\":%llu,\"http_p99_us\":%.0f,\"capture_peak_pct\":%.1f,"
+           "\"worker_peak_pct\":%.1f,\"net_peak_pct\":%.1f,\"udp_datagrams\":%llu,"
+           "\"udp_observations\":%llu,\"udp_lost\":%u,\"udp_reordered\":%llu,"
+           "\"udp_obs_missing\":%llu,\"udp_skipped\":%.0f,\"udp_age_p99_ms\":%u,\"loops\":%llu}\n",
+           opt.uplink, jsonNumber(m, "ingest_acked_events"), trace.size(), traceSec, wallSec, speedup,
+           advertRate, (unsigned long long)s.events,
+           eventRate, (unsigned long long)bleSeen, (unsigned long long)bleDigest,
+           jsonNumber(m, "ble_coalesced"), (unsigned long long)s.requests, (unsigned long long)s.failed,
+           (unsigned long long)s.cbor, (unsigned long long)s.partial, (unsigned long long)s.dropped,
+           (unsigned long long)s.duplicates, seqGaps, (unsigned long long)s.poisoned,
+           jsonNumber(m, "ingest_quarantined"), hostBleAdvertsDropped(),
+           jsonNumber(m, "ble_raw_drops"),
+           jsonNumber(m, "ble_suppressed_device") + jsonNumber(m, "ble_suppressed_global"),
+           jsonNumber(m, "event_drop_count"), jsonNumber(m, "spill_appended"), heap.peakBytes,
+           heap.liveBytes, jsonNumber(m, "ingest_latency_avg_ms"), jsonNumber(m, "ingest_post_avg_ms"),
+           jsonNumber(m, "ingest_post_p99_ms"),
+           jsonNumber(m, "queue_residence_p99_ms"), jsonNumber(m, "ble_callback_p99_us"),
+           jsonNumber(m, "loop_p99_us"), percentile(loopUs, 0.5), percentile(loopUs, 0.99),
+           httpUs.size(), (unsigned long long)load.errors.load(), percentile(httpUs, 0.99),
+           stageNumber(m, "capture", "peak_pct"), stageNumber(m, "worker", "peak_pct"),
+           stageNumber(m, "net", "peak_pct"), (unsigned long long)udp.datagrams,
+           (unsigned long long)udp.observations, (unsigned)udp.lost(), (unsigned long long)udp.reordered,
+           (unsigned long long)udp.obsMissing(), jsonNumber(m, "udp_skipped"),
+           (unsigned)udp.ageQuantile(0.99), (unsigned long long)loops);
+    exitRun();
+  }
+
+  printf("replay: %zu adverts over %.1f s of trace in %.2f s wall (%.0fx), %llu loop passes\n",
+         trace.size(), traceSec, replaySec, speedup, (unsigned long long)loops);
+  printf("  adverts/s          %10.0f\n", advertRate);
+  printf("  events at sink     %10llu  (%.0f/s over %.2f s incl. drain)\n",
+         (unsigned long long)s.events, eventRate, wallSec);
+  for (const auto &t : s.byType) {
+    printf("    %-16s %10llu\n", t.first.c_str(), (unsigned long long)t.second);
+  }
+  printf("  ble.seen coalesced %10.0f\n", jsonNumber(m, "ble_coalesced"));
+  printf("  ingest POSTs       %10llu  (%llu refused, %llu CBOR, %llu bytes)\n",
+         (unsigned long long)s.requests, (unsigned long long)s.failed, (unsigned long long)s.cbor,
+         (unsigned long long)s.bodyBytes);
+  printf("  acks               %10llu partial, %llu unanswered; %llu duplicates dropped, %u seq gaps\n",
+         (unsigned long long)s.partial, (unsigned long long)s.dropped,
+         (unsigned long long)s.duplicates, seqGaps);
+  if (opt.sink.poisonEvery > 0) {
+    printf("  poison             %10llu batches refused, %.0f events quarantined\n",
+           (unsigned long long)s.poisoned, jsonNumber(m, "ingest_quarantined"));
+  }
+  if (s.undecoded > 0) {
+    printf("  bodies not decoded (gzip without zlib, bad CBOR): %llu\n",
+           (unsigned long long)s.undecoded);
+  }
+  printf("  drops: scan off %u, raw ring %.0f, sampler %.0f, event queue %.0f, spilled %.0f\n",
+         hostBleAdvertsDropped(), jsonNumber(m, "ble_raw_drops"),
+         jsonNumber(m, "ble_suppressed_device") + jsonNumber(m, "ble_suppressed_global"),
+         jsonNumber(m, "event_drop_count"), jsonNumber(m, "spill_appended"));
+  printf("  heap high-water    %10zu bytes (live at end %zu, %llu allocations)\n", heap.peakBytes,
+         heap.liveBytes, (unsigned long long)heap.allocations);
+  const double acked = jsonNumber(m, "ingest_acked_events");
+  printf("  uplink %-11s %10.0f events acked (%.0f/s), %.0f batches, %.0f conn opens%s\n",
+         opt.uplink, acked, wallSec > 0 ? acked / wallSec : 0, jsonNumber(m, "ingest_ok_count"),
+         jsonNumber(m, "ingest_conn_opens"), opt.mqttUrl ? " (outside broker)" : "");
+  if (opt.udp) {
+    printf("  udp telemetry      %10llu observations (%.0f/s) in %llu datagrams; %u lost, %llu reordered, "
+           "%llu observations missing, %.0f skipped on the node\n",
+           (unsigned long long)udp.observations, wallSec > 0 ? udp.observations / wallSec : 0,
+           (unsigned long long)udp.datagrams, (unsigned)udp.lost(), (unsigned long long)udp.reordered,
+           (unsigned long long)udp.obsMissing(), jsonNumber(m, "udp_skipped"));
+    printf("  udp age at send    p50 <= %u ms, p99 <= %u ms, max %u ms\n", (unsigned)udp.ageQuantile(0.5),
+           (unsigned)udp.ageQuantile(0.99), (unsigned)udp.ageMax);
+  }
+  // avg and p99 come from the same histogram, over every POST of the run;
+  // the batch controller's moving average is printed apart as "recent".
+  printf("  ingest latency     avg %.0f ms, p99 <= %.0f ms over the run, recent avg %.0f ms; "
+         "queue residence p99 <= %.0f ms\n",
+         jsonNumber(m, "ingest_post_avg_ms"), jsonNumber(m, "ingest_post_p99_ms"),
+         jsonNumber(m, "ingest_latency_avg_ms"), jsonNumber(m, "queue_residence_p99_ms"));
+  printf("  BLE callback p99 <= %.0f us; loop pass p99 <= %.0f us\n",
+         jsonNumber(m, "ble_callback_p99_us"), jsonNumber(m, "loop_p99_us"));
+  printf("  loop() wall time   p50 %.0f us, p99 %.0f us, max %.0f us (during the trace)\n",
+         percentile(loopUs, 0.5), percentile(loopUs, 0.99), percentile(loopUs, 1.0));
+  printf("  pipeline           %s, peak busy capture %.1f%%, worker %.1f%%, net %.1f%%\n",
+         m.find("\"mode\":\"tasks\"") != std::string::npos ? "net task" : "cooperative",
+         stageNumber(m, "capture", "peak_pct"), stageNumber(m, "worker", "peak_pct"),
+         stageNumber(m, "net", "peak_pct"));
+  if (opt.httpClients > 0) {
+    printf("  HTTP load          %zu requests from %u clients (%llu failed), p50 %.0f us, p99 %.0f us\n",
+           httpUs.size(), opt.httpClients, (unsigned long long)load.errors.load(),
+           percentile(httpUs, 0.5), percentile(httpUs, 0.99));
+  }
+  exitRun();
+}
@@ -0,0 +1,222 @@
+#include "replay_trace.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <random>
+
+static int hexNibble(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+static bool parseLine(const char *line, TraceAdvert &a) {
+  unsigned ts = 0;
+  unsigned m[6];
+  unsigned type = 0;
+  int rssi = 0;
+  char hex[256] = "";
+  int n = sscanf(line, "%u %x:%x:%x:%x:%x:%x %u %d %255s", &ts, &m[0], &m[1], &m[2], &m[3], &m[4],
+                 &m[5], &type, &rssi, hex);
+  if (n < 9) return false;
+  a.tsMs = ts;
+  for (int i = 0; i < 6; i++) a.addr[i] = (uint8_t)m[i];
+  a.addrType = (uint8_t)type;
+  a.rssi = (int8_t)rssi;
+  size_t hexLen = strlen(hex);
+  if (hexLen % 2 != 0 || hexLen / 2 > sizeof(a.payload)) return false;
+  for (size_t i = 0; i < hexLen / 2; i++) {
+    int hi = hexNibble(hex[2 * i]);
+    int lo = hexNibble(hex[2 * i + 1]);
+    if (hi < 0 || lo < 0) return false;
+    a.payload[i] = (uint8_t)(hi << 4 | lo);
+  }
+  a.len = (uint8_t)(hexLen / 2);
+  return true;
+}
+
+bool loadTrace(const char *path, std::vector<TraceAdvert> &out, std::string &err) {
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    err = std::string("cannot open ") + path;
+    return false;
+  }
+  char line[512];
+  size_t lineNo = 0;
+  uint32_t lastTs = 0;
+  while (fgets(line, sizeof(line), f)) {
+    lineNo++;
+    const char *p = line;
+    while (*p == ' ' || *p == '\t') p++;
+    if (*p == '#' || *p == '\n' || *p == '\r' || *p == '\0') continue;
+    TraceAdvert a = {};
+    if (!parseLine(p, a) || a.tsMs < lastTs) {
+      err = std::string(path) + ":" + std::to_string(lineNo) + ": bad advert line";
+      fclose(f);
+      return false;
+    }
+    lastTs = a.tsMs;
+    out.push_back(a);
+  }
+  fclose(f);
+  return true;
+}
+
+bool writeTrace(const char *path, const std::vector<TraceAdvert> &adverts) {
+  FILE *f = fopen(path, "w");
+  if (!f) return false;
+  fprintf(f, "# ts_ms addr addr_type rssi payload\n");
+  for (const TraceAdvert &a : adverts) {
+    fprintf(f, "%u %02x:%02x:%02x:%02x:%02x:%02x %u %d ", a.tsMs, a.addr[0], a.addr[1], a.addr[2],
+            a.addr[3], a.addr[4], a.addr[5], a.addrType, a.rssi);
+    for (uint8_t i = 0; i < a.len; i++) fprintf(f, "%02x", a.payload[i]);
+    fputc('\n', f);
+  }
+  return fclose(f) == 0;
+}
+
+namespace {
+
+enum DeviceKind { kPhone, kLaptop, kBeacon, kWearable, kKinds };
+
+struct Device {
+  DeviceKind kind;
+  bool rotating;
+  uint8_t addr[6];
+  uint8_t addrType;
+  uint32_t intervalMs;
+  uint32_t phaseMs;
+  int rssi;
+  uint8_t body[24];  // per-device bytes that stay stable across rotations
+};
+
+class PayloadBuilder {
+ public:
+  explicit PayloadBuilder(TraceAdvert &a) : a_(a) { a_.len = 0; }
+  void ad(uint8_t type, const uint8_t *data, uint8_t len) {
+    if (a_.len + 2 + len > 31) return;
+    a_.payload[a_.len++] = (uint8_t)(len + 1);
+    a_.payload[a_.len++] = type;
+    memcpy(a_.payload + a_.len, data, len);
+    a_.len += len;
+  }
+
+ private:
+  TraceAdvert &a_;
+};
+
+void randomAddress(std::mt19937 &rng, uint8_t addr[6]) {
+  for (int i = 0; i < 6; i++) addr[i] = (uint8_t)rng();
+  addr[0] = (uint8_t)((addr[0] & 0x3F) | 0x40);  // resolvable private
+}
+
+void buildPayload(const Device &d, uint32_t rotation, uint32_t counter, TraceAdvert &a) {
+  PayloadBuilder p(a);
+  static const uint8_t kFlags[] = {0x06};
+  p.ad(0x01, kFlags, sizeof(kFlags));
+  uint8_t m[27];
+  switch (d.kind) {
+    case kPhone:  // Apple Nearby Info: company 0x004C, status bytes vary
+      m[0] = 0x4C;
+      m[1] = 0x00;
+      m[2] = 0x10;
+      m[3] = 0x05;
+      m[4] = d.body[0];
+      m[5] = (uint8_t)(0x18 | (counter & 0x03));
+      memcpy(m + 6, d.body + 1, 3);
+      m[8] ^= (uint8_t)rotation;
+      p.ad(0xFF, m, 9);
+      break;
+    case kLaptop:  // Microsoft CDP beacon: company 0x0006
+      m[0] = 0x06;
+      m[1] = 0x00;
+      m[2] = 0x01;
+      m[3] = 0x09;
+      m[4] = 0x20;
+      m[5] = 0x02;
+      memcpy(m + 6, d.body, 18);
+      m[23] = (uint8_t)rotation;
+      p.ad(0xFF, m, 24);
+      break;
+    case kBeacon: {  // iBeacon
+      m[0] = 0x4C;
+      m[1] = 0x00;
+      m[2] = 0x02;
+      m[3] = 0x15;
+      memcpy(m + 4, d.body, 16);
+      m[20] = 0x00;
+      m[21] = d.body[16];
+      m[22] = 0x00;
+      m[23] = d.body[17];
+      m[24] = 0xC5;
+      p.ad(0xFF, m, 25);
+      break;
+    }
+    default: {  // wearable: name plus heart-rate service
+      char name[12];
+      snprintf(name, sizeof(name), "Band-%02X%02X", d.body[0], d.body[1]);
+      p.ad(0x09, reinterpret_cast<const uint8_t *>(name), (uint8_t)strlen(name));
+      static const uint8_t kHeartRate[] = {0x0D, 0x18};
+      p.ad(0x03, kHeartRate, sizeof(kHeartRate));
+      break;
+    }
+  }
+}
+
+}  // namespace
+
+void makeSyntheticTrace(const SyntheticTraceConfig &cfg, std::vector<TraceAdvert> &out) {
+  // Registered OUIs for the public-address devices, so vendor lookups hit.
+  static const uint8_t kPublicOuis[][3] = {
+      {0xAC, 0x23, 0x3F}, {0x00, 0x80, 0xE1}, {0xF4, 0xF5, 0xD8}, {0x00, 0x1A, 0x7D}};
+  std::mt19937 rng(cfg.seed);
+  std::vector<Device> devices(cfg.devices);
+  for (Device &d : devices) {
+    d.rotating = rng() % 100 < cfg.rotatingPct;
+    d.kind = d.rotating ? (rng() % 2 ? kPhone : kLaptop) : (rng() % 2 ? kBeacon : kWearable);
+    if (d.rotating) {
+      randomAddress(rng, d.addr);
+      d.addrType = 1;
+    } else {
+      memcpy(d.addr, kPublicOuis[rng() % 4], 3);
+      for (int i = 3; i < 6; i++) d.addr[i] = (uint8_t)rng();
+      d.addrType = 0;
+    }
+    d.intervalMs = 100 + rng() % 1900;
+    d.phaseMs = rng() % d.intervalMs;
+    d.rssi = -40 - (int)(rng() % 55);
+    for (uint8_t &b : d.body) b = (uint8_t)rng();
+  }
+
+  std::uniform_int_distribution<int> step(-3, 3);
+  for (size_t i = 0; i < devices.size(); i++) {
+    Device &d = devices[i];
+    uint32_t rotateOffset = cfg.rotateMs > 0 ? (uint32_t)(rng() % cfg.rotateMs) : 0;
+    uint32_t rotation = 0;
+    uint32_t counter = 0;
+    for (uint32_t t = d.phaseMs; t < cfg.durationMs; counter++) {
+      if (d.rotating && cfg.rotateMs > 0) {
+        uint32_t r = (t + rotateOffset) / cfg.rotateMs;
+        if (r != rotation) {
+          rotation = r;
+          randomAddress(rng, d.addr);
+        }
+      }
+      TraceAdvert a = {};
+      a.tsMs = t;
+      memcpy(a.addr, d.addr, 6);
+      a.addrType = d.addrType;
+      d.rssi = std::min(-35, std::max(-100, d.rssi + step(rng)));
+      a.rssi = (int8_t)d.rssi;
+      buildPayload(d, rotation, counter, a);
+      out.push_back(a);
+      // Advertising intervals carry up to 10 ms of random delay.
+      t += d.intervalMs + rng() % 10;
+    }
+  }
+  std::stable_sort(out.begin(), out.end(),
+                   [](const TraceAdvert &a, const TraceAdvert &b) { return a.tsMs < b.tsMs; });
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+// One advert as the NimBLE callback would see it.
+struct TraceAdvert {
+  uint32_t tsMs;       // offset from the start of the trace
+  uint8_t addr[6];     // most significant byte first
+  uint8_t addrType;    // 0 public, 1 random
+  int8_t rssi;
+  uint8_t len;
+  uint8_t payload[62];
+};
+
+// Text trace format, one advert per line, '#' starts a comment:
+//   <ts_ms> <aa:bb:cc:dd:ee:ff> <addr_type> <rssi> <payload hex>
+// Lines must be in timestamp order.
+bool loadTrace(const char *path, std::vector<TraceAdvert> &out, std::string &err);
+bool writeTrace(const char *path, const std::vector<TraceAdvert> &adverts);
+
+struct SyntheticTraceConfig {
+  uint32_t devices = 200;
+  uint32_t durationMs = 60000;
+  uint32_t seed = 1;
+  // Share of devices with a random address that rotates every rotateMs.
+  uint8_t rotatingPct = 40;
+  uint32_t rotateMs = 15 * 60 * 1000;
+};
+
+// A crowded-room mix: phones and laptops with rotating random addresses,
+// beacons and wearables with public addresses, each advertising every
+// 100 ms to 2 s with jitter and a drifting RSSI.
+void makeSyntheticTrace(const SyntheticTraceConfig &cfg, std::vector<TraceAdvert> &out);
@@ -0,0 +1,137 @@
+#include "udp_collector.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "udp_telemetry.h"
+
+uint32_t UdpCollector::Source::ageQuantile(double q) const {
+  uint64_t total = 0;
+  for (uint32_t c : ageBuckets) total += c;
+  if (total == 0) return 0;
+  uint64_t want = (uint64_t)(q * total + 0.5);
+  if (want == 0) want = 1;
+  uint64_t seen = 0;
+  for (size_t i = 0; i < Histogram::kBuckets; i++) {
+    seen += ageBuckets[i];
+    if (seen < want) continue;
+    // The last bucket has no bound, and no bound says more than the maximum.
+    return i + 1 < Histogram::kBuckets && Histogram::bound(i) < ageMax ? Histogram::bound(i) : ageMax;
+  }
+  return ageMax;
+}
+
+uint16_t UdpCollector::start() {
+  fd_ = socket(AF_INET, SOCK_DGRAM, 0);
+  if (fd_ < 0) return 0;
+  // Bursts of datagrams arrive faster than a loaded test machine reads them.
+  int bufBytes = 1 << 20;
+  setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &bufBytes, sizeof(bufBytes));
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(cfg_.listenAll ? INADDR_ANY : INADDR_LOOPBACK);
+  addr.sin_port = htons(cfg_.port);
+  socklen_t len = sizeof(addr);
+  if (bind(fd_, reinterpret_cast<sockaddr *>(&addr), len) != 0 ||
+      getsockname(fd_, reinterpret_cast<sockaddr *>(&addr), &len) != 0) {
+    close(fd_);
+    fd_ = -1;
+    return 0;
+  }
+  rng_ = cfg_.seed;
+  thread_ = std::thread([this] { run(); });
+  return ntohs(addr.sin_port);
+}
+
+void UdpCollector::stop() {
+  stop_ = true;
+  if (thread_.joinable()) thread_.join();
+  if (fd_ >= 0) close(fd_);
+  fd_ = -1;
+}
+
+UdpCollector::Stats UdpCollector::stats() {
+  std::lock_guard<std::mutex> lock(mu_);
+  return stats_;
+}
+
+void UdpCollector::run() {
+  uint8_t buf[65536];
+  std::vector<uint8_t> held;  // a datagram held back to arrive late
+  bool holding = false;
+  while (!stop_) {
+    pollfd p = {fd_, POLLIN, 0};
+    if (poll(&p, 1, 100) <= 0) continue;
+    ssize_t n = recv(fd_, buf, sizeof(buf), 0);
+    if (n < 0) continue;
+    std::lock_guard<std::mutex> lock(mu_);
+    stats_.datagrams++;
+    rng_ = rng_ * 1103515245u + 12345u;
+    if (cfg_.dropPct > 0 && (rng_ >> 16) % 100 < cfg_.dropPct) {
+      stats_.impairedDrops++;
+      continue;
+    }
+    rng_ = rng_ * 1103515245u + 12345u;
+    if (!holding && cfg_.reorderPct > 0 && (rng_ >> 16) % 100 < cfg_.reorderPct) {
+      held.assign(buf, buf + n);
+      holding = true;
+      stats_.impairedReorders++;
+      continue;
+    }
+    take(buf, (size_t)n);
+    if (holding) {
+      take(held.data(), held.size());
+      holding = false;
+    }
+  }
+}
+
+void UdpCollector::take(const uint8_t *data, size_t len) {
+  UdpTelemetryHeader h;
+  const uint8_t *records = nullptr;
+  if (!udpTelemetryParse(data, len, h, records) || h.seq == 0) {
+    stats_.malformed++;
+    return;
+  }
+  const bool known = stats_.sources.count(h.node) > 0;
+  Source &src = stats_.sources[h.node];
+  std::vector<bool> &seen = seen_[h.node];
+  if (known && (int32_t)(h.epoch - src.epoch) < 0) {
+    stats_.stale++;
+    return;
+  }
+  if (!known || h.epoch != src.epoch) {
+    // A new boot numbers from scratch.
+    src.epoch = h.epoch;
+    src.epochs++;
+    src.minSeq = src.maxSeq = h.seq;
+    src.epochDatagrams = 0;
+    src.obsFirst = src.obsEnd = h.firstObs;
+    src.epochObservations = 0;
+    seen.clear();
+  }
+  if (h.seq >= seen.size()) seen.resize(h.seq + 1);
+  if (seen[h.seq]) {
+    src.duplicates++;
+    return;
+  }
+  seen[h.seq] = true;
+  if (h.seq < src.maxSeq) src.reordered++;
+  if (h.seq < src.minSeq) src.minSeq = h.seq;
+  if (h.seq > src.maxSeq) src.maxSeq = h.seq;
+  if ((int32_t)(h.firstObs - src.obsFirst) < 0) src.obsFirst = h.firstObs;
+  if ((int32_t)(h.firstObs + h.count - src.obsEnd) > 0) src.obsEnd = h.firstObs + h.count;
+  src.epochDatagrams++;
+  src.datagrams++;
+  src.epochObservations += h.count;
+  src.observations += h.count;
+  for (size_t i = 0; i < h.count; i++) {
+    UdpObservation o;
+    udpTelemetryObservation(records, i, o);
+    src.ageBuckets[Histogram::bucketFor(o.ageMs)]++;
+    if (o.ageMs > src.ageMax) src.ageMax = o.ageMs;
+  }
+}
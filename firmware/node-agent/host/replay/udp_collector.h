@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "histogram.h"
+
+// UDP telemetry collector for replay runs and local testing
+// (tools/host-collector.sh). Reads datagrams in the format of
+// lib/node-core/udp_telemetry.h and tracks, per node_id, datagrams lost,
+// duplicated and reordered by seq, and observations missing by first_obs.
+// dropPct and reorderPct impair datagrams as they arrive, to exercise that
+// accounting over a loopback link that loses nothing.
+class UdpCollector {
+ public:
+  struct Config {
+    uint8_t dropPct = 0;     // discarded on arrival
+    uint8_t reorderPct = 0;  // held back until the next datagram is read
+    uint32_t seed = 1;
+    uint16_t port = 0;       // 0 picks an ephemeral port
+    bool listenAll = false;  // all interfaces instead of 127.0.0.1
+  };
+
+  // Datagrams from one node_id; the seq and first_obs figures cover its
+  // latest epoch.
+  struct Source {
+    uint32_t epoch = 0;
+    uint32_t epochs = 0;  // distinct epochs seen
+    uint64_t datagrams = 0;
+    uint64_t observations = 0;
+    uint64_t duplicates = 0;
+    uint64_t reordered = 0;  // arrived after a later seq
+    uint32_t minSeq = 0;
+    uint32_t maxSeq = 0;
+    uint32_t epochDatagrams = 0;
+    uint32_t obsFirst = 0;  // first_obs of the earliest datagram
+    uint32_t obsEnd = 0;    // one past the last observation numbered
+    uint64_t epochObservations = 0;
+    uint32_t ageBuckets[Histogram::kBuckets] = {};  // as Histogram, in ms
+    uint32_t ageMax = 0;
+
+    // Seqs in minSeq..maxSeq never received.
+    uint32_t lost() const { return epochDatagrams ? maxSeq - minSeq + 1 - epochDatagrams : 0; }
+    // Observations numbered but not received: in lost datagrams, or
+    // skipped on the node.
+    uint64_t obsMissing() const { return (uint64_t)(obsEnd - obsFirst) - epochObservations; }
+    // Smallest bucket bound covering fraction `q` of observation ages, at
+    // most ageMax.
+    uint32_t ageQuantile(double q) const;
+  };
+
+  struct Stats {
+    uint64_t datagrams = 0;  // read from the socket
+    uint64_t malformed = 0;
+    uint64_t stale = 0;       // from an earlier epoch than the node's latest
+    uint64_t impairedDrops = 0;
+    uint64_t impairedReorders = 0;
+    std::map<std::string, Source> sources;
+  };
+
+  explicit UdpCollector(const Config &cfg) : cfg_(cfg) {}
+  ~UdpCollector() { stop(); }
+
+  // Binds Config::port; returns the port, or 0 on failure.
+  uint16_t start();
+  void stop();
+  Stats stats();
+
+ private:
+  void run();
+  void take(const uint8_t *data, size_t len);
+
+  Config cfg_;
+  int fd_ = -1;
+  std::thread thread_;
+  std::atomic<bool> stop_{false};
+  std::mutex mu_;
+  Stats stats_;
+  // Seqs received per node_id in its latest epoch, as a bitmap.
+  std::map<std::string, std::vector<bool>> seen_;
+  uint32_t rng_ = 0;
+};
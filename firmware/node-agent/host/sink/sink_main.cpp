@@ -0,0 +1,114 @@
+// Stand-in ingest server: the replay harness's IngestSink on a fixed port,
+// so a node on the bench can post to it instead of the spine. Prints a line
+// per interval and a per-node summary on Ctrl-C. Built by
+// tools/host-sink.sh.
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+
+#include "ingest_sink.h"
+
+namespace {
+
+volatile sig_atomic_t stopRequested = 0;
+
+void onSignal(int) { stopRequested = 1; }
+
+void usage() {
+  fprintf(stderr,
+          "usage: sink [--port N] [--local] [--delay-ms N] [--rtt-ms N] [--fail-pct N] [--partial-pct N]\n"
+          "            [--drop-pct N] [--reject-cbor] [--poison-every N] [--seed N]\n"
+          "            [--stats-ms N]\n");
+}
+
+void printSources(const IngestSink::Stats &s) {
+  printf("%-24s %6s %6s %10s %10s %10s %8s\n", "node_id", "epoch", "boots", "events", "dups",
+         "max_seq", "gaps");
+  for (const auto &src : s.sources) {
+    const IngestSink::Source &n = src.second;
+    printf("%-24s %6u %6u %10llu %10llu %10u %8u\n", src.first.c_str(), (unsigned)n.epoch,
+           (unsigned)n.epochs, (unsigned long long)n.events, (unsigned long long)n.duplicates,
+           (unsigned)n.maxSeq, (unsigned)n.gaps);
+  }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  IngestSink::Config cfg;
+  cfg.port = 8787;
+  cfg.listenAll = true;
+  uint32_t statsMs = 10000;
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    const char *v = i + 1 < argc ? argv[i + 1] : nullptr;
+    auto num = [&](uint32_t max) -> uint32_t {
+      i++;
+      return std::min<uint32_t>((uint32_t)strtoul(v, nullptr, 10), max);
+    };
+    if (a == "--port" && v) {
+      cfg.port = (uint16_t)num(65535);
+    } else if (a == "--local") {
+      cfg.listenAll = false;
+    } else if (a == "--delay-ms" && v) {
+      cfg.delayMs = num(600000);
+    } else if (a == "--rtt-ms" && v) {
+      cfg.rttMs = num(60000);
+    } else if (a == "--fail-pct" && v) {
+      cfg.failPct = (uint8_t)num(100);
+    } else if (a == "--partial-pct" && v) {
+      cfg.partialPct = (uint8_t)num(100);
+    } else if (a == "--drop-pct" && v) {
+      cfg.dropPct = (uint8_t)num(100);
+    } else if (a == "--reject-cbor") {
+      cfg.rejectCbor = true;
+    } else if (a == "--poison-every" && v) {
+      cfg.poisonEvery = num(0xFFFFFFFFu);
+    } else if (a == "--seed" && v) {
+      cfg.seed = num(0xFFFFFFFFu);
+    } else if (a == "--stats-ms" && v) {
+      statsMs = std::max<uint32_t>(num(3600000), 100);
+    } else {
+      usage();
+      return 2;
+    }
+  }
+
+  IngestSink sink(cfg);
+  uint16_t port = sink.start();
+  if (port == 0) {
+    fprintf(stderr, "sink: cannot listen on port %u\n", (unsigned)cfg.port);
+    return 1;
+  }
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+  printf("sink: POST http://%s:%u/v1/ingest (any path)\n", cfg.listenAll ? "<this-host>" : "127.0.0.1",
+         (unsigned)port);
+  fflush(stdout);
+
+  IngestSink::Stats last;
+  uint32_t waitedMs = 0;
+  while (!stopRequested) {
+    usleep(100 * 1000);
+    waitedMs += 100;
+    if (waitedMs < statsMs) continue;
+    waitedMs = 0;
+    IngestSink::Stats s = sink.stats();
+    printf("sink: %llu requests (+%llu), %llu events (+%llu), %llu duplicates, %llu partial, "
+           "%llu refused, %llu poisoned, %llu unanswered\n",
+           (unsigned long long)s.requests, (unsigned long long)(s.requests - last.requests),
+           (unsigned long long)s.events, (unsigned long long)(s.events - last.events),
+           (unsigned long long)s.duplicates, (unsigned long long)s.partial,
+           (unsigned long long)s.failed, (unsigned long long)s.poisoned, (unsigned long long)s.dropped);
+    fflush(stdout);
+    last = s;
+  }
+  sink.stop();
+  printSources(sink.stats());
+  return 0;
+}
@@ -0,0 +1,207 @@
+#pragma once
+
+// Host stand-in for the parts of the Arduino core that src/main.cpp uses.
+// Enough to build and run the firmware as a native process for replay
+// benchmarks (host/replay); not a general Arduino emulation.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+
+#define HEX 16
+#define DEC 10
+
+class String {
+ public:
+  String() {}
+  String(const char *s) : s_(s ? s : "") {}
+  String(const std::string &s) : s_(s) {}
+  String(char c) : s_(1, c) {}
+  String(int v, int base = DEC) { fmt((long long)v, base); }
+  String(unsigned v, int base = DEC) { fmtu(v, base); }
+  String(long v, int base = DEC) { fmt(v, base); }
+  String(unsigned long v, int base = DEC) { fmtu(v, base); }
+  String(unsigned char v, int base = DEC) { fmtu(v, base); }
+
+  size_t length() const { return s_.size(); }
+  const char *c_str() const { return s_.c_str(); }
+  char operator[](size_t i) const { return i < s_.size() ? s_[i] : 0; }
+  String &operator+=(const String &o) {
+    s_ += o.s_;
+    return *this;
+  }
+  String &operator+=(const char *o) {
+    s_ += o;
+    return *this;
+  }
+  String &operator+=(char c) {
+    s_ += c;
+    return *this;
+  }
+  bool operator==(const String &o) const { return s_ == o.s_; }
+  bool operator!=(const String &o) const { return s_ != o.s_; }
+  bool operator==(const char *o) const { return s_ == o; }
+  bool operator!=(const char *o) const { return s_ != o; }
+  int indexOf(const String &n, int from = 0) const {
+    size_t p = s_.find(n.s_, from);
+    return p == std::string::npos ? -1 : (int)p;
+  }
+  int indexOf(char c, int from = 0) const {
+    size_t p = s_.find(c, from);
+    return p == std::string::npos ? -1 : (int)p;
+  }
+  String substring(int from) const {
+    return from >= (int)s_.size() ? String() : String(s_.substr(from));
+  }
+  String substring(int from, int to) const {
+    if (from >= (int)s_.size() || to <= from) return String();
+    return String(s_.substr(from, to - from));
+  }
+  void toLowerCase() {
+    for (char &c : s_) c = (char)tolower((unsigned char)c);
+  }
+  void trim() {
+    size_t a = s_.find_first_not_of(" \t\r\n");
+    size_t b = s_.find_last_not_of(" \t\r\n");
+    s_ = a == std::string::npos ? "" : s_.substr(a, b - a + 1);
+  }
+  long toInt() const { return atol(s_.c_str()); }
+  bool reserve(size_t n) {
+    s_.reserve(n);
+    return true;
+  }
+  friend String operator+(const String &a, const String &b) { return String(a.s_ + b.s_); }
+  friend String operator+(const String &a, const char *b) { return String(a.s_ + b); }
+  friend String operator+(const char *a, const String &b) { return String(a + b.s_); }
+  friend String operator+(const String &a, char b) { return String(a.s_ + b); }
+
+ private:
+  void fmt(long long v, int base) {
+    char b[40];
+    snprintf(b, sizeof(b), base == HEX ? "%llx" : "%lld", v);
+    s_ = b;
+  }
+  void fmtu(unsigned long long v, int base) {
+    char b[40];
+    snprintf(b, sizeof(b), base == HEX ? "%llx" : "%llu", v);
+    s_ = b;
+  }
+  std::string s_;
+};
+
+// Time runs on a host clock that delay() advances without sleeping (see
+// host_hooks.h), so the loop runs faster than real time.
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+long random(long lo, long hi);
+void randomSeed(unsigned long seed);
+uint32_t esp_random();
+int64_t esp_timer_get_time();
+
+using std::max;
+using std::min;
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+class Print {
+ public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buf, size_t n) {
+    size_t i = 0;
+    for (; i < n; i++) {
+      if (write(buf[i]) != 1) break;
+    }
+    return i;
+  }
+  size_t write(const char *s) { return write(reinterpret_cast<const uint8_t *>(s), strlen(s)); }
+  size_t print(const String &s) { return write(reinterpret_cast<const uint8_t *>(s.c_str()), s.length()); }
+  size_t println(const String &s) { return print(s) + write('\n'); }
+  size_t println(const char *s) { return println(String(s)); }
+  size_t println() { return write('\n'); }
+};
+
+class Stream : public Print {
+ public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  virtual size_t readBytes(char *buf, size_t n) {
+    size_t i = 0;
+    for (; i < n; i++) {
+      int c = read();
+      if (c < 0) break;
+      buf[i] = (char)c;
+    }
+    return i;
+  }
+  size_t readBytes(uint8_t *buf, size_t n) { return readBytes(reinterpret_cast<char *>(buf), n); }
+  void setTimeout(unsigned long) {}
+};
+
+// Serial output is dropped unless HOST_SERIAL=1 is set in the environment.
+class HardwareSerial : public Stream {
+ public:
+  void begin(unsigned long) {}
+  using Print::write;
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buf, size_t n) override;
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+};
+extern HardwareSerial Serial;
+
+// Free heap is a fixed budget minus live C++ allocations.
+class EspClass {
+ public:
+  uint32_t getFreeHeap();
+  uint32_t getMinFreeHeap();
+  const char *getChipModel() { return "host"; }
+  uint8_t getChipRevision() { return 0; }
+  const char *getSdkVersion() { return "host"; }
+  uint64_t getEfuseMac() { return 0x0100005E0002ULL; }
+  uint32_t getCycleCount();
+  uint32_t getCpuFreqMHz() { return 240; }
+  void restart();
+};
+extern EspClass ESP;
+
+// Core the Arduino loop task runs on, as on the dual-core esp32dev.
+#define ARDUINO_RUNNING_CORE 1
+
+class IPAddress {
+ public:
+  IPAddress() {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
+    o_[0] = a;
+    o_[1] = b;
+    o_[2] = c;
+    o_[3] = d;
+  }
+  uint8_t operator[](int i) const { return o_[i]; }
+  uint8_t &operator[](int i) { return o_[i]; }
+  bool fromString(const char *s) {
+    unsigned a, b, c, d;
+    char tail;
+    if (sscanf(s, "%u.%u.%u.%u%c", &a, &b, &c, &d, &tail) != 4 || a > 255 || b > 255 || c > 255 || d > 255) {
+      return false;
+    }
+    *this = IPAddress(a, b, c, d);
+    return true;
+  }
+  String toString() const {
+    char b[16];
+    snprintf(b, sizeof(b), "%u.%u.%u.%u", o_[0], o_[1], o_[2], o_[3]);
+    return String(b);
+  }
+
+ private:
+  uint8_t o_[4] = {0, 0, 0, 0};
+};
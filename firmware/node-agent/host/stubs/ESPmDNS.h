@@ -0,0 +1,13 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Host stand-in: mDNS calls succeed and do nothing.
+class MDNSResponder {
+ public:
+  bool begin(const char *) { return true; }
+  bool addService(const char *, const char *, uint16_t) { return true; }
+  bool addServiceTxt(const char *, const char *, const char *, const char *) { return true; }
+  void addServiceTxt(const char *, const char *, const char *, const String &) {}
+};
+extern MDNSResponder MDNS;
@@ -0,0 +1,30 @@
+#pragma once
+
+// Host stand-in for HTTPClient: plain-HTTP GET only, which is all the probe
+// handler needs.
+
+#include <WiFi.h>
+
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+#define HTTPC_ERROR_SEND_HEADER_FAILED (-2)
+#define HTTPC_ERROR_SEND_PAYLOAD_FAILED (-3)
+#define HTTPC_ERROR_NOT_CONNECTED (-4)
+#define HTTPC_ERROR_CONNECTION_LOST (-5)
+#define HTTPC_ERROR_NO_HTTP_SERVER (-7)
+#define HTTPC_ERROR_READ_TIMEOUT (-11)
+
+class HTTPClient {
+ public:
+  bool begin(const String &url);
+  void end() { client_.stop(); }
+  void setTimeout(uint16_t ms) { timeoutMs_ = ms; }
+  int GET();
+
+ private:
+  WiFiClient client_;
+  std::string host_;
+  std::string path_;
+  uint16_t port_ = 80;
+  uint16_t timeoutMs_ = 5000;
+  bool valid_ = false;
+};
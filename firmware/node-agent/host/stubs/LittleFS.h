@@ -0,0 +1,51 @@
+#pragma once
+
+// Host stand-in for LittleFS over a host directory (hostFsSetRoot(), or a
+// fresh temporary directory by default). Paths are relative to that root.
+
+#include <Arduino.h>
+
+#include <memory>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+class File : public Stream {
+ public:
+  File() {}
+  using Print::write;
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t *buf, size_t n) override;
+  int available() override;
+  int read() override;
+  size_t read(uint8_t *buf, size_t n);
+  int peek() override;
+  bool seek(uint32_t pos);
+  size_t size() const;
+  size_t position() const;
+  void close() { impl_.reset(); }
+  operator bool() const { return impl_ != nullptr; }
+  const char *name() const;
+  bool isDirectory();
+  File openNextFile(const char *mode = FILE_READ);
+
+  struct Impl;
+  explicit File(std::shared_ptr<Impl> impl) : impl_(std::move(impl)) {}
+
+ private:
+  std::shared_ptr<Impl> impl_;
+};
+
+class LittleFSFS {
+ public:
+  bool begin(bool formatOnFail = false, const char *basePath = "/littlefs", uint8_t maxOpenFiles = 10,
+             const char *partitionLabel = "spiffs");
+  File open(const char *path, const char *mode = FILE_READ, const bool create = false);
+  bool exists(const char *path);
+  bool mkdir(const char *path);
+  bool remove(const char *path);
+  size_t totalBytes() { return 1024 * 1024; }
+  size_t usedBytes();
+};
+extern LittleFSFS LittleFS;
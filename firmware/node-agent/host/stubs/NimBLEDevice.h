@@ -0,0 +1,74 @@
+#pragma once
+
+// Host stand-in for NimBLE-Arduino's scanner. Adverts come from
+// hostBleAdvert() (host_hooks.h) instead of a radio.
+
+#include <Arduino.h>
+
+#include <atomic>
+#include <string>
+
+#define BLE_ADDR_PUBLIC 0
+#define BLE_ADDR_RANDOM 1
+
+class NimBLEAddress {
+ public:
+  NimBLEAddress() {}
+  // `addr` is little-endian, as NimBLE stores it.
+  NimBLEAddress(const uint8_t *addr, uint8_t type) : type_(type) { memcpy(val_, addr, 6); }
+  std::string toString() const;
+  const uint8_t *getNative() const { return val_; }
+  uint8_t getType() const { return type_; }
+
+ private:
+  uint8_t val_[6] = {0};
+  uint8_t type_ = 0;
+};
+
+class NimBLEAdvertisedDevice {
+ public:
+  NimBLEAddress getAddress() { return address_; }
+  uint8_t getAddressType() { return address_.getType(); }
+  int getRSSI() { return rssi_; }
+  uint8_t *getPayload() { return payload_; }
+  size_t getPayloadLength() { return payloadLen_; }
+
+  void hostSet(const NimBLEAddress &address, int8_t rssi, const uint8_t *payload, size_t len);
+
+ private:
+  NimBLEAddress address_;
+  int8_t rssi_ = 0;
+  uint8_t payload_[62] = {0};  // advert + scan response
+  size_t payloadLen_ = 0;
+};
+
+class NimBLEAdvertisedDeviceCallbacks {
+ public:
+  virtual ~NimBLEAdvertisedDeviceCallbacks() {}
+  virtual void onResult(NimBLEAdvertisedDevice *device) = 0;
+};
+
+class NimBLEScan {
+ public:
+  void setAdvertisedDeviceCallbacks(NimBLEAdvertisedDeviceCallbacks *cb, bool wantDuplicates = false);
+  void setActiveScan(bool) {}
+  void setInterval(uint16_t) {}
+  void setWindow(uint16_t) {}
+  void setMaxResults(uint8_t) {}
+  void clearResults() {}
+  bool start(uint32_t duration, void (*onComplete)(void *), bool isContinue = false);
+  bool stop();
+  bool isScanning() { return scanning_; }
+
+  bool hostDeliver(NimBLEAdvertisedDevice *device);
+
+ private:
+  NimBLEAdvertisedDeviceCallbacks *cb_ = nullptr;
+  std::atomic<bool> scanning_{false};  // the harness may feed from another thread
+};
+
+class NimBLEDevice {
+ public:
+  static void init(const std::string &) {}
+  static NimBLEScan *getScan();
+};
@@ -0,0 +1,23 @@
+#pragma once
+
+// Host stand-in for Preferences: namespaces live in process memory and
+// start out empty unless seeded with hostPrefsSet().
+
+#include <Arduino.h>
+
+class Preferences {
+ public:
+  bool begin(const char *name, bool readOnly = false);
+  void end() { ns_.clear(); }
+  size_t putString(const char *key, const String &value);
+  String getString(const char *key, const String &defaultValue = String());
+  size_t putUInt(const char *key, uint32_t value);
+  uint32_t getUInt(const char *key, uint32_t defaultValue = 0);
+  size_t putUChar(const char *key, uint8_t value);
+  uint8_t getUChar(const char *key, uint8_t defaultValue = 0);
+  size_t putUShort(const char *key, uint16_t value);
+  uint16_t getUShort(const char *key, uint16_t defaultValue = 0);
+
+ private:
+  std::string ns_;
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+// Host stand-in for the Arduino WebServer. It does not listen; handlers run
+// through hostHttpRequest() (host_hooks.h) and their output is captured.
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+typedef enum {
+  HTTP_ANY,
+  HTTP_GET,
+  HTTP_HEAD,
+  HTTP_POST,
+  HTTP_PUT,
+  HTTP_PATCH,
+  HTTP_DELETE,
+  HTTP_OPTIONS
+} HTTPMethod;
+
+#define CONTENT_LENGTH_UNKNOWN ((size_t)-1)
+
+struct HostHttpResponse;
+
+class WebServer {
+ public:
+  typedef std::function<void(void)> THandlerFunction;
+
+  explicit WebServer(int port = 80);
+  void begin() {}
+  void handleClient() {}
+  void on(const String &uri, HTTPMethod method, THandlerFunction fn);
+
+  String arg(const String &name);
+  bool hasArg(const String &name);
+  HTTPMethod method() { return method_; }
+  String uri() { return String(uri_); }
+
+  void send(int code, const char *contentType = nullptr, const String &content = String(""));
+  void send_P(int code, const char *contentType, const char *content, size_t len);
+  void setContentLength(size_t len) { (void)len; }
+  void sendHeader(const String &, const String &, bool = false) {}
+  void sendContent(const char *content, size_t len);
+  void sendContent(const String &content) { sendContent(content.c_str(), content.length()); }
+  WiFiClient client() { return WiFiClient::hostLoopback(); }
+
+  bool hostDispatch(HTTPMethod method, const char *uri, const char *query, const char *body,
+                    HostHttpResponse &out);
+
+ private:
+  struct Route {
+    std::string uri;
+    HTTPMethod method;
+    THandlerFunction fn;
+  };
+
+  std::vector<Route> routes_;
+  std::vector<std::pair<std::string, std::string>> args_;
+  HTTPMethod method_ = HTTP_GET;
+  std::string uri_;
+  HostHttpResponse *out_ = nullptr;
+};
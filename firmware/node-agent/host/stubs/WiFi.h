@@ -0,0 +1,109 @@
+#pragma once
+
+// Host stand-in for the Arduino WiFi library. The station "connects" at
+// once and sockets are real POSIX sockets, so ingest reaches whatever
+// listens on the configured URL.
+
+#include <Arduino.h>
+#include <esp_wifi.h>
+
+typedef enum {
+  ARDUINO_EVENT_WIFI_SCAN_DONE = 1,
+  ARDUINO_EVENT_WIFI_STA_CONNECTED = 4,
+  ARDUINO_EVENT_WIFI_STA_DISCONNECTED = 5,
+  ARDUINO_EVENT_WIFI_STA_GOT_IP = 7,
+} arduino_event_id_t;
+// The firmware checks for these with #if defined().
+#define ARDUINO_EVENT_WIFI_SCAN_DONE ARDUINO_EVENT_WIFI_SCAN_DONE
+#define ARDUINO_EVENT_WIFI_STA_CONNECTED ARDUINO_EVENT_WIFI_STA_CONNECTED
+#define ARDUINO_EVENT_WIFI_STA_DISCONNECTED ARDUINO_EVENT_WIFI_STA_DISCONNECTED
+#define ARDUINO_EVENT_WIFI_STA_GOT_IP ARDUINO_EVENT_WIFI_STA_GOT_IP
+
+typedef arduino_event_id_t WiFiEvent_t;
+typedef struct {
+  uint8_t reason;
+} wifi_event_sta_disconnected_t;
+typedef union {
+  wifi_event_sta_disconnected_t wifi_sta_disconnected;
+} WiFiEventInfo_t;
+typedef void (*WiFiEventSysCb)(WiFiEvent_t event, WiFiEventInfo_t info);
+typedef enum { WIFI_OFF, WIFI_STA, WIFI_AP, WIFI_AP_STA } wifi_mode_t;
+
+class WiFiClient : public Stream {
+ public:
+  WiFiClient() {}
+  virtual ~WiFiClient();
+  WiFiClient(const WiFiClient &) = delete;
+  WiFiClient &operator=(const WiFiClient &) = delete;
+  WiFiClient(WiFiClient &&other);
+
+  // `timeout` is in milliseconds.
+  virtual int connect(const char *host, uint16_t port, int32_t timeout);
+  int connect(const char *host, uint16_t port) { return connect(host, port, 3000); }
+  using Print::write;
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t *buf, size_t n) override;
+  // With nothing buffered, waits up to 1 ms of real time for data, so
+  // polling loops paced by delay() still give the peer time to answer.
+  int available() override;
+  int read() override;
+  int read(uint8_t *buf, size_t n);
+  int peek() override;
+  virtual uint8_t connected();
+  virtual void stop();
+  void setNoDelay(bool noDelay);
+  int setTimeout(uint32_t) { return 0; }
+
+  // Host only: a client that reports connected without a socket, for the
+  // WebServer stand-in's captured responses.
+  static WiFiClient hostLoopback();
+
+ protected:
+  int fd_ = -1;
+  bool loopback_ = false;
+};
+
+class WiFiUDP : public Print {
+ public:
+  ~WiFiUDP() { stop(); }
+  uint8_t begin(uint16_t port);
+  int beginPacket(const char *host, uint16_t port);
+  int beginPacket(IPAddress ip, uint16_t port);
+  int endPacket();
+  using Print::write;
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t *buf, size_t n) override;
+  void stop();
+
+ private:
+  int fd_ = -1;
+  std::string host_;
+  uint16_t port_ = 0;
+  std::string packet_;
+};
+
+class WiFiClass {
+ public:
+  bool isConnected();
+  IPAddress localIP();
+  IPAddress gatewayIP();
+  IPAddress subnetMask();
+  IPAddress dnsIP(uint8_t i = 0);
+  String macAddress();
+  uint8_t *macAddress(uint8_t *mac);
+  uint8_t *BSSID();
+  String SSID();
+  String BSSIDstr();
+  int8_t RSSI();
+  int32_t channel();
+  bool mode(wifi_mode_t mode);
+  bool softAP(const char *ssid);
+  bool setSleep(bool enabled);
+  bool setAutoReconnect(bool enabled);
+  bool setHostname(const char *name);
+  int begin(const char *ssid, const char *pass);
+  bool disconnect(bool wifiOff = false, bool eraseAp = false);
+  int hostByName(const char *host, IPAddress &out);
+  int onEvent(WiFiEventSysCb cb);
+};
+extern WiFiClass WiFi;
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <WiFi.h>
+
+// No TLS on the host: connect() always fails, so point replay runs at an
+// http:// sink.
+class WiFiClientSecure : public WiFiClient {
+ public:
+  void setInsecure() {}
+  int connect(const char *, uint16_t, int32_t) override { return 0; }
+};
@@ -0,0 +1,67 @@
+#pragma once
+
+// Host stand-in for the ESP-IDF Wi-Fi calls the firmware makes directly.
+// There is no radio: station info is fixed and scans fail to start.
+
+#include <stdint.h>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL (-1)
+
+typedef enum {
+  WIFI_AUTH_OPEN,
+  WIFI_AUTH_WEP,
+  WIFI_AUTH_WPA_PSK,
+  WIFI_AUTH_WPA2_PSK,
+  WIFI_AUTH_WPA_WPA2_PSK,
+  WIFI_AUTH_WPA2_ENTERPRISE,
+  WIFI_AUTH_WPA3_PSK,
+  WIFI_AUTH_WPA2_WPA3_PSK,
+  WIFI_AUTH_WAPI_PSK,
+  WIFI_AUTH_WPA3_ENT_192
+} wifi_auth_mode_t;
+
+typedef struct {
+  uint8_t bssid[6];
+  uint8_t ssid[33];
+  uint8_t primary;
+  int8_t rssi;
+  wifi_auth_mode_t authmode;
+} wifi_ap_record_t;
+
+typedef enum { WIFI_SCAN_TYPE_ACTIVE, WIFI_SCAN_TYPE_PASSIVE } wifi_scan_type_t;
+typedef struct {
+  uint32_t min;
+  uint32_t max;
+} wifi_active_scan_time_t;
+typedef struct {
+  wifi_active_scan_time_t active;
+  uint32_t passive;
+} wifi_scan_time_t;
+typedef struct {
+  uint8_t *ssid;
+  uint8_t *bssid;
+  uint8_t channel;
+  bool show_hidden;
+  wifi_scan_type_t scan_type;
+  wifi_scan_time_t scan_time;
+} wifi_scan_config_t;
+typedef struct {
+  wifi_auth_mode_t authmode;
+} wifi_scan_threshold_t;
+typedef struct {
+  uint8_t ssid[32];
+  uint8_t password[64];
+  wifi_scan_threshold_t threshold;
+} wifi_sta_config_t;
+typedef union {
+  wifi_sta_config_t sta;
+} wifi_config_t;
+typedef enum { WIFI_IF_STA, WIFI_IF_AP } wifi_interface_t;
+
+esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t *info);
+esp_err_t esp_wifi_set_config(wifi_interface_t iface, wifi_config_t *config);
+esp_err_t esp_wifi_scan_start(const wifi_scan_config_t *config, bool block);
+esp_err_t esp_wifi_scan_get_ap_num(uint16_t *count);
+esp_err_t esp_wifi_scan_get_ap_records(uint16_t *count, wifi_ap_record_t *records);
@@ -0,0 +1,23 @@
+#pragma once
+
+// Host stand-in for the FreeRTOS types and macros src/main.cpp uses. Tasks
+// are threads (freertos/task.h) and mutexes std::mutex (freertos/semphr.h);
+// there are no priorities, and a task's core is only reported back.
+
+#include <stdint.h>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS pdTRUE
+#define portMAX_DELAY ((TickType_t)0xFFFFFFFFu)
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define tskNO_AFFINITY 0x7FFFFFFF
+
+// The core the calling task was created for; threads not created as tasks
+// report 1, the loop task's core on a dual-core ESP32.
+BaseType_t xPortGetCoreID();
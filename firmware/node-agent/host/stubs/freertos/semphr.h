@@ -0,0 +1,10 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+struct HostMutex;
+typedef HostMutex *SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex();
+BaseType_t xSemaphoreTake(SemaphoreHandle_t mutex, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t mutex);
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+// Each task is a detached thread. vTaskDelay() sleeps in real time whatever
+// the clock mode (host_hooks.h), so an idle task does not spin or move the
+// virtual clock.
+
+struct HostTask;
+typedef HostTask *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stackBytes, void *arg,
+                                   UBaseType_t priority, TaskHandle_t *handle, BaseType_t core);
+void vTaskDelay(TickType_t ticks);
+void xTaskNotifyGive(TaskHandle_t task);
+// Called from a task created above.
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks);
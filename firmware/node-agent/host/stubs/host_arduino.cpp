@@ -0,0 +1,211 @@
+// Clock, heap accounting, Serial, ESP and Preferences for the host build.
+
+#include <Arduino.h>
+#include <ESPmDNS.h>
+#include <Preferences.h>
+
+#include <atomic>
+#include <cstddef>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <new>
+#include <random>
+#include <thread>
+
+#include "host_hooks.h"
+
+// ---- clock -----------------------------------------------------------------
+
+static const std::chrono::steady_clock::time_point kStart = std::chrono::steady_clock::now();
+static std::atomic<uint64_t> skippedUs{0};
+static std::atomic<bool> realtime{false};
+
+static uint64_t hostMicros() {
+  auto real = std::chrono::steady_clock::now() - kStart;
+  return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(real).count() +
+         skippedUs.load(std::memory_order_relaxed);
+}
+
+unsigned long millis() { return (unsigned long)(hostMicros() / 1000); }
+unsigned long micros() { return (unsigned long)hostMicros(); }
+int64_t esp_timer_get_time() { return (int64_t)hostMicros(); }
+
+void delay(unsigned long ms) {
+  if (realtime.load(std::memory_order_relaxed)) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+  } else {
+    hostAdvanceMs((uint32_t)ms);
+  }
+}
+
+void yield() { std::this_thread::yield(); }
+
+void hostSetRealtime(bool on) { realtime = on; }
+void hostAdvanceMs(uint32_t ms) { skippedUs.fetch_add((uint64_t)ms * 1000, std::memory_order_relaxed); }
+
+// Fixed seed so runs are repeatable.
+static std::mt19937 rng(1);
+
+long random(long lo, long hi) {
+  if (hi <= lo) return lo;
+  return lo + (long)(rng() % (unsigned long)(hi - lo));
+}
+void randomSeed(unsigned long seed) { rng.seed((uint32_t)seed); }
+uint32_t esp_random() { return rng(); }
+
+// ---- heap ------------------------------------------------------------------
+
+static std::atomic<size_t> heapLive{0};
+static std::atomic<size_t> heapPeak{0};
+static std::atomic<uint64_t> heapAllocs{0};
+
+// Only allocations made while tracking is on for the calling thread count,
+// so the harness's own buffers stay out of the numbers. Each block carries
+// its size and whether it was counted in a header aligned for any type.
+static thread_local bool heapTracking = false;
+static const size_t kHeapHeader = alignof(std::max_align_t);
+
+struct HeapHeader {
+  size_t size;
+  bool tracked;
+};
+static_assert(sizeof(HeapHeader) <= kHeapHeader, "heap header too large");
+
+static void *heapAlloc(size_t n) {
+  uint8_t *p = static_cast<uint8_t *>(malloc(n + kHeapHeader));
+  if (!p) return nullptr;
+  HeapHeader h = {n, heapTracking};
+  memcpy(p, &h, sizeof(h));
+  if (h.tracked) {
+    size_t live = heapLive.fetch_add(n, std::memory_order_relaxed) + n;
+    size_t peak = heapPeak.load(std::memory_order_relaxed);
+    while (live > peak && !heapPeak.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+    }
+    heapAllocs.fetch_add(1, std::memory_order_relaxed);
+  }
+  return p + kHeapHeader;
+}
+
+static void heapFree(void *ptr) {
+  if (!ptr) return;
+  uint8_t *p = static_cast<uint8_t *>(ptr) - kHeapHeader;
+  HeapHeader h;
+  memcpy(&h, p, sizeof(h));
+  if (h.tracked) heapLive.fetch_sub(h.size, std::memory_order_relaxed);
+  free(p);
+}
+
+void *operator new(size_t n) {
+  void *p = heapAlloc(n);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+void *operator new[](size_t n) { return operator new(n); }
+void *operator new(size_t n, const std::nothrow_t &) noexcept { return heapAlloc(n); }
+void *operator new[](size_t n, const std::nothrow_t &) noexcept { return heapAlloc(n); }
+void operator delete(void *p) noexcept { heapFree(p); }
+void operator delete[](void *p) noexcept { heapFree(p); }
+void operator delete(void *p, size_t) noexcept { heapFree(p); }
+void operator delete[](void *p, size_t) noexcept { heapFree(p); }
+
+HostHeapStats hostHeapStats() {
+  return HostHeapStats{heapLive.load(), heapPeak.load(), heapAllocs.load()};
+}
+
+void hostHeapTrack(bool on) { heapTracking = on; }
+
+// ---- Serial / ESP ----------------------------------------------------------
+
+HardwareSerial Serial;
+EspClass ESP;
+MDNSResponder MDNS;
+
+static bool serialEcho() {
+  static const bool echo = getenv("HOST_SERIAL") && strcmp(getenv("HOST_SERIAL"), "1") == 0;
+  return echo;
+}
+
+size_t HardwareSerial::write(uint8_t c) { return write(&c, 1); }
+
+size_t HardwareSerial::write(const uint8_t *buf, size_t n) {
+  if (serialEcho()) fwrite(buf, 1, n, stderr);
+  return n;
+}
+
+uint32_t EspClass::getFreeHeap() {
+  size_t live = heapLive.load(std::memory_order_relaxed);
+  return live < kHostHeapBudget ? kHostHeapBudget - (uint32_t)live : 0;
+}
+
+uint32_t EspClass::getMinFreeHeap() {
+  size_t peak = heapPeak.load(std::memory_order_relaxed);
+  return peak < kHostHeapBudget ? kHostHeapBudget - (uint32_t)peak : 0;
+}
+
+uint32_t EspClass::getCycleCount() { return (uint32_t)(hostMicros() * getCpuFreqMHz()); }
+
+void EspClass::restart() {
+  fprintf(stderr, "ESP.restart() called; exiting\n");
+  exit(3);
+}
+
+// ---- Preferences -----------------------------------------------------------
+
+static std::mutex prefsMu;
+static std::map<std::string, std::map<std::string, std::string>> &prefsStore() {
+  static auto *store = new std::map<std::string, std::map<std::string, std::string>>();
+  return *store;
+}
+
+void hostPrefsSet(const char *ns, const char *key, const char *value) {
+  std::lock_guard<std::mutex> lock(prefsMu);
+  prefsStore()[ns][key] = value;
+}
+
+static bool prefsGet(const std::string &ns, const char *key, std::string &out) {
+  std::lock_guard<std::mutex> lock(prefsMu);
+  auto n = prefsStore().find(ns);
+  if (n == prefsStore().end()) return false;
+  auto k = n->second.find(key);
+  if (k == n->second.end()) return false;
+  out = k->second;
+  return true;
+}
+
+bool Preferences::begin(const char *name, bool) {
+  ns_ = name;
+  return true;
+}
+
+size_t Preferences::putString(const char *key, const String &value) {
+  hostPrefsSet(ns_.c_str(), key, value.c_str());
+  return value.length();
+}
+
+String Preferences::getString(const char *key, const String &defaultValue) {
+  std::string v;
+  return prefsGet(ns_, key, v) ? String(v) : defaultValue;
+}
+
+size_t Preferences::putUInt(const char *key, uint32_t value) {
+  hostPrefsSet(ns_.c_str(), key, std::to_string(value).c_str());
+  return 4;
+}
+
+uint32_t Preferences::getUInt(const char *key, uint32_t defaultValue) {
+  std::string v;
+  return prefsGet(ns_, key, v) ? (uint32_t)strtoul(v.c_str(), nullptr, 10) : defaultValue;
+}
+
+size_t Preferences::putUChar(const char *key, uint8_t value) { return putUInt(key, value) ? 1 : 0; }
+
+uint8_t Preferences::getUChar(const char *key, uint8_t defaultValue) {
+  return (uint8_t)getUInt(key, defaultValue);
+}
+
+size_t Preferences::putUShort(const char *key, uint16_t value) { return putUInt(key, value) ? 2 : 0; }
+
+uint16_t Preferences::getUShort(const char *key, uint16_t defaultValue) {
+  return (uint16_t)getUInt(key, defaultValue);
+}
@@ -0,0 +1,58 @@
+// NimBLE scanner stand-in: adverts are pushed in by the harness.
+
+#include <NimBLEDevice.h>
+
+#include <atomic>
+
+#include "host_hooks.h"
+
+static NimBLEScan scan;
+static std::atomic<uint32_t> advertsDropped{0};
+
+std::string NimBLEAddress::toString() const {
+  char out[18];
+  snprintf(out, sizeof(out), "%02x:%02x:%02x:%02x:%02x:%02x", val_[5], val_[4], val_[3], val_[2],
+           val_[1], val_[0]);
+  return out;
+}
+
+void NimBLEAdvertisedDevice::hostSet(const NimBLEAddress &address, int8_t rssi,
+                                     const uint8_t *payload, size_t len) {
+  address_ = address;
+  rssi_ = rssi;
+  payloadLen_ = len < sizeof(payload_) ? len : sizeof(payload_);
+  memcpy(payload_, payload, payloadLen_);
+}
+
+void NimBLEScan::setAdvertisedDeviceCallbacks(NimBLEAdvertisedDeviceCallbacks *cb, bool) { cb_ = cb; }
+
+bool NimBLEScan::start(uint32_t, void (*)(void *), bool) {
+  scanning_ = true;
+  return true;
+}
+
+bool NimBLEScan::stop() {
+  scanning_ = false;
+  return true;
+}
+
+bool NimBLEScan::hostDeliver(NimBLEAdvertisedDevice *device) {
+  if (!scanning_ || !cb_) return false;
+  cb_->onResult(device);
+  return true;
+}
+
+NimBLEScan *NimBLEDevice::getScan() { return &scan; }
+
+bool hostBleAdvert(const uint8_t addr[6], uint8_t addrType, int8_t rssi, const uint8_t *payload,
+                   size_t len) {
+  uint8_t native[6];
+  for (int i = 0; i < 6; i++) native[i] = addr[5 - i];
+  NimBLEAdvertisedDevice device;
+  device.hostSet(NimBLEAddress(native, addrType), rssi, payload, len);
+  if (scan.hostDeliver(&device)) return true;
+  advertsDropped++;
+  return false;
+}
+
+uint32_t hostBleAdvertsDropped() { return advertsDropped.load(); }
@@ -0,0 +1,131 @@
+// LittleFS over a host directory.
+
+#include <LittleFS.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "host_hooks.h"
+
+LittleFSFS LittleFS;
+
+static std::string fsRoot;
+
+void hostFsSetRoot(const char *dir) {
+  fsRoot = dir;
+  ::mkdir(dir, 0755);
+}
+
+static std::string hostPath(const char *path) {
+  return fsRoot + (path[0] == '/' ? "" : "/") + path;
+}
+
+struct File::Impl {
+  std::string name;  // as passed to open()
+  FILE *fp = nullptr;
+  DIR *dir = nullptr;
+  ~Impl() {
+    if (fp) fclose(fp);
+    if (dir) closedir(dir);
+  }
+};
+
+size_t File::write(const uint8_t *buf, size_t n) {
+  if (!impl_ || !impl_->fp) return 0;
+  return fwrite(buf, 1, n, impl_->fp);
+}
+
+int File::available() {
+  if (!impl_ || !impl_->fp) return 0;
+  return (int)(size() - position());
+}
+
+int File::read() {
+  uint8_t c;
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+size_t File::read(uint8_t *buf, size_t n) {
+  if (!impl_ || !impl_->fp) return 0;
+  return fread(buf, 1, n, impl_->fp);
+}
+
+int File::peek() {
+  if (!impl_ || !impl_->fp) return -1;
+  int c = fgetc(impl_->fp);
+  if (c != EOF) ungetc(c, impl_->fp);
+  return c == EOF ? -1 : c;
+}
+
+bool File::seek(uint32_t pos) {
+  return impl_ && impl_->fp && fseek(impl_->fp, (long)pos, SEEK_SET) == 0;
+}
+
+size_t File::size() const {
+  if (!impl_ || !impl_->fp) return 0;
+  fflush(impl_->fp);
+  struct stat st;
+  return fstat(fileno(impl_->fp), &st) == 0 ? (size_t)st.st_size : 0;
+}
+
+size_t File::position() const {
+  if (!impl_ || !impl_->fp) return 0;
+  long p = ftell(impl_->fp);
+  return p < 0 ? 0 : (size_t)p;
+}
+
+const char *File::name() const { return impl_ ? impl_->name.c_str() : ""; }
+
+bool File::isDirectory() { return impl_ && impl_->dir; }
+
+File File::openNextFile(const char *mode) {
+  if (!impl_ || !impl_->dir) return File();
+  while (dirent *e = readdir(impl_->dir)) {
+    if (strcmp(e->d_name, ".") == 0 || strcmp(e->d_name, "..") == 0) continue;
+    std::string child = impl_->name + "/" + e->d_name;
+    return LittleFS.open(child.c_str(), mode);
+  }
+  return File();
+}
+
+bool LittleFSFS::begin(bool, const char *, uint8_t, const char *) {
+  if (fsRoot.empty()) {
+    char tmpl[] = "/tmp/node-agent-fs-XXXXXX";
+    if (!mkdtemp(tmpl)) return false;
+    fsRoot = tmpl;
+  }
+  return true;
+}
+
+File LittleFSFS::open(const char *path, const char *mode, const bool) {
+  std::string full = hostPath(path);
+  auto impl = std::make_shared<File::Impl>();
+  impl->name = path;
+  struct stat st;
+  if (stat(full.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+    impl->dir = opendir(full.c_str());
+    return impl->dir ? File(impl) : File();
+  }
+  const char *fmode = strcmp(mode, FILE_APPEND) == 0 ? "ab+" : strcmp(mode, FILE_WRITE) == 0 ? "wb+" : "rb";
+  impl->fp = fopen(full.c_str(), fmode);
+  return impl->fp ? File(impl) : File();
+}
+
+bool LittleFSFS::exists(const char *path) {
+  struct stat st;
+  return stat(hostPath(path).c_str(), &st) == 0;
+}
+
+bool LittleFSFS::mkdir(const char *path) { return ::mkdir(hostPath(path).c_str(), 0755) == 0; }
+
+bool LittleFSFS::remove(const char *path) { return unlink(hostPath(path).c_str()) == 0; }
+
+static size_t treeBytes(File dir) {
+  size_t total = 0;
+  for (File f = dir.openNextFile(); f; f = dir.openNextFile()) {
+    total += f.isDirectory() ? treeBytes(f) : f.size();
+  }
+  return total;
+}
+
+size_t LittleFSFS::usedBytes() { return treeBytes(open("/")); }
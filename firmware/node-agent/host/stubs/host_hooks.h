@@ -0,0 +1,60 @@
+#pragma once
+
+// Controls for the host stand-ins, used by the replay harness. None of this
+// exists on the device.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+// Clock. delay() advances the clock instantly unless real-time mode is on;
+// blocking socket waits still take real time.
+void hostSetRealtime(bool realtime);
+void hostAdvanceMs(uint32_t ms);
+
+// Heap accounting over global operator new/delete. Only allocations made
+// by a thread while it has tracking on are counted; the harness turns it on
+// around calls into the firmware.
+struct HostHeapStats {
+  size_t liveBytes;
+  size_t peakBytes;
+  uint64_t allocations;
+};
+HostHeapStats hostHeapStats();
+void hostHeapTrack(bool on);
+// Budget ESP.getFreeHeap() subtracts live bytes from (esp32dev after boot).
+static const uint32_t kHostHeapBudget = 300 * 1024;
+
+// Preferences are kept in memory; seed them before setup().
+void hostPrefsSet(const char *ns, const char *key, const char *value);
+
+// Delivers Wi-Fi events queued by WiFi.begin()/disconnect() to the
+// WiFi.onEvent() callback, as the ESP32 event task would. Call between
+// loop() passes.
+void hostWifiPoll();
+
+// Feeds one advert to the callback registered on the NimBLE scan, as the
+// NimBLE host task would. `addr` is most significant byte first. Returns
+// false when no scan is running.
+bool hostBleAdvert(const uint8_t addr[6], uint8_t addrType, int8_t rssi, const uint8_t *payload,
+                   size_t len);
+uint32_t hostBleAdvertsDropped();
+
+// Runs the handler registered on the WebServer for `uri` and captures the
+// response; `query` is "a=1&b=2". Returns false when nothing matches. Safe
+// to call from several threads; requests are served one at a time, like on
+// the device's HTTP task.
+struct HostHttpResponse {
+  int code = 0;
+  std::string contentType;
+  std::string body;
+};
+bool hostHttpRequest(const char *method, const char *uri, const char *query, const char *body,
+                     HostHttpResponse &out);
+// Each send on the WebServer then takes this long, like a client slow to
+// read its response.
+void hostHttpSetSendDelayMs(uint32_t ms);
+
+// LittleFS maps onto this host directory (created if missing).
+void hostFsSetRoot(const char *dir);
@@ -0,0 +1,429 @@
+// Wi-Fi, sockets, HTTPClient and WebServer for the host build.
+
+#include <HTTPClient.h>
+#include <WebServer.h>
+#include <WiFi.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "host_hooks.h"
+
+// ---- sockets ---------------------------------------------------------------
+
+static bool resolve(const char *host, uint16_t port, int type, sockaddr_storage &out,
+                    socklen_t &outLen) {
+  addrinfo hints = {};
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = type;
+  addrinfo *res = nullptr;
+  char portStr[8];
+  snprintf(portStr, sizeof(portStr), "%u", port);
+  if (getaddrinfo(host, portStr, &hints, &res) != 0 || !res) return false;
+  memcpy(&out, res->ai_addr, res->ai_addrlen);
+  outLen = res->ai_addrlen;
+  freeaddrinfo(res);
+  return true;
+}
+
+WiFiClient::~WiFiClient() { stop(); }
+
+WiFiClient::WiFiClient(WiFiClient &&other) : fd_(other.fd_), loopback_(other.loopback_) {
+  other.fd_ = -1;
+}
+
+WiFiClient WiFiClient::hostLoopback() {
+  WiFiClient c;
+  c.loopback_ = true;
+  return c;
+}
+
+int WiFiClient::connect(const char *host, uint16_t port, int32_t timeout) {
+  stop();
+  sockaddr_storage addr;
+  socklen_t len = 0;
+  if (!resolve(host, port, SOCK_STREAM, addr, len)) return 0;
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) return 0;
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  if (::connect(fd, reinterpret_cast<sockaddr *>(&addr), len) != 0) {
+    pollfd p = {fd, POLLOUT, 0};
+    int err = 0;
+    socklen_t errLen = sizeof(err);
+    if (errno != EINPROGRESS || poll(&p, 1, timeout) != 1 ||
+        getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &errLen) != 0 || err != 0) {
+      close(fd);
+      return 0;
+    }
+  }
+  fd_ = fd;
+  return 1;
+}
+
+size_t WiFiClient::write(const uint8_t *buf, size_t n) {
+  if (loopback_) return n;
+  size_t done = 0;
+  while (fd_ >= 0 && done < n) {
+    ssize_t w = send(fd_, buf + done, n - done, MSG_NOSIGNAL);
+    if (w > 0) {
+      done += (size_t)w;
+    } else if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      pollfd p = {fd_, POLLOUT, 0};
+      if (poll(&p, 1, 1000) != 1) break;
+    } else {
+      break;
+    }
+  }
+  return done;
+}
+
+int WiFiClient::available() {
+  if (fd_ < 0) return 0;
+  int n = 0;
+  if (ioctl(fd_, FIONREAD, &n) == 0 && n > 0) return n;
+  pollfd p = {fd_, POLLIN, 0};
+  if (poll(&p, 1, 1) != 1) return 0;
+  return ioctl(fd_, FIONREAD, &n) == 0 ? n : 0;
+}
+
+int WiFiClient::read(uint8_t *buf, size_t n) {
+  if (fd_ < 0) return -1;
+  ssize_t r = recv(fd_, buf, n, MSG_DONTWAIT);
+  return r > 0 ? (int)r : -1;
+}
+
+int WiFiClient::read() {
+  uint8_t c;
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+int WiFiClient::peek() {
+  uint8_t c;
+  if (fd_ < 0) return -1;
+  return recv(fd_, &c, 1, MSG_PEEK | MSG_DONTWAIT) == 1 ? c : -1;
+}
+
+uint8_t WiFiClient::connected() {
+  if (loopback_) return 1;
+  if (fd_ < 0) return 0;
+  uint8_t c;
+  ssize_t r = recv(fd_, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+  if (r > 0) return 1;
+  if (r == 0) return 0;
+  return errno == EAGAIN || errno == EWOULDBLOCK ? 1 : 0;
+}
+
+void WiFiClient::stop() {
+  if (fd_ >= 0) close(fd_);
+  fd_ = -1;
+}
+
+void WiFiClient::setNoDelay(bool noDelay) {
+  int on = noDelay ? 1 : 0;
+  if (fd_ >= 0) setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+}
+
+uint8_t WiFiUDP::begin(uint16_t) {
+  if (fd_ < 0) fd_ = socket(AF_INET, SOCK_DGRAM, 0);
+  return fd_ >= 0 ? 1 : 0;
+}
+
+int WiFiUDP::beginPacket(const char *host, uint16_t port) {
+  if (fd_ < 0 && !begin(0)) return 0;
+  host_ = host;
+  port_ = port;
+  packet_.clear();
+  return 1;
+}
+
+int WiFiUDP::beginPacket(IPAddress ip, uint16_t port) {
+  return beginPacket(ip.toString().c_str(), port);
+}
+
+size_t WiFiUDP::write(const uint8_t *buf, size_t n) {
+  packet_.append(reinterpret_cast<const char *>(buf), n);
+  return n;
+}
+
+int WiFiUDP::endPacket() {
+  sockaddr_storage addr;
+  socklen_t len = 0;
+  if (fd_ < 0 || !resolve(host_.c_str(), port_, SOCK_DGRAM, addr, len)) return 0;
+  ssize_t n = sendto(fd_, packet_.data(), packet_.size(), 0, reinterpret_cast<sockaddr *>(&addr), len);
+  packet_.clear();
+  return n >= 0 ? 1 : 0;
+}
+
+void WiFiUDP::stop() {
+  if (fd_ >= 0) close(fd_);
+  fd_ = -1;
+}
+
+// ---- WiFi ------------------------------------------------------------------
+
+WiFiClass WiFi;
+
+static bool staConnected = false;
+static std::string staSsid;
+static WiFiEventSysCb eventCb = nullptr;
+static std::mutex eventMu;
+static std::deque<WiFiEvent_t> pendingEvents;
+static uint8_t kBssid[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0xAA};
+
+static void postEvent(WiFiEvent_t e) {
+  std::lock_guard<std::mutex> lock(eventMu);
+  pendingEvents.push_back(e);
+}
+
+void hostWifiPoll() {
+  for (;;) {
+    WiFiEvent_t e;
+    {
+      std::lock_guard<std::mutex> lock(eventMu);
+      if (pendingEvents.empty()) return;
+      e = pendingEvents.front();
+      pendingEvents.pop_front();
+    }
+    WiFiEventInfo_t info = {};
+    if (eventCb) eventCb(e, info);
+  }
+}
+
+bool WiFiClass::isConnected() { return staConnected; }
+IPAddress WiFiClass::localIP() { return staConnected ? IPAddress(127, 0, 0, 1) : IPAddress(); }
+IPAddress WiFiClass::gatewayIP() { return IPAddress(127, 0, 0, 1); }
+IPAddress WiFiClass::subnetMask() { return IPAddress(255, 0, 0, 0); }
+IPAddress WiFiClass::dnsIP(uint8_t) { return IPAddress(127, 0, 0, 53); }
+String WiFiClass::macAddress() { return String("02:00:00:00:00:01"); }
+
+uint8_t *WiFiClass::macAddress(uint8_t *mac) {
+  static const uint8_t kMac[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+  memcpy(mac, kMac, 6);
+  return mac;
+}
+
+uint8_t *WiFiClass::BSSID() { return kBssid; }
+String WiFiClass::SSID() { return String(staSsid); }
+String WiFiClass::BSSIDstr() { return String("02:00:00:00:00:AA"); }
+int8_t WiFiClass::RSSI() { return staConnected ? -50 : 0; }
+int32_t WiFiClass::channel() { return 6; }
+bool WiFiClass::mode(wifi_mode_t) { return true; }
+bool WiFiClass::softAP(const char *) { return true; }
+bool WiFiClass::setSleep(bool) { return true; }
+bool WiFiClass::setAutoReconnect(bool) { return true; }
+bool WiFiClass::setHostname(const char *) { return true; }
+
+int WiFiClass::begin(const char *ssid, const char *) {
+  staSsid = ssid;
+  staConnected = true;
+  postEvent(ARDUINO_EVENT_WIFI_STA_CONNECTED);
+  postEvent(ARDUINO_EVENT_WIFI_STA_GOT_IP);
+  return 1;
+}
+
+bool WiFiClass::disconnect(bool, bool) {
+  if (staConnected) postEvent(ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
+  staConnected = false;
+  return true;
+}
+
+int WiFiClass::hostByName(const char *host, IPAddress &out) {
+  sockaddr_storage addr;
+  socklen_t len = 0;
+  if (!resolve(host, 0, SOCK_STREAM, addr, len)) return 0;
+  const uint8_t *ip = reinterpret_cast<const uint8_t *>(
+      &reinterpret_cast<sockaddr_in *>(&addr)->sin_addr.s_addr);
+  out = IPAddress(ip[0], ip[1], ip[2], ip[3]);
+  return 1;
+}
+
+int WiFiClass::onEvent(WiFiEventSysCb cb) {
+  eventCb = cb;
+  return 1;
+}
+
+esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t *info) {
+  if (!staConnected) return ESP_FAIL;
+  memset(info, 0, sizeof(*info));
+  memcpy(info->bssid, kBssid, 6);
+  snprintf(reinterpret_cast<char *>(info->ssid), sizeof(info->ssid), "%s", staSsid.c_str());
+  info->primary = 6;
+  info->rssi = -50;
+  info->authmode = WIFI_AUTH_WPA2_PSK;
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_config(wifi_interface_t, wifi_config_t *) { return ESP_OK; }
+esp_err_t esp_wifi_scan_start(const wifi_scan_config_t *, bool) { return ESP_FAIL; }
+
+esp_err_t esp_wifi_scan_get_ap_num(uint16_t *count) {
+  *count = 0;
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_scan_get_ap_records(uint16_t *count, wifi_ap_record_t *) {
+  *count = 0;
+  return ESP_OK;
+}
+
+// ---- HTTPClient ------------------------------------------------------------
+
+bool HTTPClient::begin(const String &url) {
+  valid_ = false;
+  std::string u = url.c_str();
+  const std::string scheme = "http://";
+  if (u.compare(0, scheme.size(), scheme) != 0) return false;
+  u = u.substr(scheme.size());
+  size_t slash = u.find('/');
+  std::string authority = u.substr(0, slash);
+  path_ = slash == std::string::npos ? "/" : u.substr(slash);
+  size_t colon = authority.find(':');
+  host_ = authority.substr(0, colon);
+  port_ = colon == std::string::npos ? 80 : (uint16_t)atoi(authority.c_str() + colon + 1);
+  valid_ = !host_.empty();
+  return valid_;
+}
+
+int HTTPClient::GET() {
+  if (!valid_) return HTTPC_ERROR_CONNECTION_REFUSED;
+  if (!client_.connect(host_.c_str(), port_, timeoutMs_)) return HTTPC_ERROR_CONNECTION_REFUSED;
+  std::string req = "GET " + path_ + " HTTP/1.1\r\nHost: " + host_ + "\r\nConnection: close\r\n\r\n";
+  if (client_.write(reinterpret_cast<const uint8_t *>(req.data()), req.size()) != req.size()) {
+    return HTTPC_ERROR_SEND_HEADER_FAILED;
+  }
+  // Real time, not the host clock: the peer needs actual time to answer.
+  std::string head;
+  for (int waited = 0; waited < timeoutMs_ && head.find("\r\n") == std::string::npos;) {
+    if (client_.available() > 0) {
+      uint8_t buf[256];
+      int n = client_.read(buf, sizeof(buf));
+      if (n > 0) head.append(reinterpret_cast<char *>(buf), (size_t)n);
+    } else if (!client_.connected()) {
+      break;
+    } else {
+      waited++;
+    }
+  }
+  int code = 0;
+  if (sscanf(head.c_str(), "HTTP/%*d.%*d %d", &code) != 1) return HTTPC_ERROR_READ_TIMEOUT;
+  return code;
+}
+
+// ---- WebServer -------------------------------------------------------------
+
+static WebServer *activeServer = nullptr;
+// One request at a time, as on the device's HTTP task.
+static std::mutex dispatchMutex;
+static std::atomic<uint32_t> sendDelayMs{0};
+
+void hostHttpSetSendDelayMs(uint32_t ms) { sendDelayMs = ms; }
+
+// A client slow to read the response.
+static void sendDelay() {
+  uint32_t ms = sendDelayMs.load(std::memory_order_relaxed);
+  if (ms > 0) std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+WebServer::WebServer(int) { activeServer = this; }
+
+void WebServer::on(const String &uri, HTTPMethod method, THandlerFunction fn) {
+  routes_.push_back(Route{uri.c_str(), method, fn});
+}
+
+String WebServer::arg(const String &name) {
+  for (const auto &a : args_) {
+    if (a.first == name.c_str()) return String(a.second);
+  }
+  return String();
+}
+
+bool WebServer::hasArg(const String &name) {
+  for (const auto &a : args_) {
+    if (a.first == name.c_str()) return true;
+  }
+  return false;
+}
+
+void WebServer::send(int code, const char *contentType, const String &content) {
+  if (!out_) return;
+  out_->code = code;
+  out_->contentType = contentType ? contentType : "";
+  out_->body.append(content.c_str(), content.length());
+  sendDelay();
+}
+
+void WebServer::send_P(int code, const char *contentType, const char *content, size_t len) {
+  if (!out_) return;
+  out_->code = code;
+  out_->contentType = contentType ? contentType : "";
+  out_->body.append(content, len);
+  sendDelay();
+}
+
+void WebServer::sendContent(const char *content, size_t len) {
+  if (!out_) return;
+  out_->body.append(content, len);
+  sendDelay();
+}
+
+static std::string urlDecode(const std::string &in) {
+  std::string out;
+  for (size_t i = 0; i < in.size(); i++) {
+    if (in[i] == '+') {
+      out += ' ';
+    } else if (in[i] == '%' && i + 2 < in.size()) {
+      out += (char)strtol(in.substr(i + 1, 2).c_str(), nullptr, 16);
+      i += 2;
+    } else {
+      out += in[i];
+    }
+  }
+  return out;
+}
+
+bool WebServer::hostDispatch(HTTPMethod method, const char *uri, const char *query, const char *body,
+                             HostHttpResponse &out) {
+  for (const Route &r : routes_) {
+    if (r.uri != uri || (r.method != HTTP_ANY && r.method != method)) continue;
+    args_.clear();
+    std::string q = query ? query : "";
+    for (size_t pos = 0; pos < q.size();) {
+      size_t amp = q.find('&', pos);
+      if (amp == std::string::npos) amp = q.size();
+      std::string pair = q.substr(pos, amp - pos);
+      size_t eq = pair.find('=');
+      args_.emplace_back(urlDecode(pair.substr(0, eq)),
+                         eq == std::string::npos ? "" : urlDecode(pair.substr(eq + 1)));
+      pos = amp + 1;
+    }
+    if (body && *body) args_.emplace_back("plain", body);
+    method_ = method;
+    uri_ = uri;
+    out = HostHttpResponse();
+    out_ = &out;
+    r.fn();
+    out_ = nullptr;
+    return true;
+  }
+  return false;
+}
+
+bool hostHttpRequest(const char *method, const char *uri, const char *query, const char *body,
+                     HostHttpResponse &out) {
+  if (!activeServer) return false;
+  HTTPMethod m = strcmp(method, "POST") == 0 ? HTTP_POST : HTTP_GET;
+  std::lock_guard<std::mutex> lock(dispatchMutex);
+  return activeServer->hostDispatch(m, uri, query, body, out);
+}
@@ -0,0 +1,76 @@
+// FreeRTOS tasks, notifications and mutexes on std::thread.
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+struct HostTask {
+  std::mutex m;
+  std::condition_variable cv;
+  uint32_t notified = 0;
+};
+
+struct HostMutex {
+  std::timed_mutex m;
+};
+
+// Tasks live until the process exits, like firmware tasks that never
+// return, so they are never freed.
+static thread_local HostTask *currentTask = nullptr;
+static thread_local BaseType_t currentCore = 1;
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *, uint32_t, void *arg, UBaseType_t,
+                                   TaskHandle_t *handle, BaseType_t core) {
+  HostTask *task = new HostTask();
+  if (handle) *handle = task;
+  std::thread([fn, arg, task, core] {
+    currentTask = task;
+    currentCore = core;
+    fn(arg);
+  }).detach();
+  return pdPASS;
+}
+
+BaseType_t xPortGetCoreID() { return currentCore; }
+
+void vTaskDelay(TickType_t ticks) { std::this_thread::sleep_for(std::chrono::milliseconds(ticks)); }
+
+void xTaskNotifyGive(TaskHandle_t task) {
+  std::lock_guard<std::mutex> lock(task->m);
+  task->notified++;
+  task->cv.notify_one();
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks) {
+  HostTask *task = currentTask;
+  std::unique_lock<std::mutex> lock(task->m);
+  auto ready = [task] { return task->notified > 0; };
+  if (ticks == portMAX_DELAY) {
+    task->cv.wait(lock, ready);
+  } else if (!task->cv.wait_for(lock, std::chrono::milliseconds(ticks), ready)) {
+    return 0;
+  }
+  uint32_t value = task->notified;
+  task->notified = clearOnExit ? 0 : value - 1;
+  return value;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() { return new HostMutex(); }
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t mutex, TickType_t ticks) {
+  if (ticks == portMAX_DELAY) {
+    mutex->m.lock();
+    return pdTRUE;
+  }
+  return mutex->m.try_lock_for(std::chrono::milliseconds(ticks)) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t mutex) {
+  mutex->m.unlock();
+  return pdTRUE;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdio.h>
+#include <string.h>
+
+// Minimal assertion helpers for host-side tests of lib/node-core. Each test
+// file is its own executable; tools/host-test.sh builds and runs them all.
+
+static int hostTestFailures = 0;
+
+#define CHECK(cond)                                                       \
+  do {                                                                    \
+    if (!(cond)) {                                                        \
+      fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__,   \
+              #cond);                                                     \
+      hostTestFailures++;                                                 \
+    }                                                                     \
+  } while (0)
+
+#define CHECK_EQ(a, b)                                                    \
+  do {                                                                    \
+    long long va_ = (long long)(a);                                       \
+    long long vb_ = (long long)(b);                                       \
+    if (va_ != vb_) {                                                     \
+      fprintf(stderr, "%s:%d: CHECK_EQ failed: %s=%lld %s=%lld\n",        \
+              __FILE__, __LINE__, #a, va_, #b, vb_);                      \
+      hostTestFailures++;                                                 \
+    }                                                                     \
+  } while (0)
+
+#define CHECK_STR(a, b)                                                   \
+  do {                                                                    \
+    const char *sa_ = (a);                                                \
+    const char *sb_ = (b);                                                \
+    if (strcmp(sa_, sb_) != 0) {                                          \
+      fprintf(stderr, "%s:%d: CHECK_STR failed:\n  got:  %s\n  want: %s\n", \
+              __FILE__, __LINE__, sa_, sb_);                              \
+      hostTestFailures++;                                                 \
+    }                                                                     \
+  } while (0)
+
+#define RUN_TEST(fn)        \
+  do {                      \
+    fn();                   \
+    printf("  %s\n", #fn);  \
+  } while (0)
+
+#define TEST_MAIN_END()                                   \
+  do {                                                    \
+    if (hostTestFailures) {                               \
+      fprintf(stderr, "%d check(s) failed\n", hostTestFailures); \
+      return 1;                                           \
+    }                                                     \
+    return 0;                                             \
+  } while (0)
@@ -0,0 +1,79 @@
+#include <string>
+
+#include "batch_controller.h"
+#include "host_test.h"
+#include "record_ring.h"
+
+static void fill(RecordRing &ring, int n, size_t len) {
+  std::string rec(len, 'x');
+  for (int i = 0; i < n; i++) CHECK(ring.push(rec.data(), rec.size()));
+}
+
+static void testPlanRespectsCountAndBytes() {
+  alignas(4) static uint8_t arena[8192];
+  RecordRing ring(arena, sizeof(arena));
+  BatchController ctl(4, 32, 250, 500);
+  CHECK_EQ(ctl.plan(ring).count, 0);
+
+  fill(ring, 10, 40);
+  BatchController::Plan p = ctl.plan(ring);
+  CHECK_EQ(p.count, 4);
+  CHECK_EQ(p.bytes, RecordBatchReader(ring, 4).length());
+
+  for (int i = 0; i < 10; i++) ctl.onSuccess(ctl.limit(), 10, 100);
+  p = ctl.plan(ring);
+  // Six records: 2 + 40 + 5 * 41 = 247 bytes; a seventh would exceed 250.
+  CHECK_EQ(p.count, 6);
+  CHECK_EQ(p.bytes, 247);
+  p = ctl.plan(ring, ring.begin(), 3);
+  CHECK_EQ(p.count, 3);
+  CHECK_EQ(p.bytes, RecordBatchReader(ring, 3).length());
+
+  // A single record larger than the byte cap is still sent on its own.
+  RecordRing big(arena, sizeof(arena));
+  fill(big, 2, 400);
+  CHECK_EQ(ctl.plan(big).count, 1);
+}
+
+static void testGrowsWithBacklogAndShrinksWhenSlow() {
+  BatchController ctl(1, 64, 100000, 500);
+  CHECK_EQ(ctl.limit(), 1);
+  ctl.onSuccess(1, 50, 0);
+  CHECK_EQ(ctl.limit(), 1);  // no backlog, no growth
+  size_t prev = ctl.limit();
+  for (int i = 0; i < 20; i++) {
+    ctl.onSuccess(ctl.limit(), 50, 1000);
+    CHECK(ctl.limit() >= prev);
+    prev = ctl.limit();
+  }
+  CHECK_EQ(ctl.limit(), 64);
+  ctl.onSuccess(10, 50, 1000);  // batch smaller than the limit: hold
+  CHECK_EQ(ctl.limit(), 64);
+  ctl.onSuccess(64, 900, 1000);
+  CHECK_EQ(ctl.limit(), 32);
+  ctl.onFailure();
+  CHECK_EQ(ctl.limit(), 16);
+  for (int i = 0; i < 10; i++) ctl.onFailure();
+  CHECK_EQ(ctl.limit(), 1);
+}
+
+static void testFixedModeAndLatencyAverage() {
+  BatchController ctl(8, 8, 100000, 500);
+  for (int i = 0; i < 5; i++) ctl.onSuccess(8, 100, 1000);
+  CHECK_EQ(ctl.limit(), 8);
+  ctl.onFailure();
+  CHECK_EQ(ctl.limit(), 8);
+  BatchController avg(1, 4, 1000, 500);
+  avg.onSuccess(1, 40, 0);
+  CHECK_EQ(avg.avgLatencyMs(), 40);
+  for (int i = 0; i < 100; i++) avg.onSuccess(1, 4, 0);
+  CHECK(avg.avgLatencyMs() <= 5);
+}
+
+int main() {
+  printf("test_batch_controller\n");
+  RUN_TEST(testPlanRespectsCountAndBytes);
+  RUN_TEST(testGrowsWithBacklogAndShrinksWhenSlow);
+  RUN_TEST(testFixedModeAndLatencyAverage);
+  TEST_MAIN_END();
+}
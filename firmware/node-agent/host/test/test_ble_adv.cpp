@@ -0,0 +1,50 @@
+#include <string>
+
+#include "ble_adv.h"
+#include "host_test.h"
+
+static void testParsesFields() {
+  const uint8_t adv[] = {
+      0x02, 0x01, 0x06,                                // flags
+      0x05, 0x03, 0x0F, 0x18, 0x0A, 0x18,              // two 16-bit UUIDs
+      0x05, 0xFF, 0x4C, 0x00, 0x10, 0x05,              // manufacturer data
+      0x05, 0x08, 'a', 'b', 'c', 'd',                  // short name
+      0x11, 0x07, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16,
+  };
+  BleAdvSummary s;
+  bleParseAdv(adv, sizeof(adv), s);
+  CHECK_EQ(s.flags, 0x06);
+  CHECK_EQ(s.svc_count, 3);
+  CHECK_EQ(s.mfg_len, 4);
+  CHECK_EQ(s.name_len, 4);
+  CHECK(std::string(s.name, s.name_len) == "abcd");
+}
+
+static void testCompleteNameWins() {
+  const uint8_t adv[] = {0x03, 0x09, 'h', 'i', 0x04, 0x08, 'x', 'y', 'z'};
+  BleAdvSummary s;
+  bleParseAdv(adv, sizeof(adv), s);
+  CHECK(std::string(s.name, s.name_len) == "hi");
+  CHECK_EQ(s.flags, 0);
+}
+
+static void testTruncatedPayloadStops() {
+  const uint8_t adv[] = {0x02, 0x01, 0x1A, 0x09, 0x09, 'n', 'a'};
+  BleAdvSummary s;
+  bleParseAdv(adv, sizeof(adv), s);
+  CHECK_EQ(s.flags, 0x1A);
+  CHECK(s.name == nullptr);
+  CHECK_EQ(s.name_len, 0);
+
+  const uint8_t zero[] = {0x00, 0x02, 0x01, 0x06};
+  bleParseAdv(zero, sizeof(zero), s);
+  CHECK_EQ(s.flags, 0);
+}
+
+int main() {
+  printf("test_ble_adv\n");
+  RUN_TEST(testParsesFields);
+  RUN_TEST(testCompleteNameWins);
+  RUN_TEST(testTruncatedPayloadStops);
+  TEST_MAIN_END();
+}
@@ -0,0 +1,67 @@
+#include "ble_digest.h"
+#include "host_test.h"
+#include "json_writer.h"
+
+static BleDeviceEntry makeDevice() {
+  BleDeviceEntry dev = BleDeviceEntry();
+  const uint8_t addr[6] = {0xC4, 0x0D, 0x1A, 0x9E, 0x07, 0x7B};
+  memcpy(dev.addr, addr, 6);
+  dev.addr_type = 1;
+  return dev;
+}
+
+// Mirrors the table update that follows bleDigestObserve on the device.
+static void observe(BleDeviceEntry &dev, int8_t rssi, uint8_t flags, uint8_t svc, uint32_t ms) {
+  bleDigestObserve(dev, rssi, flags, svc, ms);
+  dev.adv_flags = flags;
+  dev.svc_count = svc;
+  dev.rssi = rssi;
+  dev.last_seen_ms = ms;
+}
+
+static void testAccumulatesWindow() {
+  BleDeviceEntry dev = makeDevice();
+  CHECK(!bleDigestPending(dev));
+  observe(dev, -70, 6, 1, 10100);
+  observe(dev, -61, 6, 1, 10400);
+  observe(dev, -80, 2, 1, 12000);
+  observe(dev, -72, 2, 3, 19000);
+  CHECK(bleDigestPending(dev));
+  CHECK_EQ(dev.win.count, 4);
+  CHECK_EQ(dev.win.rssi_min, -80);
+  CHECK_EQ(dev.win.rssi_max, -61);
+  CHECK_EQ(dev.win.flag_changes, 1);
+  CHECK_EQ(dev.win.svc_changes, 1);
+
+  char buf[256];
+  JsonWriter w(buf, sizeof(buf));
+  bleDigestWriteDevice(w, dev, 10000);
+  CHECK_STR(w.c_str(),
+            "{\"addr\":\"c4:0d:1a:9e:07:7b\",\"addr_type\":1,\"n\":4,\"rssi\":[-80,-71,-61],"
+            "\"first\":100,\"last\":9000,\"flags\":2,\"svc\":3,\"flag_changes\":1,\"svc_changes\":1}");
+
+  bleDigestReset(dev);
+  CHECK(!bleDigestPending(dev));
+  memcpy(dev.name, "Tile", 4);
+  dev.name_len = 4;
+  observe(dev, -50, 2, 3, 40000);
+  w.reset();
+  bleDigestWriteDevice(w, dev, 40000);
+  CHECK_STR(w.c_str(),
+            "{\"addr\":\"c4:0d:1a:9e:07:7b\",\"addr_type\":1,\"n\":1,\"rssi\":[-50,-50,-50],"
+            "\"first\":0,\"last\":0,\"flags\":2,\"svc\":3,\"name\":\"Tile\"}");
+}
+
+static void testCountSaturates() {
+  BleDeviceEntry dev = makeDevice();
+  for (uint32_t i = 0; i < 70000; i++) observe(dev, -60, 6, 0, i);
+  CHECK_EQ(dev.win.count, 0xFFFF);
+  CHECK_EQ(dev.win.rssi_sum, -60 * 0xFFFF);
+}
+
+int main() {
+  printf("test_ble_digest\n");
+  RUN_TEST(testAccumulatesWindow);
+  RUN_TEST(testCountSaturates);
+  TEST_MAIN_END();
+}
@@ -0,0 +1,149 @@
+#include <string>
+#include <vector>
+
+#include "ble_fingerprint.h"
+#include "host_test.h"
+
+// Expected values come from computeFingerprints() and normalizeName() in
+// ops/strangelab-control-plane/services/ble/identity-core.mjs.
+
+// CHECK_STR on std::string results, kept alive for the comparison.
+#define CHECK_STRING(a, b)                                \
+  do {                                                    \
+    std::string got_ = (a);                               \
+    std::string want_ = (b);                              \
+    CHECK_STR(got_.c_str(), want_.c_str());               \
+  } while (0)
+
+static std::string hexOf(const uint8_t digest[32]) {
+  char hex[65];
+  sha256Hex(digest, hex);
+  return hex;
+}
+
+static std::vector<uint8_t> ad(std::vector<uint8_t> payload, uint8_t type, const std::vector<uint8_t> &data) {
+  payload.push_back((uint8_t)(data.size() + 1));
+  payload.push_back(type);
+  payload.insert(payload.end(), data.begin(), data.end());
+  return payload;
+}
+
+static std::vector<uint8_t> text(const char *s) { return std::vector<uint8_t>(s, s + strlen(s)); }
+
+static std::string stableOf(const std::vector<uint8_t> &payload) {
+  BleAdvSummary adv;
+  bleParseAdv(payload.data(), payload.size(), adv);
+  uint8_t fp[32];
+  if (!bleStableFingerprint(payload.data(), payload.size(), adv, fp)) return "null";
+  return hexOf(fp);
+}
+
+static void testSha256() {
+  uint8_t d[32];
+  Sha256 empty;
+  empty.finish(d);
+  CHECK_STRING(hexOf(d), "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+  Sha256 abc;
+  abc.update("abc");
+  abc.finish(d);
+  CHECK_STRING(hexOf(d), "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+  // Two blocks, fed in uneven pieces.
+  const char *msg = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+  Sha256 multi;
+  for (size_t i = 0; i < strlen(msg); i += 7) multi.update(msg + i, strlen(msg) - i < 7 ? strlen(msg) - i : 7);
+  multi.finish(d);
+  CHECK_STRING(hexOf(d), "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+}
+
+static void testNormalizeName() {
+  const char *cases[][2] = {
+      {"Sensor-0A1B", "sensor"},   {"abcd", ""},           {"x abcd", "x"},
+      {"Tile_12345", "tile"},      {"Pixel 7 (12)", "pixel 7"}, {"Buds (x)", "buds (x)"},
+      {"a-b-cafe", "a-b"},         {"hello  world", "hello world"}, {"TV 1234 ", "tv"},
+      {"x (1) (2)", "x (1)"},      {"deadbeef-1", "deadbeef-1"}, {"a\tb", "a b"},
+      {"(12)", ""},                {"Apple Watch (3)", "apple watch"}, {"  Node    77ff  ", "node"},
+  };
+  for (const auto &c : cases) {
+    char out[64];
+    size_t n = bleNormalizeName(c[0], strlen(c[0]), out);
+    CHECK_STRING(std::string(out, n), c[1]);
+  }
+}
+
+static void testMaskManufacturer() {
+  const uint8_t apple[] = {0x4c, 0x00, 0x10, 0x05, 0x11, 0x22, 0x33, 0x44};
+  uint8_t out[8];
+  bleMaskManufacturer(apple, sizeof(apple), out);
+  const uint8_t appleMasked[] = {0x4c, 0x00, 0x10, 0x05, 0x11, 0x22, 0x00, 0x00};
+  CHECK(memcmp(out, appleMasked, 8) == 0);
+  const uint8_t other[] = {0xa1, 0xb2, 0xc3, 0xd4, 0xe5, 0xf6};
+  bleMaskManufacturer(other, sizeof(other), out);
+  const uint8_t otherMasked[] = {0xa1, 0xb2, 0xc3, 0xd4, 0x00, 0x00};
+  CHECK(memcmp(out, otherMasked, 6) == 0);
+}
+
+static void testStableMatchesIdentityCore() {
+  std::vector<uint8_t> flags = ad({}, 0x01, {0x06});
+
+  std::vector<uint8_t> watch = ad(flags, 0x03, {0x0f, 0x18, 0x0a, 0x18});
+  watch = ad(watch, 0xFF, {0x4c, 0x00, 0x10, 0x05, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99,
+                           0xaa, 0xbb, 0xcc});
+  watch = ad(watch, 0x09, text("watch-9f0a"));
+  CHECK_STRING(stableOf(watch), "e6439ddf5200b35f91015f3884709d21b03e6c9388d0f640ca4a3a4a2a8351dd");
+
+  // 128-bit UUID, a duplicated 16-bit UUID in a second list, short name.
+  std::vector<uint8_t> uart = ad(flags, 0x07, {0x9e, 0xca, 0xdc, 0x24, 0x0e, 0xe5, 0xa9, 0xe0, 0x93, 0xf3,
+                                               0xa3, 0xb5, 0x01, 0x00, 0x40, 0x6e});
+  uart = ad(uart, 0x02, {0x0d, 0x18});
+  uart = ad(uart, 0x03, {0x0d, 0x18});
+  uart = ad(uart, 0x08, text("Apple Watch (3)"));
+  CHECK_STRING(stableOf(uart), "e26631ceeda2aac19ae32f11690aae4d78f3c9ccbc0fd2e03ad4410f319a1fdc");
+
+  std::vector<uint8_t> uuid32 = ad(flags, 0x05, {0x6f, 0xfd, 0x00, 0x00});
+  CHECK_STRING(stableOf(uuid32), "59f500c1d67356e5e0b8849a372ea44cde9e124ce5ac4d2e6103401f293a4cc9");
+
+  std::vector<uint8_t> named = ad(flags, 0x09, text("  Node    77ff  "));
+  CHECK_STRING(stableOf(named), "bfba84977be161e586fba00ee341bc5a5a6337ded504074eb1562f6a36d137a9");
+
+  CHECK_STRING(stableOf(flags), "null");
+
+  std::vector<uint8_t> microsoft =
+      ad(flags, 0xFF, {0x06, 0x00, 0x01, 0x09, 0x20, 0x02, 0x7d, 0x4a, 0x2b, 0x9c, 0x1d, 0x0e});
+  CHECK_STRING(stableOf(microsoft), "9f8fc65405c9b0a0be9f4f44bab627fe7afb71c25866623056e5227b418f6360");
+
+  // The whole name is a hex run, so only the manufacturer data remains.
+  std::vector<uint8_t> generic = ad(flags, 0xFF, {0x90, 0x05, 0xa1, 0xb2, 0xc3, 0xd4});
+  generic = ad(generic, 0x09, text("ABCDEF"));
+  CHECK_STRING(stableOf(generic), "739160391fe54f373f0c795f5a8fec801b53ece822dc7d6c7c79987caef55bde");
+
+  // Rotating the volatile manufacturer bytes keeps the fingerprint.
+  std::vector<uint8_t> rotated = ad(flags, 0x03, {0x0f, 0x18, 0x0a, 0x18});
+  rotated = ad(rotated, 0xFF, {0x4c, 0x00, 0x10, 0x05, 0x11, 0x22, 0xdd, 0xcc, 0xbb, 0xaa, 0x00, 0x99,
+                               0x88, 0x77, 0x66, 0x55});
+  rotated = ad(rotated, 0x09, text("watch-01bc"));
+  CHECK_STRING(stableOf(rotated), stableOf(watch));
+}
+
+static void testAddrFingerprint() {
+  const uint8_t a[6] = {0xC4, 0x0D, 0x1A, 0x9E, 0x07, 0x7B};
+  uint8_t fp[32];
+  bleAddrFingerprint(a, 1, fp);
+  CHECK_STRING(hexOf(fp), "79bdbecfb5d8218eac7aa0927d11d3a9c9bb0ab9814eb2a5c9d6e4c8ca7eef84");
+  const uint8_t b[6] = {0x11, 0x22, 0x33, 0x44, 0x55, 0x66};
+  bleAddrFingerprint(b, 0, fp);
+  CHECK_STRING(hexOf(fp), "999eadae84e4bf02e364ba46071678b1d626477d49000d7a0cd365df88385255");
+  bleAddrFingerprint(b, 2, fp);
+  CHECK_STRING(hexOf(fp), "939c8c58b2861017e01852f3d297fe33d6f613f91f56d0ed7c125bf892b9c8d3");
+  CHECK(bleFingerprintKey(fp) != bleAddrKey(b, 0));
+  CHECK(bleFingerprintKey(fp) >> 63);
+}
+
+int main() {
+  printf("test_ble_fingerprint\n");
+  RUN_TEST(testSha256);
+  RUN_TEST(testNormalizeName);
+  RUN_TEST(testMaskManufacturer);
+  RUN_TEST(testStableMatchesIdentityCore);
+  RUN_TEST(testAddrFingerprint);
+  TEST_MAIN_END();
+}
@@ -0,0 +1,145 @@
+#include <set>
+#include <vector>
+
+#include "ble_query.h"
+#include "host_test.h"
+#include "lru_table.h"
+
+typedef LruHashTable<BleDeviceEntry, 64> Table;
+
+static void see(Table &t, uint64_t key, uint32_t ms, int8_t rssi) {
+  bool inserted;
+  BleDeviceEntry *e = t.upsert(key, inserted);
+  e->last_seen_ms = ms;
+  e->rssi = rssi;
+}
+
+// 40 devices, three per millisecond, rssi cycling from -90 to -41.
+static void fill(Table &t) {
+  for (uint64_t k = 0; k < 40; k++) see(t, 1000 + k, 5000 + (uint32_t)k / 3, (int8_t)(-90 + k % 50));
+}
+
+static std::vector<uint64_t> collect(const Table &t, const BleLatestQuery &q, bool &more,
+                                     uint32_t &ms, uint64_t &key) {
+  std::vector<uint64_t> out;
+  more = bleQueryLatest(
+      t, q, [&](uint64_t k, const BleDeviceEntry &) { out.push_back(k); }, ms, key);
+  return out;
+}
+
+static void testPagesCoverEveryDeviceOnce() {
+  Table t;
+  fill(t);
+  for (uint16_t limit = 1; limit <= 41; limit++) {
+    BleLatestQuery q;
+    q.limit = limit;
+    std::vector<uint64_t> all;
+    bool more = true;
+    int pages = 0;
+    while (more) {
+      uint32_t ms = 0;
+      uint64_t key = 0;
+      std::vector<uint64_t> page = collect(t, q, more, ms, key);
+      CHECK(page.size() <= limit);
+      all.insert(all.end(), page.begin(), page.end());
+      q.hasCursor = true;
+      q.cursorMs = ms;
+      q.cursorKey = key;
+      pages++;
+      if (pages > 50) break;
+    }
+    CHECK_EQ(all.size(), 40);
+    for (size_t i = 0; i < all.size(); i++) CHECK_EQ(all[i], 1039 - i);
+    if (hostTestFailures) return;
+  }
+}
+
+static void testSinceAndMinRssi() {
+  Table t;
+  fill(t);
+  BleLatestQuery q;
+  q.limit = 64;
+  q.hasSince = true;
+  q.sinceMs = 5010;  // keys 1033.. are at 5011..5013
+  bool more;
+  uint32_t ms;
+  uint64_t key;
+  std::vector<uint64_t> got = collect(t, q, more, ms, key);
+  CHECK(!more);
+  CHECK_EQ(got.size(), 7);
+  CHECK_EQ(got.back(), 1033);
+
+  q = BleLatestQuery();
+  q.limit = 64;
+  q.minRssi = -60;
+  got = collect(t, q, more, ms, key);
+  CHECK_EQ(got.size(), 10);  // rssi -60..-51 for keys 1030..1039
+  for (uint64_t k : got) CHECK(k >= 1030);
+
+  // since_ms survives the millis() wrap.
+  Table w;
+  see(w, 1, 0xFFFFFFF0u, -50);
+  see(w, 2, 0x10, -50);
+  q = BleLatestQuery();
+  q.hasSince = true;
+  q.sinceMs = 0xFFFFFF00u;
+  CHECK_EQ(collect(w, q, more, ms, key).size(), 2);
+  q.sinceMs = 0xFFFFFFF0u;
+  got = collect(w, q, more, ms, key);
+  CHECK_EQ(got.size(), 1);
+  CHECK_EQ(got[0], 2);
+}
+
+static void testCursorSurvivesNewAdverts() {
+  Table t;
+  fill(t);
+  BleLatestQuery q;
+  q.limit = 10;
+  bool more;
+  uint32_t ms = 0;
+  uint64_t key = 0;
+  std::set<uint64_t> seen;
+  for (uint64_t k : collect(t, q, more, ms, key)) seen.insert(k);
+  CHECK(more);
+  // Devices from the first and the next page advertise again meanwhile.
+  see(t, 1035, 6000, -40);
+  see(t, 1025, 6001, -40);
+  q.hasCursor = true;
+  q.cursorMs = ms;
+  q.cursorKey = key;
+  q.limit = 64;
+  std::vector<uint64_t> rest = collect(t, q, more, ms, key);
+  CHECK(!more);
+  for (uint64_t k : rest) CHECK(seen.insert(k).second);
+  // 1025 moved ahead of the cursor and is left for the next since_ms poll.
+  CHECK_EQ(seen.size(), 39);
+  CHECK(!seen.count(1025));
+}
+
+static void testCursorFormat() {
+  char buf[kBleCursorMax];
+  size_t n = bleFormatCursor(buf, 0xFFFFFFFFu, 0x1ffffffffffffffULL);
+  CHECK_EQ(n, strlen(buf));
+  CHECK_STR(buf, "4294967295.1ffffffffffffff");
+  uint32_t ms;
+  uint64_t key;
+  CHECK(bleParseCursor(buf, ms, key));
+  CHECK_EQ(ms, 0xFFFFFFFFu);
+  CHECK_EQ(key, 0x1ffffffffffffffULL);
+  CHECK(bleParseCursor("12.AbC", ms, key));
+  CHECK_EQ(ms, 12);
+  CHECK_EQ(key, 0xabc);
+  const char *bad[] = {"", "12", "12.", ".ff", "-1.ff", "12.-f", "12.ffx", "4294967296.1",
+                       "1.12345678901234567"};
+  for (const char *s : bad) CHECK(!bleParseCursor(s, ms, key));
+  CHECK(!bleParseCursor(nullptr, ms, key));
+}
+
+int main() {
+  printf("test_ble_query\n");
+  RUN_TEST(testPagesCoverEveryDeviceOnce);
+  RUN_TEST(testSinceAndMinRssi);
+  RUN_TEST(testCursorSurvivesNewAdverts);
+  RUN_TEST(testCursorFormat);
+  TEST_MAIN_END();
+}
@@ -0,0 +1,121 @@
+#include <vector>
+
+#include "ble_sampler.h"
+#include "host_test.h"
+
+static BleSampler::Config defaultConfig() {
+  BleSampler::Config c;
+  c.globalPerSec = 10;
+  c.globalBurst = 10;
+  c.deviceIntervalMs = 2000;
+  c.deviceBurst = 2;
+  c.newDeviceReservePct = 30;
+  c.activeWindowMs = 10000;
+  return c;
+}
+
+static void testDeviceBucket() {
+  BleSampler s(defaultConfig());
+  BleDeviceEntry dev = BleDeviceEntry();
+  CHECK(s.admit(dev, true, 0));
+  CHECK(s.admit(dev, false, 10));
+  CHECK(!s.admit(dev, false, 20));
+  CHECK_EQ(dev.admitted, 2);
+  CHECK_EQ(dev.suppressed, 1);
+  CHECK_EQ(s.stats().suppressedDevice, 1);
+  CHECK(!s.admit(dev, false, 1999));
+  CHECK(s.admit(dev, false, 2000));
+  CHECK(!s.admit(dev, false, 2500));
+  // 2000 + 2 * 2000 refills the bucket completely.
+  CHECK(s.admit(dev, false, 6000));
+  CHECK(s.admit(dev, false, 6001));
+  CHECK(!s.admit(dev, false, 6002));
+}
+
+static void testReserveKeptForNewDevices() {
+  BleSampler s(defaultConfig());
+  std::vector<BleDeviceEntry> devs(20, BleDeviceEntry());
+  // Known devices can take the global bucket down to the 30% reserve only.
+  int admitted = 0;
+  for (int i = 0; i < 10; i++) {
+    s.admit(devs[i], true, 0);  // first sighting; spends one global token each
+  }
+  CHECK_EQ(s.globalTokens(), 0);
+  s.admit(devs[0], false, 1000);  // +10 tokens
+  for (int i = 1; i < 10; i++) {
+    if (s.admit(devs[i], false, 1000)) admitted++;
+  }
+  CHECK_EQ(admitted, 6);  // 7 allowed in total above the reserve of 3
+  CHECK_EQ(s.globalTokens(), 3);
+  CHECK(s.stats().suppressedGlobal >= 1);
+  for (int i = 10; i < 13; i++) CHECK(s.admit(devs[i], true, 1000));
+  CHECK(!s.admit(devs[13], true, 1000));
+  CHECK_EQ(s.stats().admittedNew, 13);
+}
+
+// Three chatty advertisers and a crowd of quiet ones: every quiet device
+// must make it into the event stream, and total volume stays bounded.
+static void testChattyDevicesDoNotStarveQuietOnes() {
+  BleSampler s(defaultConfig());
+  const int kChatty = 3;
+  const int kQuiet = 20;
+  std::vector<BleDeviceEntry> devs(kChatty + kQuiet, BleDeviceEntry());
+  std::vector<bool> seen(devs.size(), false);
+  uint32_t total = 0;
+  for (uint32_t ms = 0; ms < 60000; ms += 10) {
+    for (int c = 0; c < kChatty; c++) {
+      // 100 adverts/s each.
+      bool isNew = !seen[c];
+      seen[c] = true;
+      if (s.admit(devs[c], isNew, ms)) total++;
+    }
+    for (int q = 0; q < kQuiet; q++) {
+      // One advert every 3 s, staggered; 20 per device over the run.
+      if ((ms + (uint32_t)q * 150) % 3000 != 0) continue;
+      int i = kChatty + q;
+      bool isNew = !seen[i];
+      seen[i] = true;
+      if (s.admit(devs[i], isNew, ms)) total++;
+    }
+  }
+  for (int q = 0; q < kQuiet; q++) CHECK(devs[kChatty + q].admitted >= 15);
+  for (int c = 0; c < kChatty; c++) CHECK(devs[c].admitted <= 32);
+  CHECK(total <= 10 * 60 + 10);
+}
+
+// More devices than the global rate can serve at the configured per-device
+// rate: the budget is split evenly instead of going to whichever devices
+// happen to advertise right after a refill.
+static void testCrowdSharesBudgetEvenly() {
+  BleSampler s(defaultConfig());
+  const int kDevices = 200;
+  std::vector<BleDeviceEntry> devs(kDevices, BleDeviceEntry());
+  std::vector<bool> seen(kDevices, false);
+  uint32_t total = 0;
+  for (uint32_t ms = 0; ms < 120000; ms += 10) {
+    for (int i = 0; i < kDevices; i++) {
+      // 1 Hz each, a tenth of them at 10 Hz, fixed phases.
+      uint32_t interval = i % 10 == 0 ? 100 : 1000;
+      if ((ms + (uint32_t)i * 37) % interval >= 10) continue;
+      bool isNew = !seen[i];
+      seen[i] = true;
+      if (s.admit(devs[i], isNew, ms)) total++;
+    }
+  }
+  CHECK_EQ(s.activeDevices(), kDevices);
+  // 200 devices sharing 70% of 10/s: one event per device every 28.5 s.
+  CHECK_EQ(s.deviceIntervalMs(), 28571);
+  // 120 s at that share is 4 each, plus the first sighting and burst.
+  for (int i = 0; i < kDevices; i++) CHECK(devs[i].admitted >= 3);
+  for (int i = 0; i < kDevices; i++) CHECK(devs[i].admitted <= 7);
+  CHECK(total <= 10 * 120 + 10);
+}
+
+int main() {
+  printf("test_ble_sampler\n");
+  RUN_TEST(testDeviceBucket);
+  RUN_TEST(testReserveKeptForNewDevices);
+  RUN_TEST(testChattyDevicesDoNotStarveQuietOnes);
+  RUN_TEST(testCrowdSharesBudgetEvenly);
+  TEST_MAIN_END();
+}
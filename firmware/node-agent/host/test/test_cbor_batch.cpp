@@ -0,0 +1,221 @@
+#include <string>
+#include <vector>
+
+#include "cbor_batch.h"
+#include "host_test.h"
+#include "json_writer.h"
+#include "node_events.h"
+
+static const char kNodeId[] = "lab-esp32-01";
+
+static EventText text(const char *s) { return EventText{s, strlen(s)}; }
+
+static EventEnvelope envelope(uint32_t ts, uint32_t seq) {
+  return EventEnvelope{1, ts, {kNodeId, sizeof(kNodeId) - 1}, seq, 2};
+}
+
+template <typename T>
+static std::string json(const EventEnvelope &env, const T &ev) {
+  char buf[1024];
+  JsonWriter w(buf, sizeof(buf));
+  eventEncodeJson(w, env, ev);
+  return std::string(w.c_str(), w.size());
+}
+
+static std::vector<uint8_t> encode(const std::vector<std::string> &events, size_t cap = 8192) {
+  std::vector<uint8_t> buf(cap);
+  CborBatchEncoder enc(buf.data(), buf.size());
+  enc.begin(events.size());
+  for (const std::string &e : events) {
+    if (!enc.add(e.data(), e.size())) return {};
+  }
+  buf.resize(enc.finish());
+  return buf;
+}
+
+// The decoded JSON, in a buffer shared by all calls.
+static const char *decode(const std::vector<uint8_t> &cbor, size_t *events = nullptr) {
+  static char out[16384];
+  JsonWriter w(out, sizeof(out));
+  if (!cborBatchDecode(cbor.data(), cbor.size(), w, events)) return "<decode failed>";
+  return w.c_str();
+}
+
+static std::string asArray(const std::vector<std::string> &events) {
+  std::string s = "[";
+  for (size_t i = 0; i < events.size(); i++) s += (i ? "," : "") + events[i];
+  return s + "]";
+}
+
+static BleSeenEvent bleSeen(uint8_t last, int rssi) {
+  BleSeenEvent ev;
+  const uint8_t mac[6] = {0xc4, 0x0d, 0x1a, 0x9e, 0x07, last};
+  memcpy(ev.addr.b, mac, 6);
+  ev.rssi = rssi;
+  ev.addr_type = text("random");
+  ev.vendor_id.setNull();
+  ev.flags = 6;
+  if (last & 1) {
+    EventHex<32> fp = {};
+    for (uint8_t i = 0; i < 32; i++) fp.b[i] = (uint8_t)(i * 29 + last);
+    ev.fp_stable.set(fp);
+  }
+  return ev;
+}
+
+static void testHeaderBytes() {
+  std::vector<std::string> events = {
+      "{\"v\":1,\"ts_ms\":1000,\"node_id\":\"n1\",\"type\":\"x\",\"src\":\"n1\",\"seq\":7,"
+      "\"epoch\":2,\"data\":{}}"};
+  std::vector<uint8_t> cbor = encode(events);
+  const uint8_t expected[] = {
+      0xA5,                                                      // header map
+      0x63, 'f', 'm', 't', 0x01,                                 // fmt 1
+      0x61, 'v', 0x01,                                           // v 1
+      0x67, 'n', 'o', 'd', 'e', '_', 'i', 'd', 0x62, 'n', '1',   // node_id
+      0x65, 't', 's', '_', 'm', 's', 0x19, 0x03, 0xE8,           // base ts 1000
+      0x66, 'e', 'v', 'e', 'n', 't', 's', 0x81,                  // one event
+      0xA6, 0x00, 0x00,                                          // dt 0
+      0x01, 0x61, 'x',                                           // type
+      0x04, 0xF7,                                                // src = node_id
+      0x02, 0x07,                                                // seq
+      0x18, 0x3C, 0x02,                                          // epoch
+      0x03, 0xA0,                                                // data {}
+  };
+  CHECK_EQ(cbor.size(), sizeof(expected));
+  CHECK(memcmp(cbor.data(), expected, sizeof(expected)) == 0);
+  std::string array = asArray(events);
+  CHECK_STR(decode(cbor), array.c_str());
+}
+
+static void testRoundTrip() {
+  std::vector<std::string> events;
+  uint32_t ts = 50000;
+  for (uint8_t i = 0; i < 20; i++) {
+    ts += i * 37;
+    events.push_back(json(envelope(ts, i), bleSeen(i, -40 - i)));
+  }
+
+  HeartbeatEvent hb = {};
+  hb.uptime_ms = 123456789;
+  hb.heap_free = 81234;
+  hb.hostname = text("sods-node");
+  hb.wifi_rssi = -61;
+  hb.ip.setNull();
+  hb.queue_depth = 12;
+  events.push_back(json(envelope(ts - 500, 20), hb));  // clocks may step back
+
+  IngestOkEvent ok;
+  ok.ok = true;
+  ok.batch_count = 20;
+  ok.ms = 35;
+  ok.raw_bytes = 9000;
+  ok.wire_bytes = 2100;
+  ok.ratio.set(EventFixed2{428});
+  ok.encoding = text("gzip");
+  ok.format = text("cbor");
+  ok.batch_limit = 32;
+  events.push_back(json(envelope(0xFFFFFFF0u, 21), ok));  // and wrap
+  events.push_back(json(envelope(5, 22), ok));
+
+  WifiApSeenEvent ap = {};
+  ap.ssid = text("caf\xc3\xa9 \"guest\"\t\x01");
+  ap.rssi = -67;
+  ap.channel = 6;
+  ap.auth = text("wpa2");
+  events.push_back(json(envelope(6, 23), ap));
+
+  std::vector<uint8_t> cbor = encode(events);
+  CHECK(!cbor.empty());
+  size_t count = 0;
+  std::string expected = asArray(events);
+  CHECK_STR(decode(cbor, &count), expected.c_str());
+  CHECK_EQ(count, events.size());
+  CHECK(cbor.size() * 2 < expected.size());
+}
+
+static void testValues() {
+  // Hand-written events exercise the generic mapping: overrides of the
+  // header values, upper-case MACs, decimals, floats, escapes, a "dt" data
+  // key and containers of 24+ entries.
+  std::string big = "[";
+  for (int i = 0; i < 300; i++) big += (i ? "," : "") + std::to_string(i * 1000);
+  big += "]";
+  std::vector<std::string> events = {
+      "{\"v\":1,\"ts_ms\":10,\"node_id\":\"n1\",\"type\":\"a\",\"data\":{\"mac\":\"AA:BB:CC:DD:EE:FF\","
+      "\"addr\":\"aa:bb:cc:dd:ee:ff\",\"t\":-0.05,\"f\":1.5e3,\"g\":12345678901234567890,"
+      "\"h\":-9223372036854775808,\"u\":\"\\u00e9\\ud83d\\ude00\\/\",\"dt\":3,\"x\":[true,false,null],"
+      "\"hex\":\"0123456789abcdef\",\"short\":\"abcd\"}}",
+      "{\"v\":2,\"ts_ms\":9,\"node_id\":\"other\",\"src\":\"n1\",\"type\":\"b\",\"data\":{\"big\":" + big +
+          "}}",
+      "{\"v\":1,\"ts_ms\":11,\"node_id\":null,\"type\":\"c\",\"src\":\"elsewhere\"}",
+  };
+  std::vector<uint8_t> cbor = encode(events);
+  CHECK(!cbor.empty());
+  std::string expected = asArray(events);
+  // Escapes come back in JsonWriter's form and floats in %.17g.
+  size_t at = expected.find("\\u00e9\\ud83d\\ude00\\/");
+  expected.replace(at, strlen("\\u00e9\\ud83d\\ude00\\/"), "\xc3\xa9\xf0\x9f\x98\x80/");
+  at = expected.find("1.5e3");
+  expected.replace(at, 5, "1500");
+  at = expected.find("12345678901234567890");
+  CHECK(at != std::string::npos);
+  // The node_id null override stays in place after the restored ts_ms.
+  at = expected.find("\"ts_ms\":11,\"node_id\":null,");
+  expected.replace(at, strlen("\"ts_ms\":11,\"node_id\":null,"), "\"ts_ms\":11,");
+  at = expected.find("\"type\":\"c\"");
+  expected.insert(at, "\"node_id\":null,");
+  CHECK_STR(decode(cbor), expected.c_str());
+
+  // MAC as tag 48 + 6 bytes; the upper-case one stays text.
+  const uint8_t mac[] = {0xD8, 0x30, 0x46, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff};
+  bool found = false;
+  for (size_t i = 0; i + sizeof(mac) <= cbor.size(); i++) found |= memcmp(&cbor[i], mac, sizeof(mac)) == 0;
+  CHECK(found);
+}
+
+static void testRejects() {
+  // No ts_ms, malformed JSON, trailing bytes.
+  CHECK(encode({"{\"v\":1,\"type\":\"x\"}"}).empty());
+  CHECK(encode({"{\"v\":1,\"ts_ms\":1,\"type\":\"x\""}).empty());
+  CHECK(encode({"{\"v\":1,\"ts_ms\":1}x"}).empty());
+  CHECK(encode({"[1,2]"}).empty());
+
+  std::vector<std::string> events;
+  for (uint8_t i = 0; i < 10; i++) events.push_back(json(envelope(i, i), bleSeen(i, -50)));
+  CHECK(encode(events, 128).empty());  // does not fit
+
+  // Fewer events than announced.
+  uint8_t buf[1024];
+  CborBatchEncoder enc(buf, sizeof(buf));
+  enc.begin(2);
+  CHECK(enc.add(events[0].data(), events[0].size()));
+  CHECK_EQ(enc.finish(), 0u);
+  CHECK(enc.add(events[1].data(), events[1].size()));
+  CHECK(enc.finish() > 0);
+  CHECK(!enc.add(events[2].data(), events[2].size()));
+  CHECK_EQ(enc.finish(), 0u);
+
+  std::vector<uint8_t> cbor = encode(events);
+  CHECK(!cbor.empty());
+  for (size_t cut = 0; cut < cbor.size(); cut++) {
+    std::vector<uint8_t> part(cbor.begin(), cbor.begin() + cut);
+    CHECK_STR(decode(part), "<decode failed>");
+  }
+  std::vector<uint8_t> fmt = cbor;
+  fmt[5] = 0x02;  // "fmt": 2
+  CHECK_STR(decode(fmt), "<decode failed>");
+
+  char small[64];
+  JsonWriter w(small, sizeof(small));
+  CHECK(!cborBatchDecode(cbor.data(), cbor.size(), w));
+}
+
+int main() {
+  printf("test_cbor_batch\n");
+  RUN_TEST(testHeaderBytes);
+  RUN_TEST(testRoundTrip);
+  RUN_TEST(testValues);
+  RUN_TEST(testRejects);
+  TEST_MAIN_END();
+}
@@ -0,0 +1,108 @@
+#include <random>
+#include <string>
+#include <vector>
+
+#include "crc32.h"
+#include "deflate.h"
+#include "host_test.h"
+
+#if HOST_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+static DeflateEncoder encoder;
+
+static std::string sampleBatch(int events) {
+  std::string s = "[";
+  for (int i = 0; i < events; i++) {
+    char ev[256];
+    snprintf(ev, sizeof(ev),
+             "%s{\"v\":1,\"ts_ms\":%d,\"node_id\":\"lab-esp32-01\",\"type\":\"ble.seen\","
+             "\"src\":\"lab-esp32-01\",\"seq\":%d,\"mac\":\"c4:%02x:1a:9e:%02x:7b\",\"rssi\":%d,"
+             "\"data\":{\"addr\":\"c4:%02x:1a:9e:%02x:7b\",\"rssi\":%d,\"addr_type\":\"random\","
+             "\"flags\":6}}",
+             i ? "," : "", 100000 + i * 37, i + 1, i * 13 % 256, i * 7 % 256, -40 - i % 50,
+             i * 13 % 256, i * 7 % 256, -40 - i % 50);
+    s += ev;
+  }
+  return s + "]";
+}
+
+static void testCrc32KnownValue() {
+  CHECK_EQ(crc32Update(0, "123456789", 9), 0xCBF43926u);
+  uint32_t crc = crc32Update(0, "12345", 5);
+  CHECK_EQ(crc32Update(crc, "6789", 4), 0xCBF43926u);
+  CHECK_EQ(crc32Update(0, "", 0), 0);
+}
+
+static void testGzipFraming() {
+  std::string in = sampleBatch(20);
+  std::vector<uint8_t> out(in.size() + 64);
+  size_t n = encoder.gzip(reinterpret_cast<const uint8_t *>(in.data()), in.size(), out.data(),
+                          out.size());
+  CHECK(n > 18);
+  CHECK(n < in.size() / 3);
+  CHECK_EQ(out[0], 0x1F);
+  CHECK_EQ(out[1], 0x8B);
+  CHECK_EQ(out[2], 8);
+  uint32_t crc = out[n - 8] | out[n - 7] << 8 | out[n - 6] << 16 | (uint32_t)out[n - 5] << 24;
+  uint32_t size = out[n - 4] | out[n - 3] << 8 | out[n - 2] << 16 | (uint32_t)out[n - 1] << 24;
+  CHECK_EQ(crc, crc32Update(0, in.data(), in.size()));
+  CHECK_EQ(size, in.size());
+}
+
+static void testOutputTooSmall() {
+  std::string in = sampleBatch(5);
+  uint8_t out[32];
+  CHECK_EQ(encoder.deflate(reinterpret_cast<const uint8_t *>(in.data()), in.size(), out,
+                           sizeof(out)),
+           0);
+  CHECK_EQ(encoder.gzip(reinterpret_cast<const uint8_t *>(in.data()), in.size(), out, 10), 0);
+}
+
+#if HOST_HAVE_ZLIB
+static std::string gunzip(const uint8_t *data, size_t len, size_t expect) {
+  std::string out(expect + 16, '\0');
+  z_stream zs = {};
+  inflateInit2(&zs, 16 + MAX_WBITS);
+  zs.next_in = const_cast<Bytef *>(data);
+  zs.avail_in = (uInt)len;
+  zs.next_out = reinterpret_cast<Bytef *>(&out[0]);
+  zs.avail_out = (uInt)out.size();
+  int rc = inflate(&zs, Z_FINISH);
+  CHECK_EQ(rc, Z_STREAM_END);
+  out.resize(zs.total_out);
+  inflateEnd(&zs);
+  return out;
+}
+
+static void testRoundTripThroughZlib() {
+  std::mt19937 rng(11);
+  std::vector<std::string> inputs = {"", "a", "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa", sampleBatch(1),
+                                     sampleBatch(64), sampleBatch(300)};
+  for (int i = 0; i < 50; i++) {
+    std::string s(rng() % 5000, '\0');
+    int alphabet = 2 + rng() % 254;
+    for (char &c : s) c = (char)(rng() % alphabet);
+    inputs.push_back(s);
+  }
+  for (const std::string &in : inputs) {
+    std::vector<uint8_t> out(in.size() * 2 + 64);
+    size_t n = encoder.gzip(reinterpret_cast<const uint8_t *>(in.data()), in.size(), out.data(),
+                            out.size());
+    CHECK(n > 0);
+    CHECK(gunzip(out.data(), n, in.size()) == in);
+  }
+}
+#endif
+
+int main() {
+  printf("test_deflate\n");
+  RUN_TEST(testCrc32KnownValue);
+  RUN_TEST(testGzipFraming);
+  RUN_TEST(testOutputTooSmall);
+#if HOST_HAVE_ZLIB
+  RUN_TEST(testRoundTripThroughZlib);
+#endif
+  TEST_MAIN_END();
+}
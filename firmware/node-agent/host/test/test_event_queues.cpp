@@ -0,0 +1,238 @@
+#include <string>
+
+#include "event_queues.h"
+#include "host_test.h"
+
+static std::string record(uint32_t id, size_t len = 60) {
+  std::string s(len, 'a' + id % 26);
+  memcpy(&s[0], &id, 4);
+  return s;
+}
+
+static uint32_t idOf(const RecordRing::View &v) {
+  uint32_t id;
+  memcpy(&id, v.data, 4);
+  return id;
+}
+
+static void testLayout() {
+  alignas(4) static uint8_t arena[1002];
+  EventQueues q(arena, sizeof(arena), 10, 15, 4);
+  CHECK_EQ(q.ring(kEventControl).capacityBytes(), 100);
+  CHECK_EQ(q.ring(kEventStatus).capacityBytes(), 148);
+  CHECK_EQ(q.ring(kEventTelemetry).capacityBytes(), 752);
+  CHECK_EQ(q.capacityBytes(), 1000);
+
+  // Filling telemetry leaves the reserved classes untouched.
+  uint32_t id = 0;
+  while (q.tryPush(kEventTelemetry, record(id).data(), 60)) id++;
+  CHECK_EQ(id, 11);
+  CHECK(q.tryPush(kEventControl, record(100).data(), 60));
+  CHECK(q.tryPush(kEventStatus, record(200).data(), 60));
+  CHECK_EQ(q.count(), 13);
+  CHECK_EQ(q.top(), kEventControl);
+  CHECK_EQ(q.ring(kEventStatus).front().kind, kEventStatus);
+  CHECK_EQ(idOf(q.ring(kEventControl).front()), 100);
+  CHECK_EQ(idOf(q.ring(kEventTelemetry).front()), 0);
+  CHECK_EQ(q.stats(kEventTelemetry).queued, 11);
+}
+
+static void testPolicies() {
+  alignas(4) static uint8_t arena[1000];
+  EventQueues q(arena, sizeof(arena), 20, 20, 4);  // 200 bytes each: 3 records
+  size_t evicted = 0;
+
+  // Drop-newest keeps the first three.
+  for (uint32_t i = 0; i < 5; i++) q.push(kEventStatus, record(i).data(), 60, evicted);
+  CHECK_EQ(q.ring(kEventStatus).count(), 3);
+  CHECK_EQ(idOf(q.ring(kEventStatus).front()), 0);
+  CHECK_EQ(q.stats(kEventStatus).dropped, 2);
+  CHECK_EQ(q.stats(kEventStatus).evicted, 0);
+
+  // Drop-oldest keeps the last three.
+  q.setPolicy(kEventControl, DropPolicy::kDropOldest, 1);
+  for (uint32_t i = 0; i < 5; i++) {
+    CHECK(q.push(kEventControl, record(i).data(), 60, evicted));
+    CHECK_EQ(evicted, i < 3 ? 0 : 1);
+  }
+  CHECK_EQ(q.ring(kEventControl).count(), 3);
+  CHECK_EQ(idOf(q.ring(kEventControl).front()), 2);
+  CHECK_EQ(q.stats(kEventControl).evicted, 2);
+  CHECK_EQ(q.stats(kEventControl).dropped, 0);
+
+  // A larger record evicts as many as it needs, which depends on where the
+  // ring wraps.
+  CHECK(q.push(kEventControl, record(9, 120).data(), 120, evicted));
+  CHECK(evicted >= 2);
+  CHECK_EQ(q.ring(kEventControl).count(), 4 - evicted);
+  size_t before = q.ring(kEventControl).count();
+  // One larger than the ring evicts nothing.
+  CHECK(!q.push(kEventControl, record(10, 400).data(), 400, evicted));
+  CHECK_EQ(evicted, 0);
+  CHECK_EQ(q.ring(kEventControl).count(), before);
+
+  // Sample: one overflowing arrival in four replaces the oldest.
+  EventQueues s(arena, sizeof(arena), 20, 20, 4);
+  s.setPolicy(kEventStatus, DropPolicy::kSample, 4);
+  for (uint32_t i = 0; i < 3; i++) CHECK(s.push(kEventStatus, record(i).data(), 60, evicted));
+  size_t kept = 0;
+  for (uint32_t i = 3; i < 15; i++) kept += s.push(kEventStatus, record(i).data(), 60, evicted);
+  CHECK_EQ(kept, 3);
+  CHECK_EQ(s.stats(kEventStatus).dropped, 9);
+  CHECK_EQ(s.stats(kEventStatus).evicted, 3);
+  RecordRing &t = s.ring(kEventStatus);
+  size_t off = t.begin();
+  const uint32_t expected[] = {3, 7, 11};
+  for (uint32_t e : expected) {
+    CHECK_EQ(idOf(t.view(off)), e);
+    off = t.next(off);
+  }
+}
+
+static void testOffer() {
+  alignas(4) static uint8_t arena[1000];
+  EventQueues q(arena, sizeof(arena), 20, 20, 4);
+  size_t evicted = 0;
+  using Offer = EventQueues::Offer;
+
+  // Drop-newest leaves the overflow to the caller without counting it.
+  for (uint32_t i = 0; i < 3; i++) {
+    CHECK(q.offer(kEventStatus, record(i).data(), 60, evicted) == Offer::kQueued);
+  }
+  CHECK(q.offer(kEventStatus, record(3).data(), 60, evicted) == Offer::kNoRoom);
+  CHECK_EQ(q.stats(kEventStatus).dropped, 0);
+  q.drop(kEventStatus);
+  CHECK_EQ(q.stats(kEventStatus).dropped, 1);
+
+  // Sample: arrivals sampled out are dropped here; the one kept evicts, or
+  // is left to the caller while the front is in flight.
+  q.setPolicy(kEventStatus, DropPolicy::kSample, 2);
+  q.hold(kEventStatus, 1);
+  CHECK(q.offer(kEventStatus, record(4).data(), 60, evicted) == Offer::kNoRoom);
+  CHECK(q.offer(kEventStatus, record(5).data(), 60, evicted) == Offer::kSampled);
+  CHECK_EQ(q.stats(kEventStatus).dropped, 2);
+  q.releaseHolds();
+  CHECK(q.offer(kEventStatus, record(6).data(), 60, evicted) == Offer::kQueued);
+  CHECK_EQ(evicted, 1);
+}
+
+static void testHolds() {
+  alignas(4) static uint8_t arena[1000];
+  EventQueues q(arena, sizeof(arena), 20, 20, 4);
+  q.setPolicy(kEventControl, DropPolicy::kDropOldest, 1);
+  size_t evicted = 0;
+  for (uint32_t i = 0; i < 3; i++) q.push(kEventControl, record(i).data(), 60, evicted);
+
+  // In-flight records are not evicted; the arrival is dropped instead.
+  const RecordRing &ring = q.ring(kEventControl);
+  CHECK_EQ(q.firstUnheld(kEventControl), ring.begin());
+  q.hold(kEventControl, 1);
+  CHECK_EQ(q.firstUnheld(kEventControl), ring.next(ring.begin()));
+  CHECK(!q.push(kEventControl, record(3).data(), 60, evicted));
+  CHECK_EQ(evicted, 0);
+  CHECK_EQ(q.stats(kEventControl).dropped, 1);
+  q.pop(kEventControl);  // acknowledged
+  CHECK(q.push(kEventControl, record(4).data(), 60, evicted));
+  CHECK_EQ(evicted, 0);
+  CHECK(q.push(kEventControl, record(5).data(), 60, evicted));
+  CHECK_EQ(evicted, 1);
+  CHECK_EQ(idOf(q.ring(kEventControl).front()), 2);
+
+  q.hold(kEventControl, 10);  // capped at the queued count
+  CHECK_EQ(q.firstUnheld(kEventControl), RecordRing::npos);
+  q.releaseHolds();
+  CHECK(q.push(kEventControl, record(6).data(), 60, evicted));
+  CHECK_EQ(evicted, 1);
+}
+
+static void testRewrite() {
+  alignas(4) static uint8_t arena[1000];
+  EventQueues q(arena, sizeof(arena), 20, 20, 4);
+  q.setPolicy(kEventStatus, DropPolicy::kDropOldest, 1);
+  size_t evicted = 0;
+  q.push(kEventStatus, "{\"a\":1}  ", 10, evicted);
+  EventQueues::Ref a = q.lastPushed(kEventStatus);
+  q.push(kEventStatus, "{\"b\":1}", 7, evicted);
+  EventQueues::Ref b = q.lastPushed(kEventStatus);
+  CHECK(a.serial + 1 == b.serial);
+  CHECK_EQ(q.frontSerial(kEventStatus), a.serial);
+
+  CHECK(q.rewrite(kEventStatus, a, "{\"a\":22}", 8));
+  RecordRing::View v = q.ring(kEventStatus).front();
+  CHECK_EQ(v.len, 10);
+  CHECK(memcmp(v.data, "{\"a\":22}  ", 10) == 0);
+  CHECK(!q.rewrite(kEventStatus, b, "{\"b\":100}", 9));  // longer than the record
+
+  // A record once held is left alone for good, even after its hold is
+  // released: the server may already have stored it under its seq.
+  q.hold(kEventStatus, 1);
+  CHECK(!q.editable(kEventStatus, a));
+  CHECK(q.editable(kEventStatus, b));
+  q.releaseHolds();
+  CHECK(!q.editable(kEventStatus, a));
+  CHECK(!q.rewrite(kEventStatus, a, "{\"a\":3}", 7));
+  CHECK(q.editable(kEventStatus, b));
+  q.pop(kEventStatus);
+  CHECK(!q.rewrite(kEventStatus, a, "{}", 2));
+  CHECK_EQ(q.frontSerial(kEventStatus), b.serial);
+
+  // So are evicted ones, even when a new record takes their offset.
+  q.push(kEventStatus, record(1).data(), 60, evicted);
+  q.push(kEventStatus, record(2).data(), 60, evicted);
+  q.push(kEventStatus, record(3).data(), 60, evicted);
+  CHECK(evicted > 0);
+  CHECK(!q.editable(kEventStatus, b));
+  CHECK(q.editable(kEventStatus, q.lastPushed(kEventStatus)));
+}
+
+static void testPick() {
+  alignas(4) static uint8_t arena[1000];
+  EventQueues q(arena, sizeof(arena), 20, 20, 4);
+  const uint8_t all = 0x7;
+  std::string order;
+  for (int i = 0; i < 12; i++) order += "tsc"[q.pick(all)];
+  // Control first; a lower class gets its turn once passed over four times
+  // in a row, status ahead of telemetry when both have.
+  CHECK_STR(order.c_str(), "ccccstcccstc");
+
+  // Undone picks do not count as turns.
+  EventQueues::PickState before = q.pickState();
+  CHECK_EQ(q.pick(all), kEventControl);
+  CHECK_EQ(q.pick(all), kEventControl);
+  q.restorePickState(before);
+  std::string again;
+  for (int i = 0; i < 4; i++) again += "tsc"[q.pick(all)];
+  CHECK_STR(again.c_str(), "ccst");
+
+  // A class without a backlog does not build up skips.
+  EventQueues q2(arena, sizeof(arena), 20, 20, 2);
+  for (int i = 0; i < 10; i++) CHECK_EQ(q2.pick(1u << kEventControl), kEventControl);
+  CHECK_EQ(q2.pick(all), kEventControl);
+  CHECK_EQ(q2.pick(1u << kEventTelemetry), kEventTelemetry);
+  CHECK_EQ(q2.pick(0), -1);
+}
+
+static void testNames() {
+  EventClass cls = kEventTelemetry;
+  CHECK(parseEventClass("control", cls));
+  CHECK_EQ(cls, kEventControl);
+  CHECK(!parseEventClass("bulk", cls));
+  CHECK_STR(eventClassName(kEventStatus), "status");
+  DropPolicy p = DropPolicy::kDropNewest;
+  CHECK(parseDropPolicy("sample", p));
+  CHECK(p == DropPolicy::kSample);
+  CHECK(!parseDropPolicy("drop", p));
+  CHECK_STR(dropPolicyName(DropPolicy::kDropOldest), "drop-oldest");
+}
+
+int main() {
+  printf("test_event_queues\n");
+  RUN_TEST(testLayout);
+  RUN_TEST(testPolicies);
+  RUN_TEST(testOffer);
+  RUN_TEST(testHolds);
+  RUN_TEST(testRewrite);
+  RUN_TEST(testPick);
+  RUN_TEST(testNames);
+  TEST_MAIN_END();
+}
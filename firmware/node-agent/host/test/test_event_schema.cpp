@@ -0,0 +1,517 @@
+#include <string>
+
+#include "host_test.h"
+#include "json_writer.h"
+#include "node_events.h"
+
+// Every fixed-shape event fits the firmware's default EVENT_MAX_BYTES.
+static_assert(eventJsonMax(kBootEvent) < 768, "node.boot");
+static_assert(eventJsonMax(kHeartbeatEvent) < 768, "node.heartbeat");
+static_assert(eventJsonMax(kAnnounceEvent) < 768, "node.announce");
+static_assert(eventJsonMax(kWifiStatusEvent) < 768, "wifi.status");
+static_assert(eventJsonMax(kWifiApSeenEvent) < 768, "wifi.ap_seen");
+static_assert(eventJsonMax(kIngestOkEvent) < 768, "ingest.ok");
+static_assert(eventJsonMax(kIngestErrEvent) < 768, "ingest.err");
+static_assert(eventJsonMax(kProbeNetEvent) < 768, "probe.net");
+static_assert(eventJsonMax(kProbeHttpEvent) < 768, "probe.http");
+static_assert(eventJsonMax(kBleSeenEvent) < 768, "ble.seen");
+
+static const char kNodeId[] = "node-7";
+static const EventEnvelope kEnv = {1, 123456, {kNodeId, sizeof(kNodeId) - 1}, 42, 3};
+
+static EventText text(const char *s) { return EventText{s, strlen(s)}; }
+
+// The envelope as the firmware's hand-written builders produced it, plus the
+// boot epoch.
+static void legacyBegin(JsonWriter &w, const char *type) {
+  w.beginObject();
+  w.fieldUInt("v", 1);
+  w.fieldUInt("ts_ms", 123456);
+  w.fieldStr("node_id", kNodeId);
+  w.fieldStr("type", type);
+  w.fieldStr("src", kNodeId);
+  w.fieldUInt("seq", 42);
+  w.fieldUInt("epoch", 3);
+}
+
+static void legacyData(JsonWriter &w) {
+  w.key("data");
+  w.beginObject();
+}
+
+static std::string legacyEnd(JsonWriter &w) {
+  w.endObject();
+  w.endObject();
+  CHECK(!w.overflowed());
+  return std::string(w.c_str(), w.size());
+}
+
+// JSON must match the legacy output byte for byte, the binary form must
+// render back to the same JSON, and both must stay within the static bounds
+// plus `unbounded` bytes of raw JSON.
+template <typename T>
+static void checkEvent(const T &ev, const std::string &legacy, size_t unbounded = 0) {
+  const EventDesc &d = eventDescOf(static_cast<const T *>(nullptr));
+  char json[2048];
+  JsonWriter w(json, sizeof(json));
+  CHECK(eventEncodeJson(w, kEnv, ev));
+  CHECK_STR(w.c_str(), legacy.c_str());
+  CHECK(w.size() <= eventJsonMax(d) + unbounded);
+
+  uint8_t bin[1024];
+  size_t binLen = eventEncodeBinary(bin, sizeof(bin), kEnv, ev);
+  CHECK(binLen > 0);
+  CHECK(binLen <= eventBinaryMax(d) + unbounded);
+  CHECK(binLen < w.size());
+  char back[2048];
+  JsonWriter r(back, sizeof(back));
+  CHECK(eventDecodeBinary(bin, binLen, kNodeEvents, eventCount(kNodeEvents), r));
+  CHECK_STR(r.c_str(), legacy.c_str());
+
+  // Every truncation of the binary form is rejected.
+  for (size_t cut = 0; cut < binLen; cut++) {
+    JsonWriter t(back, sizeof(back));
+    CHECK(!eventDecodeBinary(bin, cut, kNodeEvents, eventCount(kNodeEvents), t));
+  }
+  CHECK_EQ(eventEncodeBinary(bin, binLen - 1, kEnv, ev), (size_t)0);
+}
+
+static const uint8_t kMac[6] = {0x24, 0x0a, 0xc4, 0x12, 0xab, 0xcd};
+
+static void testBoot() {
+  BootEvent ev;
+  ev.fw_version = text("0.1.0");
+  ev.chip_model = text("ESP32-D0WD-V3");
+  ev.chip_rev = text("3");
+  memcpy(ev.mac.b, kMac, 6);
+  ev.hostname = text("node-7");
+  ev.heap_free = 201344;
+  ev.sdk_version = text("v4.4.7");
+  ev.ingest_url = text("http://192.168.1.10:8080/v1/ingest");
+  ev.ip.setNull();
+  ev.oui_index_id.set(text("1a2b3c4d"));
+
+  char buf[1024];
+  JsonWriter w(buf, sizeof(buf));
+  legacyBegin(w, "node.boot");
+  legacyData(w);
+  w.fieldStr("fw_version", "0.1.0");
+  w.fieldStr("chip_model", "ESP32-D0WD-V3");
+  w.key("chip_rev");
+  w.writeString("3");
+  w.fieldStr("mac", "24:0A:C4:12:AB:CD");
+  w.fieldStr("hostname", "node-7");
+  w.fieldUInt("heap_free", 201344);
+  w.fieldStr("sdk_version", "v4.4.7");
+  w.fieldStr("ingest_url", "http://192.168.1.10:8080/v1/ingest");
+  w.fieldNull("ip");
+  w.fieldStr("oui_index_id", "1a2b3c4d");
+  checkEvent(ev, legacyEnd(w));
+
+  // Without the OUI index the field is left out entirely.
+  ev.oui_index_id = EventOpt<EventText>();
+  ev.ip.set(EventIp{{10, 0, 0, 7}});
+  w.reset();
+  legacyBegin(w, "node.boot");
+  legacyData(w);
+  w.fieldStr("fw_version", "0.1.0");
+  w.fieldStr("chip_model", "ESP32-D0WD-V3");
+  w.key("chip_rev");
+  w.writeString("3");
+  w.fieldStr("mac", "24:0A:C4:12:AB:CD");
+  w.fieldStr("hostname", "node-7");
+  w.fieldUInt("heap_free", 201344);
+  w.fieldStr("sdk_version", "v4.4.7");
+  w.fieldStr("ingest_url", "http://192.168.1.10:8080/v1/ingest");
+  w.fieldStr("ip", "10.0.0.7");
+  checkEvent(ev, legacyEnd(w));
+}
+
+static void testHeartbeat() {
+  HeartbeatEvent ev;
+  ev.uptime_ms = 3600000;
+  memcpy(ev.mac.b, kMac, 6);
+  ev.hostname = text("node-7");
+  ev.wifi_rssi = -61;
+  ev.ip.set(EventIp{{192, 168, 1, 23}});
+  ev.heap_free = 180000;
+  ev.queue_depth = 12;
+  ev.ble_seen_total = 4000000000u;
+
+  char buf[1024];
+  JsonWriter w(buf, sizeof(buf));
+  legacyBegin(w, "node.heartbeat");
+  legacyData(w);
+  w.fieldUInt("uptime_ms", 3600000);
+  w.fieldStr("mac", "24:0A:C4:12:AB:CD");
+  w.fieldStr("hostname", "node-7");
+  w.fieldInt("wifi_rssi", -61);
+  w.fieldStr("ip", "192.168.1.23");
+  w.fieldUInt("heap_free", 180000);
+  w.fieldUInt("queue_depth", 12);
+  w.fieldUInt("ble_seen_total", 4000000000u);
+  checkEvent(ev, legacyEnd(w));
+}
+
+static void writeLegacyDns(JsonWriter &w) {
+  w.key("dns");
+  w.beginArray();
+  w.writeString("1.1.1.1");
+  w.writeString("0.0.0.0");
+  w.endArray();
+}
+
+static void testWifiStatus() {
+  WifiStatusEvent ev;
+  ev.connected = false;
+  ev.state = text("disconnected");
+  ev.ssid = text("home \"5G\"");
+  ev.bssid.setNull();
+  ev.channel = 0;
+  ev.ip.setNull();
+  memcpy(ev.mac.b, kMac, 6);
+  ev.hostname = text("node-7");
+  ev.rssi = 0;
+  ev.gw = EventIp{{0, 0, 0, 0}};
+  ev.mask = EventIp{{0, 0, 0, 0}};
+  ev.dns.ip[0] = EventIp{{1, 1, 1, 1}};
+  ev.dns.ip[1] = EventIp{{0, 0, 0, 0}};
+  ev.reason.set(201);
+
+  char buf[1024];
+  JsonWriter w(buf, sizeof(buf));
+  legacyBegin(w, "wifi.status");
+  legacyData(w);
+  w.fieldBool("connected", false);
+  w.fieldStr("state", "disconnected");
+  w.fieldStr("ssid", "home \"5G\"");
+  w.fieldNull("bssid");
+  w.fieldInt("channel", 0);
+  w.fieldNull("ip");
+  w.fieldStr("mac", "24:0A:C4:12:AB:CD");
+  w.fieldStr("hostname", "node-7");
+  w.fieldInt("rssi", 0);
+  w.fieldStr("gw", "0.0.0.0");
+  w.fieldStr("mask", "0.0.0.0");
+  writeLegacyDns(w);
+  w.fieldInt("reason", 201);
+  checkEvent(ev, legacyEnd(w));
+
+  ev.connected = true;
+  ev.state = text("connected");
+  EventMacUpper bssid;
+  memcpy(bssid.b, kMac, 6);
+  ev.bssid.set(bssid);
+  ev.channel = 6;
+  ev.auth.set(text("wpa2"));
+  ev.reason = EventOpt<int32_t>();
+  w.reset();
+  legacyBegin(w, "wifi.status");
+  legacyData(w);
+  w.fieldBool("connected", true);
+  w.fieldStr("state", "connected");
+  w.fieldStr("ssid", "home \"5G\"");
+  w.fieldStr("bssid", "24:0A:C4:12:AB:CD");
+  w.fieldInt("channel", 6);
+  w.fieldNull("ip");
+  w.fieldStr("mac", "24:0A:C4:12:AB:CD");
+  w.fieldStr("hostname", "node-7");
+  w.fieldInt("rssi", 0);
+  w.fieldStr("gw", "0.0.0.0");
+  w.fieldStr("mask", "0.0.0.0");
+  writeLegacyDns(w);
+  w.fieldStr("auth", "wpa2");
+  checkEvent(ev, legacyEnd(w));
+}
+
+static void testAnnounce() {
+  AnnounceEvent ev;
+  ev.node_id = text(kNodeId);
+  ev.ip = EventIp{{192, 168, 1, 23}};
+  memcpy(ev.mac.b, kMac, 6);
+  ev.rssi = -55;
+  ev.hostname = text("node-7");
+  ev.ssid = text("home");
+  ev.gw = EventIp{{192, 168, 1, 1}};
+  ev.mask = EventIp{{255, 255, 255, 0}};
+  ev.dns.ip[0] = EventIp{{1, 1, 1, 1}};
+  ev.dns.ip[1] = EventIp{{0, 0, 0, 0}};
+  ev.uptime_ms = 1000;
+  ev.fw_version = text("0.1.0");
+  ev.chip = text("ESP32-C3");
+  ev.http_port = 80;
+
+  char buf[1024];
+  JsonWriter w(buf, sizeof(buf));
+  legacyBegin(w, "node.announce");
+  legacyData(w);
+  w.fieldStr("node_id", kNodeId);
+  w.fieldStr("ip", "192.168.1.23");
+  w.fieldStr("mac", "24:0A:C4:12:AB:CD");
+  w.fieldInt("rssi", -55);
+  w.fieldStr("hostname", "node-7");
+  w.fieldStr("ssid", "home");
+  w.fieldStr("gw", "192.168.1.1");
+  w.fieldStr("mask", "255.255.255.0");
+  writeLegacyDns(w);
+  w.fieldUInt("uptime_ms", 1000);
+  w.fieldStr("fw_version", "0.1.0");
+  w.fieldStr("chip", "ESP32-C3");
+  w.fieldUInt("http_port", 80);
+  checkEvent(ev, legacyEnd(w));
+}
+
+static void testWifiApSeen() {
+  WifiApSeenEvent ev;
+  ev.ssid = text("caf\xc3\xa9\tguest");
+  memcpy(ev.bssid.b, kMac, 6);
+  ev.vendor_id.set(1234);
+  ev.channel = 11;
+  ev.rssi = -80;
+  ev.auth = text("open");
+
+  char buf[1024];
+  JsonWriter w(buf, sizeof(buf));
+  legacyBegin(w, "wifi.ap_seen");
+  legacyData(w);
+  w.fieldStr("ssid", "caf\xc3\xa9\tguest");
+  w.fieldStr("bssid", "24:0a:c4:12:ab:cd");
+  w.fieldUInt("vendor_id", 1234);
+  w.fieldUInt("channel", 11);
+  w.fieldInt("rssi", -80);
+  w.fieldStr("auth", "open");
+  checkEvent(ev, legacyEnd(w));
+}
+
+static void testIngest() {
+  IngestOkEvent ok;
+  ok.ok = true;
+  ok.batch_count = 20;
+  ok.ms = 35;
+  ok.raw_bytes = 9000;
+  ok.wire_bytes = 2100;
+  ok.ratio.set(EventFixed2{9000 * 100 / 2100});
+  ok.encoding = text("gzip");
+  ok.format = text("cbor");
+  ok.batch_limit = 32;
+
+  char buf[1024];
+  JsonWriter w(buf, sizeof(buf));
+  legacyBegin(w, "ingest.ok");
+  legacyData(w);
+  w.fieldBool("ok", true);
+  w.fieldUInt("batch_count", 20);
+  w.fieldUInt("ms", 35);
+  w.fieldUInt("raw_bytes", 9000);
+  w.fieldUInt("wire_bytes", 2100);
+  w.fieldFixed("ratio", 9000 * 100 / 2100, 2);
+  w.fieldStr("encoding", "gzip");
+  w.fieldStr("format", "cbor");
+  w.fieldUInt("batch_limit", 32);
+  checkEvent(ok, legacyEnd(w));
+
+  IngestErrEvent err;
+  err.ok = false;
+  err.err = text("http_503");
+  err.ms = 1200;
+  w.reset();
+  legacyBegin(w, "ingest.err");
+  w.fieldStr("err", "http_503");
+  legacyData(w);
+  w.fieldBool("ok", false);
+  w.fieldStr("err", "http_503");
+  w.fieldUInt("ms", 1200);
+  checkEvent(err, legacyEnd(w));
+}
+
+static void testProbe() {
+  ProbeNetEvent net;
+  net.host = text("spine.local");
+  net.ok = false;
+  net.ms = 5000;
+  net.ip = text("");
+
+  char buf[1024];
+  JsonWriter w(buf, sizeof(buf));
+  legacyBegin(w, "probe.net");
+  legacyData(w);
+  w.fieldStr("host", "spine.local");
+  w.fieldBool("ok", false);
+  w.fieldUInt("ms", 5000);
+  w.fieldStr("ip", "");
+  checkEvent(net, legacyEnd(w));
+
+  ProbeHttpEvent http;
+  http.self.set(ProbeHttpResultFields{text("http://10.0.0.7/health"), 200, true, 4});
+  w.reset();
+  legacyBegin(w, "probe.http");
+  legacyData(w);
+  w.key("self");
+  w.beginObject();
+  w.fieldStr("url", "http://10.0.0.7/health");
+  w.fieldInt("code", 200);
+  w.fieldBool("ok", true);
+  w.fieldUInt("ms", 4);
+  w.endObject();
+  checkEvent(http, legacyEnd(w));
+}
+
+static void testBleSeen() {
+  BleSeenEvent ev;
+  memcpy(ev.addr.b, kMac, 6);
+  ev.rssi = -72;
+  ev.addr_type = text("public");
+  ev.vendor_id.setNull();
+  ev.flags = 6;
+
+  char buf[1024];
+  JsonWriter w(buf, sizeof(buf));
+  legacyBegin(w, "ble.seen");
+  w.fieldStr("mac", "24:0a:c4:12:ab:cd");
+  w.fieldInt("rssi", -72);
+  legacyData(w);
+  w.fieldStr("addr", "24:0a:c4:12:ab:cd");
+  w.fieldInt("rssi", -72);
+  w.fieldStr("addr_type", "public");
+  w.fieldNull("vendor_id");
+  w.fieldUInt("flags", 6);
+  std::string plain = legacyEnd(w);
+  checkEvent(ev, plain);
+
+  // With fingerprints (BLE_FINGERPRINT=1).
+  ev.fp_stable.setNull();
+  for (int i = 0; i < 32; i++) ev.fp_addr.value.b[i] = (uint8_t)(i * 8 + 1);
+  ev.fp_addr.state = EventPresence::kSet;
+  std::string hex;
+  for (int i = 0; i < 32; i++) {
+    char b[3];
+    snprintf(b, sizeof(b), "%02x", i * 8 + 1);
+    hex += b;
+  }
+  w.reset();
+  legacyBegin(w, "ble.seen");
+  w.fieldStr("mac", "24:0a:c4:12:ab:cd");
+  w.fieldInt("rssi", -72);
+  legacyData(w);
+  w.fieldStr("addr", "24:0a:c4:12:ab:cd");
+  w.fieldInt("rssi", -72);
+  w.fieldStr("addr_type", "public");
+  w.fieldNull("vendor_id");
+  w.fieldUInt("flags", 6);
+  w.fieldNull("fp_stable");
+  w.fieldStr("fp_addr", hex.c_str(), hex.size());
+  checkEvent(ev, legacyEnd(w));
+
+  // Coalesced (BLE_COALESCE=1).
+  ev.count.set(14);
+  ev.rssi_min.set(-90);
+  ev.rssi_max.set(-61);
+  w.reset();
+  legacyBegin(w, "ble.seen");
+  w.fieldStr("mac", "24:0a:c4:12:ab:cd");
+  w.fieldInt("rssi", -72);
+  legacyData(w);
+  w.fieldStr("addr", "24:0a:c4:12:ab:cd");
+  w.fieldInt("rssi", -72);
+  w.fieldStr("addr_type", "public");
+  w.fieldNull("vendor_id");
+  w.fieldUInt("flags", 6);
+  w.fieldNull("fp_stable");
+  w.fieldStr("fp_addr", hex.c_str(), hex.size());
+  w.fieldUInt("count", 14);
+  w.fieldInt("rssi_min", -90);
+  w.fieldInt("rssi_max", -61);
+  checkEvent(ev, legacyEnd(w));
+}
+
+static void testBleDigest() {
+  const char devices[] = "[{\"addr\":\"24:0a:c4:12:ab:cd\",\"n\":3},{\"addr\":\"aa:bb:cc:dd:ee:ff\",\"n\":1}]";
+  BleDigestEvent ev;
+  ev.window_start_ms = 30000;
+  ev.window_ms = 30012;
+  ev.part = 1;
+  ev.devices = EventRaw{devices, sizeof(devices) - 1};
+
+  char buf[1024];
+  JsonWriter w(buf, sizeof(buf));
+  legacyBegin(w, "ble.digest");
+  legacyData(w);
+  w.fieldUInt("window_start_ms", 30000);
+  w.fieldUInt("window_ms", 30012);
+  w.fieldUInt("part", 1);
+  w.fieldRaw("devices", devices, sizeof(devices) - 1);
+  checkEvent(ev, legacyEnd(w), sizeof(devices) - 1);
+}
+
+static void testTextClamp() {
+  CHECK_EQ(eventJsonClamp("hello", 5, 5), (size_t)5);
+  CHECK_EQ(eventJsonClamp("hello", 5, 3), (size_t)3);
+  // Escapes count at their encoded size.
+  CHECK_EQ(eventJsonClamp("a\"b", 3, 3), (size_t)2);
+  CHECK_EQ(eventJsonClamp("a\x01", 2, 6), (size_t)1);
+  CHECK_EQ(eventJsonClamp("a\x01", 2, 7), (size_t)2);
+  // A multi-byte character is kept whole or dropped.
+  CHECK_EQ(eventJsonClamp("caf\xc3\xa9", 5, 4), (size_t)3);
+  CHECK_EQ(eventJsonClamp("caf\xc3\xa9", 5, 5), (size_t)5);
+  CHECK_EQ(eventJsonClamp(nullptr, 0, 4), (size_t)0);
+
+  // A long node id and hostname are cut to their budgets in both encodings.
+  std::string longId(100, 'n');
+  EventEnvelope env = {1, 1, {longId.c_str(), longId.size()}, 1, 1};
+  std::string host(200, 'h');
+  HeartbeatEvent ev = {};
+  ev.hostname = EventText{host.c_str(), host.size()};
+  char json[2048];
+  JsonWriter w(json, sizeof(json));
+  CHECK(eventEncodeJson(w, env, ev));
+  CHECK(w.size() <= eventJsonMax(kHeartbeatEvent));
+  CHECK(strstr(json, ("\"node_id\":\"" + std::string(kEventNodeIdMax, 'n') + "\"").c_str()) != nullptr);
+  CHECK(strstr(json, ("\"hostname\":\"" + std::string(kEventHostnameMax, 'h') + "\"").c_str()) !=
+        nullptr);
+  uint8_t bin[512];
+  size_t binLen = eventEncodeBinary(bin, sizeof(bin), env, ev);
+  CHECK(binLen > 0 && binLen <= eventBinaryMax(kHeartbeatEvent));
+  char back[2048];
+  JsonWriter r(back, sizeof(back));
+  CHECK(eventDecodeBinary(bin, binLen, kNodeEvents, eventCount(kNodeEvents), r));
+  CHECK_STR(back, json);
+}
+
+static void testClasses() {
+  // Boot and ingest results must survive a telemetry flood.
+  for (const EventDesc *d : kNodeEvents) {
+    CHECK(d->cls < kEventClassCount);
+    bool control = strcmp(d->type, "node.boot") == 0 || strncmp(d->type, "ingest.", 7) == 0;
+    bool telemetry = strncmp(d->type, "ble.", 4) == 0 || strcmp(d->type, "wifi.ap_seen") == 0;
+    CHECK_EQ(d->cls, control ? kEventControl : telemetry ? kEventTelemetry : kEventStatus);
+  }
+}
+
+static void testRejects() {
+  char buf[64];
+  JsonWriter w(buf, sizeof(buf));
+  HeartbeatEvent ev = {};
+  CHECK(!eventEncodeJson(w, kEnv, ev));  // overflows a small writer
+
+  const uint8_t unknownType[] = {99, 1, 1, 0, 1};
+  char out[256];
+  JsonWriter r(out, sizeof(out));
+  CHECK(!eventDecodeBinary(unknownType, sizeof(unknownType), kNodeEvents, eventCount(kNodeEvents), r));
+}
+
+int main() {
+  printf("test_event_schema\n");
+  RUN_TEST(testBoot);
+  RUN_TEST(testHeartbeat);
+  RUN_TEST(testWifiStatus);
+  RUN_TEST(testAnnounce);
+  RUN_TEST(testWifiApSeen);
+  RUN_TEST(testIngest);
+  RUN_TEST(testProbe);
+  RUN_TEST(testBleSeen);
+  RUN_TEST(testBleDigest);
+  RUN_TEST(testTextClamp);
+  RUN_TEST(testClasses);
+  RUN_TEST(testRejects);
+  TEST_MAIN_END();
+}
@@ -0,0 +1,192 @@
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include "histogram.h"
+#include "host_test.h"
+#include "prom_writer.h"
+
+static void testBuckets() {
+  CHECK_EQ(Histogram::bucketFor(0), 0);
+  CHECK_EQ(Histogram::bucketFor(1), 0);
+  CHECK_EQ(Histogram::bucketFor(2), 1);
+  CHECK_EQ(Histogram::bucketFor(3), 2);
+  CHECK_EQ(Histogram::bucketFor(4), 2);
+  CHECK_EQ(Histogram::bucketFor(5), 3);
+  CHECK_EQ(Histogram::bucketFor(1u << 22), 22);
+  CHECK_EQ(Histogram::bucketFor((1u << 22) + 1), Histogram::kBuckets - 1);
+  CHECK_EQ(Histogram::bucketFor(0xFFFFFFFFu), Histogram::kBuckets - 1);
+  for (uint32_t v = 1; v < 100000; v++) {
+    size_t b = Histogram::bucketFor(v);
+    CHECK(v <= Histogram::bound(b));
+    if (b > 0) CHECK(v > Histogram::bound(b - 1));
+    if (hostTestFailures) return;
+  }
+}
+
+static void testRecordSnapshotAndQuantile() {
+  Histogram h;
+  Histogram::Snapshot s;
+  h.snapshot(s);
+  CHECK_EQ(s.count, 0);
+  CHECK_EQ(Histogram::quantile(s, 0.5), 0);
+  for (uint32_t v = 1; v <= 100; v++) h.record(v);
+  h.record(0xFFFFFFFFu);
+  h.record(0xFFFFFFFFu);
+  h.snapshot(s);
+  CHECK_EQ(s.count, 102);
+  CHECK_EQ(s.sum, 5050ULL + 2ULL * 0xFFFFFFFFULL);  // carries into the high word
+  CHECK_EQ(s.max, 0xFFFFFFFFu);
+  CHECK_EQ(s.counts[0], 1);
+  CHECK_EQ(s.counts[7], 36);  // 65..100
+  CHECK_EQ(s.counts[Histogram::kBuckets - 1], 2);
+  CHECK_EQ(Histogram::quantile(s, 0.5), 64);   // 51st value is 51
+  CHECK_EQ(Histogram::quantile(s, 0.9), 128);  // 92nd value is 92
+  CHECK_EQ(Histogram::quantile(s, 1.0), 0xFFFFFFFFu);
+
+  Histogram small;
+  small.record(3);
+  small.snapshot(s);
+  CHECK_EQ(Histogram::quantile(s, 0.99), 3);  // capped at the observed max
+}
+
+static void testConcurrentReaderSeesConsistentState() {
+  Histogram h;
+  std::atomic<bool> done{false};
+  uint64_t written = 0;
+  // The writer runs until the reader has its samples, so a loaded machine
+  // cannot finish the writes before the reader is scheduled.
+  std::thread writer([&] {
+    for (uint32_t i = 0; !done.load(std::memory_order_relaxed); i++) {
+      h.record(3 + (i & 1) * 4);  // 3, 7, 3, 7, ...
+      written++;
+    }
+  });
+  for (int reads = 0; reads < 20000 && !hostTestFailures; reads++) {
+    Histogram::Snapshot s;
+    h.snapshot(s);
+    uint64_t threes = s.counts[2], sevens = s.counts[3];
+    CHECK_EQ(threes + sevens, s.count);
+    CHECK_EQ(s.sum, threes * 3 + sevens * 7);
+    CHECK(threes == sevens || threes == sevens + 1);
+  }
+  done = true;
+  writer.join();
+  Histogram::Snapshot s;
+  h.snapshot(s);
+  CHECK_EQ(s.count, written);
+}
+
+static void testFifoResidence() {
+  Histogram h;
+  FifoResidence<2> r;
+  r.onPush(100);  // sampled
+  r.onPush(110);  // sampled
+  r.onPush(120);  // slots full: not sampled
+  CHECK_EQ(r.pending(), 2);
+  r.onPop(150, h);  // 50
+  r.onPush(160);    // sampled, fourth record
+  r.onPop(170, h);  // 60
+  r.onPop(180, h);  // third record, unsampled
+  r.onPop(400, h);  // 240
+  CHECK_EQ(r.pending(), 0);
+  Histogram::Snapshot s;
+  h.snapshot(s);
+  CHECK_EQ(s.count, 3);
+  CHECK_EQ(s.sum, 350);
+  CHECK_EQ(s.max, 240);
+
+  // Dropped records leave the histogram alone but keep the stream aligned.
+  r.onPush(500);
+  r.onPush(510);
+  r.onDrop();
+  r.onPop(530, h);  // 20
+  h.snapshot(s);
+  CHECK_EQ(s.count, 4);
+  CHECK_EQ(s.sum, 370);
+  CHECK_EQ(r.pending(), 0);
+}
+
+static void testPromDecimal() {
+  char buf[32];
+  CHECK_EQ(formatPromDecimal(buf, 1, 3), 5);
+  CHECK_STR(buf, "0.001");
+  formatPromDecimal(buf, 32768, 3);
+  CHECK_STR(buf, "32.768");
+  formatPromDecimal(buf, 1000, 3);
+  CHECK_STR(buf, "1");
+  formatPromDecimal(buf, 1500000, 6);
+  CHECK_STR(buf, "1.5");
+  formatPromDecimal(buf, 42, 0);
+  CHECK_STR(buf, "42");
+  formatPromDecimal(buf, 0xFFFFFFFFFFFFFFFFULL, 6);
+  CHECK_STR(buf, "18446744073709.551615");
+}
+
+static bool appendSink(void *ctx, const char *data, size_t len) {
+  static_cast<std::string *>(ctx)->append(data, len);
+  return true;
+}
+
+static void writeSample(PromWriter &p, const Histogram::Snapshot &s) {
+  p.counter("node_events_dropped_total", "Events dropped.", 7);
+  p.gauge("node_wifi_rssi_dbm", "Wi-Fi RSSI.", -61);
+  const char *const classes[] = {"control", "telemetry"};
+  const uint64_t drops[] = {0, 12};
+  p.counters("node_events_class_dropped_total", "Events dropped by class.", "class", classes, drops, 2);
+  p.histogram("node_ingest_post_seconds", "Ingest POST latency.", s, 3);
+}
+
+static void testPromOutput() {
+  Histogram h;
+  h.record(1);
+  h.record(3);
+  h.record(1u << 30);
+  Histogram::Snapshot s;
+  h.snapshot(s);
+  static char big[8192];
+  PromWriter p(big, sizeof(big));
+  writeSample(p, s);
+  CHECK(!p.overflowed());
+  std::string out = p.c_str();
+  CHECK(out.find("# HELP node_events_dropped_total Events dropped.\n"
+                 "# TYPE node_events_dropped_total counter\n"
+                 "node_events_dropped_total 7\n") == 0);
+  CHECK(out.find("node_wifi_rssi_dbm -61\n") != std::string::npos);
+  CHECK(out.find("# TYPE node_events_class_dropped_total counter\n"
+                 "node_events_class_dropped_total{class=\"control\"} 0\n"
+                 "node_events_class_dropped_total{class=\"telemetry\"} 12\n") != std::string::npos);
+  CHECK(out.find("# TYPE node_ingest_post_seconds histogram\n"
+                 "node_ingest_post_seconds_bucket{le=\"0.001\"} 1\n"
+                 "node_ingest_post_seconds_bucket{le=\"0.002\"} 1\n"
+                 "node_ingest_post_seconds_bucket{le=\"0.004\"} 2\n") != std::string::npos);
+  CHECK(out.find("node_ingest_post_seconds_bucket{le=\"4194.304\"} 2\n"
+                 "node_ingest_post_seconds_bucket{le=\"+Inf\"} 3\n"
+                 "node_ingest_post_seconds_sum 1073741.828\n"
+                 "node_ingest_post_seconds_count 3\n") != std::string::npos);
+
+  for (size_t cap = 1; cap < 64; cap += 7) {
+    char buf[64];
+    std::string streamed;
+    PromWriter ps(buf, cap);
+    ps.setSink(appendSink, &streamed);
+    writeSample(ps, s);
+    CHECK(ps.flush());
+    CHECK(streamed == out);
+  }
+  char tiny[32];
+  PromWriter overflow(tiny, sizeof(tiny));
+  writeSample(overflow, s);
+  CHECK(overflow.overflowed());
+}
+
+int main() {
+  printf("test_histogram\n");
+  RUN_TEST(testBuckets);
+  RUN_TEST(testRecordSnapshotAndQuantile);
+  RUN_TEST(testConcurrentReaderSeesConsistentState);
+  RUN_TEST(testFifoResidence);
+  RUN_TEST(testPromDecimal);
+  RUN_TEST(testPromOutput);
+  TEST_MAIN_END();
+}
@@ -0,0 +1,128 @@
+#include <string>
+
+#include "host_test.h"
+#include "http_wire.h"
+
+static void testParseUrl() {
+  HttpUrl u;
+  CHECK(parseHttpUrl("http://192.168.8.160:8088/v1/ingest", u));
+  CHECK(!u.tls);
+  CHECK_STR(u.host, "192.168.8.160");
+  CHECK_EQ(u.port, 8088);
+  CHECK_STR(u.path, "/v1/ingest");
+
+  CHECK(parseHttpUrl("https://vault.local", u));
+  CHECK(u.tls);
+  CHECK_EQ(u.port, 443);
+  CHECK_STR(u.path, "/");
+
+  CHECK(parseHttpUrl("http://host?x=1", u));
+  CHECK_STR(u.path, "/?x=1");
+
+  CHECK(!parseHttpUrl("ftp://host/", u));
+  CHECK(!parseHttpUrl("http://:80/", u));
+  CHECK(!parseHttpUrl("http://host:99999/", u));
+  CHECK(!parseHttpUrl("http://host:/", u));
+}
+
+static void testPostHead() {
+  HttpUrl u;
+  parseHttpUrl("http://pi-logger:8088/v1/ingest", u);
+  char buf[256];
+  size_t n = formatPostHead(buf, sizeof(buf), u, "application/json", nullptr, 42);
+  CHECK_EQ(n, strlen(buf));
+  CHECK_STR(buf,
+            "POST /v1/ingest HTTP/1.1\r\nHost: pi-logger:8088\r\nContent-Type: application/json\r\n"
+            "Content-Length: 42\r\nConnection: keep-alive\r\n\r\n");
+  parseHttpUrl("https://vault/x", u);
+  formatPostHead(buf, sizeof(buf), u, "application/json", "gzip", 7);
+  CHECK(strstr(buf, "Host: vault\r\n") != nullptr);
+  CHECK(strstr(buf, "Content-Encoding: gzip\r\n") != nullptr);
+  CHECK_EQ(formatPostHead(buf, 20, u, "application/json", nullptr, 1), 0);
+}
+
+static void testContentLengthByteByByte() {
+  const std::string resp =
+      "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\ncontent-length: 11\r\n\r\n"
+      "{\"ok\":true}";
+  HttpResponseParser p;
+  for (size_t i = 0; i < resp.size(); i++) {
+    CHECK(!p.done());
+    CHECK_EQ(p.feed(resp.data() + i, 1), 1);
+  }
+  CHECK(p.done());
+  CHECK_EQ(p.status(), 200);
+  CHECK(p.keepAlive());
+  CHECK_STR(p.body(), "{\"ok\":true}");
+}
+
+static void testPipelinedResponsesShareBuffer() {
+  const std::string two =
+      "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok"
+      "HTTP/1.1 400 Bad Request\r\nContent-Length: 3\r\nConnection: close\r\n\r\nbad";
+  HttpResponseParser p;
+  size_t used = p.feed(two.data(), two.size());
+  CHECK(p.done());
+  CHECK_EQ(p.status(), 200);
+  CHECK(used < two.size());
+  p.reset();
+  size_t rest = p.feed(two.data() + used, two.size() - used);
+  CHECK_EQ(used + rest, two.size());
+  CHECK(p.done());
+  CHECK_EQ(p.status(), 400);
+  CHECK(!p.keepAlive());
+  CHECK_STR(p.body(), "bad");
+}
+
+static void testChunkedAndContinue() {
+  const std::string resp =
+      "HTTP/1.1 100 Continue\r\n\r\n"
+      "HTTP/1.1 201 Created\r\nTransfer-Encoding: chunked\r\n\r\n"
+      "4\r\n{\"ok\r\nA;ext=1\r\n\":true,\"n\"\r\n2\r\n:1\r\n1\r\n}\r\n0\r\nX-Trailer: y\r\n\r\n";
+  HttpResponseParser p;
+  size_t used = p.feed(resp.data(), resp.size());
+  CHECK_EQ(used, resp.size());
+  CHECK(p.done());
+  CHECK_EQ(p.status(), 201);
+  CHECK_STR(p.body(), "{\"ok\":true,\"n\":1}");
+}
+
+static void testCloseDelimitedAndErrors() {
+  HttpResponseParser p;
+  const std::string v10 = "HTTP/1.0 200 OK\r\n\r\npartial body";
+  p.feed(v10.data(), v10.size());
+  CHECK(!p.done());
+  p.finishOnClose();
+  CHECK(p.done());
+  CHECK(!p.keepAlive());
+  CHECK_STR(p.body(), "partial body");
+
+  p.reset();
+  const std::string cut = "HTTP/1.1 200 OK\r\nContent-Length: 10\r\n\r\nabc";
+  p.feed(cut.data(), cut.size());
+  p.finishOnClose();
+  CHECK(p.failed());
+
+  p.reset();
+  CHECK(!p.started());
+  p.feed("garbage\r\n", 9);
+  CHECK(p.failed());
+  CHECK(p.started());
+
+  p.reset();
+  const std::string noBody = "HTTP/1.1 204 No Content\r\n\r\n";
+  CHECK_EQ(p.feed(noBody.data(), noBody.size()), noBody.size());
+  CHECK(p.done());
+  CHECK_EQ(p.status(), 204);
+}
+
+int main() {
+  printf("test_http_wire\n");
+  RUN_TEST(testParseUrl);
+  RUN_TEST(testPostHead);
+  RUN_TEST(testContentLengthByteByByte);
+  RUN_TEST(testPipelinedResponsesShareBuffer);
+  RUN_TEST(testChunkedAndContinue);
+  RUN_TEST(testCloseDelimitedAndErrors);
+  TEST_MAIN_END();
+}
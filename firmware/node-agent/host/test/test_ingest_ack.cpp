@@ -0,0 +1,57 @@
+#include <string>
+
+#include "host_test.h"
+#include "ingest_ack.h"
+#include "json_writer.h"
+#include "node_events.h"
+
+static const char kNodeId[] = "node-7";
+
+static void testRecordId() {
+  HeartbeatEvent ev = {};
+  EventEnvelope env = {1, 1000, {kNodeId, sizeof(kNodeId) - 1}, 4000000000u, 17};
+  char json[512];
+  JsonWriter w(json, sizeof(json));
+  CHECK(eventEncodeJson(w, env, ev));
+  EventId id = {};
+  CHECK(eventRecordId(w.c_str(), w.size(), id));
+  CHECK_EQ(id.epoch, 17);
+  CHECK_EQ(id.seq, 4000000000u);
+
+  // Only the envelope's keys count; a text value cannot fake one because its
+  // quotes are escaped.
+  std::string rec = "{\"v\":1,\"type\":\"x\\\"seq\\\":9\",\"seq\":5,\"data\":{\"seq\":6}}";
+  CHECK(eventRecordId(rec.data(), rec.size(), id));
+  CHECK_EQ(id.seq, 5);
+  CHECK_EQ(id.epoch, 0);  // written before epochs existed
+
+  // The key must be followed by a number within the record.
+  rec = "{\"seq\":12";
+  CHECK(!eventRecordId(rec.data(), rec.size() - 2, id));
+  rec = "{\"seq\":null}";
+  CHECK(!eventRecordId(rec.data(), rec.size(), id));
+  rec = "{\"seq\":4294967296}";
+  CHECK(!eventRecordId(rec.data(), rec.size(), id));
+}
+
+static void testAck() {
+  std::string body = "{\"ok\":true, \"ack_epoch\" : 3, \"ack_seq\": 981}";
+  EventId ack = {};
+  CHECK(parseIngestAck(body.data(), body.size(), ack));
+  CHECK_EQ(ack.epoch, 3);
+  CHECK_EQ(ack.seq, 981);
+  CHECK(ack == (EventId{3, 981}));
+  CHECK(!(ack == (EventId{2, 981})));
+
+  body = "{\"ok\":true,\"stored\":true,\"count\":8}";
+  CHECK(!parseIngestAck(body.data(), body.size(), ack));
+  body = "{\"ok\":false,\"ack_seq\":\"12\"}";
+  CHECK(!parseIngestAck(body.data(), body.size(), ack));
+}
+
+int main() {
+  printf("test_ingest_ack\n");
+  RUN_TEST(testRecordId);
+  RUN_TEST(testAck);
+  TEST_MAIN_END();
+}
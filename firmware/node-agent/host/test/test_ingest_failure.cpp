@@ -0,0 +1,97 @@
+#include <set>
+#include <vector>
+
+#include "host_test.h"
+#include "ingest_failure.h"
+
+static void testClassify() {
+  CHECK(classifyIngestStatus(-3) == IngestFailure::kTransport);
+  CHECK(classifyIngestStatus(0) == IngestFailure::kTransport);
+  CHECK(classifyIngestStatus(503) == IngestFailure::kServer);
+  CHECK(classifyIngestStatus(413) == IngestFailure::kTooLarge);
+  CHECK(classifyIngestStatus(400) == IngestFailure::kClient);
+  CHECK(classifyIngestStatus(302) == IngestFailure::kClient);
+  CHECK_STR(ingestFailureName(IngestFailure::kServer), "5xx");
+
+  CHECK(ingestStatusBlamesRecords(400));
+  CHECK(ingestStatusBlamesRecords(413));
+  CHECK(ingestStatusBlamesRecords(422));
+  CHECK(!ingestStatusBlamesRecords(401));
+  CHECK(!ingestStatusBlamesRecords(429));
+  CHECK(!ingestStatusBlamesRecords(415));
+  CHECK(!ingestStatusBlamesRecords(500));
+  CHECK(!ingestStatusBlamesRecords(-1));
+}
+
+// Drains a queue of `n` records in batches of up to `batch` against a server
+// that refuses any batch holding a bad record. Returns the POST count.
+static size_t drain(uint32_t firstSerial, size_t n, size_t batch, const std::set<uint32_t> &bad,
+                    std::vector<uint32_t> &culprits) {
+  BatchBisector b;
+  uint32_t front = firstSerial;
+  const uint32_t end = firstSerial + (uint32_t)n;
+  size_t posts = 0;
+  while (front != end) {
+    size_t count = batch;
+    if (b.limit(front) > 0 && b.limit(front) < count) count = b.limit(front);
+    if (count > (uint32_t)(end - front)) count = end - front;
+    posts++;
+    bool refused = false;
+    for (uint32_t i = 0; i < count; i++) refused |= bad.count(front + i) > 0;
+    if (!refused) {
+      front += (uint32_t)count;
+    } else if (b.onRefused(front, count)) {
+      culprits.push_back(front);
+      front++;
+    }
+    CHECK(posts < 1000);
+    if (posts >= 1000) break;
+  }
+  return posts;
+}
+
+static void testBisect() {
+  std::vector<uint32_t> culprits;
+  size_t posts = drain(0, 64, 64, {37}, culprits);
+  CHECK_EQ(culprits.size(), 1);
+  CHECK_EQ(culprits[0], 37);
+  CHECK(posts <= 14);  // log2(64) refusals plus the clean halves
+
+  // Two culprits side by side, serials wrapping, a clean tail after them.
+  culprits.clear();
+  uint32_t base = 0xFFFFFFF0u;
+  drain(base, 100, 32, {base + 20, base + 21}, culprits);
+  CHECK_EQ(culprits.size(), 2);
+  CHECK_EQ(culprits[0], base + 20);
+  CHECK_EQ(culprits[1], base + 21);
+
+  // Nothing bad: batches stay whole.
+  culprits.clear();
+  CHECK_EQ(drain(0, 64, 16, {}, culprits), 4);
+  CHECK(culprits.empty());
+}
+
+static void testFrontMoves() {
+  BatchBisector b;
+  CHECK(!b.active(0));
+  CHECK_EQ(b.limit(0), 0);
+  CHECK(!b.onRefused(10, 8));
+  CHECK(b.active(10));
+  CHECK_EQ(b.limit(10), 4);
+  // Suspects evicted meanwhile drop out.
+  CHECK_EQ(b.limit(15), 1);
+  CHECK(!b.active(18));
+  CHECK_EQ(b.limit(18), 0);
+  CHECK(b.onRefused(18, 1));
+  CHECK(!b.onRefused(18, 2));
+  b.reset();
+  CHECK(!b.active(18));
+}
+
+int main() {
+  printf("test_ingest_failure\n");
+  RUN_TEST(testClassify);
+  RUN_TEST(testBisect);
+  RUN_TEST(testFrontMoves);
+  TEST_MAIN_END();
+}
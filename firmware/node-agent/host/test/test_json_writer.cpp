@@ -0,0 +1,181 @@
+#include <string>
+
+#include "host_test.h"
+#include "json_writer.h"
+
+static void testObjectCommas() {
+  char buf[128];
+  JsonWriter w(buf, sizeof(buf));
+  w.beginObject();
+  w.fieldUInt("v", 1);
+  w.fieldStr("type", "ble.seen");
+  w.key("data");
+  w.beginObject();
+  w.fieldInt("rssi", -67);
+  w.fieldBool("ok", true);
+  w.fieldStrOrNull("ip", "", 0);
+  w.endObject();
+  w.key("dns");
+  w.beginArray();
+  w.writeString("1.1.1.1");
+  w.writeString("8.8.8.8");
+  w.endArray();
+  w.endObject();
+  CHECK(!w.overflowed());
+  CHECK_STR(w.c_str(),
+            "{\"v\":1,\"type\":\"ble.seen\",\"data\":{\"rssi\":-67,\"ok\":true,"
+            "\"ip\":null},\"dns\":[\"1.1.1.1\",\"8.8.8.8\"]}");
+  CHECK_EQ(w.size(), strlen(buf));
+}
+
+static void testEscaping() {
+  char buf[128];
+  JsonWriter w(buf, sizeof(buf));
+  const char in[] = "a\"b\\c\nd\re\tf\x01g-long-clean-tail-abcdefgh";
+  w.writeString(in, sizeof(in) - 1);
+  CHECK_STR(w.c_str(), "\"a\\\"b\\\\c\\nd\\re\\tf\\u0001g-long-clean-tail-abcdefgh\"");
+}
+
+static void testEscapeScanMatchesBytewise() {
+  char s[64];
+  for (size_t len = 0; len < sizeof(s); len++) {
+    for (size_t bad = 0; bad <= len; bad++) {
+      for (size_t off = 0; off < 8 && off + len <= sizeof(s); off++) {
+        memset(s, 'x', sizeof(s));
+        if (bad < len) s[off + bad] = (bad % 3 == 0) ? '"' : (bad % 3 == 1) ? '\\' : '\x1f';
+        CHECK_EQ(jsonEscapeScan(s + off, len), bad < len ? bad : len);
+      }
+    }
+  }
+  const char utf8[] = "caf\xc3\xa9 \xe2\x9c\x93 ok";
+  CHECK_EQ(jsonEscapeScan(utf8, sizeof(utf8) - 1), sizeof(utf8) - 1);
+}
+
+static void testNumbers() {
+  char buf[128];
+  JsonWriter w(buf, sizeof(buf));
+  w.beginArray();
+  w.writeUInt(0);
+  w.writeUInt(4294967295ULL);
+  w.writeUInt(18446744073709551615ULL);
+  w.writeInt(-9223372036854775807LL - 1);
+  w.writeFixed(235, 2);
+  w.writeFixed(-5, 3);
+  w.endArray();
+  CHECK_STR(w.c_str(),
+            "[0,4294967295,18446744073709551615,-9223372036854775808,2.35,-0.005]");
+}
+
+static void testOverflowAndRewind() {
+  char buf[24];
+  JsonWriter w(buf, sizeof(buf));
+  w.beginArray();
+  JsonWriter::Mark ok = w.mark();
+  w.writeString("short");
+  ok = w.mark();
+  w.writeString("this one does not fit at all");
+  CHECK(w.overflowed());
+  w.rewind(ok);
+  CHECK(!w.overflowed());
+  w.endArray();
+  CHECK_STR(w.c_str(), "[\"short\"]");
+}
+
+static bool appendSink(void *ctx, const char *data, size_t len) {
+  static_cast<std::string *>(ctx)->append(data, len);
+  return true;
+}
+
+static void writeLongDocument(JsonWriter &w) {
+  w.beginObject();
+  w.key("items");
+  w.beginArray();
+  for (int i = 0; i < 50; i++) {
+    w.beginObject();
+    w.fieldUInt("i", i);
+    w.fieldStr("name", "quote\"and\\slash\n");
+    w.fieldStr("long", "abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopqrstuvwxyz");
+    w.endObject();
+  }
+  w.endArray();
+  w.endObject();
+}
+
+static void testSinkStreamsThroughSmallBuffer() {
+  static char big[8192];
+  JsonWriter ref(big, sizeof(big));
+  writeLongDocument(ref);
+  CHECK(!ref.overflowed());
+  for (size_t cap = 1; cap <= 96; cap++) {
+    char buf[96];
+    std::string out;
+    JsonWriter w(buf, cap);
+    w.setSink(appendSink, &out);
+    writeLongDocument(w);
+    CHECK(w.flush());
+    CHECK(!w.overflowed());
+    CHECK(out == ref.c_str());
+    CHECK_EQ(w.flushedBytes(), ref.size());
+    if (hostTestFailures) return;
+  }
+}
+
+static bool failingSink(void *ctx, const char *, size_t len) {
+  size_t &budget = *static_cast<size_t *>(ctx);
+  if (len > budget) return false;
+  budget -= len;
+  return true;
+}
+
+static void testSinkFailureAndMarks() {
+  char buf[16];
+  size_t budget = 40;
+  JsonWriter w(buf, sizeof(buf));
+  w.setSink(failingSink, &budget);
+  writeLongDocument(w);
+  CHECK(w.overflowed());
+  CHECK(!w.flush());
+
+  std::string out;
+  JsonWriter m(buf, sizeof(buf));
+  m.setSink(appendSink, &out);
+  m.beginArray();
+  JsonWriter::Mark before = m.mark();
+  m.writeString("fits");
+  m.rewind(before);
+  CHECK(!m.overflowed());
+  m.writeString("0123456789abcdef");  // forces a flush
+  m.rewind(before);
+  CHECK(m.overflowed());
+
+  // Without a sink, flush() reports failure and output is untouched.
+  JsonWriter plain(buf, sizeof(buf));
+  plain.writeUInt(7);
+  CHECK(!plain.flush());
+  CHECK_STR(plain.c_str(), "7");
+}
+
+static void testFormatters() {
+  char ip[16];
+  formatIpv4(ip, 192, 168, 0, 254);
+  CHECK_STR(ip, "192.168.0.254");
+  char mac[18];
+  const uint8_t raw[6] = {0xAA, 0x0b, 0x00, 0x10, 0xfe, 0x01};
+  formatMac(mac, raw, false);
+  CHECK_STR(mac, "aa:0b:00:10:fe:01");
+  formatMac(mac, raw, true);
+  CHECK_STR(mac, "AA:0B:00:10:FE:01");
+}
+
+int main() {
+  printf("test_json_writer\n");
+  RUN_TEST(testObjectCommas);
+  RUN_TEST(testEscaping);
+  RUN_TEST(testEscapeScanMatchesBytewise);
+  RUN_TEST(testNumbers);
+  RUN_TEST(testOverflowAndRewind);
+  RUN_TEST(testSinkStreamsThroughSmallBuffer);
+  RUN_TEST(testSinkFailureAndMarks);
+  RUN_TEST(testFormatters);
+  TEST_MAIN_END();
+}
@@ -0,0 +1,130 @@
+#include "host_test.h"
+#include "loop_profiler.h"
+
+static const char *const kNames[] = {"http", "wifi", "ingest"};
+
+static void testLapsChargeStages() {
+  LoopProfiler p;
+  p.begin(kNames, 3, 10, 1000);  // 10 cycles/us, 1 ms budget
+  p.beginPass(100);
+  p.lap(0, 150);    // http 50
+  p.lap(1, 170);    // wifi 20
+  p.lap(2, 1170);   // ingest 1000
+  p.endPass(1200);  // pass 1100, under the 10000-cycle budget
+  p.beginPass(2000);
+  p.lap(0, 2030);
+  p.lap(1, 2040);
+  p.lap(2, 2100);
+  p.endPass(2100);
+  CHECK_EQ(p.stageCount(), 3);
+  CHECK_STR(p.stageName(2), "ingest");
+  CHECK_EQ(p.budgetUs(), 1000);
+  const LoopProfiler::Stats &http = p.stage(0);
+  CHECK_EQ(http.count, 2);
+  CHECK_EQ(http.minCycles, 30);
+  CHECK_EQ(http.maxCycles, 50);
+  CHECK_EQ(http.sumCycles, 80);
+  CHECK_EQ(p.stage(2).maxCycles, 1000);
+  CHECK_EQ(p.pass().count, 2);
+  CHECK_EQ(p.pass().sumCycles, 1200);
+  CHECK_EQ(p.pass().overBudget, 0);
+  Histogram::Snapshot s;
+  p.stageHistogram(2, s);
+  CHECK_EQ(s.count, 2);
+  CHECK_EQ(s.max, 100);  // microseconds
+}
+
+static void testOverBudgetBlamesLongestStage() {
+  LoopProfiler p;
+  p.begin(kNames, 3, 1, 100);
+  p.beginPass(0);
+  p.lap(0, 60);
+  p.lap(1, 120);  // wifi 60, ties go to the later stage
+  p.lap(2, 130);
+  p.endPass(130);
+  p.beginPass(200);
+  p.lap(0, 210);
+  p.lap(1, 220);
+  p.lap(2, 420);  // ingest alone over budget
+  p.endPass(420);
+  p.beginPass(500);
+  p.lap(0, 510);
+  p.lap(1, 520);
+  p.lap(2, 530);
+  p.endPass(530);
+  CHECK_EQ(p.pass().overBudget, 2);
+  CHECK_EQ(p.stage(0).blamed, 0);
+  CHECK_EQ(p.stage(1).blamed, 1);
+  CHECK_EQ(p.stage(2).blamed, 1);
+  CHECK_EQ(p.stage(2).overBudget, 1);
+  CHECK_EQ(p.stage(1).overBudget, 0);
+}
+
+static void testCounterWrapAndReset() {
+  LoopProfiler p;
+  p.begin(kNames, 3, 1, 100);
+  p.beginPass(0xFFFFFFF0u);
+  p.lap(0, 0xFFFFFFFAu);
+  p.lap(1, 4);  // wrapped: 10 cycles
+  p.lap(2, 6);
+  p.endPass(6);
+  CHECK_EQ(p.stage(1).maxCycles, 10);
+  CHECK_EQ(p.pass().maxCycles, 22);
+  // Reset mid-pass: the pass in progress is still timed from its start.
+  p.beginPass(100);
+  p.lap(0, 110);
+  p.reset();
+  CHECK_EQ(p.stage(0).count, 0);
+  CHECK_EQ(p.pass().count, 0);
+  p.lap(1, 130);
+  p.lap(2, 140);
+  p.endPass(140);
+  CHECK_EQ(p.stage(1).count, 1);
+  CHECK_EQ(p.stage(1).minCycles, 20);
+  CHECK_EQ(p.pass().sumCycles, 40);
+  Histogram::Snapshot s;
+  p.passHistogram(s);
+  CHECK_EQ(s.count, 1);
+}
+
+static void testIgnoresUnknownStage() {
+  LoopProfiler p;
+  p.begin(kNames, 3, 1, 100);
+  p.beginPass(0);
+  p.lap(7, 10);
+  p.lap(0, 15);
+  p.endPass(15);
+  CHECK_EQ(p.stage(0).maxCycles, 5);
+}
+
+static void testRepeatedLapsSumPerPass() {
+  LoopProfiler p;
+  p.begin(kNames, 3, 1, 100);
+  p.beginPass(0);
+  p.lap(0, 10);
+  p.lap(1, 30);
+  p.lap(0, 55);  // http again: 25 more
+  p.lap(2, 60);
+  // Nothing is recorded until the pass ends.
+  CHECK_EQ(p.stage(0).count, 0);
+  p.endPass(60);
+  CHECK_EQ(p.stage(0).count, 1);
+  CHECK_EQ(p.stage(0).sumCycles, 35);
+  CHECK_EQ(p.stage(1).sumCycles, 20);
+  // A stage not lapped in a pass gets no sample.
+  p.beginPass(100);
+  p.lap(1, 110);
+  p.endPass(110);
+  CHECK_EQ(p.stage(0).count, 1);
+  CHECK_EQ(p.stage(1).count, 2);
+}
+
+int main() {
+  printf("test_loop_profiler\n");
+  RUN_TEST(testLapsChargeStages);
+  RUN_TEST(testOverBudgetBlamesLongestStage);
+  RUN_TEST(testCounterWrapAndReset);
+  RUN_TEST(testIgnoresUnknownStage);
+  RUN_TEST(testRepeatedLapsSumPerPass);
+  TEST_MAIN_END();
+}
@@ -0,0 +1,110 @@
+#include <list>
+#include <map>
+#include <random>
+
+#include "ble_adv.h"
+#include "host_test.h"
+#include "lru_table.h"
+
+struct Value {
+  uint32_t id;
+  uint32_t hits;
+};
+
+// Keys are drawn from a small universe so the index sees long probe chains,
+// collisions and backward shifts across the wrap point.
+template <size_t Capacity>
+static void runAgainstModel(uint32_t seed, uint32_t universe, int steps) {
+  static LruHashTable<Value, Capacity> table;
+  table.clear();
+  std::list<uint64_t> order;  // most recent first
+  std::map<uint64_t, Value> values;
+  std::mt19937 rng(seed);
+  uint32_t evictions = 0;
+  for (int step = 0; step < steps; step++) {
+    uint64_t key = (uint64_t)(rng() % universe) << 20;
+    uint32_t op = rng() % 100;
+    if (op < 70) {
+      bool inserted = false;
+      Value *v = table.upsert(key, inserted);
+      CHECK(v != nullptr);
+      CHECK_EQ(inserted, values.count(key) == 0);
+      if (inserted) {
+        CHECK_EQ(v->hits, 0);
+        v->id = (uint32_t)step;
+        if (values.size() == Capacity) {
+          values.erase(order.back());
+          order.pop_back();
+          evictions++;
+        }
+        values[key] = *v;
+      } else {
+        CHECK_EQ(v->id, values[key].id);
+        order.remove(key);
+      }
+      v->hits++;
+      values[key].hits = v->hits;
+      order.push_front(key);
+    } else if (op < 85) {
+      bool present = values.count(key) > 0;
+      CHECK_EQ(table.erase(key), present);
+      if (present) {
+        values.erase(key);
+        order.remove(key);
+      }
+    } else {
+      Value *v = table.find(key);
+      CHECK_EQ(v != nullptr, values.count(key) > 0);
+      if (v) CHECK_EQ(v->hits, values[key].hits);
+    }
+    CHECK_EQ(table.size(), values.size());
+    if (hostTestFailures) return;
+  }
+  CHECK_EQ(table.evictions(), evictions);
+  auto it = order.begin();
+  for (uint16_t h = table.front(); h != table.npos; h = table.next(h), ++it) {
+    CHECK(it != order.end());
+    if (it == order.end()) return;
+    CHECK_EQ(table.key(h), *it);
+    CHECK_EQ(table.at(h).id, values[*it].id);
+  }
+  CHECK(it == order.end());
+}
+
+static void testRandomSmall() { runAgainstModel<8>(1, 24, 200000); }
+
+static void testRandomLarge() { runAgainstModel<1000>(2, 3000, 300000); }
+
+static void testEvictsLeastRecentlyUsed() {
+  static LruHashTable<Value, 3> table;
+  bool inserted;
+  table.upsert(1, inserted)->id = 1;
+  table.upsert(2, inserted)->id = 2;
+  table.upsert(3, inserted)->id = 3;
+  table.upsert(1, inserted);  // 1 becomes most recent; 2 is now oldest
+  CHECK(!inserted);
+  table.upsert(4, inserted)->id = 4;
+  CHECK(inserted);
+  CHECK(table.find(2) == nullptr);
+  CHECK_EQ(table.evictions(), 1);
+  CHECK_EQ(table.key(table.front()), 4);
+  CHECK_EQ(table.key(table.back()), 3);
+  CHECK(table.find(3) != nullptr);
+  CHECK_EQ(table.key(table.back()), 3);  // find() leaves recency alone
+}
+
+static void testBleAddrKey() {
+  const uint8_t a[6] = {0xC4, 0x0D, 0x1A, 0x9E, 0x07, 0x7B};
+  CHECK(bleAddrKey(a, 0) == 0xC40D1A9E077BULL);
+  CHECK(bleAddrKey(a, 1) == 0x01C40D1A9E077BULL);
+  CHECK(bleAddrKey(a, 0) != bleAddrKey(a, 1));
+}
+
+int main() {
+  printf("test_lru_table\n");
+  RUN_TEST(testRandomSmall);
+  RUN_TEST(testRandomLarge);
+  RUN_TEST(testEvictsLeastRecentlyUsed);
+  RUN_TEST(testBleAddrKey);
+  TEST_MAIN_END();
+}
@@ -0,0 +1,136 @@
+#include <string>
+
+#include "host_test.h"
+#include "mqtt_wire.h"
+
+static void testParseUrl() {
+  MqttUrl u;
+  CHECK(parseMqttUrl("mqtt://192.168.8.160", u));
+  CHECK(!u.tls);
+  CHECK_STR(u.host, "192.168.8.160");
+  CHECK_EQ(u.port, 1883);
+  CHECK_STR(u.prefix, "sods");
+  CHECK_STR(u.user, "");
+
+  CHECK(parseMqttUrl("mqtts://node:p@ss@broker.lan:9883/lab/ble/", u));
+  CHECK(u.tls);
+  CHECK_STR(u.user, "node");
+  CHECK_STR(u.pass, "p@ss");
+  CHECK_STR(u.host, "broker.lan");
+  CHECK_EQ(u.port, 9883);
+  CHECK_STR(u.prefix, "lab/ble");
+
+  CHECK(parseMqttUrl("mqtt://only-user@h:1", u));
+  CHECK_STR(u.user, "only-user");
+  CHECK_STR(u.pass, "");
+
+  CHECK(!parseMqttUrl("http://h/", u));
+  CHECK(!parseMqttUrl("mqtt://:1883", u));
+  CHECK(!parseMqttUrl("mqtt://h:0", u));
+  CHECK(!parseMqttUrl("mqtt://h/a/+/b", u));
+}
+
+static void testConnect() {
+  uint8_t buf[64];
+  size_t n = mqttConnect(buf, sizeof(buf), "n1", "", "", 30);
+  const uint8_t want[] = {0x10, 14, 0, 4, 'M', 'Q', 'T', 'T', 4, 0x02, 0, 30, 0, 2, 'n', '1'};
+  CHECK_EQ(n, sizeof(want));
+  CHECK(memcmp(buf, want, sizeof(want)) == 0);
+
+  n = mqttConnect(buf, sizeof(buf), "n1", "u", "pw", 60);
+  CHECK_EQ(n, 2 + 14 + 3 + 4);
+  CHECK_EQ(buf[9], 0xC2);
+  CHECK_EQ(buf[n - 1], 'w');
+  CHECK_EQ(mqttConnect(buf, 8, "n1", "", "", 30), 0);
+}
+
+static void testPublishHead() {
+  uint8_t buf[32];
+  size_t n = mqttPublishHead(buf, sizeof(buf), "a/b", 0x1234, 3);
+  const uint8_t want[] = {0x32, 10, 0, 3, 'a', '/', 'b', 0x12, 0x34};
+  CHECK_EQ(n, sizeof(want));
+  CHECK(memcmp(buf, want, sizeof(want)) == 0);
+
+  // Remaining length spills into more bytes past 127 and 16383.
+  n = mqttPublishHead(buf, sizeof(buf), "t", 1, 200);
+  CHECK_EQ(buf[1], (205 & 0x7F) | 0x80);
+  CHECK_EQ(buf[2], 205 >> 7);
+  CHECK_EQ(n, 3 + 3 + 2);
+  n = mqttPublishHead(buf, sizeof(buf), "t", 1, 20000);
+  CHECK_EQ(n, 4 + 3 + 2);
+  CHECK_EQ(mqttPingreq(buf, sizeof(buf)), 2);
+  CHECK_EQ(buf[0], 0xC0);
+  CHECK_EQ(mqttDisconnect(buf, 1), 0);
+}
+
+static void testReaderSplitsStream() {
+  // CONNACK, PINGRESP and two PUBACKs, fed one byte at a time.
+  const uint8_t stream[] = {0x20, 2, 0, 0, 0xD0, 0, 0x40, 2, 0, 7, 0x40, 2, 1, 2};
+  MqttReader r;
+  size_t i = 0;
+  int packets = 0;
+  uint16_t lastId = 0;
+  while (i < sizeof(stream)) {
+    i += r.feed(stream + i, 1);
+    if (!r.done()) continue;
+    if (packets == 0) {
+      CHECK_EQ(r.type(), kMqttConnack);
+      CHECK_EQ(r.connackCode(), 0);
+    } else if (packets == 1) {
+      CHECK_EQ(r.type(), kMqttPingresp);
+    } else {
+      CHECK_EQ(r.type(), kMqttPuback);
+      lastId = r.packetId();
+    }
+    packets++;
+    r.reset();
+  }
+  CHECK_EQ(packets, 4);
+  CHECK_EQ(lastId, 0x0102);
+
+  // feed() stops at the end of a packet.
+  r.reset();
+  CHECK_EQ(r.feed(stream, sizeof(stream)), 4);
+  CHECK(r.done());
+}
+
+static void testReaderSkipsLongBodiesAndRejectsJunk() {
+  std::string pub;
+  pub += char(0x30);
+  pub += char(0x80 | 2);
+  pub += char(1);  // 130 bytes
+  pub += std::string(130, 'x');
+  pub += char(0x40);
+  pub += char(2);
+  pub += char(0);
+  pub += char(9);
+  MqttReader r;
+  const uint8_t *p = reinterpret_cast<const uint8_t *>(pub.data());
+  size_t n = r.feed(p, pub.size());
+  CHECK(r.done());
+  CHECK_EQ(r.type(), kMqttPublish);
+  CHECK_EQ(r.length(), 130);
+  CHECK_EQ(n, 133);
+  r.reset();
+  r.feed(p + n, pub.size() - n);
+  CHECK_EQ(r.packetId(), 9);
+
+  const uint8_t connect[] = {0x10, 0};
+  r.reset();
+  r.feed(connect, sizeof(connect));
+  CHECK(r.failed());
+  const uint8_t tooLong[] = {0x30, 0xFF, 0xFF, 0xFF, 0xFF};
+  r.reset();
+  r.feed(tooLong, sizeof(tooLong));
+  CHECK(r.failed());
+}
+
+int main() {
+  printf("test_mqtt_wire\n");
+  RUN_TEST(testParseUrl);
+  RUN_TEST(testConnect);
+  RUN_TEST(testPublishHead);
+  RUN_TEST(testReaderSplitsStream);
+  RUN_TEST(testReaderSkipsLongBodiesAndRejectsJunk);
+  TEST_MAIN_END();
+}
@@ -0,0 +1,138 @@
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "host_test.h"
+#include "oui_index.h"
+
+#ifdef HOST_OUI_DIR
+
+static std::vector<uint8_t> readFile(const std::string &path) {
+  std::ifstream f(path, std::ios::binary);
+  return std::vector<uint8_t>((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+}
+
+static std::string repoPath(const char *rel) {
+  std::string self = __FILE__;
+  return self.substr(0, self.rfind("/firmware/node-agent/")) + "/" + rel;
+}
+
+static std::vector<uint8_t> gNames = readFile(std::string(HOST_OUI_DIR) + "/oui.idx");
+static std::vector<uint8_t> gIds = readFile(std::string(HOST_OUI_DIR) + "/oui-ids.idx");
+
+static void testEverySourceOuiResolves() {
+  OuiIndex idx;
+  CHECK(idx.begin(gNames.data(), gNames.size()));
+  std::ifstream src(repoPath("OUI/oui_combined.txt"));
+  std::string line;
+  size_t n = 0;
+  while (std::getline(src, line)) {
+    unsigned a, b, c;
+    if (sscanf(line.c_str(), "%2x-%2x-%2x", &a, &b, &c) != 3) continue;
+    n++;
+    uint16_t id = idx.lookup(a << 16 | b << 8 | c);
+    CHECK(id != OuiIndex::kNone);
+    CHECK(id < idx.vendorCount());
+    if (hostTestFailures) return;
+  }
+  CHECK(n > 30000);
+  CHECK(idx.entryCount() >= n);
+}
+
+static void testNoFalseHits() {
+  OuiIndex idx;
+  CHECK(idx.begin(gIds.data(), gIds.size()));
+  uint32_t hits = 0;
+  for (uint32_t oui = 0; oui < 0x1000000; oui++) hits += idx.lookup(oui) != OuiIndex::kNone;
+  CHECK_EQ(hits, idx.entryCount());
+  CHECK_EQ(idx.lookup(0x1000000), OuiIndex::kNone);
+}
+
+static void testNamesMatchVendorTable() {
+  OuiIndex idx;
+  CHECK(idx.begin(gNames.data(), gNames.size()));
+  CHECK(idx.hasNames());
+  std::ifstream tsv(std::string(HOST_OUI_DIR) + "/oui-vendors.tsv");
+  std::string line;
+  uint32_t n = 0;
+  char name[64];
+  while (std::getline(tsv, line)) {
+    size_t tab = line.find('\t');
+    CHECK_EQ(strtoul(line.c_str(), nullptr, 10), n);
+    size_t len = idx.vendorName((uint16_t)n, name, sizeof(name));
+    CHECK_EQ(len, line.size() - tab - 1);
+    CHECK_STR(name, line.c_str() + tab + 1);
+    n++;
+    if (hostTestFailures) return;
+  }
+  CHECK_EQ(n, idx.vendorCount());
+  CHECK_EQ(idx.vendorName((uint16_t)n, name, sizeof(name)), 0);
+  CHECK_STR(name, "");
+  // Truncation keeps the output terminated.
+  uint16_t apple = idx.lookup(0x001CB3);
+  CHECK_EQ(idx.vendorName(apple, name, 4), 3);
+  CHECK_STR(name, "App");
+}
+
+static void testIdsOnlyAgreesWithNamedIndex() {
+  OuiIndex named, ids;
+  CHECK(named.begin(gNames.data(), gNames.size()));
+  CHECK(ids.begin(gIds.data(), gIds.size()));
+  CHECK(!ids.hasNames());
+  CHECK(ids.sizeBytes() < named.sizeBytes());
+  CHECK_EQ(ids.indexId(), named.indexId());
+  char name[64];
+  CHECK_EQ(named.vendorName(named.lookup(0x001CB3), name, sizeof(name)), 5);
+  CHECK_STR(name, "Apple");
+  CHECK_EQ(ids.lookup(0x001CB3), named.lookup(0x001CB3));
+  CHECK_EQ(ids.vendorName(ids.lookup(0x001CB3), name, sizeof(name)), 0);
+  for (uint32_t oui = 0; oui < 0x1000000; oui += 97) CHECK_EQ(ids.lookup(oui), named.lookup(oui));
+}
+
+static void testMacFilters() {
+  OuiIndex idx;
+  CHECK(idx.begin(gIds.data(), gIds.size()));
+  const uint8_t apple[6] = {0x00, 0x1C, 0xB3, 0x12, 0x34, 0x56};
+  CHECK_EQ(idx.lookupMac(apple), idx.lookup(0x001CB3));
+  CHECK(idx.lookupMac(apple) != OuiIndex::kNone);
+  const uint8_t local[6] = {0x02, 0x1C, 0xB3, 0x12, 0x34, 0x56};
+  CHECK_EQ(idx.lookupMac(local), OuiIndex::kNone);
+  const uint8_t multicast[6] = {0x01, 0x00, 0x5E, 0x00, 0x00, 0x01};
+  CHECK_EQ(idx.lookupMac(multicast), OuiIndex::kNone);
+}
+
+static void testRejectsBadBlobs() {
+  OuiIndex idx;
+  CHECK(!idx.begin(nullptr, 0));
+  CHECK(!idx.valid());
+  CHECK_EQ(idx.lookup(0x001CB3), OuiIndex::kNone);
+  std::vector<uint8_t> bad = gIds;
+  bad[0] = 'X';
+  CHECK(!idx.begin(bad.data(), bad.size()));
+  bad = gIds;
+  bad[4] = 2;  // unknown format version
+  CHECK(!idx.begin(bad.data(), bad.size()));
+  CHECK(!idx.begin(gIds.data(), gIds.size() / 2));
+  CHECK(!idx.begin(gIds.data(), 39));
+  CHECK(idx.begin(gIds.data(), gIds.size()));
+}
+
+int main() {
+  printf("test_oui_index\n");
+  RUN_TEST(testEverySourceOuiResolves);
+  RUN_TEST(testNoFalseHits);
+  RUN_TEST(testNamesMatchVendorTable);
+  RUN_TEST(testIdsOnlyAgreesWithNamedIndex);
+  RUN_TEST(testMacFilters);
+  RUN_TEST(testRejectsBadBlobs);
+  TEST_MAIN_END();
+}
+
+#else
+
+int main() {
+  printf("test_oui_index: skipped (needs python3 to generate the index)\n");
+  return 0;
+}
+
+#endif
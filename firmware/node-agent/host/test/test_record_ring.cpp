@@ -0,0 +1,162 @@
+#include <deque>
+#include <random>
+#include <string>
+
+#include "host_test.h"
+#include "record_ring.h"
+
+static std::string payloadFor(uint32_t id, size_t len) {
+  std::string s(len, 'a' + id % 26);
+  if (len >= 4) memcpy(&s[0], &id, 4);
+  return s;
+}
+
+static void testFifoAcrossWraps() {
+  alignas(4) static uint8_t arena[1000];
+  RecordRing ring(arena, sizeof(arena));
+  std::deque<std::string> model;
+  std::mt19937 rng(7);
+  uint32_t id = 0;
+  size_t wraps = 0;
+  for (int step = 0; step < 200000; step++) {
+    if (rng() % 100 < 55) {
+      std::string p = payloadFor(id++, rng() % 180);
+      if (ring.push(p.data(), p.size())) {
+        model.push_back(p);
+      } else {
+        CHECK(!model.empty());
+      }
+    } else if (!model.empty()) {
+      RecordRing::View v = ring.front();
+      CHECK_EQ(v.len, model.front().size());
+      CHECK(memcmp(v.data, model.front().data(), v.len) == 0);
+      size_t headBefore = v.data - reinterpret_cast<const char *>(arena);
+      ring.pop();
+      model.pop_front();
+      if (!ring.empty()) {
+        size_t headAfter = ring.front().data - reinterpret_cast<const char *>(arena);
+        if (headAfter < headBefore) wraps++;
+      }
+    }
+    CHECK_EQ(ring.count(), model.size());
+    CHECK(ring.bytesUsed() <= ring.capacityBytes());
+    if (hostTestFailures) return;
+  }
+  CHECK(wraps > 100);
+}
+
+static void testIterationAndFlags() {
+  alignas(4) static uint8_t arena[256];
+  RecordRing ring(arena, sizeof(arena));
+  CHECK(ring.begin() == RecordRing::npos);
+  const char *items[] = {"one", "two", "three", "four"};
+  for (const char *it : items) CHECK(ring.push(it, strlen(it), 0, 7));
+  size_t i = 0;
+  for (size_t off = ring.begin(); off != RecordRing::npos; off = ring.next(off)) {
+    RecordRing::View v = ring.view(off);
+    CHECK_EQ(v.len, strlen(items[i]));
+    CHECK(memcmp(v.data, items[i], v.len) == 0);
+    CHECK_EQ(v.kind, 7);
+    if (i == 1) ring.setFlags(off, 0x01);
+    i++;
+  }
+  CHECK_EQ(i, 4);
+  ring.pop();
+  CHECK_EQ(ring.front().flags, 0x01);
+}
+
+static void testFullRingIteratesEveryRecord() {
+  alignas(4) static uint8_t arena[64];
+  RecordRing ring(arena, sizeof(arena));
+  // 4 records of 12 bytes payload -> 16 bytes each fills 64 exactly.
+  for (int i = 0; i < 4; i++) CHECK(ring.push("0123456789ab", 12));
+  CHECK(!ring.push("x", 1));
+  CHECK_EQ(ring.bytesUsed(), 64);
+  size_t n = 0;
+  for (size_t off = ring.begin(); off != RecordRing::npos; off = ring.next(off)) n++;
+  CHECK_EQ(n, 4);
+  ring.pop();
+  CHECK(ring.push("abcdefgh", 8));
+  n = 0;
+  for (size_t off = ring.begin(); off != RecordRing::npos; off = ring.next(off)) n++;
+  CHECK_EQ(n, 4);
+}
+
+static void testWrapMarkerAndHighWater() {
+  alignas(4) static uint8_t arena[64];
+  RecordRing ring(arena, sizeof(arena));
+  CHECK(ring.push("aaaaaaaaaaaaaaaaaaaa", 20));  // 24 bytes at 0
+  CHECK(ring.push("bbbbbbbbbbbbbbbbbbbb", 20));  // 24 bytes at 24
+  ring.pop();
+  // 16 bytes left at the end; a 20-byte payload wraps to offset 0.
+  CHECK(ring.push("cccccccccccccccccccc", 20));
+  CHECK_EQ(ring.bytesUsed(), 64);
+  CHECK_EQ(ring.bytesHighWater(), 64);
+  CHECK(!ring.push("d", 1));
+  ring.pop();
+  CHECK_EQ(ring.front().data[0], 'c');
+  CHECK_EQ(ring.bytesUsed(), 24);
+  ring.pop();
+  CHECK(ring.empty());
+  CHECK_EQ(ring.bytesUsed(), 0);
+  CHECK(!ring.push("e", RecordRing::kMaxRecordBytes + 1));
+}
+
+static void testBatchReaderChunks() {
+  alignas(4) static uint8_t arena[128];
+  RecordRing ring(arena, sizeof(arena));
+  CHECK(ring.push("{\"a\":1}", 7));
+  CHECK(ring.push("{\"b\":22}", 8));
+  CHECK(ring.push("{\"c\":3}", 7));
+  for (size_t chunk = 1; chunk <= 32; chunk++) {
+    RecordBatchReader reader(ring, 2);
+    std::string out;
+    char buf[32];
+    size_t n;
+    while ((n = reader.read(buf, chunk)) > 0) out.append(buf, n);
+    CHECK_STR(out.c_str(), "[{\"a\":1},{\"b\":22}]");
+    CHECK_EQ(out.size(), RecordBatchReader(ring, 2).length());
+  }
+  RecordBatchReader tail(ring, 5, ring.next(ring.begin()));
+  char tailBuf[64];
+  size_t tailLen = tail.read(tailBuf, sizeof(tailBuf));
+  CHECK_EQ(tailLen, tail.length());
+  CHECK(std::string(tailBuf, tailLen) == "[{\"b\":22},{\"c\":3}]");
+  RecordBatchReader all(ring, 10);
+  char buf[64];
+  size_t n = all.read(buf, sizeof(buf));
+  CHECK_EQ(n, all.length());
+  CHECK_EQ(all.remaining(), 0);
+}
+
+static void testBatchReaderIgnoresLaterPushes() {
+  alignas(4) static uint8_t arena[64];
+  RecordRing ring(arena, sizeof(arena));
+  for (int i = 0; i < 4; i++) CHECK(ring.push("{\"d\":0}", 7));
+  for (int i = 0; i < 3; i++) ring.pop();
+  CHECK(ring.push("{\"e\":1}", 7));
+  CHECK(ring.push("{\"f\":2}", 7));  // wraps to offset 0
+  size_t e = ring.next(ring.begin());
+  CHECK_EQ(ring.after(ring.begin()), e);
+  CHECK_EQ(ring.after(e), 0);
+  RecordBatchReader reader(ring, 3);
+  char buf[64];
+  size_t n = reader.read(buf, 4);
+  // Records pushed behind the batch while it is read are not part of it.
+  CHECK(ring.push("{\"g\":3}", 7));
+  CHECK(ring.push("{\"h\":4}", 7));
+  while (size_t m = reader.read(buf + n, 5)) n += m;
+  CHECK(std::string(buf, n) == "[{\"d\":0},{\"e\":1},{\"f\":2}]");
+  CHECK_EQ(reader.remaining(), 0);
+}
+
+int main() {
+  printf("test_record_ring\n");
+  RUN_TEST(testFifoAcrossWraps);
+  RUN_TEST(testIterationAndFlags);
+  RUN_TEST(testFullRingIteratesEveryRecord);
+  RUN_TEST(testWrapMarkerAndHighWater);
+  RUN_TEST(testBatchReaderChunks);
+  RUN_TEST(testBatchReaderIgnoresLaterPushes);
+  TEST_MAIN_END();
+}
@@ -0,0 +1,219 @@
+#include <deque>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "host_test.h"
+#include "spill_log.h"
+
+class MemStorage : public SpillStorage {
+ public:
+  size_t list(uint32_t *ids, size_t max) override {
+    size_t n = 0;
+    for (auto &kv : segs) {
+      if (n < max) ids[n++] = kv.first;
+    }
+    return n;
+  }
+  bool append(uint32_t id, const uint8_t *data, size_t len) override {
+    if (failWrites) return false;
+    appendCalls++;
+    segs[id].insert(segs[id].end(), data, data + len);
+    return true;
+  }
+  size_t read(uint32_t id, size_t offset, uint8_t *out, size_t len) override {
+    auto it = segs.find(id);
+    if (it == segs.end() || offset >= it->second.size()) return 0;
+    size_t n = std::min(len, it->second.size() - offset);
+    memcpy(out, it->second.data() + offset, n);
+    return n;
+  }
+  size_t size(uint32_t id) override {
+    auto it = segs.find(id);
+    return it == segs.end() ? 0 : it->second.size();
+  }
+  bool remove(uint32_t id) override { return segs.erase(id) > 0; }
+
+  std::map<uint32_t, std::vector<uint8_t>> segs;
+  bool failWrites = false;
+  int appendCalls = 0;
+};
+
+static std::string record(uint32_t id) {
+  std::string s = "{\"seq\":" + std::to_string(id) + ",\"pad\":\"";
+  s.append(id % 97, 'x');
+  return s + "\"}";
+}
+
+static void testInOrderReplayAcrossSegments() {
+  MemStorage st;
+  uint8_t buf[512];
+  SpillLog log(st, buf, sizeof(buf), 2048, 256);
+  log.begin();
+  std::deque<std::string> model;
+  std::mt19937 rng(3);
+  uint32_t next = 0;
+  char out[1024];
+  for (int step = 0; step < 20000; step++) {
+    if (rng() % 100 < 55) {
+      std::string r = record(next++);
+      CHECK(log.append(r.data(), r.size(), 7));
+      model.push_back(r);
+    } else {
+      size_t len = 0;
+      uint8_t kind = 0;
+      bool got = log.peek(out, sizeof(out), len, kind);
+      CHECK_EQ(got, !model.empty());
+      if (got) {
+        CHECK(std::string(out, len) == model.front());
+        CHECK_EQ(kind, 7);
+        log.pop();
+        model.pop_front();
+      }
+    }
+  }
+  CHECK_EQ(log.stats().droppedSegments, 0);
+  CHECK(log.stats().appended == next);
+  CHECK_EQ(log.stats().crcErrors, 0);
+  CHECK(st.segs.size() <= log.segmentCount());
+  // Writes are batched through the RAM buffer.
+  CHECK(st.appendCalls < (int)next / 3);
+}
+
+static void testRotationDropsOldestSegment() {
+  MemStorage st;
+  uint8_t buf[256];
+  SpillLog log(st, buf, sizeof(buf), 1000, 3);
+  log.begin();
+  for (uint32_t i = 0; i < 200; i++) {
+    std::string r = record(i % 40);
+    CHECK(log.append(r.data(), r.size()));
+  }
+  log.flush();
+  CHECK(log.segmentCount() <= 3);
+  CHECK(st.segs.size() <= 3);
+  CHECK(log.stats().droppedSegments > 0);
+  // Whatever survives still replays in order.
+  char out[256];
+  size_t len;
+  uint8_t kind;
+  int replayed = 0;
+  while (log.peek(out, sizeof(out), len, kind)) {
+    log.pop();
+    replayed++;
+  }
+  CHECK(replayed > 0);
+  CHECK(log.empty());
+  CHECK_EQ(log.pendingBytes(), 0);
+  CHECK(st.segs.size() <= 1);
+}
+
+static void testRecoversAfterRebootAndTornTail() {
+  MemStorage st;
+  uint8_t buf[128];
+  {
+    SpillLog log(st, buf, sizeof(buf), 4096, 8);
+    log.begin();
+    for (uint32_t i = 0; i < 30; i++) {
+      std::string r = record(i);
+      log.append(r.data(), r.size());
+    }
+    log.flush();
+  }
+  // Power loss mid-append: the last record is cut short.
+  std::vector<uint8_t> &tail = st.segs.rbegin()->second;
+  tail.resize(tail.size() - 5);
+
+  SpillLog log(st, buf, sizeof(buf), 4096, 8);
+  log.begin();
+  CHECK(!log.empty());
+  std::string extra = record(1000);
+  CHECK(log.append(extra.data(), extra.size()));
+  char out[256];
+  size_t len;
+  uint8_t kind;
+  std::vector<std::string> got;
+  while (log.peek(out, sizeof(out), len, kind)) {
+    got.push_back(std::string(out, len));
+    log.pop();
+  }
+  CHECK_EQ(got.size(), 30);
+  for (uint32_t i = 0; i < 29 && i < got.size(); i++) CHECK(got[i] == record(i));
+  CHECK(got.back() == extra);
+  CHECK_EQ(log.stats().crcErrors, 1);
+}
+
+static void testCorruptByteSkipsRestOfSegment() {
+  MemStorage st;
+  uint8_t buf[64];
+  SpillLog log(st, buf, sizeof(buf), 300, 16);
+  log.begin();
+  for (uint32_t i = 0; i < 40; i++) {
+    std::string r = record(i % 5);
+    log.append(r.data(), r.size());
+  }
+  log.flush();
+  CHECK(st.segs.size() > 2);
+  st.segs.begin()->second[SpillLog::kHeaderBytes + 3] ^= 0x40;
+  char out[256];
+  size_t len;
+  uint8_t kind;
+  int n = 0;
+  while (log.peek(out, sizeof(out), len, kind)) {
+    log.pop();
+    n++;
+  }
+  CHECK(n > 0 && n < 40);
+  CHECK_EQ(log.stats().crcErrors, 1);
+  CHECK(log.empty());
+}
+
+static void testOversizedRecordIsSkipped() {
+  MemStorage st;
+  uint8_t buf[64];
+  SpillLog log(st, buf, sizeof(buf), 4096, 4);
+  log.begin();
+  std::string big = record(90);
+  std::string small = record(1);
+  CHECK(log.append(big.data(), big.size()));
+  CHECK(log.append(small.data(), small.size()));
+  char out[64];
+  size_t len;
+  uint8_t kind;
+  CHECK(log.peek(out, sizeof(out), len, kind));
+  CHECK(std::string(out, len) == small);
+  CHECK_EQ(log.stats().oversized, 1);
+  CHECK_EQ(log.stats().crcErrors, 0);
+}
+
+static void testWriteFailureIsCounted() {
+  MemStorage st;
+  uint8_t buf[64];
+  SpillLog log(st, buf, sizeof(buf), 4096, 4);
+  log.begin();
+  st.failWrites = true;
+  std::string r = record(60);
+  CHECK(!log.append(r.data(), r.size()));
+  CHECK(log.stats().writeErrors > 0);
+  CHECK(log.empty());
+  st.failWrites = false;
+  r = record(1);
+  CHECK(log.append(r.data(), r.size()));
+  char out[128];
+  size_t len;
+  uint8_t kind;
+  CHECK(log.peek(out, sizeof(out), len, kind));
+  CHECK(std::string(out, len) == r);
+}
+
+int main() {
+  printf("test_spill_log\n");
+  RUN_TEST(testInOrderReplayAcrossSegments);
+  RUN_TEST(testRotationDropsOldestSegment);
+  RUN_TEST(testRecoversAfterRebootAndTornTail);
+  RUN_TEST(testCorruptByteSkipsRestOfSegment);
+  RUN_TEST(testOversizedRecordIsSkipped);
+  RUN_TEST(testWriteFailureIsCounted);
+  TEST_MAIN_END();
+}
@@ -0,0 +1,99 @@
+#include <atomic>
+#include <thread>
+
+#include "host_test.h"
+#include "spsc_ring.h"
+
+struct Sample {
+  uint32_t seq;
+  uint32_t check;
+  uint8_t pad[24];
+};
+
+static uint32_t checkFor(uint32_t seq) { return seq * 2654435761u ^ 0xA5A5A5A5u; }
+
+static void testSingleThreadCounters() {
+  SpscRing<Sample, 4> ring;
+  Sample s = {};
+  for (uint32_t i = 0; i < 4; i++) {
+    s.seq = i;
+    CHECK(ring.push(s));
+  }
+  CHECK(!ring.push(s));
+  CHECK(!ring.push(s));
+  CHECK_EQ(ring.dropCount(), 2);
+  CHECK_EQ(ring.overrunCount(), 1);
+  CHECK_EQ(ring.highWater(), 4);
+
+  Sample out;
+  CHECK(ring.pop(out));
+  CHECK_EQ(out.seq, 0);
+  CHECK(ring.push(s));
+  CHECK(!ring.push(s));
+  CHECK_EQ(ring.overrunCount(), 2);
+  while (ring.pop(out)) {
+  }
+  CHECK_EQ(ring.size(), 0);
+  CHECK(!ring.pop(out));
+}
+
+// Producer and consumer on separate threads: every record that was accepted
+// must arrive once, intact and in order; everything else is counted as a drop.
+// The first half retries on full so both sides genuinely overlap; the second
+// half drops like the NimBLE callback does.
+static void testTwoThreadStress() {
+  static SpscRing<Sample, 64> ring;
+  const uint32_t total = 2000000;
+  std::atomic<bool> done{false};
+  uint32_t accepted = 0;
+
+  std::thread producer([&] {
+    Sample s = {};
+    for (uint32_t i = 0; i < total; i++) {
+      s.seq = i;
+      s.check = checkFor(i);
+      for (size_t b = 0; b < sizeof(s.pad); b++) s.pad[b] = (uint8_t)(i + b);
+      if (i < total / 2) {
+        while (!ring.push(s)) std::this_thread::yield();
+        accepted++;
+      } else if (ring.push(s)) {
+        accepted++;
+      }
+    }
+    done.store(true, std::memory_order_release);
+  });
+
+  uint32_t received = 0;
+  uint32_t corrupt = 0;
+  uint32_t reordered = 0;
+  int64_t lastSeq = -1;
+  Sample s;
+  for (;;) {
+    if (ring.pop(s)) {
+      received++;
+      if (s.check != checkFor(s.seq) || s.pad[23] != (uint8_t)(s.seq + 23)) corrupt++;
+      if ((int64_t)s.seq <= lastSeq) reordered++;
+      lastSeq = s.seq;
+    } else if (done.load(std::memory_order_acquire) && ring.size() == 0) {
+      break;
+    }
+  }
+  producer.join();
+
+  CHECK_EQ(corrupt, 0);
+  CHECK_EQ(reordered, 0);
+  CHECK_EQ(received, accepted);
+  CHECK(received >= total / 2);
+  CHECK(ring.dropCount() >= total - accepted);
+  CHECK(ring.highWater() <= 64);
+  CHECK(ring.dropCount() == 0 || ring.overrunCount() > 0);
+  printf("  received %u dropped %u overruns %u hwm %u\n", received, ring.dropCount(),
+         ring.overrunCount(), ring.highWater());
+}
+
+int main() {
+  printf("test_spsc_ring\n");
+  RUN_TEST(testSingleThreadCounters);
+  RUN_TEST(testTwoThreadStress);
+  TEST_MAIN_END();
+}
@@ -0,0 +1,71 @@
+#include <thread>
+
+#include "host_test.h"
+#include "stage_meter.h"
+
+static void testWindow() {
+  StageMeter m;
+  StageWindow w(1000000);
+  CHECK_EQ(m.core(), -1);
+  CHECK(!w.sample(m, 5000));  // opens the first window
+  m.add(100000, 40);
+  CHECK(!w.sample(m, 900000));
+  CHECK_EQ(w.busyPermille(), 0);
+  m.add(150000, 10);
+  CHECK(w.sample(m, 1005000));
+  CHECK_EQ(w.busyPermille(), 250);
+  CHECK_EQ(w.itemsPerSec(), 50);
+
+  // The next window starts where the last one closed.
+  m.add(50000, 0);
+  CHECK(w.sample(m, 2005000));
+  CHECK_EQ(w.busyPermille(), 50);
+  CHECK_EQ(w.peakPermille(), 250);
+  CHECK_EQ(w.itemsPerSec(), 0);
+
+  // A stretch longer than the window is capped at 100%.
+  m.add(3000000, 1);
+  CHECK(w.sample(m, 3005000));
+  CHECK_EQ(w.busyPermille(), 1000);
+  CHECK_EQ(w.peakPermille(), 1000);
+}
+
+static void testWrap() {
+  // Both the clock and the busy total wrap between readings.
+  StageMeter m;
+  m.add(0xFFFFFF00u, 0);
+  StageWindow w(1000);
+  w.sample(m, 0xFFFFFE00u);
+  m.add(0x300, 3);
+  CHECK(w.sample(m, 0x200));
+  CHECK_EQ(w.busyPermille(), 750);
+  CHECK_EQ(w.itemsPerSec(), 2929);
+}
+
+static void testConcurrentReader() {
+  StageMeter m;
+  std::thread writer([&] {
+    m.setCore(1);
+    for (int i = 0; i < 100000; i++) m.add(2, 1);
+  });
+  uint32_t last = 0;
+  bool ordered = true;
+  for (int i = 0; i < 100000; i++) {
+    uint32_t items = m.items();
+    if (items < last) ordered = false;
+    last = items;
+  }
+  writer.join();
+  CHECK(ordered);
+  CHECK_EQ(m.items(), 100000);
+  CHECK_EQ(m.busyUs(), 200000);
+  CHECK_EQ(m.core(), 1);
+}
+
+int main() {
+  printf("test_stage_meter\n");
+  RUN_TEST(testWindow);
+  RUN_TEST(testWrap);
+  RUN_TEST(testConcurrentReader);
+  TEST_MAIN_END();
+}
@@ -0,0 +1,129 @@
+#include <string.h>
+
+#include "host_test.h"
+#include "udp_telemetry.h"
+
+static const uint8_t kAddr[6] = {0xAA, 0xBB, 0xCC, 0x01, 0x02, 0x03};
+
+static void testRoundTrip() {
+  uint8_t buf[200];
+  UdpTelemetryPacker p(buf, sizeof(buf));
+  p.begin(7, "node-1");
+  CHECK_EQ(p.capacity(), (200 - kUdpHeaderFixedBytes - 6) / kUdpObservationBytes);
+  CHECK_EQ(p.finish(1000), 0);
+  CHECK(p.add(kAddr, 1, -70, 0x06, 1000));
+  CHECK(p.add(kAddr, 0, -41, 0x1A, 1030));
+  CHECK_EQ(p.oldestMs(), 1000);
+  size_t len = p.finish(1050);
+  CHECK_EQ(len, kUdpHeaderFixedBytes + 6 + 2 * kUdpObservationBytes);
+  CHECK_EQ(p.pending(), 0);
+
+  UdpTelemetryHeader h;
+  const uint8_t *records = nullptr;
+  CHECK(udpTelemetryParse(buf, len, h, records));
+  CHECK_EQ(h.count, 2);
+  CHECK_EQ(h.epoch, 7);
+  CHECK_EQ(h.seq, 1);
+  CHECK_EQ(h.firstObs, 0);
+  CHECK_EQ(h.sentMs, 1050);
+  CHECK_STR(h.node, "node-1");
+  UdpObservation o;
+  udpTelemetryObservation(records, 0, o);
+  CHECK(memcmp(o.addr, kAddr, 6) == 0);
+  CHECK_EQ(o.addrType, 1);
+  CHECK_EQ(o.rssi, -70);
+  CHECK_EQ(o.flags, 0x06);
+  CHECK_EQ(o.ageMs, 50);
+  udpTelemetryObservation(records, 1, o);
+  CHECK_EQ(o.rssi, -41);
+  CHECK_EQ(o.ageMs, 20);
+
+  // Truncated, padded or foreign datagrams are refused.
+  CHECK(!udpTelemetryParse(buf, len - 1, h, records));
+  CHECK(!udpTelemetryParse(buf, len + 1, h, records));
+  buf[0] = 'X';
+  CHECK(!udpTelemetryParse(buf, len, h, records));
+}
+
+static void testNumbering() {
+  uint8_t buf[kUdpHeaderFixedBytes + 1 + 3 * kUdpObservationBytes];
+  UdpTelemetryPacker p(buf, sizeof(buf));
+  p.begin(2, "n");
+  CHECK_EQ(p.capacity(), 3);
+  for (int i = 0; i < 3; i++) CHECK(p.add(kAddr, 0, -60, 0, 10));
+  CHECK(!p.add(kAddr, 0, -60, 0, 10));  // full
+  p.finish(20);
+  // Skipped and discarded observations keep their numbers.
+  p.skip();
+  CHECK(p.add(kAddr, 0, -60, 0, 30));
+  p.discard();
+  CHECK(p.add(kAddr, 0, -60, 0, 40));
+  size_t len = p.finish(40);
+  UdpTelemetryHeader h;
+  const uint8_t *records = nullptr;
+  CHECK(udpTelemetryParse(buf, len, h, records));
+  CHECK_EQ(h.seq, 2);
+  CHECK_EQ(h.firstObs, 5);
+  CHECK_EQ(h.count, 1);
+  CHECK_EQ(p.observations(), 6);
+
+  // Ages across a millis() wrap, and saturated when held too long.
+  p.add(kAddr, 0, -60, 0, 0xFFFFFFF0u);
+  len = p.finish(0x10);
+  CHECK(udpTelemetryParse(buf, len, h, records));
+  UdpObservation o;
+  udpTelemetryObservation(records, 0, o);
+  CHECK_EQ(o.ageMs, 0x20);
+  p.add(kAddr, 0, -60, 0, 0);
+  len = p.finish(100000);
+  CHECK(udpTelemetryParse(buf, len, h, records));
+  udpTelemetryObservation(records, 0, o);
+  CHECK_EQ(o.ageMs, 0xFFFF);
+
+  p.begin(3, "n");
+  p.add(kAddr, 0, -60, 0, 0);
+  len = p.finish(0);
+  CHECK(udpTelemetryParse(buf, len, h, records));
+  CHECK_EQ(h.epoch, 3);
+  CHECK_EQ(h.seq, 1);
+  CHECK_EQ(h.firstObs, 0);
+}
+
+static void testLongNodeId() {
+  uint8_t buf[128];
+  UdpTelemetryPacker p(buf, sizeof(buf));
+  p.begin(1, "a-node-id-that-is-longer-than-thirty-two-bytes");
+  p.add(kAddr, 0, -60, 0, 0);
+  size_t len = p.finish(0);
+  UdpTelemetryHeader h;
+  const uint8_t *records = nullptr;
+  CHECK(udpTelemetryParse(buf, len, h, records));
+  CHECK_EQ(strlen(h.node), kUdpNodeIdMax);
+}
+
+static void testParseCollector() {
+  char host[32];
+  uint16_t port = 0;
+  CHECK(parseUdpCollector("10.0.0.5:9000", host, sizeof(host), port));
+  CHECK_STR(host, "10.0.0.5");
+  CHECK_EQ(port, 9000);
+  CHECK(parseUdpCollector("collector.local", host, sizeof(host), port));
+  CHECK_STR(host, "collector.local");
+  CHECK_EQ(port, kUdpCollectorDefaultPort);
+  CHECK(!parseUdpCollector("", host, sizeof(host), port));
+  CHECK(!parseUdpCollector(":9000", host, sizeof(host), port));
+  CHECK(!parseUdpCollector("host:", host, sizeof(host), port));
+  CHECK(!parseUdpCollector("host:0", host, sizeof(host), port));
+  CHECK(!parseUdpCollector("host:70000", host, sizeof(host), port));
+  CHECK(!parseUdpCollector("udp://host:1", host, sizeof(host), port));
+  CHECK(!parseUdpCollector("a-host-name-far-too-long-for-the-buffer", host, sizeof(host), port));
+}
+
+int main() {
+  printf("test_udp_telemetry\n");
+  RUN_TEST(testRoundTrip);
+  RUN_TEST(testNumbering);
+  RUN_TEST(testLongNodeId);
+  RUN_TEST(testParseCollector);
+  TEST_MAIN_END();
+}
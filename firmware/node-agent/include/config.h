@@ -24,8 +24,72 @@
 #define EVENT_SCHEMA_VERSION 1
 #endif
 
-#ifndef EVENT_QUEUE_CAPACITY
-#define EVENT_QUEUE_CAPACITY 300
+#ifndef EVENT_QUEUE_BYTES
+#define EVENT_QUEUE_BYTES 32768
+#endif
+
+#ifndef EVENT_MAX_BYTES
+#define EVENT_MAX_BYTES 768
+#endif
+
+// Status responses are rendered through this buffer. Larger ones stream
+// through it with chunked transfer encoding, so peak memory does not
+// depend on the response size.
+#ifndef HTTP_RESPONSE_CHUNK_BYTES
+#define HTTP_RESPONSE_CHUNK_BYTES 1024
+#endif
+
+// The web server runs on its own task and checks for clients this often.
+#ifndef HTTP_TASK_POLL_MS
+#define HTTP_TASK_POLL_MS 2
+#endif
+
+#ifndef HTTP_TASK_STACK_BYTES
+#define HTTP_TASK_STACK_BYTES 6144
+#endif
+
+// Queued events whose enqueue time is tracked at once for the queue
+// residence histogram; events pushed while all are in use go unsampled.
+#ifndef QUEUE_RESIDENCE_SAMPLES
+#define QUEUE_RESIDENCE_SAMPLES 32
+#endif
+
+// The queue is split by event class: control (boot, ingest results) and
+// status (heartbeat, announce, Wi-Fi, probes) get a reserved share of
+// EVENT_QUEUE_BYTES, telemetry (BLE, AP sightings) the rest. The sender
+// drains higher classes first but never passes over a class with a backlog
+// more than EVENT_CLASS_MAX_SKIP batches in a row.
+#ifndef EVENT_CLASS_CONTROL_PCT
+#define EVENT_CLASS_CONTROL_PCT 10
+#endif
+
+#ifndef EVENT_CLASS_STATUS_PCT
+#define EVENT_CLASS_STATUS_PCT 15
+#endif
+
+#ifndef EVENT_CLASS_MAX_SKIP
+#define EVENT_CLASS_MAX_SKIP 4
+#endif
+
+// What a full class does with a new event: 0 spills it, and drops it when
+// the spill log cannot take it either; 1 evicts the oldest; 2 keeps one
+// arrival in EVENT_CLASS_SAMPLE_N (evicting the oldest) and drops the rest.
+// Evicted and sampled-out events are not spilled. Changeable at runtime
+// through POST /queue/policy.
+#ifndef EVENT_CLASS_CONTROL_DROP
+#define EVENT_CLASS_CONTROL_DROP 1
+#endif
+
+#ifndef EVENT_CLASS_STATUS_DROP
+#define EVENT_CLASS_STATUS_DROP 1
+#endif
+
+#ifndef EVENT_CLASS_TELEMETRY_DROP
+#define EVENT_CLASS_TELEMETRY_DROP 0
+#endif
+
+#ifndef EVENT_CLASS_SAMPLE_N
+#define EVENT_CLASS_SAMPLE_N 8
 #endif
 
 #ifndef INGEST_TIMEOUT_MS
@@ -36,6 +100,145 @@
 #define INGEST_BATCH_SIZE 1
 #endif
 
+// Adaptive batching: the batch grows from INGEST_BATCH_SIZE up to
+// INGEST_BATCH_MAX records while POSTs stay under INGEST_TARGET_LATENCY_MS.
+// With INGEST_ADAPTIVE_BATCH 0 every batch is INGEST_BATCH_SIZE records.
+#ifndef INGEST_ADAPTIVE_BATCH
+#define INGEST_ADAPTIVE_BATCH 1
+#endif
+
+#ifndef INGEST_BATCH_MAX
+#define INGEST_BATCH_MAX 64
+#endif
+
+#ifndef INGEST_MAX_BATCH_BYTES
+#define INGEST_MAX_BATCH_BYTES 8192
+#endif
+
+#ifndef INGEST_TARGET_LATENCY_MS
+#define INGEST_TARGET_LATENCY_MS 500
+#endif
+
+// gzip batches of at least INGEST_COMPRESS_MIN_BYTES (Content-Encoding: gzip).
+// Costs one INGEST_MAX_BATCH_BYTES buffer plus 8 KB of encoder state.
+#ifndef INGEST_COMPRESS
+#define INGEST_COMPRESS 0
+#endif
+
+#ifndef INGEST_COMPRESS_MIN_BYTES
+#define INGEST_COMPRESS_MIN_BYTES 512
+#endif
+
+// Send batches as CBOR (Content-Type: application/cbor, lib/node-core/
+// cbor_batch.h) instead of JSON. A 415 response switches back to JSON until
+// reboot. Costs one INGEST_MAX_BATCH_BYTES buffer.
+#ifndef INGEST_CBOR
+#define INGEST_CBOR 0
+#endif
+
+// Batches written on the keep-alive ingest connection before reading their
+// responses (HTTP/1.1 pipelining). 1 disables pipelining.
+#ifndef INGEST_PIPELINE_DEPTH
+#define INGEST_PIPELINE_DEPTH 1
+#endif
+
+// Idle keep-alive sockets older than this are reopened rather than reused;
+// keep it below the server's keep-alive timeout (Node defaults to 5 s).
+#ifndef INGEST_KEEPALIVE_IDLE_MS
+#define INGEST_KEEPALIVE_IDLE_MS 4000
+#endif
+
+// A batch refused for its content (400, 413, 422 and similar) is bisected to
+// find the records the server objects to. Each is moved to a quarantine of
+// QUARANTINE_SLOTS entries on /debug/quarantine, keeping its first
+// QUARANTINE_EVENT_BYTES. After QUARANTINE_MAX_RUN quarantines without an
+// accepted batch, refusals back off like server errors instead.
+#ifndef QUARANTINE_SLOTS
+#define QUARANTINE_SLOTS 8
+#endif
+
+#ifndef QUARANTINE_EVENT_BYTES
+#define QUARANTINE_EVENT_BYTES 384
+#endif
+
+#ifndef QUARANTINE_MAX_RUN
+#define QUARANTINE_MAX_RUN 8
+#endif
+
+// MQTT uplink, chosen instead of HTTP in the "uplink" NVS namespace (or by
+// UPLINK_MQTT at build time): batches go out as QoS 1 PUBLISHes to
+// <prefix>/<node_id>/<class> over one session to MQTT_URL, with up to
+// MQTT_INFLIGHT awaiting PUBACK. The broker is pinged after MQTT_KEEPALIVE_S / 2
+// idle seconds.
+#ifndef UPLINK_MQTT
+#define UPLINK_MQTT 0
+#endif
+
+#ifndef MQTT_URL
+#define MQTT_URL ""
+#endif
+
+#ifndef MQTT_INFLIGHT
+#define MQTT_INFLIGHT 4
+#endif
+
+#ifndef MQTT_KEEPALIVE_S
+#define MQTT_KEEPALIVE_S 30
+#endif
+
+// UDP telemetry: with a collector set (host[:port], in the "udp" NVS
+// namespace or UDP_COLLECTOR), BLE observations go out as datagrams of up to
+// UDP_MTU bytes, sent when full or once the oldest has waited UDP_FLUSH_MS.
+// They no longer become queued ble.seen events unless UDP_MIRROR_HTTP is set.
+#ifndef UDP_COLLECTOR
+#define UDP_COLLECTOR ""
+#endif
+
+#ifndef UDP_MTU
+#define UDP_MTU 1400
+#endif
+
+#ifndef UDP_FLUSH_MS
+#define UDP_FLUSH_MS 100
+#endif
+
+#ifndef UDP_MIRROR_HTTP
+#define UDP_MIRROR_HTTP 0
+#endif
+
+// Overflow spill log on LittleFS: events a full class keeps under its drop
+// policy (EVENT_CLASS_*_DROP) but cannot fit are appended to
+// SPILL_SEGMENT_BYTES segment files (at most SPILL_MAX_SEGMENTS, oldest
+// dropped first) and replayed at SPILL_REPLAY_PER_SEC once ingest is healthy
+// and the RAM queue is below SPILL_REPLAY_QUEUE_PCT full.
+#ifndef SPILL_ENABLE
+#define SPILL_ENABLE 1
+#endif
+
+#ifndef SPILL_SEGMENT_BYTES
+#define SPILL_SEGMENT_BYTES 16384
+#endif
+
+#ifndef SPILL_MAX_SEGMENTS
+#define SPILL_MAX_SEGMENTS 32
+#endif
+
+#ifndef SPILL_WRITE_BUFFER_BYTES
+#define SPILL_WRITE_BUFFER_BYTES 2048
+#endif
+
+#ifndef SPILL_FLUSH_MS
+#define SPILL_FLUSH_MS 2000
+#endif
+
+#ifndef SPILL_REPLAY_PER_SEC
+#define SPILL_REPLAY_PER_SEC 20
+#endif
+
+#ifndef SPILL_REPLAY_QUEUE_PCT
+#define SPILL_REPLAY_QUEUE_PCT 50
+#endif
+
 #ifndef WIFI_RESET_ON_BOOT
 #define WIFI_RESET_ON_BOOT 0
 #endif
@@ -85,13 +288,57 @@
 #endif
 
 #ifndef BLE_OBS_CAPACITY
-#define BLE_OBS_CAPACITY 128
+#define BLE_OBS_CAPACITY 256
 #endif
 
 #ifndef BLE_DEDUPE_MS
 #define BLE_DEDUPE_MS 5000
 #endif
 
+// Compute fp_stable/fp_addr (BLE_IDENTITY.md) on the node and key the
+// observation table by fp_stable.
+#ifndef BLE_FINGERPRINT
+#define BLE_FINGERPRINT 1
+#endif
+
+// Tag ble.seen, wifi.ap_seen and /ble/latest with a vendor_id from the OUI
+// index generated at build time (tools/oui_index.py). Building with
+// -D OUI_INDEX_NAMES=1 also embeds vendor names (~340 KB instead of ~140 KB).
+#ifndef OUI_INDEX_ENABLE
+#define OUI_INDEX_ENABLE 1
+#endif
+
+// 0 = one ble.seen event per admitted advert, 1 = periodic ble.digest.
+// Overridable at runtime with POST /ble/mode.
+#ifndef BLE_DIGEST_MODE
+#define BLE_DIGEST_MODE 0
+#endif
+
+#ifndef BLE_DIGEST_WINDOW_MS
+#define BLE_DIGEST_WINDOW_MS 30000
+#endif
+
+#ifndef BLE_DIGEST_EVENT_BYTES
+#define BLE_DIGEST_EVENT_BYTES 2048
+#endif
+
+// In raw mode, a ble.seen for a device whose previous ble.seen is still
+// queued and unsent overwrites that event (latest RSSI and time, RSSI range,
+// "count") instead of taking more queue space. BLE_COALESCE_SLOTS devices
+// are tracked; each event is queued with BLE_COALESCE_SLACK_BYTES of padding
+// so it has room to grow when rewritten.
+#ifndef BLE_COALESCE
+#define BLE_COALESCE 1
+#endif
+
+#ifndef BLE_COALESCE_SLOTS
+#define BLE_COALESCE_SLOTS 128
+#endif
+
+#ifndef BLE_COALESCE_SLACK_BYTES
+#define BLE_COALESCE_SLACK_BYTES 8
+#endif
+
 #ifndef BLE_SCAN_INTERVAL_MS
 #define BLE_SCAN_INTERVAL_MS 45
 #endif
@@ -108,10 +355,89 @@
 #define BLE_MAX_PER_SECOND 10
 #endif
 
+#ifndef BLE_GLOBAL_BURST
+#define BLE_GLOBAL_BURST BLE_MAX_PER_SECOND
+#endif
+
+#ifndef BLE_DEVICE_INTERVAL_MS
+#define BLE_DEVICE_INTERVAL_MS 2000
+#endif
+
+#ifndef BLE_DEVICE_BURST
+#define BLE_DEVICE_BURST 2
+#endif
+
+#ifndef BLE_NEW_DEVICE_RESERVE_PCT
+#define BLE_NEW_DEVICE_RESERVE_PCT 30
+#endif
+
+#ifndef BLE_ACTIVE_WINDOW_MS
+#define BLE_ACTIVE_WINDOW_MS 10000
+#endif
+
+// Raw adverts buffered between the NimBLE callback and loop(); power of two.
+#ifndef BLE_RAW_RING_SIZE
+#define BLE_RAW_RING_SIZE 64
+#endif
+
+#ifndef BLE_DRAIN_PER_LOOP
+#define BLE_DRAIN_PER_LOOP 32
+#endif
+
 #ifndef PROBE_HTTP_TIMEOUT_MS
 #define PROBE_HTTP_TIMEOUT_MS 1500
 #endif
 
-#ifndef EVENT_VALIDATE_JSON
-#define EVENT_VALIDATE_JSON 1
+// Probes run as jobs on their own task; results of the last PROBE_JOB_SLOTS
+// jobs are kept for /probe/result.
+#ifndef PROBE_JOB_SLOTS
+#define PROBE_JOB_SLOTS 4
+#endif
+
+#ifndef PROBE_TASK_STACK_BYTES
+#define PROBE_TASK_STACK_BYTES 6144
+#endif
+
+// Pipeline: radio capture (the NimBLE host task) feeds the raw advert ring,
+// the worker (loop()) turns adverts and status into queued events, and the
+// network stage sends them to ingest. With PIPELINE_NET_TASK 1 the network
+// stage has its own task on PIPELINE_NET_CORE; single-core chips run it from
+// loop() after each worker pass.
+#ifndef PIPELINE_NET_TASK
+#ifdef CONFIG_FREERTOS_UNICORE
+#define PIPELINE_NET_TASK 0
+#else
+#define PIPELINE_NET_TASK 1
+#endif
+#endif
+
+// The protocol core, next to the Wi-Fi driver and lwIP.
+#ifndef PIPELINE_NET_CORE
+#define PIPELINE_NET_CORE 0
+#endif
+
+#ifndef PIPELINE_NET_STACK_BYTES
+#define PIPELINE_NET_STACK_BYTES 8192
+#endif
+
+// The worker wakes the network stage when events are waiting; it also
+// checks on its own this often.
+#ifndef PIPELINE_NET_IDLE_MS
+#define PIPELINE_NET_IDLE_MS 100
+#endif
+
+// Stage utilization on /metrics is the busy share of the last window.
+#ifndef PIPELINE_STATS_WINDOW_MS
+#define PIPELINE_STATS_WINDOW_MS 10000
+#endif
+
+// Per-stage loop timing from the CPU cycle counter, served on
+// /debug/profile. 0 compiles the profiler and the endpoint out entirely.
+#ifndef LOOP_PROFILE_ENABLE
+#define LOOP_PROFILE_ENABLE 0
+#endif
+
+// A loop pass longer than this counts as over budget.
+#ifndef LOOP_PROFILE_BUDGET_US
+#define LOOP_PROFILE_BUDGET_US 10000
 #endif
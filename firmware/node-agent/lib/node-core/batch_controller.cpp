@@ -0,0 +1,45 @@
+#include "batch_controller.h"
+
+#include "record_ring.h"
+
+BatchController::BatchController(size_t minCount, size_t maxCount, size_t maxBytes,
+                                 uint32_t targetMs)
+    : minCount_(minCount > 0 ? minCount : 1),
+      maxCount_(maxCount > minCount_ ? maxCount : minCount_),
+      maxBytes_(maxBytes),
+      targetMs_(targetMs),
+      limit_(minCount_) {}
+
+BatchController::Plan BatchController::plan(const RecordRing &queue) const {
+  return plan(queue, queue.begin());
+}
+
+BatchController::Plan BatchController::plan(const RecordRing &queue, size_t first,
+                                            size_t maxCount) const {
+  Plan p = {0, 2, first, first};
+  if (maxCount == 0) maxCount = 1;
+  while (p.next != RecordRing::npos && p.count < limit_ && p.count < maxCount) {
+    size_t add = queue.view(p.next).len + (p.count > 0 ? 1 : 0);
+    if (p.count > 0 && p.bytes + add > maxBytes_) break;
+    p.bytes += add;
+    p.count++;
+    p.next = queue.next(p.next);
+  }
+  if (p.count == 0) p.bytes = 0;
+  return p;
+}
+
+void BatchController::onSuccess(size_t count, uint32_t ms, size_t backlog) {
+  avgMs8_ = avgMs8_ == 0 ? ms * 8 : avgMs8_ - avgMs8_ / 8 + ms;
+  if (ms > targetMs_) {
+    limit_ = limit_ / 2 > minCount_ ? limit_ / 2 : minCount_;
+    return;
+  }
+  // Only grow when the limit was what held the batch back and more is waiting.
+  if (count >= limit_ && backlog > 0 && limit_ < maxCount_) {
+    size_t step = limit_ / 2 > 0 ? limit_ / 2 : 1;
+    limit_ = limit_ + step < maxCount_ ? limit_ + step : maxCount_;
+  }
+}
+
+void BatchController::onFailure() { limit_ = limit_ / 2 > minCount_ ? limit_ / 2 : minCount_; }
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+class RecordRing;
+
+// Sizes ingest batches from observed POST latency and queue depth. The record
+// limit grows by half while POSTs stay under the latency target and a backlog
+// remains, and halves on slow or failed POSTs. Batches are also capped by
+// their serialized size in bytes.
+class BatchController {
+ public:
+  struct Plan {
+    size_t count;
+    size_t bytes;  // serialized "[a,b,...]" size
+    size_t first;  // offset of the first record
+    size_t next;   // offset of the record after the batch, or RecordRing::npos
+  };
+
+  BatchController(size_t minCount, size_t maxCount, size_t maxBytes, uint32_t targetMs);
+
+  // Largest run of records starting at the front (or at offset `first`)
+  // within the current limits and `maxCount`; at least one record when any
+  // are available.
+  Plan plan(const RecordRing &queue) const;
+  Plan plan(const RecordRing &queue, size_t first, size_t maxCount = (size_t)-1) const;
+
+  void onSuccess(size_t count, uint32_t ms, size_t backlog);
+  void onFailure();
+
+  size_t limit() const { return limit_; }
+  size_t maxBytes() const { return maxBytes_; }
+  // Exponentially weighted POST latency (1/8 weight per sample).
+  uint32_t avgLatencyMs() const { return avgMs8_ / 8; }
+
+ private:
+  size_t minCount_;
+  size_t maxCount_;
+  size_t maxBytes_;
+  uint32_t targetMs_;
+  size_t limit_;
+  uint32_t avgMs8_ = 0;
+};
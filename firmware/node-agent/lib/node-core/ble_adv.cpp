@@ -0,0 +1,69 @@
+#include "ble_adv.h"
+
+namespace {
+
+const uint8_t kAdFlags = 0x01;
+const uint8_t kAdUuid16Incomplete = 0x02;
+const uint8_t kAdUuid16Complete = 0x03;
+const uint8_t kAdUuid32Incomplete = 0x04;
+const uint8_t kAdUuid32Complete = 0x05;
+const uint8_t kAdUuid128Incomplete = 0x06;
+const uint8_t kAdUuid128Complete = 0x07;
+const uint8_t kAdNameShort = 0x08;
+const uint8_t kAdNameComplete = 0x09;
+const uint8_t kAdManufacturer = 0xFF;
+
+}  // namespace
+
+void bleParseAdv(const uint8_t *payload, size_t len, BleAdvSummary &out) {
+  out = BleAdvSummary();
+  const char *shortName = nullptr;
+  uint8_t shortLen = 0;
+  size_t i = 0;
+  while (i < len) {
+    uint8_t fieldLen = payload[i];
+    if (fieldLen == 0 || i + 1 + fieldLen > len) break;
+    uint8_t type = payload[i + 1];
+    const uint8_t *data = payload + i + 2;
+    uint8_t dataLen = fieldLen - 1;
+    switch (type) {
+      case kAdFlags:
+        if (dataLen > 0) out.flags = data[0];
+        break;
+      case kAdUuid16Incomplete:
+      case kAdUuid16Complete:
+        out.svc_count += dataLen / 2;
+        break;
+      case kAdUuid32Incomplete:
+      case kAdUuid32Complete:
+        out.svc_count += dataLen / 4;
+        break;
+      case kAdUuid128Incomplete:
+      case kAdUuid128Complete:
+        out.svc_count += dataLen / 16;
+        break;
+      case kAdNameComplete:
+        out.name = reinterpret_cast<const char *>(data);
+        out.name_len = dataLen;
+        break;
+      case kAdNameShort:
+        shortName = reinterpret_cast<const char *>(data);
+        shortLen = dataLen;
+        break;
+      case kAdManufacturer:
+        // NimBLE's getManufacturerData() returns the first one.
+        if (!out.mfg) {
+          out.mfg = data;
+          out.mfg_len = dataLen;
+        }
+        break;
+      default:
+        break;
+    }
+    i += 1 + fieldLen;
+  }
+  if (!out.name && shortName) {
+    out.name = shortName;
+    out.name_len = shortLen;
+  }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Legacy advertising data plus scan response.
+static const size_t kBleRawPayloadMax = 62;
+
+// Fixed-size record copied out of the NimBLE scan callback. Everything else
+// (parsing, dedupe, serialization) happens on the consumer side.
+struct BleRawObservation {
+  uint32_t ts_ms;
+  uint8_t addr[6];  // most significant byte first, as printed
+  uint8_t addr_type;
+  int8_t rssi;
+  uint8_t payload_len;
+  uint8_t payload[kBleRawPayloadMax];
+};
+
+// Fields the node reports from an advertisement, parsed from the raw AD
+// structures with the same rules NimBLE's accessors use.
+struct BleAdvSummary {
+  uint8_t flags = 0;
+  uint8_t svc_count = 0;
+  uint8_t mfg_len = 0;
+  uint8_t name_len = 0;
+  const char *name = nullptr;  // points into the payload; not NUL-terminated
+  const uint8_t *mfg = nullptr;  // first manufacturer data field, company ID first
+};
+
+void bleParseAdv(const uint8_t *payload, size_t len, BleAdvSummary &out);
+
+// Longest name kept per device: a 31-byte AD block minus its length and type.
+static const size_t kBleNameMax = 29;
+
+// Per-device statistics for the current ble.digest window (ble_digest.h).
+struct BleDigestWindow {
+  uint32_t first_ms;
+  int32_t rssi_sum;
+  uint16_t count;
+  int8_t rssi_min;
+  int8_t rssi_max;
+  uint8_t flag_changes;
+  uint8_t svc_changes;
+};
+
+// One row of the device observation table. Fixed size, so the table needs
+// no heap and a lookup never touches more than one slot.
+struct BleDeviceEntry {
+  uint8_t addr[6];
+  uint8_t addr_type;
+  int8_t rssi;
+  uint8_t mfg_len;
+  uint8_t svc_count;
+  uint8_t adv_flags;
+  uint8_t name_len;
+  uint8_t tokens;  // BleSampler per-device bucket
+  uint8_t has_fp;  // keyed by fp_stable rather than by address
+  char name[kBleNameMax];
+  uint16_t epoch;  // BleSampler activity window the device was last counted in
+  uint32_t last_seen_ms;
+  uint32_t seen_count;
+  uint32_t token_ms;  // time the bucket was last refilled
+  uint32_t admitted;
+  uint32_t suppressed;
+  BleDigestWindow win;
+  uint8_t fp_stable[32];
+};
+
+// Packs a 6-byte address and its type into one table key.
+inline uint64_t bleAddrKey(const uint8_t addr[6], uint8_t addrType) {
+  uint64_t key = addrType;
+  for (int i = 0; i < 6; i++) key = (key << 8) | addr[i];
+  return key;
+}
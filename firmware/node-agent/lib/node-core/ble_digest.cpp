@@ -0,0 +1,56 @@
+#include "ble_digest.h"
+
+#include "json_writer.h"
+#include "sha256.h"
+
+void bleDigestObserve(BleDeviceEntry &dev, int8_t rssi, uint8_t flags, uint8_t svcCount,
+                      uint32_t nowMs) {
+  BleDigestWindow &win = dev.win;
+  if (win.count == 0) {
+    win.first_ms = nowMs;
+    win.rssi_min = rssi;
+    win.rssi_max = rssi;
+  } else {
+    if (rssi < win.rssi_min) win.rssi_min = rssi;
+    if (rssi > win.rssi_max) win.rssi_max = rssi;
+    if (flags != dev.adv_flags && win.flag_changes < 0xFF) win.flag_changes++;
+    if (svcCount != dev.svc_count && win.svc_changes < 0xFF) win.svc_changes++;
+  }
+  // Saturate rather than wrap; the mean stays exact up to the cap.
+  if (win.count < 0xFFFF) {
+    win.count++;
+    win.rssi_sum += rssi;
+  }
+}
+
+void bleDigestWriteDevice(JsonWriter &w, const BleDeviceEntry &dev, uint32_t windowStartMs) {
+  const BleDigestWindow &win = dev.win;
+  char addr[18];
+  size_t addrLen = formatMac(addr, dev.addr, false);
+  w.beginObject();
+  w.fieldStr("addr", addr, addrLen);
+  w.fieldUInt("addr_type", dev.addr_type);
+  w.fieldUInt("n", win.count);
+  w.key("rssi");
+  w.beginArray();
+  w.writeInt(win.rssi_min);
+  // Round half away from zero; RSSI is negative.
+  int32_t sum = win.rssi_sum;
+  int32_t n = win.count > 0 ? win.count : 1;
+  w.writeInt(sum < 0 ? (sum - n / 2) / n : (sum + n / 2) / n);
+  w.writeInt(win.rssi_max);
+  w.endArray();
+  w.fieldUInt("first", win.first_ms - windowStartMs);
+  w.fieldUInt("last", dev.last_seen_ms - windowStartMs);
+  w.fieldUInt("flags", dev.adv_flags);
+  w.fieldUInt("svc", dev.svc_count);
+  if (win.flag_changes > 0) w.fieldUInt("flag_changes", win.flag_changes);
+  if (win.svc_changes > 0) w.fieldUInt("svc_changes", win.svc_changes);
+  if (dev.name_len > 0) w.fieldStr("name", dev.name, dev.name_len);
+  if (dev.has_fp) {
+    char fp[65];
+    sha256Hex(dev.fp_stable, fp);
+    w.fieldStr("fp_stable", fp, 64);
+  }
+  w.endObject();
+}
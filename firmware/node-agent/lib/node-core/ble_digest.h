@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ble_adv.h"
+
+class JsonWriter;
+
+// Digest mode: instead of one ble.seen event per advert, each device
+// accumulates statistics over a window and the whole window is reported as
+// one compact array of per-device entries.
+
+// Folds one advert into `dev.win`. Call before the table entry's flags and
+// service count are overwritten so changes can be detected.
+void bleDigestObserve(BleDeviceEntry &dev, int8_t rssi, uint8_t flags, uint8_t svcCount,
+                      uint32_t nowMs);
+
+// Writes one device as an object:
+//   {"addr":"..","addr_type":1,"n":12,"rssi":[min,avg,max],"first":ms,"last":ms,
+//    "flags":6,"svc":1[,"flag_changes":n][,"svc_changes":n][,"name":".."]
+//    [,"fp_stable":"<64 hex>"]}
+// `first`/`last` are offsets from `windowStartMs`; the optional fields are only
+// written when non-zero or non-empty.
+void bleDigestWriteDevice(JsonWriter &w, const BleDeviceEntry &dev, uint32_t windowStartMs);
+
+inline bool bleDigestPending(const BleDeviceEntry &dev) { return dev.win.count > 0; }
+inline void bleDigestReset(BleDeviceEntry &dev) { dev.win = BleDigestWindow(); }
@@ -0,0 +1,183 @@
+#include "ble_fingerprint.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "json_writer.h"
+
+namespace {
+
+const uint8_t kAdUuid16Incomplete = 0x02;
+const uint8_t kAdUuid128Complete = 0x07;
+
+struct MaskRule {
+  uint16_t company;
+  uint8_t keep;  // leading bytes kept; identity-core masks are all prefixes
+};
+
+// identity-core MFG_MASK_RULES.
+const MaskRule kMaskRules[] = {
+    {0x004C, 6},  // Apple
+    {0x0006, 4},  // Microsoft
+};
+
+const char kHex[] = "0123456789abcdef";
+
+// JavaScript's \s over ASCII.
+bool isSpace(char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+
+bool isHex(char c) { return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'); }
+
+bool allHex(const char *s, size_t from, size_t to) {
+  for (size_t i = from; i < to; i++) {
+    if (!isHex(s[i])) return false;
+  }
+  return true;
+}
+
+// Whether /(?:[_-]?[a-f0-9]{4,}|\s+[a-f0-9]{4,}|\s*\(\d+\))$/ matches s[at..n).
+bool suffixAt(const char *s, size_t at, size_t n) {
+  if (n - at >= 4 && allHex(s, at, n)) return true;
+  if ((s[at] == '_' || s[at] == '-') && n - at - 1 >= 4 && allHex(s, at + 1, n)) return true;
+  size_t j = at;
+  while (j < n && isSpace(s[j])) j++;
+  if (j > at && n - j >= 4 && allHex(s, j, n)) return true;
+  if (j + 3 <= n && s[j] == '(' && s[n - 1] == ')') {
+    for (size_t k = j + 1; k < n - 1; k++) {
+      if (s[k] < '0' || s[k] > '9') return false;
+    }
+    return true;
+  }
+  return false;
+}
+
+size_t formatUuid(const uint8_t *le, size_t bytes, char *out) {
+  size_t n = 0;
+  for (size_t i = 0; i < bytes; i++) {
+    uint8_t b = le[bytes - 1 - i];
+    if (bytes == 16 && (i == 4 || i == 6 || i == 8 || i == 10)) out[n++] = '-';
+    out[n++] = kHex[b >> 4];
+    out[n++] = kHex[b & 0x0F];
+  }
+  out[n] = '\0';
+  return n;
+}
+
+}  // namespace
+
+size_t bleNormalizeName(const char *name, size_t len, char *out) {
+  size_t begin = 0;
+  size_t end = len;
+  while (begin < end && isSpace(name[begin])) begin++;
+  while (end > begin && isSpace(name[end - 1])) end--;
+  size_t n = 0;
+  for (size_t i = begin; i < end; i++) {
+    char c = name[i];
+    if (isSpace(c)) {
+      if (n > 0 && out[n - 1] == ' ') continue;
+      c = ' ';
+    } else if (c >= 'A' && c <= 'Z') {
+      c = (char)(c + 32);
+    }
+    out[n++] = c;
+  }
+  // The regex takes the leftmost start that reaches the end of the string.
+  for (size_t i = 0; i < n; i++) {
+    if (suffixAt(out, i, n)) {
+      n = i;
+      break;
+    }
+  }
+  while (n > 0 && out[n - 1] == ' ') n--;
+  return n;
+}
+
+void bleMaskManufacturer(const uint8_t *mfg, size_t len, uint8_t *out) {
+  size_t keep = 4;
+  if (len >= 2) {
+    uint16_t company = (uint16_t)(mfg[0] | (mfg[1] << 8));
+    for (const MaskRule &rule : kMaskRules) {
+      if (rule.company == company) keep = rule.keep;
+    }
+  }
+  for (size_t i = 0; i < len; i++) out[i] = i < keep ? mfg[i] : 0;
+}
+
+bool bleStableFingerprint(const uint8_t *payload, size_t len, const BleAdvSummary &adv,
+                          uint8_t out[Sha256::kDigestBytes]) {
+  char services[kBleFpMaxServices][37];
+  size_t svcCount = 0;
+  size_t i = 0;
+  while (i < len) {
+    uint8_t fieldLen = payload[i];
+    if (fieldLen == 0 || i + 1 + fieldLen > len) break;
+    uint8_t type = payload[i + 1];
+    if (type >= kAdUuid16Incomplete && type <= kAdUuid128Complete) {
+      size_t width = type <= 0x03 ? 2 : type <= 0x05 ? 4 : 16;
+      const uint8_t *data = payload + i + 2;
+      for (size_t off = 0; off + width <= (size_t)(fieldLen - 1); off += width) {
+        char uuid[37];
+        formatUuid(data + off, width, uuid);
+        // Insertion sort with dedupe; lists are a handful of entries.
+        size_t at = 0;
+        while (at < svcCount && strcmp(services[at], uuid) < 0) at++;
+        if (at < svcCount && strcmp(services[at], uuid) == 0) continue;
+        if (svcCount == kBleFpMaxServices) continue;
+        memmove(services[at + 1], services[at], (svcCount - at) * sizeof(services[0]));
+        memcpy(services[at], uuid, sizeof(uuid));
+        svcCount++;
+      }
+    }
+    i += 1 + fieldLen;
+  }
+
+  char name[kBleRawPayloadMax];
+  size_t nameLen = adv.name_len > 0 ? bleNormalizeName(adv.name, adv.name_len, name) : 0;
+  bool hasCompany = adv.mfg && adv.mfg_len >= 2;
+  if (svcCount == 0 && adv.mfg_len == 0 && nameLen == 0) return false;
+
+  Sha256 sha;
+  for (size_t s = 0; s < svcCount; s++) {
+    if (s > 0) sha.update(",", 1);
+    sha.update(services[s]);
+  }
+  sha.update("|", 1);
+  if (hasCompany) {
+    char company[6];
+    int n = snprintf(company, sizeof(company), "%u", (unsigned)(adv.mfg[0] | (adv.mfg[1] << 8)));
+    sha.update(company, (size_t)n);
+  }
+  sha.update("|", 1);
+  if (adv.mfg_len > 0) {
+    uint8_t masked[kBleRawPayloadMax];
+    bleMaskManufacturer(adv.mfg, adv.mfg_len, masked);
+    char hex[2];
+    for (size_t b = 0; b < adv.mfg_len; b++) {
+      hex[0] = kHex[masked[b] >> 4];
+      hex[1] = kHex[masked[b] & 0x0F];
+      sha.update(hex, 2);
+    }
+  }
+  sha.update("|", 1);
+  sha.update(name, nameLen);
+  sha.finish(out);
+  return true;
+}
+
+const char *bleAddrTypeName(uint8_t addrType) {
+  switch (addrType) {
+    case 0: return "public";
+    case 1: return "random";
+    default: return "unknown";
+  }
+}
+
+void bleAddrFingerprint(const uint8_t addr[6], uint8_t addrType, uint8_t out[Sha256::kDigestBytes]) {
+  char mac[18];
+  formatMac(mac, addr, false);
+  Sha256 sha;
+  sha.update(mac, 17);
+  sha.update("/", 1);
+  sha.update(bleAddrTypeName(addrType));
+  sha.finish(out);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ble_adv.h"
+#include "sha256.h"
+
+// On-device BLE fingerprints, computed exactly as the control plane's
+// identity-core computeFingerprints() (see BLE_IDENTITY.md) so the node's
+// values can be matched without shipping raw payloads:
+//
+//   fp_stable = sha256(services.join(",") | company | masked_mfg_hex | name_norm)
+//   fp_addr   = sha256("aa:bb:cc:dd:ee:ff/random")
+//
+// Services are the advertised UUID lists: 16- and 32-bit UUIDs as 4 and 8 hex
+// digits, 128-bit UUIDs in canonical dashed form, all lowercase, deduplicated
+// and sorted. Names are normalized for ASCII only; identity-core lowercases
+// and trims non-ASCII characters too, so such names may hash differently.
+
+static const size_t kBleFpMaxServices = 16;
+
+// identity-core normalizeName(): trim, lowercase, collapse whitespace and
+// strip a trailing hex/counter suffix ("Sensor-0A1B" -> "sensor",
+// "Apple Watch (3)" -> "apple watch"). `out` needs `len` bytes; returns the
+// normalized length.
+size_t bleNormalizeName(const char *name, size_t len, char *out);
+
+// identity-core maskManufacturer(): keeps the bytes a vendor rule marks as
+// stable (first 4 by default) and zeroes the rest. `mfg` starts with the
+// little-endian company ID; `out` needs `len` bytes.
+void bleMaskManufacturer(const uint8_t *mfg, size_t len, uint8_t *out);
+
+// fp_stable for an advert. Returns false (and leaves `out` alone) when the
+// advert has no services, manufacturer data or name to fingerprint.
+bool bleStableFingerprint(const uint8_t *payload, size_t len, const BleAdvSummary &adv,
+                          uint8_t out[Sha256::kDigestBytes]);
+
+void bleAddrFingerprint(const uint8_t addr[6], uint8_t addrType, uint8_t out[Sha256::kDigestBytes]);
+
+// "public", "random" or "unknown", as reported in events.
+const char *bleAddrTypeName(uint8_t addrType);
+
+// Observation table key for a stable fingerprint. The top bit keeps it apart
+// from bleAddrKey() keys, which use at most 56 bits.
+inline uint64_t bleFingerprintKey(const uint8_t fp[Sha256::kDigestBytes]) {
+  uint64_t key = 0;
+  for (int i = 0; i < 8; i++) key = (key << 8) | fp[i];
+  return key | (1ULL << 63);
+}
@@ -0,0 +1,26 @@
+#include "ble_query.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+size_t bleFormatCursor(char out[kBleCursorMax], uint32_t ms, uint64_t key) {
+  int n = snprintf(out, kBleCursorMax, "%lu.%llx", (unsigned long)ms, (unsigned long long)key);
+  return n < 0 ? 0 : (size_t)n;
+}
+
+bool bleParseCursor(const char *s, uint32_t &ms, uint64_t &key) {
+  if (!s || *s < '0' || *s > '9') return false;
+  char *end = nullptr;
+  unsigned long long msValue = strtoull(s, &end, 10);
+  if (*end != '.' || msValue > 0xFFFFFFFFULL) return false;
+  const char *hex = end + 1;
+  if (!((*hex >= '0' && *hex <= '9') || (*hex >= 'a' && *hex <= 'f') ||
+        (*hex >= 'A' && *hex <= 'F'))) {
+    return false;
+  }
+  unsigned long long keyValue = strtoull(hex, &end, 16);
+  if (*end != '\0' || end - hex > 16) return false;
+  ms = (uint32_t)msValue;
+  key = keyValue;
+  return true;
+}
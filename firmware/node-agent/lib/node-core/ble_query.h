@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ble_adv.h"
+
+// Filters and paging for /ble/latest. The observation table is visited most
+// recently seen first, which is also last_seen_ms order, so `since_ms` stops
+// the walk at the first older entry. A cursor names the last entry of a page
+// by (last_seen_ms, table key); the next page resumes after it even when
+// newer adverts moved other devices to the front in between (those are
+// picked up by the next `since_ms` poll instead).
+struct BleLatestQuery {
+  uint16_t limit = 50;
+  bool hasSince = false;
+  uint32_t sinceMs = 0;  // only devices seen after this
+  int16_t minRssi = -128;
+  bool hasCursor = false;
+  uint32_t cursorMs = 0;
+  uint64_t cursorKey = 0;
+};
+
+// "<last_seen_ms>.<key as hex>", NUL-terminated.
+constexpr size_t kBleCursorMax = 28;
+size_t bleFormatCursor(char out[kBleCursorMax], uint32_t ms, uint64_t key);
+bool bleParseCursor(const char *s, uint32_t &ms, uint64_t &key);
+
+// Wrap-safe "a is later than b" for millis() timestamps.
+inline bool bleMsAfter(uint32_t a, uint32_t b) { return (int32_t)(a - b) > 0; }
+
+// Calls emit(key, entry) for up to q.limit matching entries. Returns true
+// when more matching entries remain, with the cursor for the next page in
+// nextMs/nextKey.
+template <typename Table, typename Emit>
+bool bleQueryLatest(const Table &table, const BleLatestQuery &q, Emit &&emit, uint32_t &nextMs,
+                    uint64_t &nextKey) {
+  bool resumed = !q.hasCursor;
+  uint16_t emitted = 0;
+  for (auto h = table.front(); h != table.npos; h = table.next(h)) {
+    const BleDeviceEntry &e = table.at(h);
+    uint64_t key = table.key(h);
+    if (q.hasSince && !bleMsAfter(e.last_seen_ms, q.sinceMs)) break;
+    if (!resumed) {
+      // Skip what the previous pages covered: everything newer than the
+      // cursor, and entries sharing its timestamp up to the cursor itself.
+      if (bleMsAfter(e.last_seen_ms, q.cursorMs)) continue;
+      if (e.last_seen_ms == q.cursorMs) {
+        if (key == q.cursorKey) resumed = true;
+        continue;
+      }
+      resumed = true;
+    }
+    if (e.rssi < q.minRssi) continue;
+    if (emitted == q.limit) return true;
+    emit(key, e);
+    emitted++;
+    nextMs = e.last_seen_ms;
+    nextKey = key;
+  }
+  return false;
+}
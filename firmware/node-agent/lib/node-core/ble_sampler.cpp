@@ -0,0 +1,95 @@
+#include "ble_sampler.h"
+
+BleSampler::BleSampler(const Config &config) : config_(config) {
+  if (config_.globalBurst == 0) config_.globalBurst = 1;
+  if (config_.deviceBurst == 0) config_.deviceBurst = 1;
+  if (config_.newDeviceReservePct > 100) config_.newDeviceReservePct = 100;
+  capMilli_ = config_.globalBurst * 1000;
+  reserveMilli_ = capMilli_ / 100 * config_.newDeviceReservePct;
+  milli_ = capMilli_;
+}
+
+void BleSampler::refillGlobal(uint32_t nowMs) {
+  if (!started_) {
+    started_ = true;
+    lastMs_ = nowMs;
+    epochStartMs_ = nowMs;
+    return;
+  }
+  uint32_t elapsed = nowMs - lastMs_;
+  lastMs_ = nowMs;
+  // Tokens x1000 per ms equals tokens per second.
+  uint64_t add = (uint64_t)elapsed * config_.globalPerSec;
+  milli_ = milli_ + add >= capMilli_ ? capMilli_ : (uint32_t)(milli_ + add);
+}
+
+uint32_t BleSampler::deviceIntervalMs() const {
+  // Known devices share what is left after the new-device reserve, which
+  // also leaves slack so a device that just missed a refill gets in next time.
+  uint32_t perSecPct = config_.globalPerSec * (100 - config_.newDeviceReservePct);
+  if (perSecPct == 0) return config_.deviceIntervalMs;
+  uint32_t share = (uint32_t)((uint64_t)activeDevices() * 100000 / perSecPct);
+  return share > config_.deviceIntervalMs ? share : config_.deviceIntervalMs;
+}
+
+void BleSampler::countActive(BleDeviceEntry &dev, uint32_t nowMs) {
+  if (config_.activeWindowMs > 0 && nowMs - epochStartMs_ >= config_.activeWindowMs) {
+    // A gap longer than a whole window means nothing was heard in between.
+    active_ = nowMs - epochStartMs_ >= 2 * config_.activeWindowMs ? 0 : current_;
+    current_ = 0;
+    epochStartMs_ = nowMs;
+    epoch_ = epoch_ == 0xFFFF ? 1 : epoch_ + 1;
+  }
+  if (dev.epoch != epoch_) {
+    dev.epoch = epoch_;
+    current_++;
+  }
+}
+
+void BleSampler::refillDevice(BleDeviceEntry &dev, uint32_t nowMs) const {
+  uint32_t interval = deviceIntervalMs();
+  if (dev.tokens >= config_.deviceBurst || interval == 0) {
+    dev.tokens = config_.deviceBurst;
+    dev.token_ms = nowMs;
+    return;
+  }
+  uint32_t earned = (nowMs - dev.token_ms) / interval;
+  if (earned == 0) return;
+  if (earned >= (uint32_t)(config_.deviceBurst - dev.tokens)) {
+    dev.tokens = config_.deviceBurst;
+    dev.token_ms = nowMs;
+  } else {
+    dev.tokens += (uint8_t)earned;
+    // Keep the fractional part so the rate does not drift.
+    dev.token_ms += earned * interval;
+  }
+}
+
+bool BleSampler::admit(BleDeviceEntry &dev, bool isNew, uint32_t nowMs) {
+  refillGlobal(nowMs);
+  countActive(dev, nowMs);
+  if (isNew) {
+    dev.tokens = config_.deviceBurst;
+    dev.token_ms = nowMs;
+  } else {
+    refillDevice(dev, nowMs);
+  }
+  if (dev.tokens == 0) {
+    dev.suppressed++;
+    stats_.suppressedDevice++;
+    return false;
+  }
+  // Known devices leave the reserve to newcomers.
+  uint32_t floor = isNew ? 0 : reserveMilli_;
+  if (milli_ < floor + 1000) {
+    dev.suppressed++;
+    stats_.suppressedGlobal++;
+    return false;
+  }
+  milli_ -= 1000;
+  dev.tokens--;
+  dev.admitted++;
+  stats_.admitted++;
+  if (isNew) stats_.admittedNew++;
+  return true;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ble_adv.h"
+
+// Decides which adverts become ble.seen events. Each device has its own token
+// bucket (kept in its BleDeviceEntry) so a few chatty advertisers cannot use
+// up the global per-second budget, and part of the global budget is reserved
+// for devices seen for the first time. When more devices are active than the
+// global rate can serve at the configured per-device rate, the per-device
+// interval stretches to an even share, so the budget is split across devices
+// instead of going to whoever advertises right after a refill. Suppressed
+// adverts are only counted; the caller still updates the table with them.
+class BleSampler {
+ public:
+  struct Config {
+    uint32_t globalPerSec;     // sustained events per second, all devices
+    uint32_t globalBurst;      // global bucket size
+    uint32_t deviceIntervalMs; // one per-device token every this many ms
+    uint8_t deviceBurst;       // per-device bucket size
+    uint8_t newDeviceReservePct;  // share of the global bucket only new devices may use
+    uint32_t activeWindowMs;   // devices heard within this window count as active
+  };
+
+  struct Stats {
+    uint32_t admitted = 0;
+    uint32_t admittedNew = 0;
+    uint32_t suppressedDevice = 0;  // device over its own rate
+    uint32_t suppressedGlobal = 0;  // global budget exhausted
+  };
+
+  explicit BleSampler(const Config &config);
+
+  // `isNew` is true when `dev` was just inserted (all-zero). Returns whether
+  // the advert should be emitted, and updates the per-device counters.
+  bool admit(BleDeviceEntry &dev, bool isNew, uint32_t nowMs);
+
+  const Stats &stats() const { return stats_; }
+  // Whole global tokens currently available.
+  uint32_t globalTokens() const { return milli_ / 1000; }
+  // Devices heard in the last full activity window (or the current one, if more).
+  uint32_t activeDevices() const { return active_ > current_ ? active_ : current_; }
+  // Per-device token interval currently in force.
+  uint32_t deviceIntervalMs() const;
+
+ private:
+  void refillGlobal(uint32_t nowMs);
+  void refillDevice(BleDeviceEntry &dev, uint32_t nowMs) const;
+  void countActive(BleDeviceEntry &dev, uint32_t nowMs);
+
+  Config config_;
+  uint32_t milli_;        // global tokens x1000
+  uint32_t capMilli_;
+  uint32_t reserveMilli_;
+  uint32_t lastMs_ = 0;
+  bool started_ = false;
+  uint16_t epoch_ = 1;  // 0 marks entries never counted
+  uint32_t epochStartMs_ = 0;
+  uint32_t active_ = 0;
+  uint32_t current_ = 0;
+  Stats stats_;
+};
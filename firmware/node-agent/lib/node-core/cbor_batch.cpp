@@ -0,0 +1,897 @@
+#include "cbor_batch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+
+// Key table for kCborBatchFormat 1, most frequent first so the common keys
+// take one byte. Index 0 is the per-event timestamp delta; a JSON key "dt"
+// is written as text.
+struct Key {
+  const char *name;
+  uint8_t len;
+};
+const Key kKeys[] = {
+    {"dt", 2}, {"type", 4}, {"seq", 3}, {"data", 4}, {"src", 3}, {"v", 1}, {"node_id", 7},
+    {"addr", 4}, {"rssi", 4}, {"mac", 3}, {"addr_type", 9}, {"vendor_id", 9}, {"flags", 5},
+    {"fp_stable", 9}, {"fp_addr", 7}, {"ok", 2}, {"ms", 2}, {"ip", 2}, {"devices", 7},
+    {"window_start_ms", 15}, {"window_ms", 9}, {"part", 4}, {"uptime_ms", 9}, {"heap_free", 9},
+    {"queue_depth", 11}, {"wifi_rssi", 9}, {"ble_seen_total", 14}, {"batch_count", 11},
+    {"raw_bytes", 9}, {"wire_bytes", 10}, {"ratio", 5}, {"encoding", 8}, {"format", 6},
+    {"batch_limit", 11}, {"err", 3}, {"code", 4}, {"reason", 6}, {"connected", 9}, {"ssid", 4},
+    {"bssid", 5}, {"channel", 7}, {"auth", 4}, {"gw", 2}, {"mask", 4}, {"dns", 3}, {"hostname", 8},
+    {"host", 4}, {"http_port", 9}, {"url", 3}, {"state", 5}, {"ingest", 6}, {"ingest_url", 10},
+    {"self", 4}, {"chip", 4}, {"chip_model", 10}, {"chip_rev", 8}, {"fw_version", 10},
+    {"sdk_version", 11}, {"oui_index_id", 12}, {"ts_ms", 5}, {"epoch", 5},
+};
+const size_t kKeyCount = sizeof(kKeys) / sizeof(kKeys[0]);
+const uint64_t kKeyDt = 0;
+const uint64_t kKeySrc = 4;
+const uint64_t kKeyV = 5;
+const uint64_t kKeyNodeId = 6;
+
+const uint8_t kMajorUInt = 0;
+const uint8_t kMajorNegInt = 1;
+const uint8_t kMajorBytes = 2;
+const uint8_t kMajorText = 3;
+const uint8_t kMajorArray = 4;
+const uint8_t kMajorMap = 5;
+const uint8_t kMajorTag = 6;
+
+const uint8_t kFalse = 0xF4;
+const uint8_t kTrue = 0xF5;
+const uint8_t kNull = 0xF6;
+const uint8_t kUndefined = 0xF7;
+const uint8_t kFloat64 = 0xFB;
+const uint64_t kTagDecimal = 4;
+const uint64_t kTagMac = 48;
+
+const int kMaxDepth = 16;
+const int kMaxDecimals = 9;
+
+int hexVal(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  return -1;
+}
+
+// ---- CBOR output -------------------------------------------------------------
+
+struct CborOut {
+  uint8_t *buf;
+  size_t cap;
+  size_t len;
+
+  bool put(uint8_t b) {
+    if (len >= cap) return false;
+    buf[len++] = b;
+    return true;
+  }
+
+  bool put(const void *p, size_t n) {
+    if (n > cap - len) return false;
+    memcpy(buf + len, p, n);
+    len += n;
+    return true;
+  }
+
+  bool head(uint8_t major, uint64_t v) {
+    uint8_t m = (uint8_t)(major << 5);
+    if (v < 24) return put((uint8_t)(m | v));
+    uint8_t tmp[9];
+    size_t n;
+    if (v <= 0xFF) {
+      tmp[0] = m | 24;
+      n = 1;
+    } else if (v <= 0xFFFF) {
+      tmp[0] = m | 25;
+      n = 2;
+    } else if (v <= 0xFFFFFFFFULL) {
+      tmp[0] = m | 26;
+      n = 4;
+    } else {
+      tmp[0] = m | 27;
+      n = 8;
+    }
+    for (size_t i = 0; i < n; i++) tmp[n - i] = (uint8_t)(v >> (8 * i));
+    return put(tmp, n + 1);
+  }
+
+  bool integer(int64_t v) {
+    if (v >= 0) return head(kMajorUInt, (uint64_t)v);
+    return head(kMajorNegInt, (uint64_t)(-(v + 1)));
+  }
+
+  bool text(const char *s) {
+    size_t n = strlen(s);
+    return head(kMajorText, n) && put(s, n);
+  }
+
+  // Containers are opened with a one-byte head and patched on close; the
+  // rare one with 24 or more entries is shifted to make room.
+  bool close(size_t at, uint8_t major, size_t n) {
+    if (n < 24) {
+      buf[at] = (uint8_t)((major << 5) | n);
+      return true;
+    }
+    size_t extra = n <= 0xFF ? 1 : n <= 0xFFFF ? 2 : 4;
+    if (extra > cap - len) return false;
+    memmove(buf + at + 1 + extra, buf + at + 1, len - at - 1);
+    size_t end = len + extra;
+    len = at;
+    head(major, n);
+    len = end;
+    return true;
+  }
+};
+
+// ---- JSON input --------------------------------------------------------------
+
+struct JsonIn {
+  const char *p;
+  const char *end;
+
+  void ws() {
+    while (p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t')) p++;
+  }
+  bool eat(char c) {
+    ws();
+    if (p < end && *p == c) {
+      p++;
+      return true;
+    }
+    return false;
+  }
+  char peek() {
+    ws();
+    return p < end ? *p : '\0';
+  }
+};
+
+// A JSON string: `raw` spans the escaped body between the quotes and
+// `bytes` is its UTF-8 length once unescaped.
+struct JsonStr {
+  const char *raw;
+  size_t rawLen;
+  size_t bytes;
+};
+
+bool hex4(const char *p, const char *end, uint32_t &v) {
+  if (end - p < 4) return false;
+  v = 0;
+  for (int i = 0; i < 4; i++) {
+    char c = p[i];
+    if (c >= 'A' && c <= 'F') c = char(c - 'A' + 'a');
+    int h = hexVal(c);
+    if (h < 0) return false;
+    v = (v << 4) | (uint32_t)h;
+  }
+  return true;
+}
+
+// Decodes the escape at `p` (just past the backslash). Returns the code
+// point and advances `p`, or false when invalid.
+bool unescapeOne(const char *&p, const char *end, uint32_t &cp) {
+  if (p >= end) return false;
+  char c = *p++;
+  switch (c) {
+    case '"': cp = '"'; return true;
+    case '\\': cp = '\\'; return true;
+    case '/': cp = '/'; return true;
+    case 'b': cp = '\b'; return true;
+    case 'f': cp = '\f'; return true;
+    case 'n': cp = '\n'; return true;
+    case 'r': cp = '\r'; return true;
+    case 't': cp = '\t'; return true;
+    case 'u': break;
+    default: return false;
+  }
+  if (!hex4(p, end, cp)) return false;
+  p += 4;
+  if (cp >= 0xDC00 && cp <= 0xDFFF) return false;
+  if (cp >= 0xD800 && cp <= 0xDBFF) {
+    uint32_t lo;
+    if (end - p < 6 || p[0] != '\\' || p[1] != 'u' || !hex4(p + 2, end, lo) || lo < 0xDC00 ||
+        lo > 0xDFFF) {
+      return false;
+    }
+    p += 6;
+    cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+  }
+  return true;
+}
+
+size_t utf8Len(uint32_t cp) { return cp < 0x80 ? 1 : cp < 0x800 ? 2 : cp < 0x10000 ? 3 : 4; }
+
+bool scanString(JsonIn &in, JsonStr &s) {
+  if (!in.eat('"')) return false;
+  s.raw = in.p;
+  s.bytes = 0;
+  while (in.p < in.end && *in.p != '"') {
+    char c = *in.p++;
+    if ((uint8_t)c < 0x20) return false;
+    if (c != '\\') {
+      s.bytes++;
+      continue;
+    }
+    uint32_t cp;
+    if (!unescapeOne(in.p, in.end, cp)) return false;
+    s.bytes += utf8Len(cp);
+  }
+  if (in.p >= in.end) return false;
+  s.rawLen = (size_t)(in.p - s.raw);
+  in.p++;
+  return true;
+}
+
+bool writeText(CborOut &out, const JsonStr &s) {
+  if (!out.head(kMajorText, s.bytes)) return false;
+  if (s.bytes == s.rawLen) return out.put(s.raw, s.rawLen);
+  const char *p = s.raw;
+  const char *end = s.raw + s.rawLen;
+  while (p < end) {
+    if (*p != '\\') {
+      if (!out.put((uint8_t)*p++)) return false;
+      continue;
+    }
+    p++;
+    uint32_t cp;
+    unescapeOne(p, end, cp);
+    uint8_t u[4];
+    size_t n = utf8Len(cp);
+    if (n == 1) {
+      u[0] = (uint8_t)cp;
+    } else if (n == 2) {
+      u[0] = (uint8_t)(0xC0 | (cp >> 6));
+      u[1] = (uint8_t)(0x80 | (cp & 0x3F));
+    } else if (n == 3) {
+      u[0] = (uint8_t)(0xE0 | (cp >> 12));
+      u[1] = (uint8_t)(0x80 | ((cp >> 6) & 0x3F));
+      u[2] = (uint8_t)(0x80 | (cp & 0x3F));
+    } else {
+      u[0] = (uint8_t)(0xF0 | (cp >> 18));
+      u[1] = (uint8_t)(0x80 | ((cp >> 12) & 0x3F));
+      u[2] = (uint8_t)(0x80 | ((cp >> 6) & 0x3F));
+      u[3] = (uint8_t)(0x80 | (cp & 0x3F));
+    }
+    if (!out.put(u, n)) return false;
+  }
+  return true;
+}
+
+bool isMac(const JsonStr &s) {
+  if (s.rawLen != 17) return false;
+  for (size_t i = 0; i < 17; i++) {
+    if (i % 3 == 2 ? s.raw[i] != ':' : hexVal(s.raw[i]) < 0) return false;
+  }
+  return true;
+}
+
+bool isHex(const JsonStr &s) {
+  if (s.rawLen < 8 || s.rawLen > 64 || s.rawLen % 2 != 0) return false;
+  for (size_t i = 0; i < s.rawLen; i++) {
+    if (hexVal(s.raw[i]) < 0) return false;
+  }
+  return true;
+}
+
+bool writeString(CborOut &out, const JsonStr &s) {
+  if (isMac(s)) {
+    if (!out.head(kMajorTag, kTagMac) || !out.head(kMajorBytes, 6)) return false;
+    for (size_t i = 0; i < 17; i += 3) {
+      if (!out.put((uint8_t)(hexVal(s.raw[i]) << 4 | hexVal(s.raw[i + 1])))) return false;
+    }
+    return true;
+  }
+  if (isHex(s)) {
+    if (!out.head(kMajorBytes, s.rawLen / 2)) return false;
+    for (size_t i = 0; i < s.rawLen; i += 2) {
+      if (!out.put((uint8_t)(hexVal(s.raw[i]) << 4 | hexVal(s.raw[i + 1])))) return false;
+    }
+    return true;
+  }
+  return writeText(out, s);
+}
+
+bool writeKey(CborOut &out, const JsonStr &k) {
+  if (k.bytes == k.rawLen && !(k.rawLen == 2 && memcmp(k.raw, "dt", 2) == 0)) {
+    for (size_t i = 1; i < kKeyCount; i++) {
+      if (kKeys[i].len == k.rawLen && memcmp(kKeys[i].name, k.raw, k.rawLen) == 0) {
+        return out.head(kMajorUInt, i);
+      }
+    }
+  }
+  return writeText(out, k);
+}
+
+bool keyIs(const JsonStr &k, const char *name) {
+  size_t n = strlen(name);
+  return k.rawLen == n && memcmp(k.raw, name, n) == 0;
+}
+
+// A JSON number as an integer when it has no fraction or exponent.
+struct JsonNum {
+  const char *p;
+  size_t len;
+  bool integral;
+};
+
+bool scanNumber(JsonIn &in, JsonNum &n) {
+  in.ws();
+  n.p = in.p;
+  n.integral = true;
+  if (in.p < in.end && *in.p == '-') in.p++;
+  const char *digits = in.p;
+  while (in.p < in.end && *in.p >= '0' && *in.p <= '9') in.p++;
+  if (in.p == digits) return false;
+  while (in.p < in.end && (*in.p == '.' || *in.p == 'e' || *in.p == 'E' || *in.p == '+' ||
+                           *in.p == '-' || (*in.p >= '0' && *in.p <= '9'))) {
+    n.integral = false;
+    in.p++;
+  }
+  n.len = (size_t)(in.p - n.p);
+  return true;
+}
+
+// Parses `digits` (with an optional '.') into a mantissa and the number of
+// fraction digits. False on overflow, exponents or malformed input.
+bool parseDecimal(const JsonNum &n, int64_t &mantissa, int &decimals) {
+  const char *p = n.p;
+  const char *end = n.p + n.len;
+  bool neg = p < end && *p == '-';
+  if (neg) p++;
+  uint64_t mag = 0;
+  decimals = -1;
+  for (; p < end; p++) {
+    if (*p == '.') {
+      if (decimals >= 0) return false;
+      decimals = 0;
+      continue;
+    }
+    if (*p < '0' || *p > '9') return false;
+    if (mag > (UINT64_MAX - 9) / 10) return false;
+    mag = mag * 10 + (uint64_t)(*p - '0');
+    if (decimals >= 0) decimals++;
+  }
+  if (decimals < 0) decimals = 0;
+  if (mag > (uint64_t)INT64_MAX + (neg ? 1 : 0)) return false;
+  mantissa = neg ? (int64_t)(0 - mag) : (int64_t)mag;
+  return true;
+}
+
+bool writeNumber(CborOut &out, const JsonNum &n) {
+  int64_t mantissa;
+  int decimals;
+  bool neg = n.p[0] == '-';
+  if (n.integral && !neg) {
+    // Full uint64 range for unsigned values.
+    uint64_t v = 0;
+    bool fits = true;
+    for (size_t i = 0; i < n.len && fits; i++) {
+      fits = v <= (UINT64_MAX - 9) / 10;
+      v = v * 10 + (uint64_t)(n.p[i] - '0');
+    }
+    if (fits) return out.head(kMajorUInt, v);
+  } else if (parseDecimal(n, mantissa, decimals) && decimals <= kMaxDecimals) {
+    if (decimals == 0 && n.integral) return out.integer(mantissa);
+    if (decimals > 0 && n.p[n.len - 1] != '.') {
+      return out.head(kMajorTag, kTagDecimal) && out.head(kMajorArray, 2) &&
+             out.integer(-decimals) && out.integer(mantissa);
+    }
+  }
+  char tmp[40];
+  if (n.len >= sizeof(tmp)) return false;
+  memcpy(tmp, n.p, n.len);
+  tmp[n.len] = '\0';
+  char *stop = nullptr;
+  double d = strtod(tmp, &stop);
+  if (stop != tmp + n.len) return false;
+  uint64_t bits;
+  memcpy(&bits, &d, sizeof(bits));
+  uint8_t b[9];
+  b[0] = kFloat64;
+  for (int i = 0; i < 8; i++) b[8 - i] = (uint8_t)(bits >> (8 * i));
+  return out.put(b, sizeof(b));
+}
+
+bool literal(JsonIn &in, const char *word) {
+  size_t n = strlen(word);
+  if ((size_t)(in.end - in.p) < n || memcmp(in.p, word, n) != 0) return false;
+  in.p += n;
+  return true;
+}
+
+bool transcode(JsonIn &in, CborOut &out, int depth);
+
+bool transcodeMembers(JsonIn &in, CborOut &out, int depth, bool object) {
+  size_t at = out.len;
+  if (!out.put(0)) return false;
+  size_t n = 0;
+  char close = object ? '}' : ']';
+  if (!in.eat(close)) {
+    do {
+      if (object) {
+        JsonStr k;
+        if (!scanString(in, k) || !writeKey(out, k) || !in.eat(':')) return false;
+      }
+      if (!transcode(in, out, depth + 1)) return false;
+      n++;
+    } while (in.eat(','));
+    if (!in.eat(close)) return false;
+  }
+  return out.close(at, object ? kMajorMap : kMajorArray, n);
+}
+
+bool transcode(JsonIn &in, CborOut &out, int depth) {
+  if (depth > kMaxDepth) return false;
+  char c = in.peek();
+  if (c == '{' || c == '[') {
+    in.p++;
+    return transcodeMembers(in, out, depth, c == '{');
+  }
+  if (c == '"') {
+    JsonStr s;
+    return scanString(in, s) && writeString(out, s);
+  }
+  if (c == 't') return literal(in, "true") && out.put(kTrue);
+  if (c == 'f') return literal(in, "false") && out.put(kFalse);
+  if (c == 'n') return literal(in, "null") && out.put(kNull);
+  JsonNum num;
+  return scanNumber(in, num) && writeNumber(out, num);
+}
+
+bool skipValue(JsonIn &in, int depth) {
+  if (depth > kMaxDepth) return false;
+  char c = in.peek();
+  if (c == '{' || c == '[') {
+    in.p++;
+    char close = c == '{' ? '}' : ']';
+    if (in.eat(close)) return true;
+    do {
+      JsonStr k;
+      if (c == '{' && (!scanString(in, k) || !in.eat(':'))) return false;
+      if (!skipValue(in, depth + 1)) return false;
+    } while (in.eat(','));
+    return in.eat(close);
+  }
+  if (c == '"') {
+    JsonStr s;
+    return scanString(in, s);
+  }
+  if (c == 't') return literal(in, "true");
+  if (c == 'f') return literal(in, "false");
+  if (c == 'n') return literal(in, "null");
+  JsonNum num;
+  return scanNumber(in, num);
+}
+
+bool parseU32(const JsonNum &n, uint32_t &v) {
+  if (!n.integral || n.len == 0 || n.len > 10 || n.p[0] == '-') return false;
+  uint64_t x = 0;
+  for (size_t i = 0; i < n.len; i++) x = x * 10 + (uint64_t)(n.p[i] - '0');
+  if (x > 0xFFFFFFFFULL) return false;
+  v = (uint32_t)x;
+  return true;
+}
+
+}  // namespace
+
+// ---- encoder -----------------------------------------------------------------
+
+CborBatchEncoder::CborBatchEncoder(uint8_t *buf, size_t cap) : buf_(buf), cap_(cap) {}
+
+void CborBatchEncoder::begin(size_t count) {
+  len_ = 0;
+  count_ = count;
+  added_ = 0;
+  ok_ = count > 0;
+}
+
+bool CborBatchEncoder::header(const char *json, size_t len) {
+  JsonIn in{json, json + len};
+  bool haveV = false;
+  bool haveTs = false;
+  bool haveId = false;
+  JsonStr id;
+  if (!in.eat('{')) return false;
+  do {
+    JsonStr k;
+    if (!scanString(in, k) || !in.eat(':')) return false;
+    if (keyIs(k, "v") || keyIs(k, "ts_ms")) {
+      JsonNum n;
+      uint32_t v;
+      if (!scanNumber(in, n) || !parseU32(n, v)) return false;
+      if (keyIs(k, "v")) {
+        v_ = v;
+        haveV = true;
+      } else {
+        prevTs_ = v;
+        haveTs = true;
+      }
+    } else if (keyIs(k, "node_id") && in.peek() == '"') {
+      if (!scanString(in, id) || id.rawLen > sizeof(nodeId_)) return false;
+      memcpy(nodeId_, id.raw, id.rawLen);
+      nodeIdLen_ = id.rawLen;
+      haveId = true;
+    } else if (!skipValue(in, 1)) {
+      return false;
+    }
+    if (haveV && haveTs && haveId) break;
+  } while (in.eat(','));
+  if (!haveTs) return false;
+
+  CborOut out{buf_, cap_, len_};
+  bool ok = out.head(kMajorMap, 5) && out.text("fmt") && out.head(kMajorUInt, kCborBatchFormat) &&
+            out.text("v") && (haveV ? out.head(kMajorUInt, v_) : out.put(kNull)) &&
+            out.text("node_id") && (haveId ? writeText(out, id) : out.put(kNull)) &&
+            out.text("ts_ms") && out.head(kMajorUInt, prevTs_) && out.text("events") &&
+            out.head(kMajorArray, count_);
+  if (!haveV) v_ = UINT64_MAX;
+  if (!haveId) nodeIdLen_ = SIZE_MAX;
+  len_ = out.len;
+  return ok;
+}
+
+bool CborBatchEncoder::event(const char *json, size_t len) {
+  JsonIn in{json, json + len};
+  CborOut out{buf_, cap_, len_};
+  if (!in.eat('{')) return false;
+  size_t at = out.len;
+  if (!out.put(0)) return false;
+  size_t n = 0;
+  bool haveTs = false;
+  if (!in.eat('}')) {
+    do {
+      JsonStr k;
+      if (!scanString(in, k) || !in.eat(':')) return false;
+      JsonIn value = in;
+      if (keyIs(k, "ts_ms")) {
+        JsonNum num;
+        uint32_t ts;
+        if (haveTs || !scanNumber(in, num) || !parseU32(num, ts)) return false;
+        if (!out.head(kMajorUInt, kKeyDt) || !out.integer((int64_t)ts - (int64_t)prevTs_)) {
+          return false;
+        }
+        prevTs_ = ts;
+        haveTs = true;
+        n++;
+        continue;
+      }
+      if (keyIs(k, "v")) {
+        JsonNum num;
+        uint32_t v;
+        if (scanNumber(in, num) && parseU32(num, v) && v == v_) continue;
+        in = value;
+      } else if (keyIs(k, "node_id") || keyIs(k, "src")) {
+        JsonStr s;
+        bool same = in.peek() == '"' && scanString(in, s) && s.rawLen == nodeIdLen_ &&
+                    memcmp(s.raw, nodeId_, nodeIdLen_) == 0;
+        if (same && keyIs(k, "node_id")) continue;
+        if (same) {
+          if (!out.head(kMajorUInt, kKeySrc) || !out.put(kUndefined)) return false;
+          n++;
+          continue;
+        }
+        in = value;
+      }
+      if (!writeKey(out, k) || !transcode(in, out, 1)) return false;
+      n++;
+    } while (in.eat(','));
+    if (!in.eat('}')) return false;
+  }
+  in.ws();
+  if (!haveTs || in.p != in.end || !out.close(at, kMajorMap, n)) return false;
+  len_ = out.len;
+  return true;
+}
+
+bool CborBatchEncoder::add(const char *json, size_t len) {
+  if (!ok_ || added_ >= count_) return ok_ = false;
+  if (added_ == 0 && !header(json, len)) return ok_ = false;
+  if (!event(json, len)) return ok_ = false;
+  added_++;
+  return true;
+}
+
+size_t CborBatchEncoder::finish() const { return ok_ && added_ == count_ ? len_ : 0; }
+
+// ---- decoder -----------------------------------------------------------------
+
+namespace {
+
+struct CborIn {
+  const uint8_t *p;
+  const uint8_t *end;
+
+  // Reads an item head. Indefinite lengths are not part of the format.
+  bool head(uint8_t &major, uint8_t &info, uint64_t &v) {
+    if (p >= end) return false;
+    major = (uint8_t)(*p >> 5);
+    info = (uint8_t)(*p & 0x1F);
+    p++;
+    if (info < 24) {
+      v = info;
+      return true;
+    }
+    if (info > 27) return false;
+    size_t n = (size_t)1 << (info - 24);
+    if ((size_t)(end - p) < n) return false;
+    v = 0;
+    for (size_t i = 0; i < n; i++) v = (v << 8) | *p++;
+    return true;
+  }
+
+  bool expect(uint8_t major, uint64_t &v) {
+    uint8_t m, info;
+    return head(m, info, v) && m == major;
+  }
+
+  bool span(uint64_t n, const uint8_t *&data) {
+    if (n > (uint64_t)(end - p)) return false;
+    data = p;
+    p += n;
+    return true;
+  }
+
+  bool integer(int64_t &v) {
+    uint8_t m, info;
+    uint64_t raw;
+    if (!head(m, info, raw) || (m != kMajorUInt && m != kMajorNegInt) || raw > (uint64_t)INT64_MAX) {
+      return false;
+    }
+    v = m == kMajorUInt ? (int64_t)raw : -1 - (int64_t)raw;
+    return true;
+  }
+
+  bool text(const char *&s, size_t &len) {
+    uint64_t n;
+    const uint8_t *data;
+    if (!expect(kMajorText, n) || !span(n, data)) return false;
+    s = reinterpret_cast<const char *>(data);
+    len = (size_t)n;
+    return true;
+  }
+};
+
+bool skipItem(CborIn &in, int depth) {
+  if (depth > kMaxDepth) return false;
+  uint8_t major, info;
+  uint64_t v;
+  if (!in.head(major, info, v)) return false;
+  const uint8_t *data;
+  switch (major) {
+    case kMajorBytes:
+    case kMajorText: return in.span(v, data);
+    case kMajorArray:
+    case kMajorMap:
+      for (uint64_t i = 0; i < (major == kMajorMap ? v * 2 : v); i++) {
+        if (!skipItem(in, depth + 1)) return false;
+      }
+      return true;
+    case kMajorTag: return skipItem(in, depth + 1);
+    default: return true;
+  }
+}
+
+void writeHex(JsonWriter &w, const uint8_t *b, size_t n, char sep) {
+  static const char kHex[] = "0123456789abcdef";
+  char tmp[96];
+  size_t len = 0;
+  for (size_t i = 0; i < n && len + 3 <= sizeof(tmp); i++) {
+    if (sep && i > 0) tmp[len++] = sep;
+    tmp[len++] = kHex[b[i] >> 4];
+    tmp[len++] = kHex[b[i] & 15];
+  }
+  w.writeString(tmp, len);
+}
+
+// Writes the map key at `in`. `index` is set for table keys, else ~0.
+bool decodeKey(CborIn &in, JsonWriter &w, uint64_t &index) {
+  index = ~0ULL;
+  if (in.p < in.end && (*in.p >> 5) == kMajorText) {
+    const char *s;
+    size_t len;
+    char key[64];
+    if (!in.text(s, len) || len >= sizeof(key)) return false;
+    memcpy(key, s, len);
+    key[len] = '\0';
+    w.key(key);
+    return true;
+  }
+  if (!in.expect(kMajorUInt, index) || index == kKeyDt || index >= kKeyCount) return false;
+  w.key(kKeys[index].name);
+  return true;
+}
+
+bool decodeItem(CborIn &in, JsonWriter &w, int depth) {
+  if (depth > kMaxDepth) return false;
+  uint8_t major, info;
+  uint64_t v;
+  if (!in.head(major, info, v)) return false;
+  const uint8_t *data;
+  switch (major) {
+    case kMajorUInt: w.writeUInt(v); return true;
+    case kMajorNegInt:
+      if (v > (uint64_t)INT64_MAX) return false;
+      w.writeInt(-1 - (int64_t)v);
+      return true;
+    case kMajorBytes:
+      if (!in.span(v, data) || v > 32) return false;
+      writeHex(w, data, (size_t)v, '\0');
+      return true;
+    case kMajorText:
+      if (!in.span(v, data)) return false;
+      w.writeString(reinterpret_cast<const char *>(data), (size_t)v);
+      return true;
+    case kMajorArray:
+      w.beginArray();
+      for (uint64_t i = 0; i < v; i++) {
+        if (!decodeItem(in, w, depth + 1)) return false;
+      }
+      w.endArray();
+      return true;
+    case kMajorMap:
+      w.beginObject();
+      for (uint64_t i = 0; i < v; i++) {
+        uint64_t index;
+        if (!decodeKey(in, w, index) || !decodeItem(in, w, depth + 1)) return false;
+      }
+      w.endObject();
+      return true;
+    case kMajorTag:
+      if (v == kTagMac) {
+        uint64_t n;
+        if (!in.expect(kMajorBytes, n) || n != 6 || !in.span(n, data)) return false;
+        writeHex(w, data, 6, ':');
+        return true;
+      }
+      if (v == kTagDecimal) {
+        uint64_t n;
+        int64_t exp, mantissa;
+        if (!in.expect(kMajorArray, n) || n != 2 || !in.integer(exp) || !in.integer(mantissa) ||
+            exp > 0 || exp < -kMaxDecimals) {
+          return false;
+        }
+        w.writeFixed(mantissa, (uint8_t)-exp);
+        return true;
+      }
+      return false;
+    default:
+      if (info == (kFalse & 0x1F)) w.writeBool(false);
+      else if (info == (kTrue & 0x1F)) w.writeBool(true);
+      else if (info == (kNull & 0x1F)) w.writeNull();
+      else if (info == (kFloat64 & 0x1F)) {
+        double d;
+        memcpy(&d, &v, sizeof(d));
+        char tmp[32];
+        int n = snprintf(tmp, sizeof(tmp), "%.17g", d);
+        if (n <= 0 || (size_t)n >= sizeof(tmp)) return false;
+        w.writeRaw(tmp, (size_t)n);
+      } else {
+        return false;
+      }
+      return true;
+  }
+}
+
+struct BatchHeader {
+  bool haveV = false;
+  uint64_t v = 0;
+  const char *nodeId = nullptr;
+  size_t nodeIdLen = 0;
+  uint64_t ts = 0;
+};
+
+bool decodeEvent(CborIn &in, JsonWriter &w, const BatchHeader &h, uint64_t &ts) {
+  uint64_t n;
+  if (!in.expect(kMajorMap, n)) return false;
+
+  // First pass: the envelope values, which go first in the output.
+  // An event's own "v" or "node_id" of another type is left in place.
+  CborIn scan = in;
+  bool haveV = h.haveV;
+  uint64_t v = h.v;
+  const char *nodeId = h.nodeId;
+  size_t nodeIdLen = h.nodeIdLen;
+  bool vInPlace = false;
+  bool idInPlace = false;
+  bool haveDt = false;
+  for (uint64_t i = 0; i < n; i++) {
+    uint64_t index = ~0ULL;
+    if (scan.p < scan.end && (*scan.p >> 5) == kMajorUInt) {
+      if (!scan.expect(kMajorUInt, index)) return false;
+    } else if (!skipItem(scan, 1)) {
+      return false;
+    }
+    if (index == kKeyDt) {
+      int64_t dt;
+      if (!scan.integer(dt)) return false;
+      ts = (uint32_t)(ts + (uint64_t)dt);
+      haveDt = true;
+    } else if (index == kKeyV && scan.p < scan.end && (*scan.p >> 5) == kMajorUInt) {
+      if (!scan.expect(kMajorUInt, v)) return false;
+      haveV = true;
+    } else if (index == kKeyNodeId && scan.p < scan.end && (*scan.p >> 5) == kMajorText) {
+      if (!scan.text(nodeId, nodeIdLen)) return false;
+    } else if (index == kKeyV || index == kKeyNodeId) {
+      (index == kKeyV ? vInPlace : idInPlace) = true;
+      if (!skipItem(scan, 1)) return false;
+    } else if (!skipItem(scan, 1)) {
+      return false;
+    }
+  }
+  if (!haveDt) return false;
+
+  w.beginObject();
+  if (haveV && !vInPlace) w.fieldUInt("v", v);
+  w.fieldUInt("ts_ms", ts);
+  if (nodeId && !idInPlace) w.fieldStr("node_id", nodeId, nodeIdLen);
+  for (uint64_t i = 0; i < n; i++) {
+    if (in.p < in.end && (*in.p >> 5) == kMajorUInt) {
+      uint64_t index;
+      if (!in.expect(kMajorUInt, index)) return false;
+      if (index == kKeyDt || (index == kKeyV && !vInPlace) || (index == kKeyNodeId && !idInPlace)) {
+        if (!skipItem(in, 1)) return false;
+        continue;
+      }
+      if (index >= kKeyCount) return false;
+      if (index == kKeySrc && in.p < in.end && *in.p == kUndefined) {
+        in.p++;
+        if (!h.nodeId) return false;
+        w.fieldStr("src", h.nodeId, h.nodeIdLen);
+        continue;
+      }
+      w.key(kKeys[index].name);
+    } else {
+      uint64_t unused;
+      if (!decodeKey(in, w, unused)) return false;
+    }
+    if (!decodeItem(in, w, 1)) return false;
+  }
+  w.endObject();
+  return true;
+}
+
+}  // namespace
+
+bool cborBatchDecode(const uint8_t *data, size_t len, JsonWriter &w, size_t *events) {
+  CborIn in{data, data + len};
+  uint64_t fields;
+  if (!in.expect(kMajorMap, fields)) return false;
+  BatchHeader h;
+  bool haveFmt = false;
+  size_t count = 0;
+  w.beginArray();
+  for (uint64_t i = 0; i < fields; i++) {
+    const char *k;
+    size_t klen;
+    if (!in.text(k, klen)) return false;
+    if (klen == 3 && memcmp(k, "fmt", 3) == 0) {
+      uint64_t fmt;
+      if (!in.expect(kMajorUInt, fmt) || fmt != kCborBatchFormat) return false;
+      haveFmt = true;
+    } else if (klen == 1 && k[0] == 'v' && in.p < in.end && *in.p != kNull) {
+      if (!in.expect(kMajorUInt, h.v)) return false;
+      h.haveV = true;
+    } else if (klen == 7 && memcmp(k, "node_id", 7) == 0 && in.p < in.end && *in.p != kNull) {
+      if (!in.text(h.nodeId, h.nodeIdLen)) return false;
+    } else if (klen == 5 && memcmp(k, "ts_ms", 5) == 0) {
+      if (!in.expect(kMajorUInt, h.ts)) return false;
+    } else if (klen == 6 && memcmp(k, "events", 6) == 0) {
+      uint64_t n;
+      if (!haveFmt || !in.expect(kMajorArray, n)) return false;
+      uint64_t ts = h.ts;
+      for (uint64_t e = 0; e < n; e++) {
+        if (!decodeEvent(in, w, h, ts)) return false;
+        count++;
+      }
+    } else if (!skipItem(in, 0)) {
+      return false;
+    }
+  }
+  w.endArray();
+  if (events) *events = count;
+  return haveFmt && in.p == in.end && !w.overflowed();
+}
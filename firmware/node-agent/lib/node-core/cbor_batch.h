@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "json_writer.h"
+
+// Compact CBOR (RFC 8949) form of an ingest batch, sent with
+// Content-Type: application/cbor. The queue keeps events as JSON, so a batch
+// is transcoded at send time into one map:
+//
+//   {"fmt": 1, "v": <schema>, "node_id": <text>, "ts_ms": <base>,
+//    "events": [{0: <dt>, ...}, ...]}
+//
+// The header is taken from the first event. Each event drops "v" and
+// "node_id" when they match it, replaces "ts_ms" with key 0, the delta from
+// the previous event (from the base for the first), and writes a "src" equal
+// to node_id as undefined. Keys in the format's key table are written as
+// their index, lower-case MAC strings as tag-48 byte strings, lower-case hex
+// strings of 8+ digits as byte strings and decimals as tag-4 decimal
+// fractions. cborBatchDecode() reverses all of it.
+
+// Key table version carried in "fmt". The table is append-only within a
+// version.
+constexpr uint32_t kCborBatchFormat = 1;
+
+class CborBatchEncoder {
+ public:
+  CborBatchEncoder(uint8_t *buf, size_t cap);
+
+  // Starts a batch of exactly `count` events.
+  void begin(size_t count);
+  // Transcodes one JSON event object. False when the record is not an
+  // object with a numeric "ts_ms", is malformed, or does not fit; the batch
+  // is then unusable.
+  bool add(const char *json, size_t len);
+  // Encoded size, or 0 unless all `count` events were added.
+  size_t finish() const;
+
+  const uint8_t *data() const { return buf_; }
+
+ private:
+  // Escaped node_id bytes kept for comparison; longer ids fail the batch.
+  static const size_t kNodeIdMax = 96;
+
+  bool header(const char *json, size_t len);
+  bool event(const char *json, size_t len);
+
+  uint8_t *buf_;
+  size_t cap_;
+  size_t len_ = 0;
+  size_t count_ = 0;
+  size_t added_ = 0;
+  bool ok_ = false;
+  uint64_t v_ = 0;
+  uint32_t prevTs_ = 0;
+  char nodeId_[kNodeIdMax];
+  size_t nodeIdLen_ = 0;
+};
+
+// Reference decoder: writes the batch as a JSON array of events with the
+// envelope restored, byte-identical to the queued JSON for events whose
+// first keys are "v", "ts_ms" and "node_id" (everything the firmware emits).
+// `events` receives the event count. False on malformed input, an unknown
+// "fmt" or when `w` overflowed.
+bool cborBatchDecode(const uint8_t *in, size_t len, JsonWriter &w, size_t *events = nullptr);
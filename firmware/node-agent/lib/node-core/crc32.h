@@ -0,0 +1,8 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// CRC-32 (IEEE 802.3, reflected, as used by gzip and zlib). Pass the previous
+// return value as `crc` to checksum data in pieces; start with 0.
+uint32_t crc32Update(uint32_t crc, const void *data, size_t len);
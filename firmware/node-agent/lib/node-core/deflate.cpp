@@ -0,0 +1,156 @@
+#include "deflate.h"
+
+#include <string.h>
+
+#include "crc32.h"
+
+namespace {
+
+const size_t kMinMatch = 3;
+const size_t kMaxMatch = 258;
+const size_t kWindow = 32768;
+
+const uint16_t kLenBase[29] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+                               31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+const uint8_t kLenExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                               2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+const uint16_t kDistBase[30] = {1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+                                33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+                                1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+const uint8_t kDistExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+                                6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+class BitWriter {
+ public:
+  BitWriter(uint8_t *out, size_t cap) : out_(out), cap_(cap) {}
+
+  // Writes `n` bits of `value`, least significant first.
+  void bits(uint32_t value, unsigned n) {
+    acc_ |= value << count_;
+    count_ += n;
+    while (count_ >= 8) {
+      byte((uint8_t)acc_);
+      acc_ >>= 8;
+      count_ -= 8;
+    }
+  }
+
+  // Huffman codes are defined most significant bit first.
+  void code(uint32_t value, unsigned n) {
+    uint32_t rev = 0;
+    for (unsigned i = 0; i < n; i++) {
+      rev = (rev << 1) | (value & 1);
+      value >>= 1;
+    }
+    bits(rev, n);
+  }
+
+  void flush() {
+    if (count_ > 0) byte((uint8_t)acc_);
+    acc_ = 0;
+    count_ = 0;
+  }
+
+  size_t size() const { return pos_; }
+  bool overflowed() const { return overflow_; }
+
+ private:
+  void byte(uint8_t b) {
+    if (pos_ >= cap_) {
+      overflow_ = true;
+      return;
+    }
+    out_[pos_++] = b;
+  }
+
+  uint8_t *out_;
+  size_t cap_;
+  size_t pos_ = 0;
+  uint32_t acc_ = 0;
+  unsigned count_ = 0;
+  bool overflow_ = false;
+};
+
+void writeLiteral(BitWriter &bw, unsigned sym) {
+  if (sym < 144) bw.code(0x30 + sym, 8);
+  else if (sym < 256) bw.code(0x190 + (sym - 144), 9);
+  else if (sym < 280) bw.code(sym - 256, 7);
+  else bw.code(0xC0 + (sym - 280), 8);
+}
+
+void writeMatch(BitWriter &bw, size_t len, size_t dist) {
+  unsigned li = 28;
+  while (kLenBase[li] > len) li--;
+  writeLiteral(bw, 257 + li);
+  if (kLenExtra[li]) bw.bits((uint32_t)(len - kLenBase[li]), kLenExtra[li]);
+  unsigned di = 29;
+  while (kDistBase[di] > dist) di--;
+  bw.code(di, 5);
+  if (kDistExtra[di]) bw.bits((uint32_t)(dist - kDistBase[di]), kDistExtra[di]);
+}
+
+inline uint32_t load32(const uint8_t *p) {
+  uint32_t v;
+  memcpy(&v, p, 4);
+  return v;
+}
+
+}  // namespace
+
+size_t DeflateEncoder::deflate(const uint8_t *in, size_t len, uint8_t *out, size_t cap) {
+  if (len > kMaxInput) return 0;
+  memset(head_, 0, sizeof(head_));
+  BitWriter bw(out, cap);
+  bw.bits(1, 1);  // BFINAL
+  bw.bits(1, 2);  // BTYPE = fixed Huffman
+
+  auto insert = [&](size_t pos) -> size_t {
+    uint32_t h = (load32(in + pos) * 2654435761u) >> (32 - kHashBits);
+    size_t cand = head_[h];
+    head_[h] = (uint16_t)(pos + 1);
+    return cand;
+  };
+
+  size_t i = 0;
+  while (i < len && !bw.overflowed()) {
+    size_t matchLen = 0;
+    size_t dist = 0;
+    if (i + 4 <= len) {
+      size_t cand = insert(i);
+      if (cand != 0) {
+        size_t from = cand - 1;
+        dist = i - from;
+        if (dist <= kWindow) {
+          size_t limit = len - i < kMaxMatch ? len - i : kMaxMatch;
+          while (matchLen < limit && in[from + matchLen] == in[i + matchLen]) matchLen++;
+        }
+      }
+    }
+    if (matchLen >= kMinMatch) {
+      writeMatch(bw, matchLen, dist);
+      size_t end = i + matchLen;
+      for (size_t p = i + 1; p < end && p + 4 <= len; p++) insert(p);
+      i = end;
+    } else {
+      writeLiteral(bw, in[i]);
+      i++;
+    }
+  }
+  writeLiteral(bw, 256);
+  bw.flush();
+  return bw.overflowed() ? 0 : bw.size();
+}
+
+size_t DeflateEncoder::gzip(const uint8_t *in, size_t len, uint8_t *out, size_t cap) {
+  static const uint8_t kHeader[10] = {0x1F, 0x8B, 0x08, 0, 0, 0, 0, 0, 0, 0xFF};
+  if (cap < sizeof(kHeader) + 8) return 0;
+  memcpy(out, kHeader, sizeof(kHeader));
+  size_t body = deflate(in, len, out + sizeof(kHeader), cap - sizeof(kHeader) - 8);
+  if (body == 0) return 0;
+  size_t n = sizeof(kHeader) + body;
+  uint32_t crc = crc32Update(0, in, len);
+  uint32_t size = (uint32_t)len;
+  for (int b = 0; b < 4; b++) out[n++] = (uint8_t)(crc >> (8 * b));
+  for (int b = 0; b < 4; b++) out[n++] = (uint8_t)(size >> (8 * b));
+  return n;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Small one-shot DEFLATE (RFC 1951) encoder for ingest batches. It emits a
+// single fixed-Huffman block with greedy LZ77 matching over a one-probe hash
+// table, which keeps its state to 8 KB and needs no heap. Repeated JSON keys
+// and node ids compress well without dynamic Huffman tables.
+class DeflateEncoder {
+ public:
+  // Match positions are stored as 16-bit offsets.
+  static const size_t kMaxInput = 0xFFFF;
+
+  // Raw DEFLATE stream. Returns the compressed size, or 0 when `out` is too
+  // small or the input is larger than kMaxInput.
+  size_t deflate(const uint8_t *in, size_t len, uint8_t *out, size_t cap);
+  // gzip member (RFC 1952) wrapping deflate(), for Content-Encoding: gzip.
+  size_t gzip(const uint8_t *in, size_t len, uint8_t *out, size_t cap);
+
+ private:
+  static const int kHashBits = 12;
+  uint16_t head_[1 << kHashBits];
+};
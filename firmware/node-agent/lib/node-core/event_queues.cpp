@@ -0,0 +1,198 @@
+#include "event_queues.h"
+
+#include <string.h>
+
+namespace {
+
+const char *const kClassNames[kEventClassCount] = {"telemetry", "status", "control"};
+const char *const kPolicyNames[] = {"drop-newest", "drop-oldest", "sample"};
+
+size_t share(size_t bytes, uint8_t pct) { return (bytes / 4 * pct / 100) * 4; }
+
+// Where the classes above telemetry start.
+size_t upperStart(size_t bytes, uint8_t controlPct, uint8_t statusPct) {
+  return (bytes & ~(size_t)3) - share(bytes, controlPct) - share(bytes, statusPct);
+}
+
+}  // namespace
+
+const char *eventClassName(EventClass cls) { return cls < kEventClassCount ? kClassNames[cls] : "?"; }
+
+bool parseEventClass(const char *s, EventClass &out) {
+  for (size_t i = 0; i < kEventClassCount; i++) {
+    if (strcmp(s, kClassNames[i]) == 0) {
+      out = (EventClass)i;
+      return true;
+    }
+  }
+  return false;
+}
+
+const char *dropPolicyName(DropPolicy policy) { return kPolicyNames[(size_t)policy]; }
+
+bool parseDropPolicy(const char *s, DropPolicy &out) {
+  for (size_t i = 0; i < sizeof(kPolicyNames) / sizeof(kPolicyNames[0]); i++) {
+    if (strcmp(s, kPolicyNames[i]) == 0) {
+      out = (DropPolicy)i;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Telemetry takes the start of the arena, then status, then control.
+EventQueues::EventQueues(uint8_t *arena, size_t bytes, uint8_t controlPct, uint8_t statusPct,
+                         uint8_t maxSkip)
+    : rings_{RecordRing(arena, upperStart(bytes, controlPct, statusPct)),
+             RecordRing(arena + upperStart(bytes, controlPct, statusPct), share(bytes, statusPct)),
+             RecordRing(arena + upperStart(bytes, controlPct, 0), share(bytes, controlPct))},
+      policy_{DropPolicy::kDropNewest, DropPolicy::kDropNewest, DropPolicy::kDropNewest},
+      sampleN_{1, 1, 1},
+      maxSkip_(maxSkip) {}
+
+bool EventQueues::tryPush(EventClass cls, const char *data, size_t len) {
+  if (!rings_[cls].push(data, len, 0, cls)) return false;
+  pushed_[cls]++;
+  stats_[cls].queued++;
+  return true;
+}
+
+bool EventQueues::push(EventClass cls, const char *data, size_t len, size_t &evicted) {
+  Offer result = offer(cls, data, len, evicted);
+  if (result == Offer::kNoRoom) drop(cls);
+  return result == Offer::kQueued;
+}
+
+EventQueues::Offer EventQueues::offer(EventClass cls, const char *data, size_t len,
+                                      size_t &evicted) {
+  evicted = 0;
+  if (tryPush(cls, data, len)) return Offer::kQueued;
+  if (policy_[cls] == DropPolicy::kSample && overflows_[cls]++ % sampleN_[cls] != 0) {
+    drop(cls);
+    return Offer::kSampled;
+  }
+  RecordRing &ring = rings_[cls];
+  // Drop-oldest and a sampled-in arrival make room by evicting.
+  bool evict = policy_[cls] != DropPolicy::kDropNewest;
+  // Evicting cannot make room for a record larger than the ring.
+  if (evict && RecordRing::footprint(len) > ring.capacityBytes()) evict = false;
+  bool queued = false;
+  // Records in flight sit at the front, so they stop the eviction.
+  while (evict && !queued && !ring.empty() && held_[cls] == 0) {
+    ring.pop();
+    popped_[cls]++;
+    evicted++;
+    queued = tryPush(cls, data, len);
+  }
+  stats_[cls].evicted += evicted;
+  return queued ? Offer::kQueued : Offer::kNoRoom;
+}
+
+void EventQueues::setPolicy(EventClass cls, DropPolicy policy, uint16_t sampleN) {
+  policy_[cls] = policy;
+  sampleN_[cls] = sampleN > 0 ? sampleN : 1;
+  overflows_[cls] = 0;
+}
+
+int EventQueues::pick(uint8_t pending) {
+  int chosen = -1;
+  for (int c = kEventClassCount - 1; c >= 0; c--) {
+    if (!(pending & (1u << c))) continue;
+    if (chosen < 0) {
+      chosen = c;
+    } else if (pick_.skips[c] >= maxSkip_) {
+      chosen = c;
+      break;
+    }
+  }
+  for (int c = 0; c < (int)kEventClassCount; c++) {
+    if (c == chosen || !(pending & (1u << c))) {
+      pick_.skips[c] = 0;
+    } else if (pick_.skips[c] < 0xFF) {
+      pick_.skips[c]++;
+    }
+  }
+  return chosen;
+}
+
+EventQueues::PickState EventQueues::pickState() const { return pick_; }
+
+void EventQueues::restorePickState(const PickState &state) { pick_ = state; }
+
+int EventQueues::top() const {
+  for (int c = kEventClassCount - 1; c >= 0; c--) {
+    if (!rings_[c].empty()) return c;
+  }
+  return -1;
+}
+
+void EventQueues::hold(EventClass cls, size_t count) {
+  held_[cls] += count;
+  if (held_[cls] > rings_[cls].count()) held_[cls] = rings_[cls].count();
+  uint32_t end = popped_[cls] + (uint32_t)held_[cls];
+  if ((int32_t)(end - sent_[cls]) > 0) sent_[cls] = end;
+}
+
+void EventQueues::releaseHolds() {
+  for (size_t c = 0; c < kEventClassCount; c++) held_[c] = 0;
+}
+
+size_t EventQueues::firstUnheld(EventClass cls) const {
+  const RecordRing &ring = rings_[cls];
+  size_t off = ring.begin();
+  for (size_t i = 0; i < held_[cls] && off != RecordRing::npos; i++) off = ring.next(off);
+  return off;
+}
+
+void EventQueues::pop(EventClass cls) {
+  if (rings_[cls].empty()) return;
+  rings_[cls].pop();
+  popped_[cls]++;
+  if (held_[cls] > 0) held_[cls]--;
+}
+
+EventQueues::Ref EventQueues::lastPushed(EventClass cls) const {
+  return Ref{(uint32_t)rings_[cls].last(), pushed_[cls] - 1};
+}
+
+// Records leave in push order and are held from the front, so the serial
+// alone says whether the record is still queued and whether it was ever held.
+bool EventQueues::editable(EventClass cls, const Ref &ref) const {
+  uint32_t pos = ref.serial - popped_[cls];
+  return pos < rings_[cls].count() && (int32_t)(ref.serial - sent_[cls]) >= 0;
+}
+
+bool EventQueues::rewrite(EventClass cls, const Ref &ref, const char *data, size_t len) {
+  if (!editable(cls, ref)) return false;
+  RecordRing &ring = rings_[cls];
+  size_t cap = ring.view(ref.off).len;
+  if (len > cap) return false;
+  char *dst = ring.mutableData(ref.off);
+  memcpy(dst, data, len);
+  memset(dst + len, ' ', cap - len);
+  return true;
+}
+
+size_t EventQueues::count() const {
+  size_t n = 0;
+  for (const RecordRing &r : rings_) n += r.count();
+  return n;
+}
+
+size_t EventQueues::bytesUsed() const {
+  size_t n = 0;
+  for (const RecordRing &r : rings_) n += r.bytesUsed();
+  return n;
+}
+
+size_t EventQueues::bytesHighWater() const {
+  size_t n = 0;
+  for (const RecordRing &r : rings_) n += r.bytesHighWater();
+  return n;
+}
+
+size_t EventQueues::capacityBytes() const {
+  size_t n = 0;
+  for (const RecordRing &r : rings_) n += r.capacityBytes();
+  return n;
+}
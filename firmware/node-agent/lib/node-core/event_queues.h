@@ -0,0 +1,130 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "event_schema.h"
+#include "record_ring.h"
+
+// What a full class queue does with one more record.
+enum class DropPolicy : uint8_t {
+  kDropNewest,  // the arriving record is dropped
+  kDropOldest,  // the oldest records are evicted to make room
+  kSample,      // one arrival in N is kept as with kDropOldest, the rest dropped
+};
+
+const char *eventClassName(EventClass cls);
+bool parseEventClass(const char *s, EventClass &out);
+const char *dropPolicyName(DropPolicy policy);
+bool parseDropPolicy(const char *s, DropPolicy &out);
+
+// The node's event queue, split by EventClass: one RecordRing per class over
+// its reserved share of a single arena, so a flood of telemetry cannot take
+// the room that control and status events need. Each record's kind is its
+// class. Records the sender has written but not yet seen acknowledged are
+// held and never evicted or rewritten, and a record written once is never
+// rewritten even after its hold is released: the server may have stored it
+// under its seq already. Records are pushed and popped through
+// this class only, which numbers them so a Ref can tell whether its record
+// is still queued.
+class EventQueues {
+ public:
+  // Scheduler state, saved before a pick so a batch that was not delivered
+  // does not count as a turn.
+  struct PickState {
+    uint8_t skips[kEventClassCount];
+  };
+
+  // A queued record: its offset in the class ring and its push serial.
+  struct Ref {
+    uint32_t off;
+    uint32_t serial;
+  };
+
+  struct Stats {
+    uint32_t queued;   // records accepted
+    uint32_t dropped;  // arrivals refused
+    uint32_t evicted;  // queued records removed to make room
+  };
+
+  // Control and status get their percentage of `bytes`, telemetry the rest.
+  // A lower class with a backlog is passed over at most `maxSkip` times in a
+  // row by pick().
+  EventQueues(uint8_t *arena, size_t bytes, uint8_t controlPct, uint8_t statusPct, uint8_t maxSkip);
+
+  // What offer() did with an arrival.
+  enum class Offer : uint8_t {
+    kQueued,   // queued, possibly after evicting older records
+    kNoRoom,   // the policy keeps it but the class has no room for it
+    kSampled,  // the policy dropped it (sampled out); counted as dropped
+  };
+
+  // Queues a record if it fits, without applying the drop policy.
+  bool tryPush(EventClass cls, const char *data, size_t len);
+  // Queues a record under the class drop policy; `evicted` receives the
+  // number of queued records removed for it. False when it was dropped.
+  bool push(EventClass cls, const char *data, size_t len, size_t &evicted);
+  // Like push(), but an arrival the policy keeps and the class cannot fit
+  // (drop-newest, or eviction stopped by records in flight) is left to the
+  // caller and not counted; drop() counts it if it goes nowhere else.
+  Offer offer(EventClass cls, const char *data, size_t len, size_t &evicted);
+  void drop(EventClass cls) { stats_[cls].dropped++; }
+
+  void setPolicy(EventClass cls, DropPolicy policy, uint16_t sampleN);
+  DropPolicy policy(EventClass cls) const { return policy_[cls]; }
+  uint16_t sampleN(EventClass cls) const { return sampleN_[cls]; }
+
+  // Class to drain next among the bits set in `pending` (1 << class): the
+  // highest, unless a lower one has been passed over maxSkip times in a row.
+  // -1 when `pending` is empty.
+  int pick(uint8_t pending);
+  PickState pickState() const;
+  void restorePickState(const PickState &state);
+  // Highest class with queued records, or -1.
+  int top() const;
+
+  // The record pushed last into a class.
+  Ref lastPushed(EventClass cls) const;
+  // Push serial of the front record of a class, or of the next push when
+  // the class is empty.
+  uint32_t frontSerial(EventClass cls) const { return popped_[cls]; }
+  // True while the record is queued and has never been in flight.
+  bool editable(EventClass cls, const Ref &ref) const;
+  // Overwrites an editable record with `len` bytes, padding the rest of it
+  // with spaces. False when the record is gone, was sent or is shorter.
+  bool rewrite(EventClass cls, const Ref &ref, const char *data, size_t len);
+
+  // Marks `count` more records at the front of a class as in flight.
+  void hold(EventClass cls, size_t count);
+  void releaseHolds();
+  // Offset of the first record of a class not in flight, or
+  // RecordRing::npos when there is none.
+  size_t firstUnheld(EventClass cls) const;
+  // Removes the front record of a class, in flight or not.
+  void pop(EventClass cls);
+
+  const RecordRing &ring(EventClass cls) const { return rings_[cls]; }
+  // For flags and in-place reads; push and pop through the methods above.
+  RecordRing &ring(EventClass cls) { return rings_[cls]; }
+  const Stats &stats(EventClass cls) const { return stats_[cls]; }
+
+  size_t count() const;
+  bool empty() const { return count() == 0; }
+  size_t bytesUsed() const;
+  // Sum of the per-class high-water marks.
+  size_t bytesHighWater() const;
+  size_t capacityBytes() const;
+
+ private:
+  RecordRing rings_[kEventClassCount];
+  Stats stats_[kEventClassCount] = {};
+  DropPolicy policy_[kEventClassCount];
+  uint16_t sampleN_[kEventClassCount];
+  uint32_t overflows_[kEventClassCount] = {};
+  uint32_t pushed_[kEventClassCount] = {};
+  uint32_t popped_[kEventClassCount] = {};
+  size_t held_[kEventClassCount] = {};
+  uint32_t sent_[kEventClassCount] = {};  // serial of the first record never held
+  PickState pick_ = {};
+  uint8_t maxSkip_;
+};
@@ -0,0 +1,363 @@
+#include "event_schema.h"
+
+#include <string.h>
+
+namespace {
+
+const char kHex[] = "0123456789abcdef";
+
+template <typename T>
+const T &valueAt(const void *base, uint16_t offset) {
+  return *reinterpret_cast<const T *>(static_cast<const uint8_t *>(base) + offset);
+}
+
+EventPresence presenceOf(const EventField &f, const void *base) {
+  return f.optional ? valueAt<EventPresence>(base, f.stateOffset) : EventPresence::kSet;
+}
+
+// Writes the hex form of n <= kEventHexMax bytes.
+void writeHex(JsonWriter &w, const uint8_t *b, size_t n) {
+  char buf[kEventHexMax * 2];
+  for (size_t i = 0; i < n; i++) {
+    buf[i * 2] = kHex[b[i] >> 4];
+    buf[i * 2 + 1] = kHex[b[i] & 0x0F];
+  }
+  w.writeString(buf, n * 2);
+}
+
+void writeIp(JsonWriter &w, const EventIp &ip) {
+  char buf[16];
+  size_t len = formatIpv4(buf, ip.b[0], ip.b[1], ip.b[2], ip.b[3]);
+  w.writeString(buf, len);
+}
+
+void writeMac(JsonWriter &w, const uint8_t *mac, bool upper) {
+  char buf[18];
+  size_t len = formatMac(buf, mac, upper);
+  w.writeString(buf, len);
+}
+
+bool writeJsonFields(JsonWriter &w, const EventField *fields, size_t n, const void *base);
+
+// Writes the value of `f` found at `v`.
+bool writeJsonValue(JsonWriter &w, const EventField &f, const void *v) {
+  switch (f.kind) {
+    case EventFieldKind::kU32: w.writeUInt(*static_cast<const uint32_t *>(v)); break;
+    case EventFieldKind::kI32: w.writeInt(*static_cast<const int32_t *>(v)); break;
+    case EventFieldKind::kBool: w.writeBool(*static_cast<const bool *>(v)); break;
+    case EventFieldKind::kText: {
+      const EventText &t = *static_cast<const EventText *>(v);
+      w.writeString(t.p, eventJsonClamp(t.p, t.len, f.size));
+      break;
+    }
+    case EventFieldKind::kMac: writeMac(w, static_cast<const EventMac *>(v)->b, false); break;
+    case EventFieldKind::kMacUpper: writeMac(w, static_cast<const EventMacUpper *>(v)->b, true); break;
+    case EventFieldKind::kIp: writeIp(w, *static_cast<const EventIp *>(v)); break;
+    case EventFieldKind::kIpList: {
+      const EventIp *ips = static_cast<const EventIp *>(v);
+      w.beginArray();
+      for (uint16_t i = 0; i < f.size; i++) writeIp(w, ips[i]);
+      w.endArray();
+      break;
+    }
+    case EventFieldKind::kHex: writeHex(w, static_cast<const uint8_t *>(v), f.size); break;
+    case EventFieldKind::kFixed2: w.writeFixed(static_cast<const EventFixed2 *>(v)->scaled, 2); break;
+    case EventFieldKind::kRaw: {
+      const EventRaw &r = *static_cast<const EventRaw *>(v);
+      if (f.size > 0 && r.len > f.size) return false;
+      w.writeRaw(r.p, r.len);
+      break;
+    }
+    case EventFieldKind::kObject:
+      w.beginObject();
+      if (!writeJsonFields(w, f.sub, f.subCount, v)) return false;
+      w.endObject();
+      break;
+  }
+  return true;
+}
+
+bool writeJsonFields(JsonWriter &w, const EventField *fields, size_t n, const void *base) {
+  for (size_t i = 0; i < n; i++) {
+    const EventField &f = fields[i];
+    EventPresence p = presenceOf(f, base);
+    if (p == EventPresence::kAbsent) continue;
+    w.key(f.key);
+    if (p == EventPresence::kNull) {
+      w.writeNull();
+    } else if (!writeJsonValue(w, f, static_cast<const uint8_t *>(base) + f.offset)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// ---- binary ----------------------------------------------------------------
+
+struct Out {
+  uint8_t *p;
+  size_t cap;
+  size_t len;
+  bool ok;
+
+  void byte(uint8_t b) {
+    if (len < cap) {
+      p[len++] = b;
+    } else {
+      ok = false;
+    }
+  }
+  void bytes(const void *src, size_t n) {
+    if (cap - len < n) {
+      ok = false;
+      return;
+    }
+    memcpy(p + len, src, n);
+    len += n;
+  }
+  void varint(uint32_t v) {
+    while (v >= 0x80) {
+      byte((uint8_t)(v | 0x80));
+      v >>= 7;
+    }
+    byte((uint8_t)v);
+  }
+  void zigzag(int32_t v) { varint(((uint32_t)v << 1) ^ (uint32_t)(v >> 31)); }
+};
+
+void putBinaryFields(Out &o, const EventField *fields, size_t n, const void *base);
+
+void putBinaryValue(Out &o, const EventField &f, const void *v) {
+  switch (f.kind) {
+    case EventFieldKind::kU32: o.varint(*static_cast<const uint32_t *>(v)); break;
+    case EventFieldKind::kI32: o.zigzag(*static_cast<const int32_t *>(v)); break;
+    case EventFieldKind::kBool: o.byte(*static_cast<const bool *>(v) ? 1 : 0); break;
+    case EventFieldKind::kText: {
+      const EventText &t = *static_cast<const EventText *>(v);
+      size_t len = eventJsonClamp(t.p, t.len, f.size);
+      o.varint((uint32_t)len);
+      o.bytes(t.p, len);
+      break;
+    }
+    case EventFieldKind::kMac:
+    case EventFieldKind::kMacUpper: o.bytes(v, 6); break;
+    case EventFieldKind::kIp: o.bytes(v, 4); break;
+    case EventFieldKind::kIpList: o.bytes(v, (size_t)f.size * 4); break;
+    case EventFieldKind::kHex: o.bytes(v, f.size); break;
+    case EventFieldKind::kFixed2: o.zigzag(static_cast<const EventFixed2 *>(v)->scaled); break;
+    case EventFieldKind::kRaw: {
+      const EventRaw &r = *static_cast<const EventRaw *>(v);
+      if (f.size > 0 && r.len > f.size) o.ok = false;
+      o.varint((uint32_t)r.len);
+      o.bytes(r.p, r.len);
+      break;
+    }
+    case EventFieldKind::kObject: putBinaryFields(o, f.sub, f.subCount, v); break;
+  }
+}
+
+void putBinaryFields(Out &o, const EventField *fields, size_t n, const void *base) {
+  for (size_t i = 0; i < n && o.ok; i++) {
+    const EventField &f = fields[i];
+    EventPresence p = presenceOf(f, base);
+    if (f.optional) o.byte((uint8_t)p);
+    if (p == EventPresence::kSet) putBinaryValue(o, f, static_cast<const uint8_t *>(base) + f.offset);
+  }
+}
+
+struct In {
+  const uint8_t *p;
+  size_t len;
+  size_t pos;
+  bool ok;
+
+  uint8_t byte() {
+    if (pos < len) return p[pos++];
+    ok = false;
+    return 0;
+  }
+  const uint8_t *bytes(size_t n) {
+    if (len - pos < n) {
+      ok = false;
+      return nullptr;
+    }
+    const uint8_t *b = p + pos;
+    pos += n;
+    return b;
+  }
+  uint32_t varint() {
+    uint32_t v = 0;
+    for (int shift = 0; shift < 35 && ok; shift += 7) {
+      uint8_t b = byte();
+      v |= (uint32_t)(b & 0x7F) << shift;
+      if ((b & 0x80) == 0) return v;
+    }
+    ok = false;
+    return 0;
+  }
+  int32_t zigzag() {
+    uint32_t v = varint();
+    return (int32_t)((v >> 1) ^ (0U - (v & 1)));
+  }
+};
+
+bool readBinaryFields(In &in, JsonWriter &w, const EventField *fields, size_t n);
+
+bool readBinaryValue(In &in, JsonWriter &w, const EventField &f) {
+  switch (f.kind) {
+    case EventFieldKind::kU32: w.writeUInt(in.varint()); break;
+    case EventFieldKind::kI32: w.writeInt(in.zigzag()); break;
+    case EventFieldKind::kBool: w.writeBool(in.byte() != 0); break;
+    case EventFieldKind::kText: {
+      uint32_t len = in.varint();
+      const uint8_t *b = in.bytes(len);
+      if (b) w.writeString(reinterpret_cast<const char *>(b), len);
+      break;
+    }
+    case EventFieldKind::kMac:
+    case EventFieldKind::kMacUpper: {
+      const uint8_t *b = in.bytes(6);
+      if (b) writeMac(w, b, f.kind == EventFieldKind::kMacUpper);
+      break;
+    }
+    case EventFieldKind::kIp: {
+      const uint8_t *b = in.bytes(4);
+      if (b) writeIp(w, EventIp{{b[0], b[1], b[2], b[3]}});
+      break;
+    }
+    case EventFieldKind::kIpList:
+      w.beginArray();
+      for (uint16_t i = 0; i < f.size && in.ok; i++) {
+        const uint8_t *b = in.bytes(4);
+        if (b) writeIp(w, EventIp{{b[0], b[1], b[2], b[3]}});
+      }
+      w.endArray();
+      break;
+    case EventFieldKind::kHex: {
+      const uint8_t *b = in.bytes(f.size);
+      if (b) writeHex(w, b, f.size);
+      break;
+    }
+    case EventFieldKind::kFixed2: w.writeFixed(in.zigzag(), 2); break;
+    case EventFieldKind::kRaw: {
+      uint32_t len = in.varint();
+      const uint8_t *b = in.bytes(len);
+      if (b) w.writeRaw(reinterpret_cast<const char *>(b), len);
+      break;
+    }
+    case EventFieldKind::kObject:
+      w.beginObject();
+      if (!readBinaryFields(in, w, f.sub, f.subCount)) return false;
+      w.endObject();
+      break;
+  }
+  return in.ok;
+}
+
+bool readBinaryFields(In &in, JsonWriter &w, const EventField *fields, size_t n) {
+  for (size_t i = 0; i < n && in.ok; i++) {
+    const EventField &f = fields[i];
+    uint8_t p = f.optional ? in.byte() : (uint8_t)EventPresence::kSet;
+    if (p == (uint8_t)EventPresence::kAbsent) continue;
+    if (p > (uint8_t)EventPresence::kSet) return false;
+    w.key(f.key);
+    if (p == (uint8_t)EventPresence::kNull) {
+      w.writeNull();
+    } else if (!readBinaryValue(in, w, f)) {
+      return false;
+    }
+  }
+  return in.ok;
+}
+
+}  // namespace
+
+size_t eventJsonClamp(const char *s, size_t len, size_t budget) {
+  if (len <= budget && jsonEscapeScan(s, len) == len) return len;
+  size_t used = 0;
+  size_t i = 0;
+  size_t cut = 0;  // last character boundary that fits
+  while (i < len) {
+    uint8_t c = (uint8_t)s[i];
+    size_t cost = 1;
+    if (c == '"' || c == '\\' || c == '\n' || c == '\r' || c == '\t' || c == '\b' || c == '\f') {
+      cost = 2;
+    } else if (c < 0x20) {
+      cost = 6;
+    }
+    if (used + cost > budget) break;
+    used += cost;
+    i++;
+    // Only cut before a byte that starts a character.
+    if (i == len || ((uint8_t)s[i] & 0xC0) != 0x80) cut = i;
+  }
+  return cut;
+}
+
+bool eventEncodeJson(JsonWriter &w, const EventDesc &d, const EventEnvelope &env, const void *value) {
+  size_t idLen = eventJsonClamp(env.node_id.p, env.node_id.len, kEventNodeIdMax);
+  w.beginObject();
+  w.fieldUInt("v", env.v);
+  w.fieldUInt("ts_ms", env.ts_ms);
+  w.fieldStr("node_id", env.node_id.p, idLen);
+  w.fieldStr("type", d.type);
+  w.fieldStr("src", env.node_id.p, idLen);
+  w.fieldUInt("seq", env.seq);
+  w.fieldUInt("epoch", env.epoch);
+  if (!writeJsonFields(w, d.envelope, d.envelopeCount, value)) return false;
+  w.key("data");
+  w.beginObject();
+  if (!writeJsonFields(w, d.data, d.dataCount, value)) return false;
+  w.endObject();
+  w.endObject();
+  return !w.overflowed();
+}
+
+size_t eventEncodeBinary(uint8_t *out, size_t cap, const EventDesc &d, const EventEnvelope &env,
+                         const void *value) {
+  Out o = {out, cap, 0, true};
+  size_t idLen = eventJsonClamp(env.node_id.p, env.node_id.len, kEventNodeIdMax);
+  o.byte(d.id);
+  o.varint(env.v);
+  o.varint(env.ts_ms);
+  o.varint((uint32_t)idLen);
+  o.bytes(env.node_id.p, idLen);
+  o.varint(env.seq);
+  o.varint(env.epoch);
+  putBinaryFields(o, d.envelope, d.envelopeCount, value);
+  putBinaryFields(o, d.data, d.dataCount, value);
+  return o.ok ? o.len : 0;
+}
+
+bool eventDecodeBinary(const uint8_t *in, size_t len, const EventDesc *const *types, size_t typeCount,
+                       JsonWriter &w) {
+  In r = {in, len, 0, true};
+  uint8_t id = r.byte();
+  const EventDesc *d = nullptr;
+  for (size_t i = 0; i < typeCount; i++) {
+    if (types[i]->id == id) d = types[i];
+  }
+  if (!d) return false;
+  uint32_t v = r.varint();
+  uint32_t ts = r.varint();
+  uint32_t idLen = r.varint();
+  const uint8_t *nodeId = r.bytes(idLen);
+  uint32_t seq = r.varint();
+  uint32_t epoch = r.varint();
+  if (!r.ok) return false;
+  w.beginObject();
+  w.fieldUInt("v", v);
+  w.fieldUInt("ts_ms", ts);
+  w.fieldStr("node_id", reinterpret_cast<const char *>(nodeId), idLen);
+  w.fieldStr("type", d->type);
+  w.fieldStr("src", reinterpret_cast<const char *>(nodeId), idLen);
+  w.fieldUInt("seq", seq);
+  w.fieldUInt("epoch", epoch);
+  if (!readBinaryFields(r, w, d->envelope, d->envelopeCount)) return false;
+  w.key("data");
+  w.beginObject();
+  if (!readBinaryFields(r, w, d->data, d->dataCount)) return false;
+  w.endObject();
+  w.endObject();
+  return r.pos == len && !w.overflowed();
+}
@@ -0,0 +1,318 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "json_writer.h"
+
+// Compile-time event descriptors. An event type is a plain struct of field
+// values plus a constexpr table naming each field once: JSON key, kind
+// (taken from the member's type), offset and, for text, a size budget. The
+// same table drives the JSON encoder, the binary encoder and the static
+// maximum size of either, so the envelope is always complete and a builder
+// cannot outgrow its buffer unnoticed (see eventJsonMax()).
+
+// Field value types. Text is not owned and must outlive the encode call.
+struct EventText {
+  const char *p;
+  size_t len;
+};
+struct EventMac {  // lower-case "aa:bb:.."
+  uint8_t b[6];
+};
+struct EventMacUpper {  // upper-case "AA:BB:.."
+  uint8_t b[6];
+};
+struct EventIp {
+  uint8_t b[4];
+};
+template <size_t N>
+struct EventIpList {
+  EventIp ip[N];
+};
+template <size_t N>
+struct EventHex {  // written as lower-case hex
+  uint8_t b[N];
+};
+struct EventFixed2 {  // value * 100, written with two decimals
+  int32_t scaled;
+};
+struct EventRaw {  // an already-serialized JSON value, written verbatim
+  const char *p;
+  size_t len;
+};
+
+// A field that may be left out (the default) or written as null.
+enum class EventPresence : uint8_t { kAbsent = 0, kNull = 1, kSet = 2 };
+
+template <typename T>
+struct EventOpt {
+  EventPresence state = EventPresence::kAbsent;
+  T value{};
+
+  void set(const T &v) {
+    value = v;
+    state = EventPresence::kSet;
+  }
+  void setNull() { state = EventPresence::kNull; }
+};
+
+enum class EventFieldKind : uint8_t {
+  kU32,
+  kI32,
+  kBool,
+  kText,
+  kMac,
+  kMacUpper,
+  kIp,
+  kIpList,
+  kHex,
+  kFixed2,
+  kRaw,
+  kObject,
+};
+
+struct EventField {
+  const char *key;
+  EventFieldKind kind;
+  bool optional;          // the member is an EventOpt
+  uint16_t offset;        // of the value (inside the EventOpt when optional)
+  uint16_t stateOffset;   // of the EventOpt state
+  uint16_t size;          // text: encoded byte budget (0 = unbounded raw); hex, ip list: count
+  const EventField *sub;  // kObject
+  uint8_t subCount;
+};
+
+// Queue class of an event type, also the order the sender drains them in:
+// higher classes first. Telemetry is 0 so records spilled before classes
+// existed (kind 0) replay as telemetry.
+enum EventClass : uint8_t {
+  kEventTelemetry = 0,
+  kEventStatus = 1,
+  kEventControl = 2,
+};
+constexpr size_t kEventClassCount = 3;
+
+struct EventDesc {
+  const char *type;
+  uint8_t id;                   // type tag in the binary encoding
+  const EventField *envelope;   // extra envelope fields, written before "data"
+  uint8_t envelopeCount;
+  const EventField *data;
+  uint8_t dataCount;
+  EventClass cls;
+};
+
+// Common envelope; "src" is written from node_id. `seq` counts events
+// since boot and `epoch` counts boots, so (node_id, epoch, seq) names one
+// event for good.
+struct EventEnvelope {
+  uint32_t v;
+  uint32_t ts_ms;
+  EventText node_id;
+  uint32_t seq;
+  uint32_t epoch;
+};
+
+// Encoded budget of node_id (and src); longer ids are cut.
+constexpr size_t kEventNodeIdMax = 48;
+// Longest EventHex.
+constexpr size_t kEventHexMax = 32;
+
+template <typename T>
+struct EventKindOf;
+#define EVENT_KIND_OF(T, K, N)                         \
+  template <>                                          \
+  struct EventKindOf<T> {                              \
+    static constexpr EventFieldKind kind = EventFieldKind::K; \
+    static constexpr uint16_t count = N;               \
+  }
+EVENT_KIND_OF(uint32_t, kU32, 0);
+EVENT_KIND_OF(int32_t, kI32, 0);
+EVENT_KIND_OF(bool, kBool, 0);
+EVENT_KIND_OF(EventText, kText, 0);
+EVENT_KIND_OF(EventMac, kMac, 0);
+EVENT_KIND_OF(EventMacUpper, kMacUpper, 0);
+EVENT_KIND_OF(EventIp, kIp, 0);
+EVENT_KIND_OF(EventFixed2, kFixed2, 0);
+EVENT_KIND_OF(EventRaw, kRaw, 0);
+#undef EVENT_KIND_OF
+template <size_t N>
+struct EventKindOf<EventIpList<N>> {
+  static constexpr EventFieldKind kind = EventFieldKind::kIpList;
+  static constexpr uint16_t count = N;
+};
+template <size_t N>
+struct EventKindOf<EventHex<N>> {
+  static_assert(N <= kEventHexMax, "EventHex too long");
+  static constexpr EventFieldKind kind = EventFieldKind::kHex;
+  static constexpr uint16_t count = N;
+};
+template <typename T>
+struct EventKindOf<EventOpt<T>> : EventKindOf<T> {};
+
+template <typename T>
+struct EventOptTraits {
+  static constexpr bool optional = false;
+  static constexpr size_t valueOffset = 0;
+};
+template <typename T>
+struct EventOptTraits<EventOpt<T>> {
+  static constexpr bool optional = true;
+  static constexpr size_t valueOffset = offsetof(EventOpt<T>, value);
+};
+
+template <typename T, size_t N>
+constexpr uint8_t eventCount(const T (&)[N]) {
+  return (uint8_t)N;
+}
+
+#define EVENT_FIELD_AT(S, K, M, SIZE, SUB, SUBN)                                               \
+  EventField {                                                                                \
+    K, EventKindOf<decltype(S::M)>::kind, EventOptTraits<decltype(S::M)>::optional,           \
+        (uint16_t)(offsetof(S, M) + EventOptTraits<decltype(S::M)>::valueOffset),             \
+        (uint16_t)offsetof(S, M),                                                              \
+        (uint16_t)((SIZE) ? (SIZE) : EventKindOf<decltype(S::M)>::count), SUB, SUBN           \
+  }
+// A field whose JSON key is the member name.
+#define EVENT_FIELD(S, M) EVENT_FIELD_AT(S, #M, M, 0, nullptr, 0)
+// Text or raw JSON with an encoded byte budget.
+#define EVENT_TEXT(S, M, SIZE) EVENT_FIELD_AT(S, #M, M, SIZE, nullptr, 0)
+// The same member under another key (envelope copies of data fields).
+#define EVENT_FIELD_AS(S, KEY, M) EVENT_FIELD_AT(S, KEY, M, 0, nullptr, 0)
+#define EVENT_TEXT_AS(S, KEY, M, SIZE) EVENT_FIELD_AT(S, KEY, M, SIZE, nullptr, 0)
+// A nested object described by its own field table.
+#define EVENT_OBJECT(S, M, FIELDS)                                                   \
+  EventField {                                                                      \
+    #M, EventFieldKind::kObject, EventOptTraits<decltype(S::M)>::optional,          \
+        (uint16_t)(offsetof(S, M) + EventOptTraits<decltype(S::M)>::valueOffset),   \
+        (uint16_t)offsetof(S, M), 0, FIELDS, eventCount(FIELDS)                      \
+  }
+
+// ---- static sizes ------------------------------------------------------------
+
+constexpr size_t eventStrLen(const char *s) {
+  size_t n = 0;
+  while (s[n]) n++;
+  return n;
+}
+
+constexpr size_t eventVarintMax(size_t v) {
+  size_t n = 1;
+  while (v >= 0x80) {
+    v >>= 7;
+    n++;
+  }
+  return n;
+}
+
+constexpr size_t eventFieldsJsonMax(const EventField *f, size_t n);
+constexpr size_t eventFieldsBinaryMax(const EventField *f, size_t n);
+
+constexpr size_t eventValueJsonMax(const EventField &f) {
+  switch (f.kind) {
+    case EventFieldKind::kU32: return 10;
+    case EventFieldKind::kI32: return 11;
+    case EventFieldKind::kBool: return 5;
+    case EventFieldKind::kText: return f.size + 2;
+    case EventFieldKind::kMac:
+    case EventFieldKind::kMacUpper: return 19;
+    case EventFieldKind::kIp: return 17;
+    case EventFieldKind::kIpList: return f.size * 18 + 1;
+    case EventFieldKind::kHex: return f.size * 2 + 2;
+    case EventFieldKind::kFixed2: return 12;
+    case EventFieldKind::kRaw: return f.size;
+    case EventFieldKind::kObject: return 2 + eventFieldsJsonMax(f.sub, f.subCount);
+  }
+  return 0;
+}
+
+constexpr size_t eventValueBinaryMax(const EventField &f) {
+  switch (f.kind) {
+    case EventFieldKind::kU32:
+    case EventFieldKind::kI32:
+    case EventFieldKind::kFixed2: return 5;
+    case EventFieldKind::kBool: return 1;
+    case EventFieldKind::kText:
+    case EventFieldKind::kRaw: return eventVarintMax(f.size) + f.size;
+    case EventFieldKind::kMac:
+    case EventFieldKind::kMacUpper: return 6;
+    case EventFieldKind::kIp: return 4;
+    case EventFieldKind::kIpList: return f.size * 4;
+    case EventFieldKind::kHex: return f.size;
+    case EventFieldKind::kObject: return eventFieldsBinaryMax(f.sub, f.subCount);
+  }
+  return 0;
+}
+
+// `"key":value,` with the value at its longest (null for optional fields).
+constexpr size_t eventKeyJsonMax(const char *key, size_t valueMax) {
+  return eventStrLen(key) + 4 + valueMax;
+}
+
+constexpr size_t eventFieldsJsonMax(const EventField *f, size_t n) {
+  size_t total = 0;
+  for (size_t i = 0; i < n; i++) {
+    size_t v = eventValueJsonMax(f[i]);
+    total += eventKeyJsonMax(f[i].key, f[i].optional && v < 4 ? 4 : v);
+  }
+  return total;
+}
+
+constexpr size_t eventFieldsBinaryMax(const EventField *f, size_t n) {
+  size_t total = 0;
+  for (size_t i = 0; i < n; i++) total += (f[i].optional ? 1 : 0) + eventValueBinaryMax(f[i]);
+  return total;
+}
+
+// Longest JSON encoding, excluding the NUL and any unbounded raw field.
+constexpr size_t eventJsonMax(const EventDesc &d) {
+  return 2 + eventKeyJsonMax("v", 10) + eventKeyJsonMax("ts_ms", 10) +
+         eventKeyJsonMax("node_id", kEventNodeIdMax + 2) +
+         eventKeyJsonMax("type", eventStrLen(d.type) + 2) +
+         eventKeyJsonMax("src", kEventNodeIdMax + 2) + eventKeyJsonMax("seq", 10) +
+         eventKeyJsonMax("epoch", 10) + eventFieldsJsonMax(d.envelope, d.envelopeCount) +
+         eventKeyJsonMax("data", 2 + eventFieldsJsonMax(d.data, d.dataCount));
+}
+
+// Longest binary encoding, excluding any unbounded raw field.
+constexpr size_t eventBinaryMax(const EventDesc &d) {
+  return 1 + 5 + 5 + eventVarintMax(kEventNodeIdMax) + kEventNodeIdMax + 5 + 5 +
+         eventFieldsBinaryMax(d.envelope, d.envelopeCount) +
+         eventFieldsBinaryMax(d.data, d.dataCount);
+}
+
+// ---- encoders ----------------------------------------------------------------
+
+// Writes the event as one JSON object. Text longer than its budget is cut
+// (at a character boundary) so its escaped form fits. False when `w`
+// overflowed or a raw value exceeded its budget.
+bool eventEncodeJson(JsonWriter &w, const EventDesc &d, const EventEnvelope &env, const void *value);
+
+// Compact positional encoding: type id, then the envelope and every field
+// in table order with no keys. Integers are LEB128 varints (signed ones
+// zigzagged), text is length-prefixed and cut exactly as in JSON, MACs and
+// IPs are raw bytes, and optional fields carry a presence byte. Returns the
+// length, or 0 when `cap` is too small.
+size_t eventEncodeBinary(uint8_t *out, size_t cap, const EventDesc &d, const EventEnvelope &env,
+                         const void *value);
+
+// Renders a binary event as the JSON eventEncodeJson() writes for it.
+// `types` lists the descriptors the id may name.
+bool eventDecodeBinary(const uint8_t *in, size_t len, const EventDesc *const *types, size_t typeCount,
+                       JsonWriter &w);
+
+// Length of the longest prefix of `s` whose JSON-escaped form fits in
+// `budget` bytes, never splitting a UTF-8 sequence.
+size_t eventJsonClamp(const char *s, size_t len, size_t budget);
+
+// Typed wrappers; eventDescOf(const T *) names the descriptor of T.
+template <typename T>
+bool eventEncodeJson(JsonWriter &w, const EventEnvelope &env, const T &ev) {
+  return eventEncodeJson(w, eventDescOf(static_cast<const T *>(nullptr)), env, &ev);
+}
+
+template <typename T>
+size_t eventEncodeBinary(uint8_t *out, size_t cap, const EventEnvelope &env, const T &ev) {
+  return eventEncodeBinary(out, cap, eventDescOf(static_cast<const T *>(nullptr)), env, &ev);
+}
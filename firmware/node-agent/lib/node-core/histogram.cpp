@@ -0,0 +1,41 @@
+#include "histogram.h"
+
+void Histogram::snapshot(Snapshot &out) const {
+  for (;;) {
+    uint32_t before = seq_.load(std::memory_order_acquire);
+    if (before & 1) continue;  // writer mid-update
+    out.count = 0;
+    for (size_t i = 0; i < kBuckets; i++) {
+      out.counts[i] = counts_[i].load(std::memory_order_relaxed);
+      out.count += out.counts[i];
+    }
+    out.sum = (uint64_t)sumHi_.load(std::memory_order_relaxed) << 32 |
+              sumLo_.load(std::memory_order_relaxed);
+    out.max = max_.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (seq_.load(std::memory_order_relaxed) == before) return;
+  }
+}
+
+void Histogram::reset() {
+  uint32_t seq = seq_.load(std::memory_order_relaxed);
+  seq_.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  for (size_t i = 0; i < kBuckets; i++) counts_[i].store(0, std::memory_order_relaxed);
+  sumLo_.store(0, std::memory_order_relaxed);
+  sumHi_.store(0, std::memory_order_relaxed);
+  max_.store(0, std::memory_order_relaxed);
+  seq_.store(seq + 2, std::memory_order_release);
+}
+
+uint32_t Histogram::quantile(const Snapshot &s, double q) {
+  if (s.count == 0) return 0;
+  uint64_t rank = (uint64_t)(q * (double)s.count + 0.999999);
+  if (rank == 0) rank = 1;
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kBuckets - 1; i++) {
+    seen += s.counts[i];
+    if (seen >= rank) return bound(i) < s.max ? bound(i) : s.max;
+  }
+  return s.max;
+}
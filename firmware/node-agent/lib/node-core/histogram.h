@@ -0,0 +1,105 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+// Fixed-bucket latency histogram. Bucket i counts values <= 2^i (in whatever
+// unit the caller records); the last bucket is unbounded. One task records,
+// any task may read: the writer brackets each update with a sequence counter
+// (a seqlock), so record() never blocks or takes a lock, and snapshot()
+// retries until it copies a consistent state.
+class Histogram {
+ public:
+  static constexpr size_t kBuckets = 24;
+
+  struct Snapshot {
+    uint32_t counts[kBuckets];  // per bucket, not cumulative
+    uint64_t count;
+    uint64_t sum;
+    uint32_t max;
+  };
+
+  // Upper bound of bucket i; the last bucket has none.
+  static uint32_t bound(size_t i) { return 1u << i; }
+  static size_t bucketFor(uint32_t v) {
+    if (v <= 1) return 0;
+    size_t i = 32 - (size_t)__builtin_clz(v - 1);
+    return i < kBuckets - 1 ? i : kBuckets - 1;
+  }
+
+  void record(uint32_t v) {
+    uint32_t seq = seq_.load(std::memory_order_relaxed);
+    seq_.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    size_t b = bucketFor(v);
+    counts_[b].store(counts_[b].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    uint32_t lo = sumLo_.load(std::memory_order_relaxed);
+    uint32_t nextLo = lo + v;
+    sumLo_.store(nextLo, std::memory_order_relaxed);
+    if (nextLo < lo) sumHi_.store(sumHi_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    if (v > max_.load(std::memory_order_relaxed)) max_.store(v, std::memory_order_relaxed);
+    seq_.store(seq + 2, std::memory_order_release);
+  }
+
+  // Writer side only, like record().
+  void reset();
+
+  void snapshot(Snapshot &out) const;
+  // Smallest bucket bound covering fraction `q` (0..1] of the values, or
+  // the maximum when that lands in the unbounded bucket; 0 when empty.
+  static uint32_t quantile(const Snapshot &s, double q);
+
+ private:
+  std::atomic<uint32_t> seq_{0};
+  std::atomic<uint32_t> counts_[kBuckets] = {};
+  std::atomic<uint32_t> sumLo_{0};
+  std::atomic<uint32_t> sumHi_{0};
+  std::atomic<uint32_t> max_{0};
+};
+
+// Measures how long records wait in a FIFO without a timestamp per record.
+// The push time of up to Slots queued records is remembered by their
+// position in the stream; when that record is popped, its wait goes into the
+// histogram. Records pushed while every slot is taken are simply not sampled.
+template <size_t Slots>
+class FifoResidence {
+ public:
+  void onPush(uint32_t nowMs) {
+    uint32_t seq = pushed_++;
+    if (count_ == Slots) return;
+    slots_[(head_ + count_) % Slots] = Sample{seq, nowMs};
+    count_++;
+  }
+
+  void onPop(uint32_t nowMs, Histogram &hist) {
+    uint32_t seq = popped_++;
+    if (count_ == 0 || slots_[head_].seq != seq) return;
+    hist.record(nowMs - slots_[head_].ms);
+    head_ = (head_ + 1) % Slots;
+    count_--;
+  }
+
+  // A record removed from the front without being delivered.
+  void onDrop() {
+    uint32_t seq = popped_++;
+    if (count_ == 0 || slots_[head_].seq != seq) return;
+    head_ = (head_ + 1) % Slots;
+    count_--;
+  }
+
+  size_t pending() const { return count_; }
+
+ private:
+  struct Sample {
+    uint32_t seq;
+    uint32_t ms;
+  };
+
+  Sample slots_[Slots] = {};
+  size_t head_ = 0;
+  size_t count_ = 0;
+  uint32_t pushed_ = 0;
+  uint32_t popped_ = 0;
+};
@@ -0,0 +1,251 @@
+#include "http_wire.h"
+
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+
+char lower(char c) { return (c >= 'A' && c <= 'Z') ? char(c + 32) : c; }
+
+// Case-insensitive prefix match; returns the remainder with leading spaces
+// skipped, or nullptr.
+const char *headerValue(const char *line, const char *name) {
+  size_t i = 0;
+  for (; name[i]; i++) {
+    if (lower(line[i]) != name[i]) return nullptr;
+  }
+  const char *v = line + i;
+  while (*v == ' ' || *v == '\t') v++;
+  return v;
+}
+
+bool containsNoCase(const char *s, const char *needle) {
+  size_t n = strlen(needle);
+  for (; *s; s++) {
+    size_t i = 0;
+    while (i < n && lower(s[i]) == needle[i]) i++;
+    if (i == n) return true;
+  }
+  return false;
+}
+
+}  // namespace
+
+bool parseHttpUrl(const char *url, HttpUrl &out) {
+  out = HttpUrl();
+  const char *p = url;
+  if (strncmp(p, "http://", 7) == 0) {
+    p += 7;
+    out.port = 80;
+  } else if (strncmp(p, "https://", 8) == 0) {
+    p += 8;
+    out.tls = true;
+    out.port = 443;
+  } else {
+    return false;
+  }
+  size_t hostLen = strcspn(p, ":/?");
+  if (hostLen == 0 || hostLen >= sizeof(out.host)) return false;
+  memcpy(out.host, p, hostLen);
+  out.host[hostLen] = '\0';
+  p += hostLen;
+  if (*p == ':') {
+    p++;
+    uint32_t port = 0;
+    size_t digits = 0;
+    while (*p >= '0' && *p <= '9') {
+      port = port * 10 + uint32_t(*p - '0');
+      if (port > 65535) return false;
+      p++;
+      digits++;
+    }
+    if (digits == 0 || port == 0) return false;
+    out.port = (uint16_t)port;
+  }
+  if (*p == '\0') {
+    out.path[0] = '/';
+    out.path[1] = '\0';
+    return true;
+  }
+  size_t pathLen = strlen(p);
+  bool slash = *p == '/';
+  if (pathLen + (slash ? 0 : 1) >= sizeof(out.path)) return false;
+  size_t o = 0;
+  if (!slash) out.path[o++] = '/';
+  memcpy(out.path + o, p, pathLen + 1);
+  return true;
+}
+
+size_t formatPostHead(char *out, size_t cap, const HttpUrl &url, const char *contentType,
+                      const char *contentEncoding, size_t contentLength) {
+  bool defaultPort = url.port == (url.tls ? 443 : 80);
+  char port[8] = {0};
+  if (!defaultPort) snprintf(port, sizeof(port), ":%u", (unsigned)url.port);
+  int n = snprintf(out, cap,
+                   "POST %s HTTP/1.1\r\nHost: %s%s\r\nContent-Type: %s\r\n%s%s%s"
+                   "Content-Length: %lu\r\nConnection: keep-alive\r\n\r\n",
+                   url.path, url.host, port, contentType,
+                   contentEncoding ? "Content-Encoding: " : "", contentEncoding ? contentEncoding : "",
+                   contentEncoding ? "\r\n" : "", (unsigned long)contentLength);
+  if (n < 0 || (size_t)n >= cap) return 0;
+  return (size_t)n;
+}
+
+void HttpResponseParser::reset() {
+  state_ = kStatusLine;
+  lineLen_ = 0;
+  status_ = 0;
+  keepAlive_ = true;
+  chunked_ = false;
+  haveLength_ = false;
+  remaining_ = 0;
+  seen_ = 0;
+  bodyLen_ = 0;
+  body_[0] = '\0';
+}
+
+bool HttpResponseParser::takeLine(const char *data, size_t len, size_t &i) {
+  while (i < len) {
+    char c = data[i++];
+    if (c == '\n') {
+      if (lineLen_ > 0 && line_[lineLen_ - 1] == '\r') lineLen_--;
+      line_[lineLen_] = '\0';
+      lineLen_ = 0;
+      return true;
+    }
+    // Over-long lines are truncated; only short headers matter here.
+    if (lineLen_ < sizeof(line_) - 1) line_[lineLen_++] = c;
+  }
+  return false;
+}
+
+void HttpResponseParser::onStatusLine() {
+  if (strncmp(line_, "HTTP/1.", 7) != 0 || strlen(line_) < 12 || line_[8] != ' ') {
+    state_ = kError;
+    return;
+  }
+  int code = 0;
+  for (int i = 9; i < 12; i++) {
+    if (line_[i] < '0' || line_[i] > '9') {
+      state_ = kError;
+      return;
+    }
+    code = code * 10 + (line_[i] - '0');
+  }
+  status_ = code;
+  keepAlive_ = line_[7] != '0';
+  state_ = kHeaders;
+}
+
+void HttpResponseParser::onHeaderLine() {
+  const char *v;
+  if ((v = headerValue(line_, "content-length:")) != nullptr) {
+    uint64_t n = 0;
+    while (*v >= '0' && *v <= '9') n = n * 10 + uint64_t(*v++ - '0');
+    remaining_ = n;
+    haveLength_ = true;
+  } else if ((v = headerValue(line_, "transfer-encoding:")) != nullptr) {
+    chunked_ = containsNoCase(v, "chunked");
+  } else if ((v = headerValue(line_, "connection:")) != nullptr) {
+    if (containsNoCase(v, "close")) keepAlive_ = false;
+    else if (containsNoCase(v, "keep-alive")) keepAlive_ = true;
+  }
+}
+
+void HttpResponseParser::startBody() {
+  if (status_ >= 100 && status_ < 200) {
+    // Interim response (e.g. 100 Continue): the real one follows.
+    bool keep = keepAlive_;
+    reset();
+    keepAlive_ = keep;
+    seen_ = 1;
+    return;
+  }
+  if (status_ == 204 || status_ == 304) {
+    state_ = kDone;
+  } else if (chunked_) {
+    state_ = kChunkSize;
+  } else if (haveLength_) {
+    state_ = remaining_ == 0 ? kDone : kBody;
+  } else {
+    keepAlive_ = false;
+    state_ = kBodyUntilClose;
+  }
+}
+
+void HttpResponseParser::keepBody(const char *data, size_t len) {
+  size_t room = kBodyKeep - bodyLen_;
+  if (len > room) len = room;
+  memcpy(body_ + bodyLen_, data, len);
+  bodyLen_ += len;
+  body_[bodyLen_] = '\0';
+}
+
+size_t HttpResponseParser::feed(const char *data, size_t len) {
+  size_t i = 0;
+  while (i < len && state_ != kDone && state_ != kError) {
+    size_t before = i;
+    switch (state_) {
+      case kStatusLine:
+        if (takeLine(data, len, i)) onStatusLine();
+        break;
+      case kHeaders:
+        if (takeLine(data, len, i)) {
+          if (line_[0] == '\0') startBody();
+          else onHeaderLine();
+        }
+        break;
+      case kBody:
+      case kChunkData: {
+        size_t take = len - i;
+        if (take > remaining_) take = (size_t)remaining_;
+        keepBody(data + i, take);
+        i += take;
+        remaining_ -= take;
+        if (remaining_ == 0) state_ = state_ == kBody ? kDone : kChunkEnd;
+        break;
+      }
+      case kBodyUntilClose:
+        keepBody(data + i, len - i);
+        i = len;
+        break;
+      case kChunkSize:
+        if (takeLine(data, len, i)) {
+          uint64_t n = 0;
+          const char *p = line_;
+          size_t digits = 0;
+          for (;; p++, digits++) {
+            char c = lower(*p);
+            if (c >= '0' && c <= '9') n = n * 16 + uint64_t(c - '0');
+            else if (c >= 'a' && c <= 'f') n = n * 16 + uint64_t(c - 'a' + 10);
+            else break;
+          }
+          if (digits == 0) {
+            state_ = kError;
+          } else if (n == 0) {
+            state_ = kTrailers;
+          } else {
+            remaining_ = n;
+            state_ = kChunkData;
+          }
+        }
+        break;
+      case kChunkEnd:
+        if (takeLine(data, len, i)) state_ = line_[0] == '\0' ? kChunkSize : kError;
+        break;
+      case kTrailers:
+        if (takeLine(data, len, i) && line_[0] == '\0') state_ = kDone;
+        break;
+      default:
+        break;
+    }
+    seen_ += i - before;
+  }
+  return i;
+}
+
+void HttpResponseParser::finishOnClose() {
+  keepAlive_ = false;
+  if (state_ == kBodyUntilClose) state_ = kDone;
+  else if (state_ != kDone) state_ = kError;
+}
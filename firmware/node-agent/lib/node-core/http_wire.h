@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Minimal HTTP/1.1 client plumbing for the ingest connection: URL parsing,
+// request head formatting and an incremental response parser. Transport is
+// left to the caller so the same code runs over WiFiClient, WiFiClientSecure
+// or host sockets.
+
+struct HttpUrl {
+  bool tls = false;
+  char host[64] = {0};
+  uint16_t port = 0;
+  char path[128] = {0};
+};
+
+// Accepts http:// and https:// URLs with optional port and path. Returns false
+// for other schemes or components that do not fit HttpUrl.
+bool parseHttpUrl(const char *url, HttpUrl &out);
+
+// Writes "POST <path> HTTP/1.1" plus Host, Content-Type, optional
+// Content-Encoding, Content-Length and Connection: keep-alive headers and the
+// blank line. Returns the length, or 0 when `cap` is too small.
+size_t formatPostHead(char *out, size_t cap, const HttpUrl &url, const char *contentType,
+                      const char *contentEncoding, size_t contentLength);
+
+// Parses one response from a byte stream. feed() stops consuming at the end
+// of the response, so bytes of a following pipelined response stay with the
+// caller. Bodies are discarded except for the first kBodyKeep bytes.
+class HttpResponseParser {
+ public:
+  static const size_t kBodyKeep = 256;
+
+  HttpResponseParser() { reset(); }
+  void reset();
+  size_t feed(const char *data, size_t len);
+  // The peer closed the connection; completes close-delimited bodies.
+  void finishOnClose();
+
+  bool done() const { return state_ == kDone; }
+  bool failed() const { return state_ == kError; }
+  bool started() const { return seen_ > 0; }
+  int status() const { return status_; }
+  // Whether the connection can carry another request after this response.
+  bool keepAlive() const { return keepAlive_; }
+  const char *body() const { return body_; }
+  size_t bodyLen() const { return bodyLen_; }
+
+ private:
+  enum State { kStatusLine, kHeaders, kBody, kBodyUntilClose, kChunkSize, kChunkData, kChunkEnd,
+               kTrailers, kDone, kError };
+
+  bool takeLine(const char *data, size_t len, size_t &i);
+  void onStatusLine();
+  void onHeaderLine();
+  void startBody();
+  void keepBody(const char *data, size_t len);
+
+  State state_ = kStatusLine;
+  char line_[128];
+  size_t lineLen_ = 0;
+  int status_ = 0;
+  bool keepAlive_ = true;
+  bool chunked_ = false;
+  bool haveLength_ = false;
+  uint64_t remaining_ = 0;
+  uint64_t seen_ = 0;
+  char body_[kBodyKeep + 1];
+  size_t bodyLen_ = 0;
+};
@@ -0,0 +1,44 @@
+#include "ingest_ack.h"
+
+#include <string.h>
+
+namespace {
+
+// Finds `"key":` in [p, p + len) and reads the unsigned integer after it,
+// allowing spaces around the colon.
+bool findUInt(const char *p, size_t len, const char *key, uint32_t &out) {
+  const size_t keyLen = strlen(key);
+  const char *end = p + len;
+  for (const char *q = p; q + keyLen + 3 <= end; q++) {
+    if (q[0] != '"' || memcmp(q + 1, key, keyLen) != 0 || q[keyLen + 1] != '"') continue;
+    const char *v = q + keyLen + 2;
+    while (v < end && *v == ' ') v++;
+    if (v == end || *v != ':') continue;
+    v++;
+    while (v < end && *v == ' ') v++;
+    if (v == end || *v < '0' || *v > '9') return false;
+    uint64_t n = 0;
+    while (v < end && *v >= '0' && *v <= '9') {
+      n = n * 10 + (uint64_t)(*v - '0');
+      if (n > 0xFFFFFFFFull) return false;
+      v++;
+    }
+    out = (uint32_t)n;
+    return true;
+  }
+  return false;
+}
+
+}  // namespace
+
+bool eventRecordId(const char *rec, size_t len, EventId &id) {
+  id.epoch = 0;
+  findUInt(rec, len, "epoch", id.epoch);
+  return findUInt(rec, len, "seq", id.seq);
+}
+
+bool parseIngestAck(const char *body, size_t len, EventId &ack) {
+  ack.epoch = 0;
+  findUInt(body, len, "ack_epoch", ack.epoch);
+  return findUInt(body, len, "ack_seq", ack.seq);
+}
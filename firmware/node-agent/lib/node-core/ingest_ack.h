@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Partial acknowledgement of an ingest batch. The server may answer with
+//   {"ok":true,"ack_epoch":E,"ack_seq":S}
+// to say it stored the batch's events in order up to and including the one
+// whose envelope carries epoch E and seq S, and none after it. The node pops
+// that prefix and sends the rest again. A response without "ack_seq"
+// acknowledges a 2xx batch whole, as servers that predate the fields do.
+//
+// (node_id, epoch, seq) identifies an event across reboots, so a server can
+// drop a resent event by that key alone instead of comparing payloads.
+
+struct EventId {
+  uint32_t epoch;
+  uint32_t seq;
+};
+
+inline bool operator==(const EventId &a, const EventId &b) {
+  return a.epoch == b.epoch && a.seq == b.seq;
+}
+
+// Reads "epoch" and "seq" from one queued JSON event: the first occurrence
+// of each key, which eventEncodeJson() writes in the envelope ahead of any
+// data field. False without "seq"; events from firmware that did not write
+// "epoch" read as epoch 0.
+bool eventRecordId(const char *rec, size_t len, EventId &id);
+
+// Reads "ack_epoch" and "ack_seq" from a response body. False without
+// "ack_seq"; a missing "ack_epoch" reads as 0.
+bool parseIngestAck(const char *body, size_t len, EventId &ack);
@@ -0,0 +1,51 @@
+#include "ingest_failure.h"
+
+IngestFailure classifyIngestStatus(int status) {
+  if (status < 100) return IngestFailure::kTransport;
+  if (status >= 500) return IngestFailure::kServer;
+  if (status == 413) return IngestFailure::kTooLarge;
+  return IngestFailure::kClient;
+}
+
+const char *ingestFailureName(IngestFailure f) {
+  switch (f) {
+    case IngestFailure::kTransport:
+      return "transport";
+    case IngestFailure::kServer:
+      return "5xx";
+    case IngestFailure::kTooLarge:
+      return "413";
+    case IngestFailure::kClient:
+      return "4xx";
+  }
+  return "?";
+}
+
+bool ingestStatusBlamesRecords(int status) {
+  if (status < 400 || status >= 500) return false;
+  switch (status) {
+    case 401:
+    case 403:
+    case 404:
+    case 405:
+    case 408:
+    case 415:
+    case 429:
+      return false;
+    default:
+      return true;
+  }
+}
+
+size_t BatchBisector::limit(uint32_t front) const {
+  if (!active(front)) return 0;
+  uint32_t suspects = end_ - front;
+  return suspects > 1 ? suspects / 2 : 1;
+}
+
+bool BatchBisector::onRefused(uint32_t front, size_t count) {
+  if (count <= 1) return true;
+  active_ = true;
+  end_ = front + (uint32_t)count;
+  return false;
+}
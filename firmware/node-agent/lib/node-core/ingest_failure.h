@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Why an ingest POST failed, from its HTTP status or a negative transport
+// error code.
+enum class IngestFailure : uint8_t {
+  kTransport,  // no usable response: connect, write, read or parse
+  kServer,     // 5xx
+  kTooLarge,   // 413
+  kClient,     // any other 4xx (or unexpected status)
+};
+const size_t kIngestFailureCount = 4;
+
+IngestFailure classifyIngestStatus(int status);
+// "transport", "5xx", "413" or "4xx".
+const char *ingestFailureName(IngestFailure f);
+
+// Whether the status refuses the batch for what is in it, so resending the
+// same records can never succeed: 413 and 4xx other than those about the
+// request as a whole (401, 403, 404, 405, 408, 415, 429).
+bool ingestStatusBlamesRecords(int status);
+
+// Narrows a refused batch down to the records the server objects to. The
+// suspect records are a run at the front of a class queue, tracked by push
+// serial so records popped or evicted meanwhile drop out of it. Each refusal
+// halves the next batch; each accepted batch moves the front past records
+// that were fine. A single refused record is the culprit.
+class BatchBisector {
+ public:
+  // True while suspect records remain at the front, given the serial of the
+  // queue's front record.
+  bool active(uint32_t front) const { return active_ && (int32_t)(end_ - front) > 0; }
+  // Most records the next batch from `front` may hold: half the suspects,
+  // at least one. 0 when not bisecting.
+  size_t limit(uint32_t front) const;
+  // The batch of `count` records from `front` was refused for its content.
+  // True when that was a single record, for the caller to set aside; the
+  // rest of the suspects are still narrowed down after it.
+  bool onRefused(uint32_t front, size_t count);
+  void reset() { active_ = false; }
+
+ private:
+  bool active_ = false;
+  uint32_t end_ = 0;  // serial after the last suspect
+};
@@ -0,0 +1,368 @@
+#include "json_writer.h"
+
+#include <string.h>
+
+namespace {
+
+typedef uintptr_t Word;
+
+constexpr Word kOnes = ~(Word)0 / 0xFF;
+constexpr Word kHighs = kOnes * 0x80;
+
+inline bool wordHasZeroByte(Word v) { return ((v - kOnes) & ~v & kHighs) != 0; }
+
+inline bool wordNeedsEscape(Word w) {
+  // Any byte < 0x20, or equal to '"' or '\\'.
+  bool control = ((w - kOnes * 0x20) & ~w & kHighs) != 0;
+  return control || wordHasZeroByte(w ^ (kOnes * '"')) || wordHasZeroByte(w ^ (kOnes * '\\'));
+}
+
+inline bool byteNeedsEscape(uint8_t c) { return c < 0x20 || c == '"' || c == '\\'; }
+
+const char kHex[] = "0123456789abcdef";
+const char kHexUpper[] = "0123456789ABCDEF";
+
+size_t formatU32(char *out, uint32_t v) {
+  char tmp[10];
+  size_t n = 0;
+  do {
+    tmp[n++] = char('0' + v % 10);
+    v /= 10;
+  } while (v != 0);
+  for (size_t i = 0; i < n; i++) out[i] = tmp[n - 1 - i];
+  return n;
+}
+
+size_t formatU64(char *out, uint64_t v) {
+  if (v <= 0xFFFFFFFFULL) return formatU32(out, (uint32_t)v);
+  char tmp[20];
+  size_t n = 0;
+  while (v != 0) {
+    tmp[n++] = char('0' + v % 10);
+    v /= 10;
+  }
+  for (size_t i = 0; i < n; i++) out[i] = tmp[n - 1 - i];
+  return n;
+}
+
+}  // namespace
+
+size_t jsonEscapeScan(const char *s, size_t len) {
+  size_t i = 0;
+  while (i < len && ((uintptr_t)(s + i) % sizeof(Word)) != 0) {
+    if (byteNeedsEscape((uint8_t)s[i])) return i;
+    i++;
+  }
+  while (i + sizeof(Word) <= len) {
+    Word w;
+    memcpy(&w, s + i, sizeof(Word));
+    if (wordNeedsEscape(w)) break;
+    i += sizeof(Word);
+  }
+  while (i < len) {
+    if (byteNeedsEscape((uint8_t)s[i])) return i;
+    i++;
+  }
+  return len;
+}
+
+size_t formatIpv4(char out[16], uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
+  size_t n = formatU32(out, a);
+  out[n++] = '.';
+  n += formatU32(out + n, b);
+  out[n++] = '.';
+  n += formatU32(out + n, c);
+  out[n++] = '.';
+  n += formatU32(out + n, d);
+  out[n] = '\0';
+  return n;
+}
+
+size_t formatMac(char out[18], const uint8_t mac[6], bool upper) {
+  const char *hex = upper ? kHexUpper : kHex;
+  for (int i = 0; i < 6; i++) {
+    out[i * 3] = hex[mac[i] >> 4];
+    out[i * 3 + 1] = hex[mac[i] & 0x0F];
+    out[i * 3 + 2] = i < 5 ? ':' : '\0';
+  }
+  return 17;
+}
+
+JsonWriter::JsonWriter(char *buf, size_t cap) : buf_(buf), cap_(cap) {
+  if (cap_ > 0) buf_[0] = '\0';
+  else overflow_ = true;
+}
+
+void JsonWriter::setSink(Sink sink, void *ctx) {
+  sink_ = sink;
+  sinkCtx_ = ctx;
+}
+
+bool JsonWriter::flush() {
+  if (!sink_ || overflow_) return false;
+  if (pos_ == 0) return true;
+  if (!sink_(sinkCtx_, buf_, pos_)) {
+    overflow_ = true;
+    return false;
+  }
+  flushed_ += pos_;
+  pos_ = 0;
+  buf_[0] = '\0';
+  return true;
+}
+
+void JsonWriter::putSlow(const char *s, size_t len) {
+  if (!flush()) {
+    overflow_ = true;
+    return;
+  }
+  if (len < cap_) {
+    memcpy(buf_, s, len);
+    pos_ = len;
+    buf_[pos_] = '\0';
+    return;
+  }
+  // Larger than the whole buffer: pass it straight through.
+  if (sink_(sinkCtx_, s, len)) {
+    flushed_ += len;
+  } else {
+    overflow_ = true;
+  }
+}
+
+void JsonWriter::put(char c) {
+  if (overflow_ || pos_ + 1 >= cap_) {
+    putSlow(&c, 1);
+    return;
+  }
+  buf_[pos_++] = c;
+  buf_[pos_] = '\0';
+}
+
+void JsonWriter::put(const char *s, size_t len) {
+  if (overflow_ || pos_ + len >= cap_) {
+    putSlow(s, len);
+    return;
+  }
+  memcpy(buf_ + pos_, s, len);
+  pos_ += len;
+  buf_[pos_] = '\0';
+}
+
+void JsonWriter::beforeValue() {
+  if (pendingKey_) {
+    pendingKey_ = false;
+    return;
+  }
+  uint32_t bit = 1U << depth_;
+  if (firstMask_ & bit) {
+    firstMask_ &= ~bit;
+  } else {
+    put(',');
+  }
+}
+
+void JsonWriter::putEscaped(const char *s, size_t len) {
+  while (len > 0) {
+    size_t clean = jsonEscapeScan(s, len);
+    if (clean > 0) put(s, clean);
+    if (clean == len) return;
+    uint8_t c = (uint8_t)s[clean];
+    switch (c) {
+      case '"': put("\\\"", 2); break;
+      case '\\': put("\\\\", 2); break;
+      case '\n': put("\\n", 2); break;
+      case '\r': put("\\r", 2); break;
+      case '\t': put("\\t", 2); break;
+      case '\b': put("\\b", 2); break;
+      case '\f': put("\\f", 2); break;
+      default: {
+        char esc[6] = {'\\', 'u', '0', '0', kHex[c >> 4], kHex[c & 0x0F]};
+        put(esc, sizeof(esc));
+        break;
+      }
+    }
+    s += clean + 1;
+    len -= clean + 1;
+  }
+}
+
+void JsonWriter::beginObject() {
+  beforeValue();
+  put('{');
+  depth_++;
+  firstMask_ |= 1U << depth_;
+}
+
+void JsonWriter::endObject() {
+  if (depth_ > 0) depth_--;
+  put('}');
+}
+
+void JsonWriter::beginArray() {
+  beforeValue();
+  put('[');
+  depth_++;
+  firstMask_ |= 1U << depth_;
+}
+
+void JsonWriter::endArray() {
+  if (depth_ > 0) depth_--;
+  put(']');
+}
+
+void JsonWriter::key(const char *k) {
+  uint32_t bit = 1U << depth_;
+  if (firstMask_ & bit) {
+    firstMask_ &= ~bit;
+  } else {
+    put(',');
+  }
+  put('"');
+  put(k, strlen(k));
+  put("\":", 2);
+  pendingKey_ = true;
+}
+
+void JsonWriter::writeString(const char *s) { writeString(s, s ? strlen(s) : 0); }
+
+void JsonWriter::writeString(const char *s, size_t len) {
+  beforeValue();
+  put('"');
+  if (s) putEscaped(s, len);
+  put('"');
+}
+
+void JsonWriter::writeInt(int64_t v) {
+  beforeValue();
+  char tmp[21];
+  size_t n = 0;
+  uint64_t mag = (uint64_t)v;
+  if (v < 0) {
+    tmp[n++] = '-';
+    mag = 0 - mag;
+  }
+  n += formatU64(tmp + n, mag);
+  put(tmp, n);
+}
+
+void JsonWriter::writeUInt(uint64_t v) {
+  beforeValue();
+  char tmp[20];
+  put(tmp, formatU64(tmp, v));
+}
+
+void JsonWriter::writeFixed(int64_t scaled, uint8_t decimals) {
+  if (decimals == 0) {
+    writeInt(scaled);
+    return;
+  }
+  beforeValue();
+  char tmp[24];
+  size_t n = 0;
+  uint64_t mag = (uint64_t)scaled;
+  if (scaled < 0) {
+    tmp[n++] = '-';
+    mag = 0 - mag;
+  }
+  uint64_t div = 1;
+  for (uint8_t i = 0; i < decimals; i++) div *= 10;
+  n += formatU64(tmp + n, mag / div);
+  tmp[n++] = '.';
+  uint64_t frac = mag % div;
+  for (uint8_t i = decimals; i > 0; i--) {
+    tmp[n + i - 1] = char('0' + frac % 10);
+    frac /= 10;
+  }
+  n += decimals;
+  put(tmp, n);
+}
+
+void JsonWriter::writeBool(bool v) {
+  beforeValue();
+  if (v) put("true", 4);
+  else put("false", 5);
+}
+
+void JsonWriter::writeNull() {
+  beforeValue();
+  put("null", 4);
+}
+
+void JsonWriter::writeRaw(const char *json, size_t len) {
+  beforeValue();
+  put(json, len);
+}
+
+void JsonWriter::fieldStr(const char *k, const char *v) {
+  key(k);
+  writeString(v);
+}
+
+void JsonWriter::fieldStr(const char *k, const char *v, size_t len) {
+  key(k);
+  writeString(v, len);
+}
+
+void JsonWriter::fieldStrOrNull(const char *k, const char *v, size_t len) {
+  key(k);
+  if (!v || len == 0) writeNull();
+  else writeString(v, len);
+}
+
+void JsonWriter::fieldInt(const char *k, int64_t v) {
+  key(k);
+  writeInt(v);
+}
+
+void JsonWriter::fieldUInt(const char *k, uint64_t v) {
+  key(k);
+  writeUInt(v);
+}
+
+void JsonWriter::fieldFixed(const char *k, int64_t scaled, uint8_t decimals) {
+  key(k);
+  writeFixed(scaled, decimals);
+}
+
+void JsonWriter::fieldBool(const char *k, bool v) {
+  key(k);
+  writeBool(v);
+}
+
+void JsonWriter::fieldNull(const char *k) {
+  key(k);
+  writeNull();
+}
+
+void JsonWriter::fieldRaw(const char *k, const char *json, size_t len) {
+  key(k);
+  writeRaw(json, len);
+}
+
+JsonWriter::Mark JsonWriter::mark() const {
+  return Mark{pos_, depth_, firstMask_, pendingKey_, flushed_};
+}
+
+void JsonWriter::rewind(const Mark &m) {
+  if (m.flushed != flushed_) {
+    overflow_ = true;
+    return;
+  }
+  pos_ = m.pos;
+  depth_ = m.depth;
+  firstMask_ = m.firstMask;
+  pendingKey_ = m.pendingKey;
+  overflow_ = false;
+  if (cap_ > 0) buf_[pos_] = '\0';
+}
+
+void JsonWriter::reset() {
+  pos_ = 0;
+  depth_ = 0;
+  firstMask_ = 1;
+  pendingKey_ = false;
+  flushed_ = 0;
+  overflow_ = cap_ == 0;
+  if (cap_ > 0) buf_[0] = '\0';
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Streaming JSON writer over caller-owned storage. It never allocates: output
+// goes straight into `buf`, commas are inserted automatically, and once the
+// buffer is exhausted further writes are dropped and overflowed() latches.
+// The output is always NUL-terminated so c_str() can be handed to C APIs.
+//
+// With a sink set, a write that does not fit first hands the buffered bytes
+// to the sink and continues from the start of the buffer, so a document of
+// any size goes out through `cap` bytes; overflowed() then only latches when
+// the sink fails.
+class JsonWriter {
+ public:
+  struct Mark {
+    size_t pos;
+    uint8_t depth;
+    uint32_t firstMask;
+    bool pendingKey;
+    size_t flushed;
+  };
+
+  // Receives output in order; returns false to abort (e.g. client gone).
+  typedef bool (*Sink)(void *ctx, const char *data, size_t len);
+
+  JsonWriter(char *buf, size_t cap);
+
+  void setSink(Sink sink, void *ctx);
+  // Hands the buffered bytes to the sink. False without a sink or on failure.
+  bool flush();
+  // Bytes already handed to the sink.
+  size_t flushedBytes() const { return flushed_; }
+
+  void beginObject();
+  void endObject();
+  void beginArray();
+  void endArray();
+  void key(const char *k);
+
+  void writeString(const char *s);
+  void writeString(const char *s, size_t len);
+  void writeInt(int64_t v);
+  void writeUInt(uint64_t v);
+  void writeFixed(int64_t scaled, uint8_t decimals);
+  void writeBool(bool v);
+  void writeNull();
+  // Appends an already-serialized JSON value verbatim.
+  void writeRaw(const char *json, size_t len);
+
+  void fieldStr(const char *k, const char *v);
+  void fieldStr(const char *k, const char *v, size_t len);
+  // Empty strings are written as null, matching the event schema.
+  void fieldStrOrNull(const char *k, const char *v, size_t len);
+  void fieldInt(const char *k, int64_t v);
+  void fieldUInt(const char *k, uint64_t v);
+  void fieldFixed(const char *k, int64_t scaled, uint8_t decimals);
+  void fieldBool(const char *k, bool v);
+  void fieldNull(const char *k);
+  void fieldRaw(const char *k, const char *json, size_t len);
+
+  // Arduino String / std::string convenience without copying.
+  template <typename S>
+  void fieldText(const char *k, const S &v) {
+    fieldStr(k, v.c_str(), v.length());
+  }
+  template <typename S>
+  void fieldTextOrNull(const char *k, const S &v) {
+    fieldStrOrNull(k, v.c_str(), v.length());
+  }
+
+  // Checkpoints let callers drop a partially written element when it would
+  // not fit, keeping the output well-formed. A mark taken before a flush
+  // cannot be rewound to; trying latches overflow.
+  Mark mark() const;
+  void rewind(const Mark &m);
+  void reset();
+
+  const char *c_str() const { return buf_; }
+  size_t size() const { return pos_; }
+  size_t capacity() const { return cap_; }
+  size_t remaining() const { return cap_ > pos_ + 1 ? cap_ - pos_ - 1 : 0; }
+  bool overflowed() const { return overflow_; }
+
+ private:
+  void put(char c);
+  void put(const char *s, size_t len);
+  void putSlow(const char *s, size_t len);
+  void beforeValue();
+  void putEscaped(const char *s, size_t len);
+
+  char *buf_;
+  size_t cap_;
+  size_t pos_ = 0;
+  uint8_t depth_ = 0;
+  uint32_t firstMask_ = 1;
+  bool pendingKey_ = false;
+  bool overflow_ = false;
+  Sink sink_ = nullptr;
+  void *sinkCtx_ = nullptr;
+  size_t flushed_ = 0;
+};
+
+// Returns the index of the first byte in `s` that needs JSON escaping
+// (quote, backslash or a control character), or `len` when none does.
+// Scans a machine word at a time.
+size_t jsonEscapeScan(const char *s, size_t len);
+
+// Fixed-width formatters used by event builders; both NUL-terminate.
+size_t formatIpv4(char out[16], uint8_t a, uint8_t b, uint8_t c, uint8_t d);
+size_t formatMac(char out[18], const uint8_t mac[6], bool upper);
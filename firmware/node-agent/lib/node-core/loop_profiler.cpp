@@ -0,0 +1,58 @@
+#include "loop_profiler.h"
+
+void LoopProfiler::begin(const char *const *names, size_t stages, uint32_t cyclesPerUs,
+                         uint32_t budgetUs) {
+  names_ = names;
+  stages_ = stages < kMaxStages ? stages : kMaxStages;
+  cyclesPerUs_ = cyclesPerUs > 0 ? cyclesPerUs : 1;
+  budgetCycles_ = budgetUs * cyclesPerUs_;
+  reset();
+}
+
+void LoopProfiler::beginPass(uint32_t nowCycles) {
+  passStart_ = nowCycles;
+  lastLap_ = nowCycles;
+  lapped_ = 0;
+}
+
+void LoopProfiler::lap(size_t stage, uint32_t nowCycles) {
+  uint32_t cycles = nowCycles - lastLap_;
+  lastLap_ = nowCycles;
+  if (stage >= stages_) return;
+  if (!(lapped_ & (1U << stage))) passCycles_[stage] = 0;
+  lapped_ |= 1U << stage;
+  passCycles_[stage] += cycles;
+}
+
+void LoopProfiler::endPass(uint32_t nowCycles) {
+  uint32_t longestCycles = 0;
+  size_t longestStage = stages_;
+  for (size_t i = 0; i < stages_; i++) {
+    if (!(lapped_ & (1U << i))) continue;
+    add(i, passCycles_[i]);
+    if (passCycles_[i] >= longestCycles) {
+      longestCycles = passCycles_[i];
+      longestStage = i;
+    }
+  }
+  uint32_t cycles = nowCycles - passStart_;
+  add(kMaxStages, cycles);
+  if (cycles > budgetCycles_ && longestStage < stages_ && longestCycles > 0) stats_[longestStage].blamed++;
+}
+
+void LoopProfiler::reset() {
+  for (size_t i = 0; i <= kMaxStages; i++) {
+    stats_[i] = Stats{};
+    hist_[i].reset();
+  }
+}
+
+void LoopProfiler::add(size_t slot, uint32_t cycles) {
+  Stats &s = stats_[slot];
+  if (s.count == 0 || cycles < s.minCycles) s.minCycles = cycles;
+  if (cycles > s.maxCycles) s.maxCycles = cycles;
+  s.sumCycles += cycles;
+  s.count++;
+  if (cycles > budgetCycles_) s.overBudget++;
+  hist_[slot].record(cycles / cyclesPerUs_);
+}
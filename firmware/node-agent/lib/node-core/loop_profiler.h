@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "histogram.h"
+
+// Per-stage timing of one loop pass from CPU cycle counter readings. The
+// loop reads the counter once per stage boundary: lap(stage, now) charges
+// the cycles since the previous lap to that stage. A stage lapped more than
+// once in a pass is charged the sum, as one sample. The counter is 32 bits
+// and wraps, which is fine as long as no single stage runs for a full wrap
+// (~17 s at 240 MHz).
+//
+// A pass whose total exceeds the budget counts as over budget, and the
+// stage that took longest in that pass is blamed for it. A stage is also
+// over budget on its own when it alone takes longer than the whole budget.
+//
+// Not thread-safe. In the firmware /debug/profile reads and calls reset()
+// from the HTTP task under the state lock, and the worker calls endPass()
+// under that lock too. beginPass() and lap() run wherever the worker is,
+// locked or not: they only touch per-pass fields that endPass() alone
+// folds into the statistics.
+class LoopProfiler {
+ public:
+  static constexpr size_t kMaxStages = 12;
+
+  struct Stats {
+    uint32_t count;
+    uint32_t minCycles;
+    uint32_t maxCycles;
+    uint64_t sumCycles;
+    uint32_t overBudget;
+    uint32_t blamed;
+  };
+
+  // `names` must outlive the profiler. Stage indexes are 0..stages-1.
+  void begin(const char *const *names, size_t stages, uint32_t cyclesPerUs, uint32_t budgetUs);
+
+  void beginPass(uint32_t nowCycles);
+  void lap(size_t stage, uint32_t nowCycles);
+  void endPass(uint32_t nowCycles);
+
+  // Clears statistics; a pass in progress carries on.
+  void reset();
+
+  size_t stageCount() const { return stages_; }
+  const char *stageName(size_t i) const { return names_[i]; }
+  const Stats &stage(size_t i) const { return stats_[i]; }
+  const Stats &pass() const { return stats_[kMaxStages]; }
+  // Histograms are kept in microseconds.
+  void stageHistogram(size_t i, Histogram::Snapshot &out) const { hist_[i].snapshot(out); }
+  void passHistogram(Histogram::Snapshot &out) const { hist_[kMaxStages].snapshot(out); }
+
+  uint32_t cyclesPerUs() const { return cyclesPerUs_; }
+  uint32_t budgetUs() const { return budgetCycles_ / cyclesPerUs_; }
+
+ private:
+  void add(size_t slot, uint32_t cycles);
+
+  const char *const *names_ = nullptr;
+  size_t stages_ = 0;
+  uint32_t cyclesPerUs_ = 1;
+  uint32_t budgetCycles_ = 0;
+  uint32_t passStart_ = 0;
+  uint32_t lastLap_ = 0;
+  uint32_t lapped_ = 0;  // stages lapped this pass, by bit
+  uint32_t passCycles_[kMaxStages] = {};
+  Stats stats_[kMaxStages + 1] = {};
+  Histogram hist_[kMaxStages + 1];
+};
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Fixed-capacity map from 64-bit keys to `Entry` values with least-recently
+// used eviction. Entries live in a static node pool; an open-addressing
+// index (linear probing, at most half full, backward-shift deletion) maps
+// keys to nodes, and an intrusive doubly linked list keeps them in recency
+// order. Lookups, updates and evictions are O(1) regardless of capacity.
+template <typename Entry, size_t Capacity>
+class LruHashTable {
+  static_assert(Capacity > 0 && Capacity < 0xFFFF, "LruHashTable capacity must fit 16-bit links");
+
+  static constexpr size_t indexSizeFor(size_t n) {
+    size_t s = 1;
+    while (s < n * 2) s <<= 1;
+    return s;
+  }
+
+ public:
+  typedef uint16_t Handle;
+  static const Handle npos = 0xFFFF;
+  static constexpr size_t kIndexSize = indexSizeFor(Capacity);
+
+  LruHashTable() { clear(); }
+
+  void clear() {
+    for (size_t i = 0; i < kIndexSize; i++) index_[i] = 0;
+    for (size_t i = 0; i < Capacity; i++) nodes_[i].next = (Handle)(i + 1 < Capacity ? i + 1 : npos);
+    free_ = 0;
+    head_ = tail_ = npos;
+    size_ = 0;
+  }
+
+  // Looks up `key` without changing its recency.
+  Entry *find(uint64_t key) {
+    Handle h = lookup(key);
+    return h == npos ? nullptr : &nodes_[h].value;
+  }
+
+  // Returns the entry for `key`, moved to the most-recent position. A missing
+  // key gets a value-initialized entry, evicting the least recently used one
+  // when the table is full; `inserted` tells the two cases apart.
+  Entry *upsert(uint64_t key, bool &inserted) {
+    Handle h = lookup(key);
+    if (h != npos) {
+      inserted = false;
+      moveToFront(h);
+      return &nodes_[h].value;
+    }
+    inserted = true;
+    if (free_ == npos) {
+      evictions_++;
+      eraseHandle(tail_);
+    }
+    h = free_;
+    free_ = nodes_[h].next;
+    Node &n = nodes_[h];
+    n.key = key;
+    n.value = Entry();
+    linkFront(h);
+    size_t i = home(key);
+    while (index_[i] != 0) i = (i + 1) & (kIndexSize - 1);
+    index_[i] = (uint16_t)(h + 1);
+    size_++;
+    return &n.value;
+  }
+
+  bool erase(uint64_t key) {
+    Handle h = lookup(key);
+    if (h == npos) return false;
+    eraseHandle(h);
+    return true;
+  }
+
+  size_t size() const { return size_; }
+  static constexpr size_t capacity() { return Capacity; }
+  uint32_t evictions() const { return evictions_; }
+
+  // Most-recent-first iteration:
+  //   for (Handle h = t.front(); h != t.npos; h = t.next(h)) use(t.key(h), t.at(h));
+  Handle front() const { return head_; }
+  Handle back() const { return tail_; }
+  Handle next(Handle h) const { return nodes_[h].next; }
+  Handle prev(Handle h) const { return nodes_[h].prev; }
+  uint64_t key(Handle h) const { return nodes_[h].key; }
+  Entry &at(Handle h) { return nodes_[h].value; }
+  const Entry &at(Handle h) const { return nodes_[h].value; }
+
+ private:
+  struct Node {
+    uint64_t key;
+    Handle prev;
+    Handle next;
+    Entry value;
+  };
+
+  static size_t home(uint64_t key) {
+    // splitmix64 finalizer: MAC prefixes (OUIs) are heavily clustered.
+    key ^= key >> 30;
+    key *= 0xBF58476D1CE4E5B9ULL;
+    key ^= key >> 27;
+    key *= 0x94D049BB133111EBULL;
+    key ^= key >> 31;
+    return (size_t)key & (kIndexSize - 1);
+  }
+
+  Handle lookup(uint64_t key) const {
+    size_t i = home(key);
+    while (index_[i] != 0) {
+      Handle h = (Handle)(index_[i] - 1);
+      if (nodes_[h].key == key) return h;
+      i = (i + 1) & (kIndexSize - 1);
+    }
+    return npos;
+  }
+
+  void unlink(Handle h) {
+    Node &n = nodes_[h];
+    if (n.prev != npos) nodes_[n.prev].next = n.next;
+    else head_ = n.next;
+    if (n.next != npos) nodes_[n.next].prev = n.prev;
+    else tail_ = n.prev;
+  }
+
+  void linkFront(Handle h) {
+    Node &n = nodes_[h];
+    n.prev = npos;
+    n.next = head_;
+    if (head_ != npos) nodes_[head_].prev = h;
+    head_ = h;
+    if (tail_ == npos) tail_ = h;
+  }
+
+  void moveToFront(Handle h) {
+    if (head_ == h) return;
+    unlink(h);
+    linkFront(h);
+  }
+
+  void eraseHandle(Handle h) {
+    const size_t mask = kIndexSize - 1;
+    size_t i = home(nodes_[h].key);
+    while ((Handle)(index_[i] - 1) != h) i = (i + 1) & mask;
+    // Backward-shift deletion keeps probe sequences intact without tombstones.
+    size_t j = i;
+    for (;;) {
+      j = (j + 1) & mask;
+      if (index_[j] == 0) break;
+      size_t k = home(nodes_[index_[j] - 1].key);
+      bool stays = i <= j ? (i < k && k <= j) : (i < k || k <= j);
+      if (stays) continue;
+      index_[i] = index_[j];
+      i = j;
+    }
+    index_[i] = 0;
+    unlink(h);
+    nodes_[h].next = free_;
+    free_ = h;
+    size_--;
+  }
+
+  Node nodes_[Capacity];
+  uint16_t index_[kIndexSize];
+  Handle head_;
+  Handle tail_;
+  Handle free_;
+  size_t size_;
+  uint32_t evictions_ = 0;
+};
@@ -0,0 +1,206 @@
+#include "mqtt_wire.h"
+
+#include <string.h>
+
+namespace {
+
+const uint32_t kMaxRemaining = 268435455;  // four length bytes
+
+// Copies [p, p+len) into a NUL-terminated field; false when it does not fit.
+bool copyField(char *dst, size_t cap, const char *p, size_t len) {
+  if (len >= cap) return false;
+  memcpy(dst, p, len);
+  dst[len] = '\0';
+  return true;
+}
+
+class PacketWriter {
+ public:
+  PacketWriter(uint8_t *out, size_t cap) : out_(out), cap_(cap) {}
+
+  // Fixed header: type and flags, then the remaining length as a varint.
+  void header(uint8_t typeAndFlags, size_t remaining) {
+    if (remaining > kMaxRemaining) {
+      ok_ = false;
+      return;
+    }
+    byte(typeAndFlags);
+    do {
+      uint8_t b = remaining & 0x7F;
+      remaining >>= 7;
+      byte(remaining > 0 ? (b | 0x80) : b);
+    } while (remaining > 0);
+  }
+  void byte(uint8_t b) {
+    if (len_ >= cap_) {
+      ok_ = false;
+      return;
+    }
+    out_[len_++] = b;
+  }
+  void u16(uint16_t v) {
+    byte(v >> 8);
+    byte(v & 0xFF);
+  }
+  void str(const char *s) {
+    size_t n = strlen(s);
+    if (n > 0xFFFF) {
+      ok_ = false;
+      return;
+    }
+    u16((uint16_t)n);
+    for (size_t i = 0; i < n; i++) byte((uint8_t)s[i]);
+  }
+  size_t finish() const { return ok_ ? len_ : 0; }
+
+ private:
+  uint8_t *out_;
+  size_t cap_;
+  size_t len_ = 0;
+  bool ok_ = true;
+};
+
+}  // namespace
+
+bool parseMqttUrl(const char *url, MqttUrl &out, const char *defaultPrefix) {
+  out = MqttUrl();
+  const char *p = url;
+  if (strncmp(p, "mqtt://", 7) == 0) {
+    p += 7;
+    out.port = 1883;
+  } else if (strncmp(p, "mqtts://", 8) == 0) {
+    p += 8;
+    out.tls = true;
+    out.port = 8883;
+  } else {
+    return false;
+  }
+  size_t authorityLen = strcspn(p, "/");
+  const char *at = nullptr;  // the last '@': passwords may hold one
+  for (size_t i = 0; i < authorityLen; i++) {
+    if (p[i] == '@') at = p + i;
+  }
+  if (at) {
+    size_t userLen = strcspn(p, ":@");
+    if (!copyField(out.user, sizeof(out.user), p, userLen)) return false;
+    if (p[userLen] == ':' && !copyField(out.pass, sizeof(out.pass), p + userLen + 1,
+                                        (size_t)(at - p) - userLen - 1)) {
+      return false;
+    }
+    p = at + 1;
+  }
+  size_t hostLen = strcspn(p, ":/");
+  if (hostLen == 0 || !copyField(out.host, sizeof(out.host), p, hostLen)) return false;
+  p += hostLen;
+  if (*p == ':') {
+    p++;
+    uint32_t port = 0;
+    size_t digits = 0;
+    while (*p >= '0' && *p <= '9') {
+      port = port * 10 + uint32_t(*p - '0');
+      if (port > 65535) return false;
+      p++;
+      digits++;
+    }
+    if (digits == 0 || port == 0) return false;
+    out.port = (uint16_t)port;
+  }
+  while (*p == '/') p++;
+  size_t prefixLen = strlen(p);
+  while (prefixLen > 0 && p[prefixLen - 1] == '/') prefixLen--;
+  if (prefixLen == 0) {
+    p = defaultPrefix;
+    prefixLen = strlen(p);
+  }
+  if (strcspn(p, "+#") < prefixLen) return false;  // wildcards cannot be published to
+  return copyField(out.prefix, sizeof(out.prefix), p, prefixLen);
+}
+
+size_t mqttConnect(uint8_t *out, size_t cap, const char *clientId, const char *user, const char *pass,
+                   uint16_t keepAliveS) {
+  const bool hasUser = user && *user;
+  const bool hasPass = hasUser && pass && *pass;
+  size_t remaining = 10 + 2 + strlen(clientId);
+  if (hasUser) remaining += 2 + strlen(user);
+  if (hasPass) remaining += 2 + strlen(pass);
+  uint8_t flags = 0x02;  // clean session
+  if (hasUser) flags |= 0x80;
+  if (hasPass) flags |= 0x40;
+  PacketWriter w(out, cap);
+  w.header(kMqttConnect << 4, remaining);
+  w.str("MQTT");
+  w.byte(4);  // protocol level 3.1.1
+  w.byte(flags);
+  w.u16(keepAliveS);
+  w.str(clientId);
+  if (hasUser) w.str(user);
+  if (hasPass) w.str(pass);
+  return w.finish();
+}
+
+size_t mqttPublishHead(uint8_t *out, size_t cap, const char *topic, uint16_t packetId,
+                       size_t payloadLen) {
+  PacketWriter w(out, cap);
+  w.header(kMqttPublish << 4 | 0x02, 2 + strlen(topic) + 2 + payloadLen);  // QoS 1
+  w.str(topic);
+  w.u16(packetId);
+  return w.finish();
+}
+
+size_t mqttPingreq(uint8_t *out, size_t cap) {
+  PacketWriter w(out, cap);
+  w.header(kMqttPingreq << 4, 0);
+  return w.finish();
+}
+
+size_t mqttDisconnect(uint8_t *out, size_t cap) {
+  PacketWriter w(out, cap);
+  w.header(kMqttDisconnect << 4, 0);
+  return w.finish();
+}
+
+void MqttReader::reset() {
+  state_ = kHeader;
+  header_ = 0;
+  length_ = 0;
+  lengthBytes_ = 0;
+  seen_ = 0;
+  memset(body_, 0, sizeof(body_));
+}
+
+size_t MqttReader::feed(const uint8_t *data, size_t len) {
+  size_t i = 0;
+  while (i < len && state_ != kDone && state_ != kError) {
+    uint8_t b = data[i];
+    switch (state_) {
+      case kHeader:
+        header_ = b;
+        // Type 0 is reserved, and a broker never sends CONNECT.
+        state_ = (b >> 4) == 0 || (b >> 4) == kMqttConnect ? kError : kLength;
+        i++;
+        break;
+      case kLength:
+        length_ |= uint32_t(b & 0x7F) << (7 * lengthBytes_);
+        lengthBytes_++;
+        i++;
+        if (b & 0x80) {
+          if (lengthBytes_ == 4) state_ = kError;
+        } else {
+          state_ = length_ == 0 ? kDone : kBody;
+        }
+        break;
+      case kBody: {
+        size_t n = len - i;
+        if (n > length_ - seen_) n = length_ - seen_;
+        for (size_t k = 0; k < n && seen_ + k < kBodyKeep; k++) body_[seen_ + k] = data[i + k];
+        seen_ += (uint32_t)n;
+        i += n;
+        if (seen_ == length_) state_ = kDone;
+        break;
+      }
+      default:
+        break;
+    }
+  }
+  return i;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Minimal MQTT 3.1.1 client framing for the MQTT uplink: URL parsing, the
+// packets a publish-only client sends and an incremental reader for what
+// the broker sends back. Transport is left to the caller, as in
+// http_wire.h.
+
+struct MqttUrl {
+  bool tls = false;
+  char host[64] = {0};
+  uint16_t port = 0;
+  char user[32] = {0};
+  char pass[64] = {0};
+  char prefix[64] = {0};  // topic prefix, without slashes at either end
+};
+
+// Accepts mqtt://[user[:pass]@]host[:port][/prefix] and mqtts://, on ports
+// 1883 and 8883 by default. The prefix defaults to `defaultPrefix`.
+bool parseMqttUrl(const char *url, MqttUrl &out, const char *defaultPrefix = "sods");
+
+enum MqttPacketType : uint8_t {
+  kMqttConnect = 1,
+  kMqttConnack = 2,
+  kMqttPublish = 3,
+  kMqttPuback = 4,
+  kMqttPingreq = 12,
+  kMqttPingresp = 13,
+  kMqttDisconnect = 14,
+};
+
+// Each writer returns the packet length, or 0 when `cap` is too small.
+
+// CONNECT with a clean session; `user` and `pass` are left out when empty.
+size_t mqttConnect(uint8_t *out, size_t cap, const char *clientId, const char *user, const char *pass,
+                   uint16_t keepAliveS);
+// Fixed header, topic and packet id of a QoS 1 PUBLISH. The caller writes
+// the `payloadLen` bytes of payload after it.
+size_t mqttPublishHead(uint8_t *out, size_t cap, const char *topic, uint16_t packetId,
+                       size_t payloadLen);
+size_t mqttPingreq(uint8_t *out, size_t cap);
+size_t mqttDisconnect(uint8_t *out, size_t cap);
+
+// Reads one broker packet from a byte stream. feed() stops consuming at the
+// end of the packet, so bytes of the next one stay with the caller. Only
+// the first kBodyKeep bytes of the body are kept: enough for CONNACK and
+// PUBACK, the rest of longer packets is skipped.
+class MqttReader {
+ public:
+  static const size_t kBodyKeep = 4;
+
+  MqttReader() { reset(); }
+  void reset();
+  size_t feed(const uint8_t *data, size_t len);
+
+  bool done() const { return state_ == kDone; }
+  bool failed() const { return state_ == kError; }
+  MqttPacketType type() const { return (MqttPacketType)(header_ >> 4); }
+  uint32_t length() const { return length_; }
+  // CONNACK: the return code, 0 when accepted.
+  uint8_t connackCode() const { return length_ >= 2 ? body_[1] : 0xFF; }
+  // PUBACK: the packet id acknowledged.
+  uint16_t packetId() const { return length_ >= 2 ? (uint16_t)(body_[0] << 8 | body_[1]) : 0; }
+
+ private:
+  enum State { kHeader, kLength, kBody, kDone, kError };
+
+  State state_ = kHeader;
+  uint8_t header_ = 0;
+  uint32_t length_ = 0;
+  uint8_t lengthBytes_ = 0;
+  uint32_t seen_ = 0;
+  uint8_t body_[kBodyKeep];
+};
@@ -0,0 +1,328 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "event_schema.h"
+
+// Every event the node emits, declared once: the struct holds the values,
+// the table below it gives the JSON key, order and text budget of each
+// field. Text budgets are in encoded (escaped) bytes.
+
+constexpr size_t kEventHostnameMax = 63;
+constexpr size_t kEventSsidMax = 64;
+constexpr size_t kEventUrlMax = 160;
+
+// ---- node.boot ---------------------------------------------------------------
+
+struct BootEvent {
+  EventText fw_version;
+  EventText chip_model;
+  EventText chip_rev;
+  EventMacUpper mac;
+  EventText hostname;
+  uint32_t heap_free;
+  EventText sdk_version;
+  EventText ingest_url;
+  EventOpt<EventIp> ip;
+  EventOpt<EventText> oui_index_id;  // absent without the OUI index
+};
+
+static constexpr EventField kBootFields[] = {
+    EVENT_TEXT(BootEvent, fw_version, 32),
+    EVENT_TEXT(BootEvent, chip_model, 32),
+    EVENT_TEXT(BootEvent, chip_rev, 3),
+    EVENT_FIELD(BootEvent, mac),
+    EVENT_TEXT(BootEvent, hostname, kEventHostnameMax),
+    EVENT_FIELD(BootEvent, heap_free),
+    EVENT_TEXT(BootEvent, sdk_version, 32),
+    EVENT_TEXT(BootEvent, ingest_url, kEventUrlMax),
+    EVENT_FIELD(BootEvent, ip),
+    EVENT_TEXT(BootEvent, oui_index_id, 8),
+};
+static constexpr EventDesc kBootEvent = {"node.boot", 1, nullptr, 0, kBootFields, eventCount(kBootFields),
+                                         kEventControl};
+static constexpr const EventDesc &eventDescOf(const BootEvent *) { return kBootEvent; }
+
+// ---- node.heartbeat ----------------------------------------------------------
+
+struct HeartbeatEvent {
+  uint32_t uptime_ms;
+  EventMacUpper mac;
+  EventText hostname;
+  int32_t wifi_rssi;
+  EventOpt<EventIp> ip;
+  uint32_t heap_free;
+  uint32_t queue_depth;
+  uint32_t ble_seen_total;
+};
+
+static constexpr EventField kHeartbeatFields[] = {
+    EVENT_FIELD(HeartbeatEvent, uptime_ms),
+    EVENT_FIELD(HeartbeatEvent, mac),
+    EVENT_TEXT(HeartbeatEvent, hostname, kEventHostnameMax),
+    EVENT_FIELD(HeartbeatEvent, wifi_rssi),
+    EVENT_FIELD(HeartbeatEvent, ip),
+    EVENT_FIELD(HeartbeatEvent, heap_free),
+    EVENT_FIELD(HeartbeatEvent, queue_depth),
+    EVENT_FIELD(HeartbeatEvent, ble_seen_total),
+};
+static constexpr EventDesc kHeartbeatEvent = {"node.heartbeat", 2, nullptr, 0, kHeartbeatFields,
+                                              eventCount(kHeartbeatFields), kEventStatus};
+static constexpr const EventDesc &eventDescOf(const HeartbeatEvent *) { return kHeartbeatEvent; }
+
+// ---- node.announce -----------------------------------------------------------
+
+struct AnnounceEvent {
+  EventText node_id;
+  EventIp ip;
+  EventMacUpper mac;
+  int32_t rssi;
+  EventText hostname;
+  EventText ssid;
+  EventIp gw;
+  EventIp mask;
+  EventIpList<2> dns;
+  uint32_t uptime_ms;
+  EventText fw_version;
+  EventText chip;
+  uint32_t http_port;
+};
+
+static constexpr EventField kAnnounceFields[] = {
+    EVENT_TEXT(AnnounceEvent, node_id, kEventNodeIdMax),
+    EVENT_FIELD(AnnounceEvent, ip),
+    EVENT_FIELD(AnnounceEvent, mac),
+    EVENT_FIELD(AnnounceEvent, rssi),
+    EVENT_TEXT(AnnounceEvent, hostname, kEventHostnameMax),
+    EVENT_TEXT(AnnounceEvent, ssid, kEventSsidMax),
+    EVENT_FIELD(AnnounceEvent, gw),
+    EVENT_FIELD(AnnounceEvent, mask),
+    EVENT_FIELD(AnnounceEvent, dns),
+    EVENT_FIELD(AnnounceEvent, uptime_ms),
+    EVENT_TEXT(AnnounceEvent, fw_version, 32),
+    EVENT_TEXT(AnnounceEvent, chip, 32),
+    EVENT_FIELD(AnnounceEvent, http_port),
+};
+static constexpr EventDesc kAnnounceEvent = {"node.announce", 3, nullptr, 0, kAnnounceFields,
+                                             eventCount(kAnnounceFields), kEventStatus};
+static constexpr const EventDesc &eventDescOf(const AnnounceEvent *) { return kAnnounceEvent; }
+
+// ---- wifi.status -------------------------------------------------------------
+
+struct WifiStatusEvent {
+  bool connected;
+  EventText state;
+  EventText ssid;
+  EventOpt<EventMacUpper> bssid;
+  int32_t channel;
+  EventOpt<EventIp> ip;
+  EventMacUpper mac;
+  EventText hostname;
+  int32_t rssi;
+  EventIp gw;
+  EventIp mask;
+  EventIpList<2> dns;
+  EventOpt<EventText> auth;
+  EventOpt<int32_t> reason;
+};
+
+static constexpr EventField kWifiStatusFields[] = {
+    EVENT_FIELD(WifiStatusEvent, connected),
+    EVENT_TEXT(WifiStatusEvent, state, 24),
+    EVENT_TEXT(WifiStatusEvent, ssid, kEventSsidMax),
+    EVENT_FIELD(WifiStatusEvent, bssid),
+    EVENT_FIELD(WifiStatusEvent, channel),
+    EVENT_FIELD(WifiStatusEvent, ip),
+    EVENT_FIELD(WifiStatusEvent, mac),
+    EVENT_TEXT(WifiStatusEvent, hostname, kEventHostnameMax),
+    EVENT_FIELD(WifiStatusEvent, rssi),
+    EVENT_FIELD(WifiStatusEvent, gw),
+    EVENT_FIELD(WifiStatusEvent, mask),
+    EVENT_FIELD(WifiStatusEvent, dns),
+    EVENT_TEXT(WifiStatusEvent, auth, 16),
+    EVENT_FIELD(WifiStatusEvent, reason),
+};
+static constexpr EventDesc kWifiStatusEvent = {"wifi.status", 4, nullptr, 0, kWifiStatusFields,
+                                               eventCount(kWifiStatusFields), kEventStatus};
+static constexpr const EventDesc &eventDescOf(const WifiStatusEvent *) { return kWifiStatusEvent; }
+
+// ---- wifi.ap_seen ------------------------------------------------------------
+
+struct WifiApSeenEvent {
+  EventText ssid;
+  EventMac bssid;
+  EventOpt<uint32_t> vendor_id;
+  uint32_t channel;
+  int32_t rssi;
+  EventText auth;
+};
+
+static constexpr EventField kWifiApSeenFields[] = {
+    EVENT_TEXT(WifiApSeenEvent, ssid, kEventSsidMax),
+    EVENT_FIELD(WifiApSeenEvent, bssid),
+    EVENT_FIELD(WifiApSeenEvent, vendor_id),
+    EVENT_FIELD(WifiApSeenEvent, channel),
+    EVENT_FIELD(WifiApSeenEvent, rssi),
+    EVENT_TEXT(WifiApSeenEvent, auth, 16),
+};
+static constexpr EventDesc kWifiApSeenEvent = {"wifi.ap_seen", 5, nullptr, 0, kWifiApSeenFields,
+                                               eventCount(kWifiApSeenFields), kEventTelemetry};
+static constexpr const EventDesc &eventDescOf(const WifiApSeenEvent *) { return kWifiApSeenEvent; }
+
+// ---- ingest.ok / ingest.err --------------------------------------------------
+
+struct IngestOkEvent {
+  bool ok;
+  uint32_t batch_count;
+  uint32_t ms;
+  uint32_t raw_bytes;
+  uint32_t wire_bytes;
+  EventOpt<EventFixed2> ratio;
+  EventText encoding;
+  EventText format;
+  uint32_t batch_limit;
+};
+
+static constexpr EventField kIngestOkFields[] = {
+    EVENT_FIELD(IngestOkEvent, ok),
+    EVENT_FIELD(IngestOkEvent, batch_count),
+    EVENT_FIELD(IngestOkEvent, ms),
+    EVENT_FIELD(IngestOkEvent, raw_bytes),
+    EVENT_FIELD(IngestOkEvent, wire_bytes),
+    EVENT_FIELD(IngestOkEvent, ratio),
+    EVENT_TEXT(IngestOkEvent, encoding, 16),
+    EVENT_TEXT(IngestOkEvent, format, 8),
+    EVENT_FIELD(IngestOkEvent, batch_limit),
+};
+static constexpr EventDesc kIngestOkEvent = {"ingest.ok", 6, nullptr, 0, kIngestOkFields,
+                                             eventCount(kIngestOkFields), kEventControl};
+static constexpr const EventDesc &eventDescOf(const IngestOkEvent *) { return kIngestOkEvent; }
+
+struct IngestErrEvent {
+  bool ok;
+  EventText err;
+  uint32_t ms;
+};
+
+// "err" is also copied into the envelope.
+static constexpr EventField kIngestErrEnvelope[] = {
+    EVENT_TEXT(IngestErrEvent, err, 96),
+};
+static constexpr EventField kIngestErrFields[] = {
+    EVENT_FIELD(IngestErrEvent, ok),
+    EVENT_TEXT(IngestErrEvent, err, 96),
+    EVENT_FIELD(IngestErrEvent, ms),
+};
+static constexpr EventDesc kIngestErrEvent = {"ingest.err", 7, kIngestErrEnvelope,
+                                              eventCount(kIngestErrEnvelope), kIngestErrFields,
+                                              eventCount(kIngestErrFields), kEventControl};
+static constexpr const EventDesc &eventDescOf(const IngestErrEvent *) { return kIngestErrEvent; }
+
+// ---- probe.net / probe.http --------------------------------------------------
+
+struct ProbeNetEvent {
+  EventText host;
+  bool ok;
+  uint32_t ms;
+  EventText ip;  // "" when the lookup failed
+};
+
+static constexpr EventField kProbeNetFields[] = {
+    EVENT_TEXT(ProbeNetEvent, host, 96),
+    EVENT_FIELD(ProbeNetEvent, ok),
+    EVENT_FIELD(ProbeNetEvent, ms),
+    EVENT_TEXT(ProbeNetEvent, ip, 15),
+};
+static constexpr EventDesc kProbeNetEvent = {"probe.net", 8, nullptr, 0, kProbeNetFields,
+                                             eventCount(kProbeNetFields), kEventStatus};
+static constexpr const EventDesc &eventDescOf(const ProbeNetEvent *) { return kProbeNetEvent; }
+
+struct ProbeHttpResultFields {
+  EventText url;
+  int32_t code;
+  bool ok;
+  uint32_t ms;
+};
+
+static constexpr EventField kProbeHttpResultFields[] = {
+    EVENT_TEXT(ProbeHttpResultFields, url, kEventUrlMax),
+    EVENT_FIELD(ProbeHttpResultFields, code),
+    EVENT_FIELD(ProbeHttpResultFields, ok),
+    EVENT_FIELD(ProbeHttpResultFields, ms),
+};
+
+struct ProbeHttpEvent {
+  EventOpt<ProbeHttpResultFields> ingest;
+  EventOpt<ProbeHttpResultFields> self;
+};
+
+static constexpr EventField kProbeHttpFields[] = {
+    EVENT_OBJECT(ProbeHttpEvent, ingest, kProbeHttpResultFields),
+    EVENT_OBJECT(ProbeHttpEvent, self, kProbeHttpResultFields),
+};
+static constexpr EventDesc kProbeHttpEvent = {"probe.http", 9, nullptr, 0, kProbeHttpFields,
+                                              eventCount(kProbeHttpFields), kEventStatus};
+static constexpr const EventDesc &eventDescOf(const ProbeHttpEvent *) { return kProbeHttpEvent; }
+
+// ---- ble.seen / ble.digest ---------------------------------------------------
+
+struct BleSeenEvent {
+  EventMac addr;
+  int32_t rssi;
+  EventText addr_type;
+  EventOpt<uint32_t> vendor_id;
+  uint32_t flags;
+  EventOpt<EventHex<32>> fp_stable;  // absent without BLE_FINGERPRINT
+  EventOpt<EventHex<32>> fp_addr;
+  // With BLE_COALESCE: adverts folded into this event while it was queued,
+  // and the RSSI range over them; "rssi" is the latest.
+  EventOpt<uint32_t> count;
+  EventOpt<int32_t> rssi_min;
+  EventOpt<int32_t> rssi_max;
+};
+
+// The address and RSSI are also copied into the envelope as "mac" and "rssi".
+static constexpr EventField kBleSeenEnvelope[] = {
+    EVENT_FIELD_AS(BleSeenEvent, "mac", addr),
+    EVENT_FIELD(BleSeenEvent, rssi),
+};
+static constexpr EventField kBleSeenFields[] = {
+    EVENT_FIELD(BleSeenEvent, addr),
+    EVENT_FIELD(BleSeenEvent, rssi),
+    EVENT_TEXT(BleSeenEvent, addr_type, 16),
+    EVENT_FIELD(BleSeenEvent, vendor_id),
+    EVENT_FIELD(BleSeenEvent, flags),
+    EVENT_FIELD(BleSeenEvent, fp_stable),
+    EVENT_FIELD(BleSeenEvent, fp_addr),
+    EVENT_FIELD(BleSeenEvent, count),
+    EVENT_FIELD(BleSeenEvent, rssi_min),
+    EVENT_FIELD(BleSeenEvent, rssi_max),
+};
+static constexpr EventDesc kBleSeenEvent = {"ble.seen", 10, kBleSeenEnvelope, eventCount(kBleSeenEnvelope),
+                                            kBleSeenFields, eventCount(kBleSeenFields), kEventTelemetry};
+static constexpr const EventDesc &eventDescOf(const BleSeenEvent *) { return kBleSeenEvent; }
+
+struct BleDigestEvent {
+  uint32_t window_start_ms;
+  uint32_t window_ms;
+  uint32_t part;
+  EventRaw devices;  // JSON array, sized by the caller
+};
+
+static constexpr EventField kBleDigestFields[] = {
+    EVENT_FIELD(BleDigestEvent, window_start_ms),
+    EVENT_FIELD(BleDigestEvent, window_ms),
+    EVENT_FIELD(BleDigestEvent, part),
+    EVENT_FIELD(BleDigestEvent, devices),
+};
+static constexpr EventDesc kBleDigestEvent = {"ble.digest", 11, nullptr, 0, kBleDigestFields,
+                                              eventCount(kBleDigestFields), kEventTelemetry};
+static constexpr const EventDesc &eventDescOf(const BleDigestEvent *) { return kBleDigestEvent; }
+
+// All of the above, for eventDecodeBinary().
+static constexpr const EventDesc *kNodeEvents[] = {
+    &kBootEvent,     &kHeartbeatEvent, &kAnnounceEvent,  &kWifiStatusEvent,
+    &kWifiApSeenEvent, &kIngestOkEvent, &kIngestErrEvent, &kProbeNetEvent,
+    &kProbeHttpEvent, &kBleSeenEvent,   &kBleDigestEvent,
+};
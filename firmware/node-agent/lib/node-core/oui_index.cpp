@@ -0,0 +1,139 @@
+#include "oui_index.h"
+
+#include <string.h>
+
+namespace {
+
+constexpr size_t kHeaderSize = 40;
+constexpr uint8_t kFormatVersion = 1;
+
+}  // namespace
+
+uint32_t OuiIndex::u32(size_t off) const {
+  return (uint32_t)data_[off] | (uint32_t)data_[off + 1] << 8 | (uint32_t)data_[off + 2] << 16 |
+         (uint32_t)data_[off + 3] << 24;
+}
+
+bool OuiIndex::begin(const uint8_t *data, size_t len) {
+  *this = OuiIndex();
+  if (!data || len < kHeaderSize || memcmp(data, "OUIX", 4) != 0 || data[4] != kFormatVersion) {
+    return false;
+  }
+  data_ = data;
+  len_ = len;
+  keyShift_ = data[5];
+  nameShift_ = data[6];
+  uint8_t tokens = data[7];
+  entries_ = u32(8);
+  vendors_ = u32(12);
+  indexId_ = u32(16);
+  keyBlocks_ = u32(20);
+  keyData_ = u32(24);
+  nameBlocks_ = u32(28);
+  nameData_ = u32(32);
+  tokenTable_ = u32(36);
+
+  bool ok = keyShift_ < 16 && nameShift_ < 16 && tokens <= kMaxTokens && vendors_ <= 0x7FFF &&
+            entries_ > 0 && keyBlocks_ >= kHeaderSize && keyBlocks_ <= keyData_ &&
+            keyData_ <= nameBlocks_ && nameBlocks_ <= nameData_ && nameData_ <= tokenTable_ &&
+            tokenTable_ <= len;
+  blockCount_ = (entries_ + (1u << keyShift_) - 1) >> keyShift_;
+  ok = ok && (uint64_t)blockCount_ * 8 <= keyData_ - keyBlocks_;
+  if (ok && nameData_ > nameBlocks_) {
+    uint32_t nameBlockCount = (vendors_ + (1u << nameShift_) - 1) >> nameShift_;
+    ok = (uint64_t)nameBlockCount * 4 <= nameData_ - nameBlocks_;
+    nameCount_ = vendors_;
+  }
+  size_t pos = tokenTable_;
+  for (uint8_t i = 0; ok && i < tokens; i++) {
+    ok = pos < len && pos + 1 + data[pos] <= len && pos - tokenTable_ <= 0xFFFF;
+    tokenOff_[i] = (uint16_t)(pos - tokenTable_);
+    pos += 1 + data[pos];
+  }
+  if (!ok) {
+    *this = OuiIndex();
+    return false;
+  }
+  tokenCount_ = tokens;
+  return true;
+}
+
+uint16_t OuiIndex::lookup(uint32_t oui) const {
+  if (!data_ || oui < u32(keyBlocks_)) return kNone;
+  // Last block whose first OUI is <= oui.
+  uint32_t lo = 0, hi = blockCount_;
+  while (hi - lo > 1) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if (u32(keyBlocks_ + mid * 8) <= oui) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+  uint32_t key = u32(keyBlocks_ + lo * 8);
+  size_t pos = keyData_ + u32(keyBlocks_ + lo * 8 + 4);
+  uint32_t first = lo << keyShift_;
+  uint32_t count = entries_ - first < (1u << keyShift_) ? entries_ - first : 1u << keyShift_;
+  for (uint32_t i = 0; i < count; i++) {
+    if (i > 0) {
+      uint32_t delta = 0;
+      for (int shift = 0; pos < nameBlocks_ && shift < 28; shift += 7) {
+        uint8_t b = data_[pos++];
+        delta |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) break;
+      }
+      key += delta;
+    }
+    if (pos >= nameBlocks_) return kNone;
+    uint16_t id = data_[pos++];
+    if (id & 0x80) {
+      if (pos >= nameBlocks_) return kNone;
+      id = (uint16_t)((id & 0x7F) << 8 | data_[pos++]);
+    }
+    if (key == oui) return id;
+    if (key > oui) break;
+  }
+  return kNone;
+}
+
+uint16_t OuiIndex::lookupMac(const uint8_t mac[6]) const {
+  // Bit 0 of the first byte: group address; bit 1: locally administered.
+  if (mac[0] & 0x03) return kNone;
+  return lookup((uint32_t)mac[0] << 16 | (uint32_t)mac[1] << 8 | mac[2]);
+}
+
+size_t OuiIndex::vendorName(uint16_t id, char *out, size_t cap) const {
+  if (cap == 0) return 0;
+  out[0] = '\0';
+  if (id >= nameCount_) return 0;
+  // Rebuild the front-coded (still token-compressed) name from its block start.
+  uint8_t enc[255];
+  uint8_t encLen = 0;
+  size_t pos = nameData_ + u32(nameBlocks_ + (id >> nameShift_) * 4);
+  uint32_t first = (uint32_t)id >> nameShift_ << nameShift_;
+  for (uint32_t i = first; i <= id; i++) {
+    if (pos + 2 > tokenTable_) return 0;
+    uint8_t shared = data_[pos];
+    uint8_t suffix = data_[pos + 1];
+    pos += 2;
+    if (shared > encLen || (size_t)shared + suffix > sizeof(enc) || pos + suffix > tokenTable_) {
+      return 0;
+    }
+    memcpy(enc + shared, data_ + pos, suffix);
+    encLen = (uint8_t)(shared + suffix);
+    pos += suffix;
+  }
+  size_t n = 0;
+  for (uint8_t i = 0; i < encLen && n + 1 < cap; i++) {
+    uint8_t c = enc[i];
+    if (c < 0x80) {
+      out[n++] = (char)c;
+      continue;
+    }
+    if ((size_t)(c - 0x80) >= tokenCount_) continue;
+    const uint8_t *tok = data_ + tokenTable_ + tokenOff_[c - 0x80];
+    for (uint8_t j = 0; j < tok[0] && n + 1 < cap; j++) out[n++] = (char)tok[1 + j];
+  }
+  out[n] = '\0';
+  return n;
+}
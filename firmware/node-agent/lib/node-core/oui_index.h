@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Read-only view of the OUI vendor index built by tools/oui_index.py (layout
+// documented there). The blob stays where it is, typically in flash; the view
+// keeps only offsets and a token table, so lookups allocate nothing.
+//
+// Entries are sorted by OUI and split into blocks of 32 with the first OUI
+// of each block stored in full: a lookup binary-searches the block table and
+// then walks at most 31 delta-coded entries. Vendor ids index the generator's
+// sorted vendor list and are stable for a given index id; names are optional
+// (front-coded, token-compressed) and absent from ids-only builds.
+class OuiIndex {
+ public:
+  static constexpr uint16_t kNone = 0xFFFF;
+  static constexpr size_t kMaxTokens = 128;
+
+  // Validates the header and section offsets. Returns false (and stays
+  // empty, so every lookup misses) when `data` is not a usable index.
+  bool begin(const uint8_t *data, size_t len);
+
+  bool valid() const { return data_ != nullptr; }
+  bool hasNames() const { return nameCount_ > 0; }
+  uint32_t entryCount() const { return entries_; }
+  uint32_t vendorCount() const { return vendors_; }
+  uint32_t indexId() const { return indexId_; }
+  size_t sizeBytes() const { return len_; }
+
+  // Vendor id for a 24-bit OUI, or kNone.
+  uint16_t lookup(uint32_t oui) const;
+  // Vendor id for a MAC (most significant byte first). Locally administered
+  // and multicast addresses have no registered OUI and return kNone. BLE
+  // random addresses carry no OUI either; callers check the address type.
+  uint16_t lookupMac(const uint8_t mac[6]) const;
+
+  // Writes the NUL-terminated vendor name into `out` (truncated to fit) and
+  // returns its length; 0 when the id is unknown or names were not built in.
+  size_t vendorName(uint16_t id, char *out, size_t cap) const;
+
+ private:
+  uint32_t u32(size_t off) const;
+
+  const uint8_t *data_ = nullptr;
+  size_t len_ = 0;
+  uint32_t entries_ = 0;
+  uint32_t vendors_ = 0;
+  uint32_t indexId_ = 0;
+  uint8_t keyShift_ = 0;
+  uint8_t nameShift_ = 0;
+  uint32_t keyBlocks_ = 0;
+  uint32_t blockCount_ = 0;
+  uint32_t keyData_ = 0;
+  uint32_t nameBlocks_ = 0;
+  uint32_t nameData_ = 0;
+  uint32_t tokenTable_ = 0;
+  uint32_t nameCount_ = 0;
+  uint8_t tokenCount_ = 0;
+  uint16_t tokenOff_[kMaxTokens] = {};
+};
@@ -0,0 +1,147 @@
+#include "prom_writer.h"
+
+#include <stdio.h>
+#include <string.h>
+
+size_t formatPromDecimal(char *out, uint64_t scaled, uint8_t decimals) {
+  uint64_t div = 1;
+  for (uint8_t i = 0; i < decimals; i++) div *= 10;
+  int n = snprintf(out, 32, "%llu", (unsigned long long)(scaled / div));
+  uint64_t frac = scaled % div;
+  if (decimals == 0 || frac == 0 || n < 0) return n < 0 ? 0 : (size_t)n;
+  char digits[20];
+  for (int i = decimals - 1; i >= 0; i--) {
+    digits[i] = char('0' + frac % 10);
+    frac /= 10;
+  }
+  uint8_t used = decimals;
+  while (used > 0 && digits[used - 1] == '0') used--;
+  out[n++] = '.';
+  memcpy(out + n, digits, used);
+  n += used;
+  out[n] = '\0';
+  return (size_t)n;
+}
+
+PromWriter::PromWriter(char *buf, size_t cap) : buf_(buf), cap_(cap) {
+  if (cap_ > 0) buf_[0] = '\0';
+  else overflow_ = true;
+}
+
+void PromWriter::setSink(Sink sink, void *ctx) {
+  sink_ = sink;
+  sinkCtx_ = ctx;
+}
+
+bool PromWriter::flush() {
+  if (!sink_ || overflow_) return false;
+  if (pos_ == 0) return true;
+  if (!sink_(sinkCtx_, buf_, pos_)) {
+    overflow_ = true;
+    return false;
+  }
+  pos_ = 0;
+  buf_[0] = '\0';
+  return true;
+}
+
+void PromWriter::put(const char *s, size_t len) {
+  if (overflow_) return;
+  if (pos_ + len >= cap_) {
+    if (!flush()) {
+      overflow_ = true;
+      return;
+    }
+    if (len >= cap_) {
+      if (!sink_(sinkCtx_, s, len)) overflow_ = true;
+      return;
+    }
+  }
+  memcpy(buf_ + pos_, s, len);
+  pos_ += len;
+  buf_[pos_] = '\0';
+}
+
+void PromWriter::put(const char *s) { put(s, strlen(s)); }
+
+void PromWriter::header(const char *name, const char *help, const char *type) {
+  put("# HELP ");
+  put(name);
+  put(" ");
+  put(help);
+  put("\n# TYPE ");
+  put(name);
+  put(" ");
+  put(type);
+  put("\n");
+}
+
+void PromWriter::sample(const char *name, const char *suffix, const char *label,
+                        const char *labelValue, const char *value) {
+  put(name);
+  put(suffix);
+  if (label) {
+    put("{");
+    put(label);
+    put("=\"");
+    put(labelValue);
+    put("\"}");
+  }
+  put(" ");
+  put(value);
+  put("\n");
+}
+
+void PromWriter::counter(const char *name, const char *help, uint64_t value) {
+  header(name, help, "counter");
+  char num[24];
+  snprintf(num, sizeof(num), "%llu", (unsigned long long)value);
+  sample(name, "", nullptr, nullptr, num);
+}
+
+void PromWriter::gauge(const char *name, const char *help, int64_t value) {
+  header(name, help, "gauge");
+  char num[24];
+  snprintf(num, sizeof(num), "%lld", (long long)value);
+  sample(name, "", nullptr, nullptr, num);
+}
+
+void PromWriter::counters(const char *name, const char *help, const char *label,
+                          const char *const *labelValues, const uint64_t *values, size_t count) {
+  header(name, help, "counter");
+  char num[24];
+  for (size_t i = 0; i < count; i++) {
+    snprintf(num, sizeof(num), "%llu", (unsigned long long)values[i]);
+    sample(name, "", label, labelValues[i], num);
+  }
+}
+
+void PromWriter::gauges(const char *name, const char *help, const char *label,
+                        const char *const *labelValues, const int64_t *values, size_t count) {
+  header(name, help, "gauge");
+  char num[24];
+  for (size_t i = 0; i < count; i++) {
+    snprintf(num, sizeof(num), "%lld", (long long)values[i]);
+    sample(name, "", label, labelValues[i], num);
+  }
+}
+
+void PromWriter::histogram(const char *name, const char *help, const Histogram::Snapshot &s,
+                           uint8_t decimals) {
+  header(name, help, "histogram");
+  char le[32];
+  char num[32];
+  uint64_t cumulative = 0;
+  for (size_t i = 0; i < Histogram::kBuckets - 1; i++) {
+    cumulative += s.counts[i];
+    formatPromDecimal(le, Histogram::bound(i), decimals);
+    snprintf(num, sizeof(num), "%llu", (unsigned long long)cumulative);
+    sample(name, "_bucket", "le", le, num);
+  }
+  snprintf(num, sizeof(num), "%llu", (unsigned long long)s.count);
+  sample(name, "_bucket", "le", "+Inf", num);
+  formatPromDecimal(num, s.sum, decimals);
+  sample(name, "_sum", nullptr, nullptr, num);
+  snprintf(num, sizeof(num), "%llu", (unsigned long long)s.count);
+  sample(name, "_count", nullptr, nullptr, num);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "histogram.h"
+
+// Prometheus text exposition format (0.0.4) over caller-owned storage. Like
+// JsonWriter it never allocates; with a sink set, output that does not fit
+// is handed to the sink and the buffer reused, otherwise overflowed()
+// latches. Metric names and help texts are trusted literals.
+class PromWriter {
+ public:
+  typedef bool (*Sink)(void *ctx, const char *data, size_t len);
+
+  PromWriter(char *buf, size_t cap);
+
+  void setSink(Sink sink, void *ctx);
+  bool flush();
+
+  void counter(const char *name, const char *help, uint64_t value);
+  void gauge(const char *name, const char *help, int64_t value);
+  // One family with a sample per value of `label`, e.g. name{class="control"}.
+  // Label values are trusted literals too.
+  void counters(const char *name, const char *help, const char *label, const char *const *labelValues,
+                const uint64_t *values, size_t count);
+  void gauges(const char *name, const char *help, const char *label, const char *const *labelValues,
+              const int64_t *values, size_t count);
+  // `decimals` converts recorded units to the base unit in the name, e.g. 3
+  // for milliseconds into *_seconds, 6 for microseconds.
+  void histogram(const char *name, const char *help, const Histogram::Snapshot &s,
+                 uint8_t decimals);
+
+  const char *c_str() const { return buf_; }
+  size_t size() const { return pos_; }
+  bool overflowed() const { return overflow_; }
+
+ private:
+  void header(const char *name, const char *help, const char *type);
+  void sample(const char *name, const char *suffix, const char *label, const char *labelValue,
+              const char *value);
+  void put(const char *s, size_t len);
+  void put(const char *s);
+
+  char *buf_;
+  size_t cap_;
+  size_t pos_ = 0;
+  bool overflow_ = false;
+  Sink sink_ = nullptr;
+  void *sinkCtx_ = nullptr;
+};
+
+// Writes `scaled / 10^decimals` as a plain decimal (no exponent), trailing
+// zeros trimmed; returns the length. `out` needs 32 bytes.
+size_t formatPromDecimal(char *out, uint64_t scaled, uint8_t decimals);
@@ -0,0 +1,165 @@
+#include "record_ring.h"
+
+#include <string.h>
+
+namespace {
+
+const uint16_t kWrapMarker = 0xFFFF;
+
+}  // namespace
+
+RecordRing::RecordRing(uint8_t *arena, size_t bytes) : arena_(arena), cap_(bytes & ~(size_t)3) {}
+
+void RecordRing::writeHeader(size_t off, size_t len, uint8_t flags, uint8_t kind) {
+  uint8_t *h = arena_ + off;
+  h[0] = (uint8_t)(len & 0xFF);
+  h[1] = (uint8_t)(len >> 8);
+  h[2] = flags;
+  h[3] = kind;
+}
+
+size_t RecordRing::recordLen(size_t off) const {
+  const uint8_t *h = arena_ + off;
+  return (size_t)h[0] | ((size_t)h[1] << 8);
+}
+
+size_t RecordRing::placeFor(size_t need) const {
+  if (need > cap_) return npos;
+  if (count_ == 0) return 0;
+  if (tail_ > head_) {
+    if (need <= cap_ - tail_) return tail_;
+    if (need <= head_) return 0;
+    return npos;
+  }
+  if (tail_ < head_ && need <= head_ - tail_) return tail_;
+  return npos;
+}
+
+char *RecordRing::allocate(size_t len, uint8_t flags, uint8_t kind) {
+  if (len > kMaxRecordBytes) return nullptr;
+  size_t need = footprint(len);
+  size_t at = placeFor(need);
+  if (at == npos) return nullptr;
+  if (count_ == 0) {
+    head_ = 0;
+  } else if (at == 0 && tail_ != 0) {
+    writeHeader(tail_, kWrapMarker, 0, 0);
+  }
+  writeHeader(at, len, flags, kind);
+  last_ = at;
+  tail_ = at + need;
+  if (tail_ == cap_) tail_ = 0;
+  count_++;
+  size_t used = bytesUsed();
+  if (used > highWater_) highWater_ = used;
+  return reinterpret_cast<char *>(arena_ + at + kHeaderBytes);
+}
+
+bool RecordRing::push(const char *data, size_t len, uint8_t flags, uint8_t kind) {
+  char *dst = allocate(len, flags, kind);
+  if (!dst) return false;
+  if (len > 0) memcpy(dst, data, len);
+  return true;
+}
+
+size_t RecordRing::normalize(size_t off) const {
+  if (off == cap_) return 0;
+  if (off != tail_ && recordLen(off) == kWrapMarker) return 0;
+  return off;
+}
+
+void RecordRing::pop() {
+  if (count_ == 0) return;
+  count_--;
+  if (count_ == 0) {
+    head_ = 0;
+    tail_ = 0;
+    return;
+  }
+  head_ = normalize(head_ + footprint(recordLen(head_)));
+}
+
+void RecordRing::clear() {
+  head_ = 0;
+  tail_ = 0;
+  last_ = 0;
+  count_ = 0;
+}
+
+size_t RecordRing::next(size_t off) const {
+  if (off == npos) return npos;
+  size_t pos = off + footprint(recordLen(off));
+  if (pos == cap_) pos = 0;
+  if (pos == tail_) return npos;
+  pos = normalize(pos);
+  return pos == tail_ ? npos : pos;
+}
+
+size_t RecordRing::after(size_t off) const {
+  size_t pos = off + footprint(recordLen(off));
+  if (pos == cap_ || recordLen(pos) == kWrapMarker) return 0;
+  return pos;
+}
+
+RecordRing::View RecordRing::view(size_t off) const {
+  const uint8_t *h = arena_ + off;
+  View v;
+  v.data = reinterpret_cast<const char *>(h + kHeaderBytes);
+  v.len = recordLen(off);
+  v.flags = h[2];
+  v.kind = h[3];
+  return v;
+}
+
+char *RecordRing::mutableData(size_t off) { return reinterpret_cast<char *>(arena_ + off + kHeaderBytes); }
+
+void RecordRing::setFlags(size_t off, uint8_t flags) { arena_[off + 2] = flags; }
+
+size_t RecordRing::bytesUsed() const {
+  if (count_ == 0) return 0;
+  if (tail_ > head_) return tail_ - head_;
+  return cap_ - head_ + tail_;
+}
+
+RecordBatchReader::RecordBatchReader(const RecordRing &ring, size_t count)
+    : RecordBatchReader(ring, count, ring.begin()) {}
+
+RecordBatchReader::RecordBatchReader(const RecordRing &ring, size_t count, size_t first)
+    : ring_(ring), off_(first) {
+  size_t off = off_;
+  while (count_ < count && off != RecordRing::npos) {
+    length_ += ring_.view(off).len + (count_ > 0 ? 1 : 0);
+    off = ring_.next(off);
+    count_++;
+  }
+}
+
+size_t RecordBatchReader::read(char *out, size_t max) {
+  size_t n = 0;
+  while (n < max && sent_ < length_) {
+    if (sent_ == 0 || sent_ == length_ - 1) {
+      out[n++] = sent_ == 0 ? '[' : ']';
+      sent_++;
+      continue;
+    }
+    if (pos_ == 0 && index_ > 0 && !sepDone_) {
+      out[n++] = ',';
+      sent_++;
+      sepDone_ = true;
+      continue;
+    }
+    RecordRing::View v = ring_.view(off_);
+    size_t take = v.len - pos_;
+    if (take > max - n) take = max - n;
+    memcpy(out + n, v.data + pos_, take);
+    n += take;
+    sent_ += take;
+    pos_ += take;
+    if (pos_ == v.len) {
+      pos_ = 0;
+      if (++index_ < count_) off_ = ring_.after(off_);
+      sepDone_ = false;
+    }
+  }
+  return n;
+}
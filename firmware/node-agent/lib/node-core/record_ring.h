@@ -0,0 +1,99 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// FIFO of variable-length records framed in place inside one caller-provided
+// byte arena. Each record is a 4-byte header (length, flags, kind) followed by
+// its payload, padded to 4 bytes. Records never straddle the end of the
+// arena: when one does not fit, a wrap marker sends it back to offset 0, so
+// every payload is a single contiguous view into the arena.
+class RecordRing {
+ public:
+  static const size_t kHeaderBytes = 4;
+  static const size_t kMaxRecordBytes = 0xFFFE;
+  static const size_t npos = (size_t)-1;
+
+  struct View {
+    const char *data;
+    size_t len;
+    uint8_t flags;
+    uint8_t kind;
+  };
+
+  RecordRing(uint8_t *arena, size_t bytes);
+
+  // Fails (without side effects) when the record does not fit.
+  bool push(const char *data, size_t len, uint8_t flags = 0, uint8_t kind = 0);
+  // Reserves space for a record and returns a writable pointer to its
+  // payload, or nullptr when it does not fit. The record becomes visible to
+  // readers immediately.
+  char *allocate(size_t len, uint8_t flags = 0, uint8_t kind = 0);
+  void pop();
+  void clear();
+
+  bool empty() const { return count_ == 0; }
+  size_t count() const { return count_; }
+  View front() const { return view(head_); }
+  // Offset of the most recently pushed record; only meaningful when not empty.
+  size_t last() const { return last_; }
+
+  // Record offsets for in-order iteration:
+  //   for (size_t off = ring.begin(); off != RecordRing::npos; off = ring.next(off))
+  size_t begin() const { return count_ ? head_ : npos; }
+  size_t next(size_t off) const;
+  // Offset of the record after `off`, which must not be the last one queued.
+  // Reads only record headers, never the ring's tail, so it may walk records
+  // that a concurrent push cannot touch.
+  size_t after(size_t off) const;
+  View view(size_t off) const;
+  char *mutableData(size_t off);
+  void setFlags(size_t off, uint8_t flags);
+
+  // Bytes held by queued records including headers, padding and any space
+  // skipped at the end of the arena by a wrap.
+  size_t bytesUsed() const;
+  size_t bytesHighWater() const { return highWater_; }
+  size_t capacityBytes() const { return cap_; }
+  // Arena footprint of a record with `len` payload bytes.
+  static size_t footprint(size_t len) { return kHeaderBytes + ((len + 3) & ~(size_t)3); }
+
+ private:
+  size_t placeFor(size_t need) const;
+  size_t normalize(size_t off) const;
+  void writeHeader(size_t off, size_t len, uint8_t flags, uint8_t kind);
+  size_t recordLen(size_t off) const;
+
+  uint8_t *arena_;
+  size_t cap_;
+  size_t head_ = 0;
+  size_t tail_ = 0;
+  size_t last_ = 0;
+  size_t count_ = 0;
+  size_t highWater_ = 0;
+};
+
+// Produces "[rec,rec,...]" for `count` records of a ring, starting at the
+// front or at record offset `first`, without copying them into a separate
+// payload buffer; read() accepts any chunk size. After construction it reads
+// only the records it covers, so it can run without the owner's lock while
+// those records are neither popped nor rewritten.
+class RecordBatchReader {
+ public:
+  RecordBatchReader(const RecordRing &ring, size_t count);
+  RecordBatchReader(const RecordRing &ring, size_t count, size_t first);
+
+  size_t length() const { return length_; }
+  size_t remaining() const { return length_ - sent_; }
+  size_t read(char *out, size_t max);
+
+ private:
+  const RecordRing &ring_;
+  size_t length_ = 2;
+  size_t sent_ = 0;
+  size_t off_;
+  size_t pos_ = 0;
+  size_t index_ = 0;
+  size_t count_ = 0;
+  bool sepDone_ = false;
+};
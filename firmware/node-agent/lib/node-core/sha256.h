@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(ESP_PLATFORM)
+#include <mbedtls/sha256.h>
+#endif
+
+// Incremental SHA-256. On the ESP32 this goes through mbedTLS, which uses the
+// chip's SHA accelerator; on the host it is a portable implementation.
+class Sha256 {
+ public:
+  static const size_t kDigestBytes = 32;
+
+  Sha256();
+  ~Sha256();
+  Sha256(const Sha256 &) = delete;
+  Sha256 &operator=(const Sha256 &) = delete;
+
+  void update(const void *data, size_t len);
+  void update(const char *s);
+  // Writes the digest; the object must not be updated afterwards.
+  void finish(uint8_t out[kDigestBytes]);
+
+ private:
+#if defined(ESP_PLATFORM)
+  mbedtls_sha256_context ctx_;
+#else
+  void compress(const uint8_t block[64]);
+
+  uint32_t state_[8];
+  uint64_t total_ = 0;
+  uint8_t block_[64];
+  size_t used_ = 0;
+#endif
+};
+
+// Lowercase hex of a digest; `out` receives 64 characters plus a NUL.
+void sha256Hex(const uint8_t digest[Sha256::kDigestBytes], char out[65]);
@@ -0,0 +1,192 @@
+#include "spill_log.h"
+
+#include <string.h>
+
+#include "crc32.h"
+
+namespace {
+
+const size_t kListMax = 256;
+
+}  // namespace
+
+SpillLog::SpillLog(SpillStorage &storage, uint8_t *writeBuf, size_t writeBufBytes,
+                   size_t segmentBytes, size_t maxSegments)
+    : storage_(storage),
+      buf_(writeBuf),
+      bufCap_(writeBufBytes),
+      segmentBytes_(segmentBytes),
+      maxSegments_(maxSegments > 1 ? maxSegments : 2) {}
+
+void SpillLog::begin() {
+  uint32_t ids[kListMax];
+  size_t n = storage_.list(ids, kListMax);
+  bufLen_ = 0;
+  readOff_ = 0;
+  peeked_ = false;
+  pendingBytes_ = 0;
+  if (n == 0) {
+    firstSeg_ = lastSeg_ = 0;
+    firstSegBytes_ = lastSegBytes_ = 0;
+    return;
+  }
+  uint32_t lo = ids[0];
+  uint32_t hi = ids[0];
+  for (size_t i = 1; i < n; i++) {
+    if (ids[i] < lo) lo = ids[i];
+    if (ids[i] > hi) hi = ids[i];
+  }
+  firstSeg_ = lo;
+  lastSeg_ = hi;
+  for (uint32_t id = lo; id <= hi; id++) pendingBytes_ += storage_.size(id);
+  firstSegBytes_ = storage_.size(firstSeg_);
+  lastSegBytes_ = storage_.size(lastSeg_);
+  // Never append after a possibly torn tail; start a fresh segment instead.
+  if (lastSegBytes_ > 0) rotate();
+  while (segmentCount() > maxSegments_) dropFirstSegment(true);
+}
+
+void SpillLog::rotate() {
+  flush();
+  if (firstSeg_ == lastSeg_) firstSegBytes_ = lastSegBytes_;
+  lastSeg_++;
+  lastSegBytes_ = 0;
+}
+
+void SpillLog::dropFirstSegment(bool counted) {
+  size_t size = firstSeg_ == lastSeg_ ? lastSegBytes_ : firstSegBytes_;
+  size_t unread = size > readOff_ ? size - readOff_ : 0;
+  pendingBytes_ -= unread < pendingBytes_ ? unread : pendingBytes_;
+  if (counted) {
+    stats_.droppedSegments++;
+    stats_.droppedBytes += unread;
+  }
+  storage_.remove(firstSeg_);
+  advanceSegment();
+}
+
+void SpillLog::advanceSegment() {
+  if (firstSeg_ == lastSeg_) {
+    // Reader caught up with the writer: start over in a new segment.
+    bufLen_ = 0;
+    lastSeg_++;
+    lastSegBytes_ = 0;
+  }
+  firstSeg_++;
+  firstSegBytes_ = firstSeg_ == lastSeg_ ? 0 : storage_.size(firstSeg_);
+  readOff_ = 0;
+  peeked_ = false;
+}
+
+bool SpillLog::append(const char *data, size_t len, uint8_t kind) {
+  if (len > 0xFFFF) return false;
+  size_t need = kHeaderBytes + len;
+  if (lastSegBytes_ > 0 && lastSegBytes_ + need > segmentBytes_) {
+    rotate();
+    while (segmentCount() > maxSegments_) dropFirstSegment(true);
+  }
+  if (bufLen_ + need > bufCap_ && !flush()) return false;
+
+  uint8_t header[kHeaderBytes] = {kMagic, kind, (uint8_t)(len & 0xFF), (uint8_t)(len >> 8)};
+  uint32_t crc = crc32Update(crc32Update(0, header, 4), data, len);
+  for (int b = 0; b < 4; b++) header[4 + b] = (uint8_t)(crc >> (8 * b));
+
+  if (need > bufCap_) {
+    if (!storage_.append(lastSeg_, header, kHeaderBytes) ||
+        !storage_.append(lastSeg_, reinterpret_cast<const uint8_t *>(data), len)) {
+      stats_.writeErrors++;
+      return false;
+    }
+    stats_.writtenBytes += need;
+  } else {
+    memcpy(buf_ + bufLen_, header, kHeaderBytes);
+    memcpy(buf_ + bufLen_ + kHeaderBytes, data, len);
+    bufLen_ += need;
+  }
+  lastSegBytes_ += need;
+  pendingBytes_ += need;
+  stats_.appended++;
+  return true;
+}
+
+bool SpillLog::flush() {
+  if (bufLen_ == 0) return true;
+  bool ok = storage_.append(lastSeg_, buf_, bufLen_);
+  if (ok) {
+    stats_.writtenBytes += bufLen_;
+  } else {
+    stats_.writeErrors++;
+    lastSegBytes_ -= bufLen_;
+    pendingBytes_ -= bufLen_;
+  }
+  bufLen_ = 0;
+  return ok;
+}
+
+bool SpillLog::peek(char *out, size_t cap, size_t &len, uint8_t &kind) {
+  while (pendingBytes_ > 0) {
+    bool onLast = firstSeg_ == lastSeg_;
+    size_t segSize = onLast ? lastSegBytes_ : firstSegBytes_;
+    if (readOff_ >= segSize) {
+      if (onLast) {
+        pendingBytes_ = 0;
+        return false;
+      }
+      dropFirstSegment(false);
+      continue;
+    }
+    if (onLast && bufLen_ > 0) flush();
+
+    uint8_t header[kHeaderBytes];
+    size_t got = storage_.read(firstSeg_, readOff_, header, kHeaderBytes);
+    size_t recLen = (size_t)header[2] | ((size_t)header[3] << 8);
+    bool ok = got == kHeaderBytes && header[0] == kMagic && readOff_ + kHeaderBytes + recLen <= segSize;
+    if (ok && recLen > cap) {
+      // Intact but unreadable here: skip just this record.
+      stats_.oversized++;
+      readOff_ += kHeaderBytes + recLen;
+      pendingBytes_ -= kHeaderBytes + recLen;
+      continue;
+    }
+    if (ok) {
+      ok = storage_.read(firstSeg_, readOff_ + kHeaderBytes, reinterpret_cast<uint8_t *>(out),
+                         recLen) == recLen;
+    }
+    if (ok) {
+      uint32_t crc = crc32Update(crc32Update(0, header, 4), out, recLen);
+      uint32_t want = (uint32_t)header[4] | ((uint32_t)header[5] << 8) |
+                      ((uint32_t)header[6] << 16) | ((uint32_t)header[7] << 24);
+      ok = crc == want;
+    }
+    if (!ok) {
+      // Framing can no longer be trusted: abandon the rest of the segment.
+      stats_.crcErrors++;
+      if (onLast) {
+        pendingBytes_ = 0;
+        readOff_ = segSize;
+        return false;
+      }
+      pendingBytes_ -= segSize - readOff_ < pendingBytes_ ? segSize - readOff_ : pendingBytes_;
+      readOff_ = segSize;
+      continue;
+    }
+    len = recLen;
+    kind = header[1];
+    peekLen_ = recLen;
+    peeked_ = true;
+    return true;
+  }
+  return false;
+}
+
+void SpillLog::pop() {
+  if (!peeked_) return;
+  peeked_ = false;
+  size_t used = kHeaderBytes + peekLen_;
+  readOff_ += used;
+  pendingBytes_ -= used < pendingBytes_ ? used : pendingBytes_;
+  stats_.replayed++;
+  bool onLast = firstSeg_ == lastSeg_;
+  size_t segSize = onLast ? lastSegBytes_ : firstSegBytes_;
+  if (readOff_ >= segSize && (!onLast || pendingBytes_ == 0)) dropFirstSegment(false);
+}
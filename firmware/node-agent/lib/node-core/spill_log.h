@@ -0,0 +1,88 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Backing store for SpillLog: numbered, append-only segment files. The
+// device implementation sits on LittleFS; host tests use memory or stdio.
+class SpillStorage {
+ public:
+  virtual ~SpillStorage() {}
+  // Writes up to `max` existing segment ids, in any order; returns the count.
+  virtual size_t list(uint32_t *ids, size_t max) = 0;
+  virtual bool append(uint32_t id, const uint8_t *data, size_t len) = 0;
+  virtual size_t read(uint32_t id, size_t offset, uint8_t *out, size_t len) = 0;
+  // 0 when the segment does not exist.
+  virtual size_t size(uint32_t id) = 0;
+  virtual bool remove(uint32_t id) = 0;
+};
+
+// Append-only overflow log for queued events, split into fixed-size
+// segments. Each record is framed as
+//   magic(0xA5) kind len:u16le crc32:u32le payload
+// with the CRC covering the first four header bytes and the payload, so a torn
+// or corrupted tail is detected and skipped on replay. Appends are buffered
+// in RAM and written a buffer at a time. Segments are never rewritten: they
+// are deleted whole once replayed, and the oldest is dropped when the log
+// reaches maxSegments. That keeps flash wear to one sequential write per byte.
+// The read position is not persisted; after a reboot the oldest segment is
+// replayed from its start.
+class SpillLog {
+ public:
+  static const size_t kHeaderBytes = 8;
+  static const uint8_t kMagic = 0xA5;
+
+  struct Stats {
+    uint32_t appended;
+    uint32_t replayed;
+    uint32_t crcErrors;
+    uint32_t oversized;  // intact records larger than the reader's buffer, skipped
+    uint32_t writeErrors;
+    uint32_t droppedSegments;
+    uint64_t droppedBytes;
+    uint64_t writtenBytes;
+  };
+
+  SpillLog(SpillStorage &storage, uint8_t *writeBuf, size_t writeBufBytes, size_t segmentBytes,
+           size_t maxSegments);
+
+  // Picks up segments left by a previous boot.
+  void begin();
+
+  bool append(const char *data, size_t len, uint8_t kind = 0);
+  // Writes buffered records to storage.
+  bool flush();
+  size_t buffered() const { return bufLen_; }
+
+  // Copies the oldest record into `out`. Returns false when the log is empty.
+  // Records larger than `cap` are skipped and counted as errors.
+  bool peek(char *out, size_t cap, size_t &len, uint8_t &kind);
+  // Consumes the record returned by the last successful peek().
+  void pop();
+
+  bool empty() const { return pendingBytes_ == 0; }
+  uint64_t pendingBytes() const { return pendingBytes_; }
+  size_t segmentCount() const { return (size_t)(lastSeg_ - firstSeg_ + 1); }
+  const Stats &stats() const { return stats_; }
+
+ private:
+  void rotate();
+  void dropFirstSegment(bool counted);
+  void advanceSegment();
+
+  SpillStorage &storage_;
+  uint8_t *buf_;
+  size_t bufCap_;
+  size_t bufLen_ = 0;
+  size_t segmentBytes_;
+  size_t maxSegments_;
+  uint32_t firstSeg_ = 0;
+  uint32_t lastSeg_ = 0;
+  size_t firstSegBytes_ = 0;  // size of firstSeg_ when it is not the last
+  size_t lastSegBytes_ = 0;   // includes buffered bytes
+  size_t readOff_ = 0;
+  size_t peekLen_ = 0;
+  bool peeked_ = false;
+  uint64_t pendingBytes_ = 0;
+  Stats stats_ = {};
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+// Lock-free single-producer/single-consumer ring of fixed-size records.
+// push() may only be called from one task (e.g. the NimBLE host callback)
+// and pop() from one other task (the main loop). Indices only ever move
+// forward; each side owns one of them and publishes it with release
+// ordering. Statistics are written by the producer alone, so they need only
+// plain atomic loads/stores (no read-modify-write, which the ESP32-C3 lacks).
+template <typename T, size_t N>
+class SpscRing {
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+ public:
+  // Producer side. Returns false and counts a drop when the ring is full.
+  bool push(const T &item) {
+    uint32_t tail = tail_.load(std::memory_order_relaxed);
+    uint32_t head = head_.load(std::memory_order_acquire);
+    if (tail - head >= N) {
+      bump(drops_);
+      if (!full_) {
+        full_ = true;
+        bump(overruns_);
+      }
+      return false;
+    }
+    full_ = false;
+    slots_[tail & (N - 1)] = item;
+    tail_.store(tail + 1, std::memory_order_release);
+    uint32_t depth = tail + 1 - head;
+    if (depth > highWater_.load(std::memory_order_relaxed)) {
+      highWater_.store(depth, std::memory_order_relaxed);
+    }
+    return true;
+  }
+
+  // Consumer side.
+  bool pop(T &out) {
+    uint32_t head = head_.load(std::memory_order_relaxed);
+    uint32_t tail = tail_.load(std::memory_order_acquire);
+    if (head == tail) return false;
+    out = slots_[head & (N - 1)];
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  size_t size() const {
+    return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+  }
+  static constexpr size_t capacity() { return N; }
+  // Records rejected because the ring was full.
+  uint32_t dropCount() const { return drops_.load(std::memory_order_relaxed); }
+  // Distinct episodes in which the producer outran the consumer and filled
+  // the ring (one overrun may cover many drops).
+  uint32_t overrunCount() const { return overruns_.load(std::memory_order_relaxed); }
+  uint32_t highWater() const { return highWater_.load(std::memory_order_relaxed); }
+
+ private:
+  static void bump(std::atomic<uint32_t> &counter) {
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+
+  T slots_[N];
+  std::atomic<uint32_t> head_{0};
+  std::atomic<uint32_t> tail_{0};
+  std::atomic<uint32_t> drops_{0};
+  std::atomic<uint32_t> overruns_{0};
+  std::atomic<uint32_t> highWater_{0};
+  bool full_ = false;
+};
@@ -0,0 +1,23 @@
+#include "stage_meter.h"
+
+bool StageWindow::sample(const StageMeter &meter, uint32_t nowUs) {
+  uint32_t busy = meter.busyUs();
+  uint32_t items = meter.items();
+  if (!open_) {
+    open_ = true;
+    startUs_ = nowUs;
+    startBusy_ = busy;
+    startItems_ = items;
+    return false;
+  }
+  uint32_t elapsed = nowUs - startUs_;
+  if (elapsed < windowUs_ || elapsed == 0) return false;
+  uint64_t permille = (uint64_t)(busy - startBusy_) * 1000 / elapsed;
+  permille_ = permille > 1000 ? 1000 : (uint16_t)permille;
+  if (permille_ > peak_) peak_ = permille_;
+  itemsPerSec_ = (uint32_t)((uint64_t)(items - startItems_) * 1000000 / elapsed);
+  startUs_ = nowUs;
+  startBusy_ = busy;
+  startItems_ = items;
+  return true;
+}
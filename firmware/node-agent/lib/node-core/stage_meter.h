@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+// Busy time and item count of one pipeline stage. The stage's own task adds
+// each stretch of work; any task may read. Totals are 32 bits and wrap (busy
+// microseconds after ~71 min), so they only mean something as differences
+// between two readings, which is how StageWindow uses them.
+class StageMeter {
+ public:
+  void add(uint32_t busyUs, uint32_t items) {
+    busyUs_.store(busyUs_.load(std::memory_order_relaxed) + busyUs, std::memory_order_relaxed);
+    items_.store(items_.load(std::memory_order_relaxed) + items, std::memory_order_relaxed);
+  }
+  // The core the stage last ran on.
+  void setCore(int core) { core_.store(core, std::memory_order_relaxed); }
+
+  uint32_t busyUs() const { return busyUs_.load(std::memory_order_relaxed); }
+  uint32_t items() const { return items_.load(std::memory_order_relaxed); }
+  // -1 until the stage has run.
+  int core() const { return core_.load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<uint32_t> busyUs_{0};
+  std::atomic<uint32_t> items_{0};
+  std::atomic<int> core_{-1};
+};
+
+// Utilization of a stage over consecutive windows. One task calls sample()
+// regularly; once `windowUs` has passed since the window opened, the busy
+// time and items added since then become the figures for that window. Work
+// is charged to the window it finishes in, so a stretch longer than the
+// window reads as 100% busy.
+class StageWindow {
+ public:
+  explicit StageWindow(uint32_t windowUs) : windowUs_(windowUs) {}
+
+  // True when a window closed and the figures below changed.
+  bool sample(const StageMeter &meter, uint32_t nowUs);
+
+  // Busy share of the last closed window in tenths of a percent (0..1000).
+  uint16_t busyPermille() const { return permille_; }
+  // Highest busyPermille() so far.
+  uint16_t peakPermille() const { return peak_; }
+  uint32_t itemsPerSec() const { return itemsPerSec_; }
+  uint32_t windowUs() const { return windowUs_; }
+
+ private:
+  uint32_t windowUs_;
+  bool open_ = false;
+  uint32_t startUs_ = 0;
+  uint32_t startBusy_ = 0;
+  uint32_t startItems_ = 0;
+  uint16_t permille_ = 0;
+  uint16_t peak_ = 0;
+  uint32_t itemsPerSec_ = 0;
+};
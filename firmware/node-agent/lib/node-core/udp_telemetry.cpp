@@ -0,0 +1,129 @@
+#include "udp_telemetry.h"
+
+#include <string.h>
+
+namespace {
+
+void putU16(uint8_t *p, uint16_t v) {
+  p[0] = v & 0xFF;
+  p[1] = v >> 8;
+}
+
+void putU32(uint8_t *p, uint32_t v) {
+  for (int i = 0; i < 4; i++) p[i] = (v >> (8 * i)) & 0xFF;
+}
+
+uint16_t getU16(const uint8_t *p) { return (uint16_t)(p[0] | p[1] << 8); }
+
+uint32_t getU32(const uint8_t *p) {
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+}  // namespace
+
+void UdpTelemetryPacker::begin(uint32_t epoch, const char *nodeId) {
+  epoch_ = epoch;
+  size_t n = strlen(nodeId);
+  nodeLen_ = (uint8_t)(n < kUdpNodeIdMax ? n : kUdpNodeIdMax);
+  memcpy(node_, nodeId, nodeLen_);
+  seq_ = 0;
+  nextObs_ = 0;
+  count_ = 0;
+}
+
+size_t UdpTelemetryPacker::capacity() const {
+  if (cap_ <= headerBytes()) return 0;
+  size_t n = (cap_ - headerBytes()) / kUdpObservationBytes;
+  return n < 255 ? n : 255;
+}
+
+bool UdpTelemetryPacker::add(const uint8_t addr[6], uint8_t addrType, int8_t rssi, uint8_t flags,
+                             uint32_t receivedMs) {
+  if (count_ >= capacity()) return false;
+  if (count_ == 0) oldestMs_ = receivedMs;
+  uint8_t *p = buf_ + headerBytes() + count_ * kUdpObservationBytes;
+  memcpy(p, addr, 6);
+  p[6] = addrType;
+  p[7] = (uint8_t)rssi;
+  p[8] = flags;
+  // The low bits of the reception time until finish() turns them into an age.
+  putU16(p + 9, (uint16_t)receivedMs);
+  count_++;
+  nextObs_++;
+  return true;
+}
+
+size_t UdpTelemetryPacker::finish(uint32_t nowMs) {
+  if (count_ == 0) return 0;
+  const bool saturated = nowMs - oldestMs_ >= 0xFFFF;
+  for (size_t i = 0; i < count_; i++) {
+    uint8_t *age = buf_ + headerBytes() + i * kUdpObservationBytes + 9;
+    putU16(age, saturated ? 0xFFFF : (uint16_t)((uint16_t)nowMs - getU16(age)));
+  }
+  uint8_t *h = buf_;
+  h[0] = 'S';
+  h[1] = 'U';
+  h[2] = kUdpTelemetryVersion;
+  h[3] = count_;
+  putU32(h + 4, epoch_);
+  putU32(h + 8, ++seq_);
+  putU32(h + 12, nextObs_ - count_);
+  putU32(h + 16, nowMs);
+  h[20] = nodeLen_;
+  memcpy(h + kUdpHeaderFixedBytes, node_, nodeLen_);
+  size_t len = headerBytes() + count_ * kUdpObservationBytes;
+  count_ = 0;
+  return len;
+}
+
+bool udpTelemetryParse(const uint8_t *data, size_t len, UdpTelemetryHeader &header,
+                       const uint8_t *&records) {
+  if (len < kUdpHeaderFixedBytes || data[0] != 'S' || data[1] != 'U' ||
+      data[2] != kUdpTelemetryVersion) {
+    return false;
+  }
+  size_t nodeLen = data[20];
+  if (nodeLen > kUdpNodeIdMax) return false;
+  size_t headerLen = kUdpHeaderFixedBytes + nodeLen;
+  if (len != headerLen + data[3] * kUdpObservationBytes) return false;
+  header.count = data[3];
+  header.epoch = getU32(data + 4);
+  header.seq = getU32(data + 8);
+  header.firstObs = getU32(data + 12);
+  header.sentMs = getU32(data + 16);
+  memcpy(header.node, data + kUdpHeaderFixedBytes, nodeLen);
+  header.node[nodeLen] = '\0';
+  records = data + headerLen;
+  return true;
+}
+
+void udpTelemetryObservation(const uint8_t *records, size_t i, UdpObservation &out) {
+  const uint8_t *p = records + i * kUdpObservationBytes;
+  memcpy(out.addr, p, 6);
+  out.addrType = p[6];
+  out.rssi = (int8_t)p[7];
+  out.flags = p[8];
+  out.ageMs = getU16(p + 9);
+}
+
+bool parseUdpCollector(const char *spec, char *host, size_t hostCap, uint16_t &port) {
+  const char *colon = strrchr(spec, ':');
+  size_t hostLen = colon ? (size_t)(colon - spec) : strlen(spec);
+  if (hostLen == 0 || hostLen >= hostCap || strcspn(spec, " /") < hostLen) return false;
+  port = kUdpCollectorDefaultPort;
+  if (colon) {
+    uint32_t v = 0;
+    const char *p = colon + 1;
+    if (*p == '\0') return false;
+    for (; *p; p++) {
+      if (*p < '0' || *p > '9') return false;
+      v = v * 10 + uint32_t(*p - '0');
+      if (v > 65535) return false;
+    }
+    if (v == 0) return false;
+    port = (uint16_t)v;
+  }
+  memcpy(host, spec, hostLen);
+  host[hostLen] = '\0';
+  return true;
+}
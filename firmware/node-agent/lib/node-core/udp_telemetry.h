@@ -0,0 +1,101 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Datagram format of the UDP telemetry channel: BLE observations packed
+// into as few datagrams as the MTU allows, for a live display that wants
+// the latest readings more than every one of them. Nothing is resent.
+//
+// Header, little-endian:
+//   magic     2  'S' 'U'
+//   version   1  kUdpTelemetryVersion
+//   count     1  observations in the datagram
+//   epoch     4  boot epoch, as in events
+//   seq       4  datagram number within the epoch, from 1
+//   first_obs 4  number of the first observation within the epoch, from 0.
+//                Observations the node skipped (no Wi-Fi, no collector)
+//                still take a number, so a jump with no jump in seq is a
+//                loss on the node, not on the network.
+//   sent_ms   4  node millis() when sent
+//   node_len  1  then node_len bytes of node_id
+// Then `count` observations of kUdpObservationBytes:
+//   addr      6  as received, most significant byte first
+//   addr_type 1  BLE address type
+//   rssi      1  signed dBm
+//   flags     1  advertising flags
+//   age_ms    2  time from reception to sent_ms, saturating
+
+const uint8_t kUdpTelemetryVersion = 1;
+const size_t kUdpHeaderFixedBytes = 21;
+const size_t kUdpNodeIdMax = 32;
+const size_t kUdpObservationBytes = 11;
+const uint16_t kUdpCollectorDefaultPort = 8788;
+
+struct UdpObservation {
+  uint8_t addr[6];
+  uint8_t addrType;
+  int8_t rssi;
+  uint8_t flags;
+  uint16_t ageMs;
+};
+
+struct UdpTelemetryHeader {
+  uint8_t count = 0;
+  uint32_t epoch = 0;
+  uint32_t seq = 0;
+  uint32_t firstObs = 0;
+  uint32_t sentMs = 0;
+  char node[kUdpNodeIdMax + 1] = {0};
+};
+
+// Fills datagrams of up to `cap` bytes in the caller's buffer. add() until
+// it returns false or the oldest observation is old enough, then finish()
+// and send what it returns. Numbering restarts with begin().
+class UdpTelemetryPacker {
+ public:
+  UdpTelemetryPacker(uint8_t *buf, size_t cap) : buf_(buf), cap_(cap) {}
+
+  // `nodeId` is cut at kUdpNodeIdMax bytes.
+  void begin(uint32_t epoch, const char *nodeId);
+  // False when the datagram is full; send it and add again.
+  bool add(const uint8_t addr[6], uint8_t addrType, int8_t rssi, uint8_t flags, uint32_t receivedMs);
+  // Counts an observation that will not be sent.
+  void skip() { nextObs_++; }
+  // Drops the pending observations; their numbers stay used.
+  void discard() { count_ = 0; }
+  // Writes the header and the ages; returns the datagram length, 0 when
+  // empty. The next datagram starts empty.
+  size_t finish(uint32_t nowMs);
+
+  size_t pending() const { return count_; }
+  // Reception time of the oldest pending observation.
+  uint32_t oldestMs() const { return oldestMs_; }
+  // Observations that fit in one datagram.
+  size_t capacity() const;
+  uint32_t lastSeq() const { return seq_; }
+  uint32_t observations() const { return nextObs_; }
+
+ private:
+  size_t headerBytes() const { return kUdpHeaderFixedBytes + nodeLen_; }
+
+  uint8_t *buf_;
+  size_t cap_;
+  uint32_t epoch_ = 0;
+  char node_[kUdpNodeIdMax] = {0};
+  uint8_t nodeLen_ = 0;
+  uint32_t seq_ = 0;
+  uint32_t nextObs_ = 0;
+  uint8_t count_ = 0;
+  uint32_t oldestMs_ = 0;
+};
+
+// Reads a datagram's header; false when it is not one. `records` points at
+// the first observation, and the length covers header.count of them.
+bool udpTelemetryParse(const uint8_t *data, size_t len, UdpTelemetryHeader &header,
+                       const uint8_t *&records);
+// Observation i of a parsed datagram.
+void udpTelemetryObservation(const uint8_t *records, size_t i, UdpObservation &out);
+
+// Accepts host[:port], the port defaulting to kUdpCollectorDefaultPort.
+bool parseUdpCollector(const char *spec, char *host, size_t hostCap, uint16_t &port);
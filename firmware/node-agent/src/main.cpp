@@ -1,68 +1,116 @@
 #include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
 #include <WiFi.h>
 #include <HTTPClient.h>
+#include <WiFiClientSecure.h>
 #include <Preferences.h>
 #include <WebServer.h>
 #include <NimBLEDevice.h>
 #include <ESPmDNS.h>
 #include <esp_wifi.h>
+#include <LittleFS.h>
 #include "config.h"
-
-struct EventEntry {
-  String json;
-  bool logged;
-};
-
-class EventQueue {
+#include "batch_controller.h"
+#include "ble_adv.h"
+#include "ble_digest.h"
+#include "ble_fingerprint.h"
+#include "ble_query.h"
+#include "ble_sampler.h"
+#include "cbor_batch.h"
+#include "deflate.h"
+#include "event_queues.h"
+#include "histogram.h"
+#include "http_wire.h"
+#include "ingest_ack.h"
+#include "ingest_failure.h"
+#include "json_writer.h"
+#include "loop_profiler.h"
+#include "lru_table.h"
+#include "mqtt_wire.h"
+#include "node_events.h"
+#include "oui_index.h"
+#include "prom_writer.h"
+#include "record_ring.h"
+#include "spill_log.h"
+#include "spsc_ring.h"
+#include "stage_meter.h"
+#include "udp_telemetry.h"
+
+// Queue records carry JSON events framed in one byte arena; the flag marks
+// records already echoed to Serial while ingest is failing.
+static const uint8_t kEventFlagLogged = 0x01;
+
+#if SPILL_ENABLE
+static const char *kSpillDir = "/spill";
+
+// SpillLog segments as /spill/<id hex>.seg files. Appends open, write and
+// close the file so each flushed buffer is committed; reads keep one handle.
+class LittleFsSpillStorage : public SpillStorage {
  public:
-  explicit EventQueue(size_t capacity) : capacity_(capacity) {
-    buffer_ = new EventEntry[capacity_];
+  size_t list(uint32_t *ids, size_t max) override {
+    File dir = LittleFS.open(kSpillDir);
+    if (!dir || !dir.isDirectory()) return 0;
+    size_t n = 0;
+    for (File f = dir.openNextFile(); f && n < max; f = dir.openNextFile()) {
+      const char *name = f.name();
+      const char *slash = strrchr(name, '/');
+      if (slash) name = slash + 1;
+      char *end = nullptr;
+      unsigned long id = strtoul(name, &end, 16);
+      if (end != name && strcmp(end, ".seg") == 0) ids[n++] = (uint32_t)id;
+    }
+    return n;
   }
 
-  ~EventQueue() { delete[] buffer_; }
+  bool append(uint32_t id, const uint8_t *data, size_t len) override {
+    if (readFile_ && readId_ == id) readFile_.close();
+    char path[24];
+    File f = LittleFS.open(segmentPath(path, id), FILE_APPEND);
+    if (!f) return false;
+    bool ok = f.write(data, len) == len;
+    f.close();
+    return ok;
+  }
 
-  bool push(const String &json) {
-    if (count_ >= capacity_) {
-      return false;
+  size_t read(uint32_t id, size_t offset, uint8_t *out, size_t len) override {
+    if (!readFile_ || readId_ != id) {
+      if (readFile_) readFile_.close();
+      char path[24];
+      readFile_ = LittleFS.open(segmentPath(path, id), FILE_READ);
+      readId_ = id;
+      if (!readFile_) return 0;
     }
-    buffer_[tail_] = {json, false};
-    tail_ = (tail_ + 1) % capacity_;
-    count_++;
-    return true;
+    if (!readFile_.seek(offset)) return 0;
+    return readFile_.read(out, len);
   }
 
-  bool empty() const { return count_ == 0; }
-
-  EventEntry &front() { return buffer_[head_]; }
-
-  EventEntry &at(size_t idx) { return buffer_[(head_ + idx) % capacity_]; }
-
-  void pop() {
-    if (count_ == 0) return;
-    head_ = (head_ + 1) % capacity_;
-    count_--;
+  size_t size(uint32_t id) override {
+    char path[24];
+    File f = LittleFS.open(segmentPath(path, id), FILE_READ);
+    if (!f) return 0;
+    size_t n = f.size();
+    f.close();
+    return n;
   }
 
-  size_t size() const { return count_; }
+  bool remove(uint32_t id) override {
+    if (readFile_ && readId_ == id) readFile_.close();
+    char path[24];
+    return LittleFS.remove(segmentPath(path, id));
+  }
 
  private:
-  EventEntry *buffer_ = nullptr;
-  size_t capacity_ = 0;
-  size_t head_ = 0;
-  size_t tail_ = 0;
-  size_t count_ = 0;
-};
+  static const char *segmentPath(char *out, uint32_t id) {
+    snprintf(out, 24, "%s/%08lx.seg", kSpillDir, (unsigned long)id);
+    return out;
+  }
 
-struct BleObservation {
-  String mac;
-  String name;
-  int rssi = 0;
-  uint8_t mfg_len = 0;
-  uint8_t svc_count = 0;
-  uint8_t adv_flags = 0;
-  unsigned long last_seen_ms = 0;
-  uint32_t seen_count = 0;
+  File readFile_;
+  uint32_t readId_ = 0;
 };
+#endif
 
 struct WifiApSeenCache {
   uint8_t bssid[6] = {0};
@@ -70,21 +118,150 @@ struct WifiApSeenCache {
   bool valid = false;
 };
 
-static String buildEvent(const String &type, const String &dataJson,
-                         const String &extraJson = "");
 static void handleWifiScanDone();
 
 static Preferences prefs;
 static WebServer server(80);
+static char responseBuf[HTTP_RESPONSE_CHUNK_BYTES];
+
+// Node state (queues, tables, counters) is guarded by this lock. loop()
+// holds it for each worker pass; the network stage, HTTP handlers and probe
+// jobs run on their own tasks and take it before touching that state.
+static SemaphoreHandle_t stateMutex = nullptr;
+
+class StateLock {
+ public:
+  StateLock() { xSemaphoreTake(stateMutex, portMAX_DELAY); }
+  ~StateLock() { xSemaphoreGive(stateMutex); }
+  StateLock(const StateLock &) = delete;
+  StateLock &operator=(const StateLock &) = delete;
+};
+
+// Releases a held state lock for a blocking call and takes it back. What the
+// holder touches in between must be its own.
+class StateUnlock {
+ public:
+  StateUnlock() { xSemaphoreGive(stateMutex); }
+  ~StateUnlock() { xSemaphoreTake(stateMutex, portMAX_DELAY); }
+  StateUnlock(const StateUnlock &) = delete;
+  StateUnlock &operator=(const StateUnlock &) = delete;
+};
+
 static bool portalActive = false;
 static bool serverStarted = false;
-static EventQueue queue(EVENT_QUEUE_CAPACITY);
+static_assert(EVENT_QUEUE_BYTES / 100 * EVENT_CLASS_CONTROL_PCT >= EVENT_MAX_BYTES + 8 &&
+                  EVENT_QUEUE_BYTES / 100 * EVENT_CLASS_STATUS_PCT >= EVENT_MAX_BYTES + 8 &&
+                  EVENT_QUEUE_BYTES / 100 * (100 - EVENT_CLASS_CONTROL_PCT - EVENT_CLASS_STATUS_PCT) >=
+                      EVENT_MAX_BYTES + 8,
+              "every event class needs room for an EVENT_MAX_BYTES event");
+alignas(4) static uint8_t eventArena[EVENT_QUEUE_BYTES];
+static EventQueues queue(eventArena, sizeof(eventArena), EVENT_CLASS_CONTROL_PCT, EVENT_CLASS_STATUS_PCT,
+                         EVENT_CLASS_MAX_SKIP);
+#if SPILL_ENABLE
+static LittleFsSpillStorage spillStorage;
+static uint8_t spillWriteBuf[SPILL_WRITE_BUFFER_BYTES];
+static SpillLog spillLog(spillStorage, spillWriteBuf, sizeof(spillWriteBuf), SPILL_SEGMENT_BYTES,
+                         SPILL_MAX_SEGMENTS);
+static bool spillReady = false;
+static unsigned long spillBufferedSinceMs = 0;
+static unsigned long spillRefillMs = 0;
+static uint32_t spillTokens = 0;
+static int spillHeadClass = -1;  // of the oldest spilled event, once peeked
+#endif
 
-static BleObservation bleRing[BLE_OBS_CAPACITY];
-static size_t bleRingCount = 0;
-static size_t bleRingHead = 0;
-static uint32_t bleRingOverwriteCount = 0;
+// Raw adverts handed from the NimBLE host task to loop().
+static SpscRing<BleRawObservation, BLE_RAW_RING_SIZE> bleRawRing;
+// Devices seen recently, most recent first; the least recently seen device is
+// evicted when the table is full.
+static LruHashTable<BleDeviceEntry, BLE_OBS_CAPACITY> bleTable;
 static uint32_t bleDedupeCount = 0;
+static uint32_t bleFpCount = 0;
+static uint32_t bleAddrRotationCount = 0;
+static bool bleDigestMode = BLE_DIGEST_MODE;
+static uint32_t bleDigestWindowMs = BLE_DIGEST_WINDOW_MS;
+static unsigned long bleDigestWindowStart = 0;
+// A digest's device array is built first and then encoded into the event;
+// its buffer leaves room for the rest of the event at its longest.
+static_assert(BLE_DIGEST_EVENT_BYTES >= eventJsonMax(kBleDigestEvent) + 256,
+              "BLE_DIGEST_EVENT_BYTES too small for a ble.digest event");
+static char bleDigestBuf[BLE_DIGEST_EVENT_BYTES];
+static char bleDigestDevicesBuf[BLE_DIGEST_EVENT_BYTES - eventJsonMax(kBleDigestEvent)];
+static uint32_t bleDigestEventCount = 0;
+static uint32_t bleDigestDeviceCount = 0;
+static BleSampler bleSampler({BLE_MAX_PER_SECOND, BLE_GLOBAL_BURST, BLE_DEVICE_INTERVAL_MS,
+                              BLE_DEVICE_BURST, BLE_NEW_DEVICE_RESERVE_PCT, BLE_ACTIVE_WINDOW_MS});
+#if BLE_COALESCE
+// Where each device's latest ble.seen sits in the telemetry queue, keyed
+// like bleTable. An entry is only used while EventQueues says the record is
+// still queued and unsent.
+struct BleQueuedSeen {
+  EventQueues::Ref ref;
+  uint32_t seq;
+  uint32_t count;
+  int8_t rssiMin;
+  int8_t rssiMax;
+};
+static LruHashTable<BleQueuedSeen, BLE_COALESCE_SLOTS> bleQueued;
+static uint32_t bleCoalescedCount = 0;
+#endif
+
+#if LOOP_PROFILE_ENABLE
+enum LoopStage : uint8_t {
+  kStageHttp,
+  kStageWifi,
+  kStageBleDrain,
+  kStageBleDigest,
+  kStageBleScan,
+  kStageMdns,
+  kStageWifiScan,
+  kStageStatus,
+  kStageSpill,
+  kStageHeap,
+  kStageCount
+};
+static const char *const kLoopStageNames[kStageCount] = {
+    "http", "wifi", "ble_drain", "ble_digest", "ble_scan", "mdns",
+    "wifi_scan", "status", "spill", "heap"};
+static LoopProfiler loopProfiler;
+static unsigned long loopProfileResetMs = 0;
+// Each lap charges the cycles since the previous one to `stage`.
+#define LOOP_PROFILE_BEGIN() loopProfiler.beginPass(ESP.getCycleCount())
+#define LOOP_PROFILE_LAP(stage) loopProfiler.lap(stage, ESP.getCycleCount())
+#define LOOP_PROFILE_END() loopProfiler.endPass(ESP.getCycleCount())
+#else
+#define LOOP_PROFILE_BEGIN() do {} while (0)
+#define LOOP_PROFILE_LAP(stage) do {} while (0)
+#define LOOP_PROFILE_END() do {} while (0)
+#endif
+
+// One locked slice of a worker pass. The wait for the state lock is charged
+// to the `http` profiler stage and left out of the worker's busy time.
+class WorkerSlice {
+ public:
+  explicit WorkerSlice(uint32_t &busyUs) : busyUs_(busyUs) {
+    xSemaphoreTake(stateMutex, portMAX_DELAY);
+    LOOP_PROFILE_LAP(kStageHttp);
+    startUs_ = micros();
+  }
+  ~WorkerSlice() {
+    busyUs_ += micros() - startUs_;
+    xSemaphoreGive(stateMutex);
+  }
+  WorkerSlice(const WorkerSlice &) = delete;
+  WorkerSlice &operator=(const WorkerSlice &) = delete;
+
+ private:
+  uint32_t &busyUs_;
+  uint32_t startUs_;
+};
+
+#if OUI_INDEX_ENABLE
+// Built from OUI/oui_combined.txt by tools/oui_index.py and linked in through
+// board_build.embed_files; it stays in flash.
+extern const uint8_t ouiIndexStart[] asm("_binary_src_oui_idx_start");
+extern const uint8_t ouiIndexEnd[] asm("_binary_src_oui_idx_end");
+static OuiIndex ouiIndex;
+#endif
 
 static uint32_t eventDropCount = 0;
 static uint32_t bleSeenCount = 0;
@@ -94,7 +271,28 @@ static unsigned long lastBleResultMs = 0;
 static unsigned long lastBleRestartMs = 0;
 static uint32_t bleMinHeap = 0;
 static unsigned long loopMaxMs = 0;
-static uint32_t eventInvalidCount = 0;
+// Hot-path latency histograms, exported on /metrics/prom. Each is recorded
+// by one stage only, which runs on one task at a time: the net stage (the
+// net task, or loop() without PIPELINE_NET_TASK), the NimBLE host task or
+// the worker. The residence trackers feeding queueResidenceHist are shared
+// by the worker and the net stage, under the state lock.
+static Histogram ingestPostHist;       // ms, per acknowledged ingest POST; net stage
+static Histogram queueResidenceHist;   // ms, enqueue to acknowledged; net stage
+static Histogram bleCallbackHist;      // us, onResult body; NimBLE host task
+static Histogram loopHist;             // us, one loop() pass; worker
+static FifoResidence<QUEUE_RESIDENCE_SAMPLES> queueResidence[kEventClassCount];
+static uint32_t eventOversizeCount = 0;
+
+// Pipeline stages (config.h). Each meter is written by its stage's task:
+// adverts captured, events queued, events acknowledged. The worker samples
+// them into windows for /metrics.
+enum PipeStage : uint8_t { kPipeCapture, kPipeWorker, kPipeNet, kPipeStageCount };
+static const char *const kPipeStageNames[kPipeStageCount] = {"capture", "worker", "net"};
+static StageMeter pipeMeters[kPipeStageCount];
+static StageWindow pipeWindows[kPipeStageCount] = {StageWindow(PIPELINE_STATS_WINDOW_MS * 1000UL),
+                                                   StageWindow(PIPELINE_STATS_WINDOW_MS * 1000UL),
+                                                   StageWindow(PIPELINE_STATS_WINDOW_MS * 1000UL)};
+static uint32_t ingestAckedCount = 0;
 
 static const char *kDefaultNodeId = "node-unknown";
 static const char *kDefaultIngestUrl = "";
@@ -102,12 +300,142 @@ static const char *kDefaultIngestUrl = "";
 static String nodeId;
 static String ingestUrl;
 static uint32_t eventSeq = 0;
+// Boot counter kept in NVS; with eventSeq it names each event across reboots.
+static uint32_t bootEpoch = 0;
 static unsigned long lastHeartbeatMs = 0;
 static unsigned long nextSendAtMs = 0;
 static uint8_t failCount = 0;
-static unsigned long bleSecondStart = 0;
-static uint8_t bleCountThisSecond = 0;
 
+static BatchController ingestBatch(INGEST_BATCH_SIZE,
+                                   INGEST_ADAPTIVE_BATCH ? INGEST_BATCH_MAX : INGEST_BATCH_SIZE,
+                                   INGEST_MAX_BATCH_BYTES, INGEST_TARGET_LATENCY_MS);
+static_assert(EVENT_MAX_BYTES <= INGEST_MAX_BATCH_BYTES, "one event must fit a batch");
+#if INGEST_COMPRESS
+static DeflateEncoder ingestDeflate;
+static uint8_t ingestRawBuf[INGEST_MAX_BATCH_BYTES];
+static uint8_t ingestWireBuf[INGEST_MAX_BATCH_BYTES];
+#endif
+#if INGEST_CBOR
+static uint8_t ingestCborBuf[INGEST_MAX_BATCH_BYTES];
+static CborBatchEncoder ingestCbor(ingestCborBuf, sizeof(ingestCborBuf));
+static bool ingestCborRejected = false;  // the server answered 415
+#endif
+
+struct IngestInFlight {
+  EventClass cls;
+  EventQueues::PickState picked;  // scheduler state before this batch
+  size_t count;
+  size_t rawBytes;   // queued JSON
+  size_t wireBytes;  // body as sent
+  bool cbor;
+  bool gzip;
+  unsigned long sentMs;
+};
+
+static bool ingestUseCbor() {
+#if INGEST_CBOR
+  return !ingestCborRejected;
+#else
+  return false;
+#endif
+}
+
+static WiFiClient ingestPlainClient;
+static WiFiClientSecure ingestTlsClient;
+static WiFiClient *ingestClient = nullptr;
+static String ingestTargetUrl;
+static HttpUrl ingestTarget;
+static bool ingestTargetValid = false;
+static bool ingestConnected = false;
+static unsigned long ingestLastUseMs = 0;
+static char ingestRx[512];
+static size_t ingestRxLen = 0;
+static size_t ingestRxPos = 0;
+static uint32_t ingestConnOpenCount = 0;
+static uint32_t ingestConnReuseCount = 0;
+static uint32_t ingestHandshakeMsTotal = 0;
+static uint32_t ingestHandshakeSavedMs = 0;
+static uint32_t ingestPipelinedCount = 0;
+static uint32_t ingestStaleRetryCount = 0;
+static uint32_t ingestPartialAckCount = 0;
+static uint32_t ingestFailCounts[kIngestFailureCount] = {};
+// Records the server refused, found by bisecting their batch. The newest of
+// quarantineCount is at (quarantineCount - 1) % QUARANTINE_SLOTS.
+struct QuarantineEntry {
+  unsigned long ms;
+  int16_t status;
+  uint8_t cls;
+  uint16_t len;   // as queued
+  uint16_t kept;  // leading bytes in `event`
+  char event[QUARANTINE_EVENT_BYTES];
+};
+static BatchBisector ingestBisect[kEventClassCount];
+static QuarantineEntry quarantine[QUARANTINE_SLOTS];
+static uint32_t quarantineCount = 0;
+static uint32_t quarantineCleared = 0;  // quarantineCount at the last clear
+static uint8_t quarantineRun = 0;  // since the last accepted batch
+// Uplink for queued events: HTTP POSTs to ingestUrl, or QoS 1 PUBLISHes to
+// the broker at mqttUrl. Set from NVS and by /uplink; the network stage
+// closes the old connection and switches at its next round.
+enum class Uplink : uint8_t { kHttp, kMqtt };
+static Uplink uplinkMode = UPLINK_MQTT ? Uplink::kMqtt : Uplink::kHttp;
+static Uplink uplinkActive = Uplink::kHttp;  // what the ingest connection speaks
+static const char *uplinkName(Uplink mode) { return mode == Uplink::kMqtt ? "mqtt" : "http"; }
+static String mqttUrl;
+static String mqttTargetUrl;
+static MqttUrl mqttTarget;
+static bool mqttTargetValid = false;
+static bool mqttSessionUp = false;
+static bool mqttPingPending = false;
+static MqttReader mqttReader;
+static uint16_t mqttPacketId = 0;
+static uint8_t mqttFailCount = 0;  // paces broker reconnects like Wi-Fi ones
+static uint32_t mqttPublishCount = 0;
+static uint32_t mqttPingCount = 0;
+static uint32_t mqttInflightPeak = 0;
+// UDP telemetry: BLE observations packed into datagrams for the collector
+// at udpHost:udpPort, sent by the worker as they fill or age and never
+// queued behind ingest. An empty udpCollector turns it off. Set from NVS and
+// by /udp.
+static_assert(UDP_MTU >= kUdpHeaderFixedBytes + kUdpNodeIdMax + kUdpObservationBytes,
+              "UDP_MTU cannot hold one observation");
+static String udpCollector;
+static char udpHost[64] = {0};
+static uint16_t udpPort = 0;
+static IPAddress udpAddr;
+static bool udpResolved = false;
+static unsigned long udpResolveAtMs = 0;
+static WiFiUDP udpOut;
+static uint8_t udpBuf[UDP_MTU];
+static UdpTelemetryPacker udpPacker(udpBuf, sizeof(udpBuf));
+static uint32_t udpDatagramCount = 0;
+static uint32_t udpSendErrCount = 0;
+static uint32_t udpSkippedCount = 0;
+
+static bool udpTelemetryOn() { return udpHost[0] != '\0'; }
+
+// Points the UDP channel at host[:port], or turns it off when empty.
+// Observations still pending are dropped; numbering carries on, so the
+// collector sees them as skipped.
+static bool setUdpCollector(const String &spec) {
+  char host[sizeof(udpHost)] = {0};
+  uint16_t port = 0;
+  if (spec.length() > 0 && !parseUdpCollector(spec.c_str(), host, sizeof(host), port)) return false;
+  udpSkippedCount += udpPacker.pending();
+  udpPacker.discard();
+  udpCollector = spec;
+  memcpy(udpHost, host, sizeof(udpHost));
+  udpPort = port;
+  // An address needs no lookup; a name waits for resolveUdpCollector().
+  udpResolved = host[0] != '\0' && udpAddr.fromString(host);
+  udpResolveAtMs = 0;
+  return true;
+}
+
+static uint64_t ingestRawBytesTotal = 0;
+static uint64_t ingestWireBytesTotal = 0;
+static uint32_t ingestCompressedCount = 0;
+static uint32_t ingestCborCount = 0;
 static uint32_t ingestOkCount = 0;
 static uint32_t ingestErrCount = 0;
 static unsigned long lastIngestOkMs = 0;
@@ -126,6 +454,15 @@ static unsigned long nextWifiAttemptMs = 0;
 static uint8_t wifiFailCount = 0;
 static String wifiState = "disconnected";
 static int lastDisconnectReason = -1;
+// Wi-Fi events arrive on the Wi-Fi event task, which must not touch node
+// state. handleWifiEvent() only records them here; the worker handles them
+// under the state lock.
+enum class WifiEventKind : uint8_t { kDisconnected, kGotIp, kConnected, kScanDone };
+struct WifiEventRecord {
+  WifiEventKind kind;
+  uint16_t reason;  // kDisconnected only
+};
+static SpscRing<WifiEventRecord, 16> wifiEventRing;
 static String lastAuthMode = "";
 static unsigned long wifiConnectStartMs = 0;
 static bool wifiScanInProgress = false;
@@ -154,68 +491,60 @@ static inline void markIngestErr(const String &err) {
   lastIngestErrMs = millis();
 }
 
-static String jsonBool(bool v) { return v ? "true" : "false"; }
+static void writeIpField(JsonWriter &w, const char *key, const IPAddress &ip) {
+  char buf[16];
+  size_t len = formatIpv4(buf, ip[0], ip[1], ip[2], ip[3]);
+  w.fieldStr(key, buf, len);
+}
 
-static String ipToString(const IPAddress &ip) {
-  return String(ip[0]) + "." + String(ip[1]) + "." + String(ip[2]) + "." +
-         String(ip[3]);
+static void writeMacField(JsonWriter &w, const char *key, const uint8_t *mac, bool upper) {
+  char buf[18];
+  size_t len = formatMac(buf, mac, upper);
+  w.fieldStr(key, buf, len);
 }
 
-static String jsonEscape(const String &input) {
-  String out;
-  out.reserve(input.length() + 8);
-  for (size_t i = 0; i < input.length(); i++) {
-    char c = input[i];
-    if (c == '"') {
-      out += "\\\"";
-    } else if (c == '\\') {
-      out += "\\\\";
-    } else if (c == '\n') {
-      out += "\\n";
-    } else if (c == '\r') {
-      out += "\\r";
-    } else if (c == '\t') {
-      out += "\\t";
-    } else {
-      out += c;
-    }
-  }
-  return out;
+// Station MAC in the same upper-case form WiFi.macAddress() reports.
+static void writeStationMacField(JsonWriter &w, const char *key) {
+  uint8_t mac[6];
+  WiFi.macAddress(mac);
+  writeMacField(w, key, mac, true);
 }
 
-static String jsonKV(const String &key, const String &value, bool quote = true) {
-  if (quote) {
-    return String("\"") + key + "\":\"" + jsonEscape(value) + "\"";
+static void writeDnsField(JsonWriter &w) {
+  char buf[16];
+  w.key("dns");
+  w.beginArray();
+  for (uint8_t i = 0; i < 2; i++) {
+    IPAddress ip = WiFi.dnsIP(i);
+    size_t len = formatIpv4(buf, ip[0], ip[1], ip[2], ip[3]);
+    w.writeString(buf, len);
   }
-  return String("\"") + key + "\":" + value;
+  w.endArray();
+}
+
+static EventText eventText(const String &s) { return EventText{s.c_str(), s.length()}; }
+static EventText eventText(const char *s) { return EventText{s, strlen(s)}; }
+static EventIp eventIp(const IPAddress &ip) { return EventIp{{ip[0], ip[1], ip[2], ip[3]}}; }
+
+static EventMacUpper stationMac() {
+  EventMacUpper mac;
+  WiFi.macAddress(mac.b);
+  return mac;
 }
 
-static String jsonMaybeString(const String &key, const String &value) {
-  if (value.length() == 0) {
-    return String("\"") + key + "\":null";
+// Station IP, or null while disconnected.
+static void setLocalIp(EventOpt<EventIp> &ip) {
+  if (WiFi.isConnected()) {
+    ip.set(eventIp(WiFi.localIP()));
+  } else {
+    ip.setNull();
   }
-  return jsonKV(key, value);
 }
 
-static String bssidToString(const uint8_t *bssid) {
-  char buf[18];
-  snprintf(buf, sizeof(buf), "%02x:%02x:%02x:%02x:%02x:%02x",
-           bssid[0], bssid[1], bssid[2], bssid[3], bssid[4], bssid[5]);
-  return String(buf);
-}
-
-static bool isValidEventJson(const String &json) {
-#if EVENT_VALIDATE_JSON
-  return json.indexOf("\"v\"") >= 0 &&
-         json.indexOf("\"ts_ms\"") >= 0 &&
-         json.indexOf("\"node_id\"") >= 0 &&
-         json.indexOf("\"type\"") >= 0 &&
-         json.indexOf("\"src\"") >= 0 &&
-         json.indexOf("\"data\"") >= 0;
-#else
-  (void)json;
-  return true;
-#endif
+static EventIpList<2> dnsIps() {
+  EventIpList<2> dns;
+  for (uint8_t i = 0; i < 2; i++) dns.ip[i] = eventIp(WiFi.dnsIP(i));
+  return dns;
 }
 
 static const char *authModeToString(wifi_auth_mode_t mode) {
@@ -240,26 +569,96 @@ static void refreshAuthMode() {
   }
 }
 
-static unsigned long computeWifiBackoffMs() {
+// Reconnect delay after `fails` failures in a row: Wi-Fi and the MQTT broker.
+static unsigned long retryBackoffMs(uint8_t fails) {
   uint32_t base = WIFI_RETRY_BASE_MS;
-  for (uint8_t i = 0; i < wifiFailCount; i++) {
+  for (uint8_t i = 0; i < fails; i++) {
     base = min<uint32_t>(base * 2U, WIFI_RETRY_MAX_MS);
   }
   uint32_t jitter = (uint32_t)random(0, 1000);
   return base + jitter;
 }
 
-static bool enqueueEventChecked(const String &json) {
-  if (!isValidEventJson(json)) {
-    eventInvalidCount++;
-    return false;
+static unsigned long computeWifiBackoffMs() { return retryBackoffMs(wifiFailCount); }
+
+// A full class applies its drop policy first. An event the policy keeps but
+// the class cannot fit goes to the spill log, and is lost only when that
+// fails too; evicted and sampled-out events never reach flash.
+static bool enqueueEvent(const char *json, size_t len, EventClass cls) {
+  size_t evicted = 0;
+  EventQueues::Offer result = queue.offer(cls, json, len, evicted);
+  for (size_t i = 0; i < evicted; i++) queueResidence[cls].onDrop();
+  eventDropCount += evicted;
+  if (result == EventQueues::Offer::kQueued) {
+    queueResidence[cls].onPush(millis());
+    return true;
   }
-  if (!queue.push(json)) {
-    eventDropCount++;
-    return false;
+  if (result == EventQueues::Offer::kNoRoom) {
+#if SPILL_ENABLE
+    if (spillReady && spillLog.append(json, len, cls)) {
+      if (spillBufferedSinceMs == 0) spillBufferedSinceMs = millis();
+      return true;
+    }
+#endif
+    queue.drop(cls);
+  }
+  eventDropCount++;
+  return false;
+}
+
+#if SPILL_ENABLE
+static bool spillReplayHasRoom(EventClass cls) {
+  const RecordRing &ring = queue.ring(cls);
+  return ring.bytesUsed() < ring.capacityBytes() * SPILL_REPLAY_QUEUE_PCT / 100;
+}
+
+static void startSpill() {
+  if (!LittleFS.begin(true)) return;
+  if (!LittleFS.exists(kSpillDir)) LittleFS.mkdir(kSpillDir);
+  spillLog.begin();
+  spillReady = true;
+}
+
+// Flushes buffered spill records and moves spilled events back into the RAM
+// queue once ingest is healthy. Replay is paced by a token bucket and only
+// fills each class to SPILL_REPLAY_QUEUE_PCT, leaving room for live events.
+// Events spilled before the queue had classes come back as telemetry.
+// Healthy means the last send on the active uplink succeeded.
+static void serviceSpill() {
+  if (!spillReady) return;
+  unsigned long now = millis();
+  if (spillLog.buffered() > 0 && now - spillBufferedSinceMs >= SPILL_FLUSH_MS) {
+    spillLog.flush();
+  }
+  if (spillLog.buffered() == 0) spillBufferedSinceMs = 0;
+
+  uint8_t uplinkFails = uplinkActive == Uplink::kMqtt ? mqttFailCount : failCount;
+  if (spillLog.empty() || uplinkFails != 0 || lastIngestOkMs == 0 || !WiFi.isConnected()) {
+    spillRefillMs = now;
+    return;
+  }
+  uint32_t add = (uint32_t)((now - spillRefillMs) * SPILL_REPLAY_PER_SEC / 1000);
+  if (add > 0) {
+    spillTokens = min<uint32_t>(spillTokens + add, SPILL_REPLAY_PER_SEC);
+    spillRefillMs = now;
+  }
+  char buf[EVENT_MAX_BYTES];
+  while (spillTokens > 0) {
+    // Skip the flash read while the class it would go to is still full.
+    if (spillHeadClass >= 0 && !spillReplayHasRoom((EventClass)spillHeadClass)) break;
+    size_t len = 0;
+    uint8_t kind = 0;
+    if (!spillLog.peek(buf, sizeof(buf), len, kind)) break;
+    EventClass cls = kind < kEventClassCount ? (EventClass)kind : kEventTelemetry;
+    spillHeadClass = cls;
+    if (!spillReplayHasRoom(cls) || !queue.tryPush(cls, buf, len)) break;
+    queueResidence[cls].onPush(now);
+    spillLog.pop();
+    spillHeadClass = -1;
+    spillTokens--;
   }
-  return true;
 }
+#endif
 
 static bool bssidEquals(const uint8_t *a, const uint8_t *b) {
   for (int i = 0; i < 6; i++) {
@@ -300,146 +699,209 @@ static bool shouldEmitAp(const uint8_t *bssid, unsigned long now) {
   return true;
 }
 
-static void emitWifiApSeen(const wifi_ap_record_t &ap) {
-  unsigned long now = millis();
-  if (!shouldEmitAp(ap.bssid, now)) return;
+// Events are filled into their node_events.h struct and encoded against its
+// descriptor, which always writes the full envelope. The descriptor bounds
+// the encoded size, so a fixed-shape event is checked against
+// EVENT_MAX_BYTES at compile time rather than scanned at runtime.
+static bool commitEvent(const EventDesc &desc, const void *value, char *buf, size_t cap) {
+  EventEnvelope env = {EVENT_SCHEMA_VERSION, (uint32_t)(esp_timer_get_time() / 1000ULL),
+                       eventText(nodeId), ++eventSeq, bootEpoch};
+  JsonWriter w(buf, cap);
+  if (!eventEncodeJson(w, desc, env, value)) {
+    eventOversizeCount++;
+    return false;
+  }
+  return enqueueEvent(w.c_str(), w.size(), desc.cls);
+}
 
-  String data = "{";
-  data += jsonKV("ssid", String(reinterpret_cast<const char *>(ap.ssid)));
-  data += "," + jsonKV("bssid", bssidToString(ap.bssid));
-  data += "," + jsonKV("channel", String(ap.primary), false);
-  data += "," + jsonKV("rssi", String(ap.rssi), false);
-  data += "," + jsonKV("auth", authModeToString(ap.authmode));
-  data += "}";
-  if (enqueueEventChecked(buildEvent("wifi.ap_seen", data))) {
-    wifiApSeenCount++;
+template <typename T>
+static bool commitEvent(const T &ev) {
+  static_assert(eventJsonMax(eventDescOf(static_cast<const T *>(nullptr))) < EVENT_MAX_BYTES,
+                "event can outgrow EVENT_MAX_BYTES");
+  char buf[EVENT_MAX_BYTES];
+  return commitEvent(eventDescOf(static_cast<const T *>(nullptr)), &ev, buf, sizeof(buf));
+}
+
+// Vendor id for a registered (globally administered) MAC, or OuiIndex::kNone.
+static uint16_t ouiVendorId(const uint8_t mac[6]) {
+#if OUI_INDEX_ENABLE
+  return ouiIndex.lookupMac(mac);
+#else
+  (void)mac;
+  return OuiIndex::kNone;
+#endif
+}
+
+// Only public BLE addresses carry an OUI; random ones are not looked up.
+static uint16_t bleVendorId(const uint8_t addr[6], uint8_t addrType) {
+  return addrType == 0 ? ouiVendorId(addr) : OuiIndex::kNone;
+}
+
+// Vendor name, when the index was built with names (OUI_INDEX_NAMES=1).
+static size_t ouiVendorName(uint16_t vendorId, char *out, size_t cap) {
+#if OUI_INDEX_ENABLE
+  return ouiIndex.vendorName(vendorId, out, cap);
+#else
+  (void)vendorId;
+  if (cap > 0) out[0] = '\0';
+  return 0;
+#endif
+}
+
+static void writeVendorField(JsonWriter &w, uint16_t vendorId) {
+  if (vendorId != OuiIndex::kNone) {
+    w.fieldUInt("vendor_id", vendorId);
   } else {
-    wifiApDropCount++;
+    w.fieldNull("vendor_id");
   }
 }
 
-static String buildEvent(const String &type, const String &dataJson,
-                         const String &extraJson) {
-  unsigned long ts = (unsigned long)(esp_timer_get_time() / 1000ULL);
-  String json = "{";
-  json += jsonKV("v", String(EVENT_SCHEMA_VERSION), false);
-  json += "," + jsonKV("ts_ms", String(ts), false);
-  json += "," + jsonKV("node_id", nodeId);
-  json += "," + jsonKV("type", type);
-  json += "," + jsonKV("src", nodeId);
-  json += "," + jsonKV("seq", String(++eventSeq), false);
-  if (extraJson.length() > 0) {
-    json += "," + extraJson;
+static void setVendorId(EventOpt<uint32_t> &field, uint16_t vendorId) {
+  if (vendorId != OuiIndex::kNone) {
+    field.set(vendorId);
+  } else {
+    field.setNull();
   }
-  json += ",\"data\":" + dataJson;
-  json += "}";
-  return json;
 }
 
-static void enqueueEvent(const String &json) {
-  (void)enqueueEventChecked(json);
+static void emitWifiApSeen(const wifi_ap_record_t &ap) {
+  unsigned long now = millis();
+  if (!shouldEmitAp(ap.bssid, now)) return;
+
+  WifiApSeenEvent ev;
+  ev.ssid = eventText(reinterpret_cast<const char *>(ap.ssid));
+  memcpy(ev.bssid.b, ap.bssid, 6);
+  setVendorId(ev.vendor_id, ouiVendorId(ap.bssid));
+  ev.channel = ap.primary;
+  ev.rssi = ap.rssi;
+  ev.auth = eventText(authModeToString(ap.authmode));
+  if (commitEvent(ev)) {
+    wifiApSeenCount++;
+  } else {
+    wifiApDropCount++;
+  }
 }
 
 static void emitBootEvent() {
-  String ip = WiFi.isConnected() ? WiFi.localIP().toString() : "";
-  String data = "{";
-  data += jsonKV("fw_version", FW_VERSION);
-  data += "," + jsonKV("chip_model", ESP.getChipModel());
-  data += "," + jsonKV("chip_rev", String(ESP.getChipRevision()));
-  data += "," + jsonKV("mac", WiFi.macAddress());
-  data += "," + jsonKV("hostname", hostname);
-  data += "," + jsonKV("heap_free", String(ESP.getFreeHeap()), false);
-  data += "," + jsonKV("sdk_version", ESP.getSdkVersion());
-  data += "," + jsonKV("ingest_url", ingestUrl);
-  data += "," + jsonMaybeString("ip", ip);
-  data += "}";
-  enqueueEvent(buildEvent("node.boot", data));
+  BootEvent ev;
+  ev.fw_version = eventText(FW_VERSION);
+  ev.chip_model = eventText(ESP.getChipModel());
+  char rev[4];
+  snprintf(rev, sizeof(rev), "%u", (unsigned)ESP.getChipRevision());
+  ev.chip_rev = eventText(rev);
+  ev.mac = stationMac();
+  ev.hostname = eventText(hostname);
+  ev.heap_free = ESP.getFreeHeap();
+  ev.sdk_version = eventText(ESP.getSdkVersion());
+  ev.ingest_url = eventText(ingestUrl);
+  setLocalIp(ev.ip);
+#if OUI_INDEX_ENABLE
+  char id[9];
+  if (ouiIndex.valid()) {
+    // Vendor ids in events are positions in this index's vendor table.
+    snprintf(id, sizeof(id), "%08x", (unsigned)ouiIndex.indexId());
+    ev.oui_index_id.set(eventText(id));
+  } else {
+    ev.oui_index_id.setNull();
+  }
+#endif
+  commitEvent(ev);
 }
 
 static void emitHeartbeat() {
-  String ip = WiFi.isConnected() ? WiFi.localIP().toString() : "";
-  String data = "{";
-  data += jsonKV("uptime_ms", String(millis()), false);
-  data += "," + jsonKV("mac", WiFi.macAddress());
-  data += "," + jsonKV("hostname", hostname);
-  data += "," + jsonKV("wifi_rssi", String(WiFi.RSSI()), false);
-  data += "," + jsonMaybeString("ip", ip);
-  data += "," + jsonKV("heap_free", String(ESP.getFreeHeap()), false);
-  data += "," + jsonKV("queue_depth", String(queue.size()), false);
-  data += "," + jsonKV("ble_seen_total", String(bleSeenCount), false);
-  data += "}";
-  enqueueEvent(buildEvent("node.heartbeat", data));
+  HeartbeatEvent ev;
+  ev.uptime_ms = millis();
+  ev.mac = stationMac();
+  ev.hostname = eventText(hostname);
+  ev.wifi_rssi = WiFi.RSSI();
+  setLocalIp(ev.ip);
+  ev.heap_free = ESP.getFreeHeap();
+  ev.queue_depth = queue.count();
+  ev.ble_seen_total = bleSeenCount;
+  commitEvent(ev);
 }
 
 static void emitWifiStatus() {
-  String dns0 = ipToString(WiFi.dnsIP(0));
-  String dns1 = ipToString(WiFi.dnsIP(1));
-  String ip = WiFi.isConnected() ? WiFi.localIP().toString() : "";
-  String bssid = WiFi.isConnected() ? WiFi.BSSIDstr() : "";
-  int channel = WiFi.channel();
-  String data = "{";
-  data += jsonKV("connected", jsonBool(WiFi.isConnected()), false);
-  data += "," + jsonKV("state", wifiState);
-  data += "," + jsonKV("ssid", WiFi.SSID());
-  data += "," + jsonMaybeString("bssid", bssid);
-  data += "," + jsonKV("channel", String(channel), false);
-  data += "," + jsonMaybeString("ip", ip);
-  data += "," + jsonKV("mac", WiFi.macAddress());
-  data += "," + jsonKV("hostname", hostname);
-  data += "," + jsonKV("rssi", String(WiFi.RSSI()), false);
-  data += "," + jsonKV("gw", ipToString(WiFi.gatewayIP()));
-  data += "," + jsonKV("mask", ipToString(WiFi.subnetMask()));
-  data += ",\"dns\":[\"" + dns0 + "\",\"" + dns1 + "\"]";
+  bool connected = WiFi.isConnected();
+  WifiStatusEvent ev;
+  ev.connected = connected;
+  ev.state = eventText(wifiState);
+  ev.ssid = eventText(runtimeSsid);
+  const uint8_t *bssid = connected ? WiFi.BSSID() : nullptr;
+  if (bssid) {
+    EventMacUpper mac;
+    memcpy(mac.b, bssid, 6);
+    ev.bssid.set(mac);
+  } else {
+    ev.bssid.setNull();
+  }
+  ev.channel = WiFi.channel();
+  setLocalIp(ev.ip);
+  ev.mac = stationMac();
+  ev.hostname = eventText(hostname);
+  ev.rssi = WiFi.RSSI();
+  ev.gw = eventIp(WiFi.gatewayIP());
+  ev.mask = eventIp(WiFi.subnetMask());
+  ev.dns = dnsIps();
   if (lastAuthMode.length() > 0) {
-    data += "," + jsonKV("auth", lastAuthMode);
+    ev.auth.set(eventText(lastAuthMode));
   }
   if (lastDisconnectReason >= 0) {
-    data += "," + jsonKV("reason", String(lastDisconnectReason), false);
+    ev.reason.set(lastDisconnectReason);
   }
-  data += "}";
-  enqueueEvent(buildEvent("wifi.status", data));
+  commitEvent(ev);
+}
+
+static void writeRatioField(JsonWriter &w, const char *key, uint64_t raw, uint64_t wire) {
+  if (wire == 0) w.fieldNull(key);
+  else w.fieldFixed(key, (int64_t)(raw * 100 / wire), 2);
 }
 
-static void emitIngestOk(uint32_t count, unsigned long ms) {
-  String data = "{";
-  data += jsonKV("ok", "true", false);
-  data += "," + jsonKV("batch_count", String(count), false);
-  data += "," + jsonKV("ms", String(ms), false);
-  data += "}";
-  enqueueEvent(buildEvent("ingest.ok", data));
+static void emitIngestOk(const IngestInFlight &f, unsigned long ms) {
+  IngestOkEvent ev;
+  ev.ok = true;
+  ev.batch_count = f.count;
+  ev.ms = ms;
+  ev.raw_bytes = f.rawBytes;
+  ev.wire_bytes = f.wireBytes;
+  if (f.wireBytes == 0) {
+    ev.ratio.setNull();
+  } else {
+    ev.ratio.set(EventFixed2{(int32_t)((uint64_t)f.rawBytes * 100 / f.wireBytes)});
+  }
+  ev.encoding = eventText(f.gzip ? "gzip" : "identity");
+  ev.format = eventText(f.cbor ? "cbor" : "json");
+  ev.batch_limit = ingestBatch.limit();
+  commitEvent(ev);
   lastIngestOkEventMs = millis();
 }
 
 static void emitIngestErr(const String &err, unsigned long ms) {
-  String data = "{";
-  data += jsonKV("ok", "false", false);
-  data += "," + jsonKV("err", err);
-  data += "," + jsonKV("ms", String(ms), false);
-  data += "}";
-  enqueueEvent(buildEvent("ingest.err", data, jsonKV("err", err)));
+  IngestErrEvent ev;
+  ev.ok = false;
+  ev.err = eventText(err);
+  ev.ms = ms;
+  commitEvent(ev);
   lastIngestErrEventMs = millis();
 }
 
 static void emitAnnounce() {
   if (!WiFi.isConnected()) return;
-  String dns0 = ipToString(WiFi.dnsIP(0));
-  String dns1 = ipToString(WiFi.dnsIP(1));
-  String data = "{";
-  data += jsonKV("node_id", nodeId);
-  data += jsonKV("ip", WiFi.localIP().toString());
-  data += "," + jsonKV("mac", WiFi.macAddress());
-  data += "," + jsonKV("rssi", String(WiFi.RSSI()), false);
-  data += "," + jsonKV("hostname", hostname);
-  data += "," + jsonKV("ssid", WiFi.SSID());
-  data += "," + jsonKV("gw", ipToString(WiFi.gatewayIP()));
-  data += "," + jsonKV("mask", ipToString(WiFi.subnetMask()));
-  data += ",\"dns\":[\"" + dns0 + "\",\"" + dns1 + "\"]";
-  data += "," + jsonKV("uptime_ms", String(millis()), false);
-  data += "," + jsonKV("fw_version", FW_VERSION);
-  data += "," + jsonKV("chip", ESP.getChipModel());
-  data += "," + jsonKV("http_port", "80", false);
-  data += "}";
-  enqueueEvent(buildEvent("node.announce", data));
+  AnnounceEvent ev;
+  ev.node_id = eventText(nodeId);
+  ev.ip = eventIp(WiFi.localIP());
+  ev.mac = stationMac();
+  ev.rssi = WiFi.RSSI();
+  ev.hostname = eventText(hostname);
+  ev.ssid = eventText(runtimeSsid);
+  ev.gw = eventIp(WiFi.gatewayIP());
+  ev.mask = eventIp(WiFi.subnetMask());
+  ev.dns = dnsIps();
+  ev.uptime_ms = millis();
+  ev.fw_version = eventText(FW_VERSION);
+  ev.chip = eventText(ESP.getChipModel());
+  ev.http_port = 80;
+  commitEvent(ev);
   lastAnnounceMs = millis();
 }
 
@@ -483,211 +945,881 @@ static void handlePortalSave() {
   ESP.restart();
 }
 
-static String maskSecret(const String &value) {
-  if (value.length() == 0) return "";
-  return "***";
+// Status handlers run on the HTTP task with the state lock held and render
+// into the shared response buffer (one request is served at a time).
+// responseWriter() responses must fit the buffer; route() sends them once
+// the lock is released, so a slow client holds up the HTTP task only.
+// streamWriter() responses switch to chunked transfer encoding on the first
+// flush and send each flush with the lock released, so memory use does not
+// grow with the response. Handlers using it must not hold pointers into
+// node state across a write: another task may run at any flush.
+static const char *kJsonType = "application/json";
+static const char *kPromType = "text/plain; version=0.0.4";
+
+struct PendingResponse {
+  int code;  // 0: the handler sent its own response
+  const char *type;
+  size_t len;
+};
+static PendingResponse pendingResponse;
+static bool responseStreaming = false;
+
+static void respond(int code, const char *type, const char *body, size_t len) {
+  if (len > sizeof(responseBuf)) len = sizeof(responseBuf);
+  if (body != responseBuf) memmove(responseBuf, body, len);
+  pendingResponse = PendingResponse{code, type, len};
+}
+
+static void respond(int code, const char *body) { respond(code, kJsonType, body, strlen(body)); }
+
+// Writer sink; ctx is the content type.
+static bool streamResponseChunk(void *ctx, const char *data, size_t len) {
+  StateUnlock unlocked;
+  if (!responseStreaming) {
+    responseStreaming = true;
+    server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server.send(200, static_cast<const char *>(ctx), "");
+  }
+  server.sendContent(data, len);
+  return server.client().connected();
+}
+
+static JsonWriter responseWriter() { return JsonWriter(responseBuf, sizeof(responseBuf)); }
+
+static JsonWriter streamWriter() {
+  JsonWriter w(responseBuf, sizeof(responseBuf));
+  w.setSink(streamResponseChunk, const_cast<char *>(kJsonType));
+  return w;
+}
+
+// Ends a response rendered through responseBuf.
+template <typename Writer>
+static void sendWriter(Writer &w, int code, const char *type) {
+  if (responseStreaming) {
+    // Headers are gone; on failure the client just sees a short body.
+    if (w.flush()) {
+      StateUnlock unlocked;
+      server.sendContent("");
+    }
+    return;
+  }
+  if (w.overflowed()) {
+    respond(500, "{\"ok\":false,\"err\":\"response_overflow\"}");
+    return;
+  }
+  respond(code, type, w.c_str(), w.size());
+}
+
+static void sendJson(JsonWriter &w, int code = 200) { sendWriter(w, code, kJsonType); }
+
+static void route(const char *uri, HTTPMethod method, void (*handler)()) {
+  server.on(uri, method, [handler]() {
+    pendingResponse.code = 0;
+    responseStreaming = false;
+    {
+      StateLock lock;
+      handler();
+    }
+    if (pendingResponse.code != 0) {
+      server.send_P(pendingResponse.code, pendingResponse.type, responseBuf, pendingResponse.len);
+    }
+  });
+}
+
+static void writeTsMsField(JsonWriter &w) {
+  w.fieldUInt("ts_ms", (unsigned long)(esp_timer_get_time() / 1000ULL));
 }
 
 static void handleHealth() {
-  String out = "{";
+  JsonWriter w = responseWriter();
   bool ok = WiFi.isConnected() && serverStarted;
-  out += "\"ok\":" + jsonBool(ok);
-  out += ",\"node_id\":\"" + nodeId + "\"";
-  out += ",\"uptime_ms\":" + String(millis());
-  out += ",\"heap_free\":" + String(ESP.getFreeHeap());
-
-  out += ",\"wifi\":{";
-  out += "\"connected\":" + jsonBool(WiFi.isConnected());
-  out += ",\"state\":\"" + wifiState + "\"";
-  out += ",\"ip\":\"" + ipToString(WiFi.localIP()) + "\"";
-  out += ",\"rssi\":" + String(WiFi.RSSI());
-  out += ",\"ssid\":\"" + String(WiFi.SSID()) + "\"";
+  w.beginObject();
+  w.fieldBool("ok", ok);
+  w.fieldText("node_id", nodeId);
+  w.fieldUInt("uptime_ms", millis());
+  w.fieldUInt("heap_free", ESP.getFreeHeap());
+
+  w.key("wifi");
+  w.beginObject();
+  w.fieldBool("connected", WiFi.isConnected());
+  w.fieldText("state", wifiState);
+  writeIpField(w, "ip", WiFi.localIP());
+  w.fieldInt("rssi", WiFi.RSSI());
+  w.fieldText("ssid", runtimeSsid);
   if (lastDisconnectReason >= 0) {
-    out += ",\"reason\":" + String(lastDisconnectReason);
+    w.fieldInt("reason", lastDisconnectReason);
   }
   if (lastAuthMode.length() > 0) {
-    out += ",\"auth\":\"" + lastAuthMode + "\"";
-  }
-  out += "}";
-
-  out += ",\"ingest\":{";
-  out += "\"url\":\"" + ingestUrl + "\"";
-  out += ",\"ok_count\":" + String(ingestOkCount);
-  out += ",\"err_count\":" + String(ingestErrCount);
-  out += ",\"last_ok\":"
-         + jsonBool(lastIngestOkMs > 0 && lastIngestOkMs >= lastIngestErrMs);
-  out += ",\"last_ok_ms\":" + String(lastIngestOkMs);
-  out += ",\"last_err_ms\":" + String(lastIngestErrMs);
-  out += ",\"last_err\":\"" + jsonEscape(lastIngestErr) + "\"";
-  out += "}";
-
-  out += ",\"ble\":{";
-  out += "\"enabled\":true";
-  out += ",\"seen_count\":" + String(bleSeenCount);
-  out += ",\"drop_count\":" + String(bleRingOverwriteCount);
-  out += ",\"dedupe_count\":" + String(bleDedupeCount);
-  out += "}";
-
-  out += ",\"build\":{";
-  out += "\"fw_version\":\"" + String(FW_VERSION) + "\"";
-  out += ",\"chip\":\"" + String(ESP.getChipModel()) + "\"";
-  out += ",\"rev\":\"" + String(ESP.getChipRevision()) + "\"";
-  out += ",\"sdk\":\"" + String(ESP.getSdkVersion()) + "\"";
-  out += "}";
-
-  out += ",\"time\":{";
-  out += "\"ts_ms\":" + String((unsigned long)(esp_timer_get_time() / 1000ULL));
-  out += "}";
-
-  out += "}";
-  server.send(200, "application/json", out);
+    w.fieldText("auth", lastAuthMode);
+  }
+  w.endObject();
+
+  w.key("ingest");
+  w.beginObject();
+  w.fieldText("url", ingestUrl);
+  w.fieldUInt("ok_count", ingestOkCount);
+  w.fieldUInt("err_count", ingestErrCount);
+  w.fieldBool("last_ok", lastIngestOkMs > 0 && lastIngestOkMs >= lastIngestErrMs);
+  w.fieldUInt("last_ok_ms", lastIngestOkMs);
+  w.fieldUInt("last_err_ms", lastIngestErrMs);
+  w.fieldText("last_err", lastIngestErr);
+  w.endObject();
+
+  w.key("ble");
+  w.beginObject();
+  w.fieldBool("enabled", true);
+  w.fieldUInt("seen_count", bleSeenCount);
+  w.fieldUInt("drop_count", bleTable.evictions());
+  w.fieldUInt("dedupe_count", bleDedupeCount);
+  w.endObject();
+
+  w.key("build");
+  w.beginObject();
+  w.fieldStr("fw_version", FW_VERSION);
+  w.fieldStr("chip", ESP.getChipModel());
+  char rev[4];
+  snprintf(rev, sizeof(rev), "%u", (unsigned)ESP.getChipRevision());
+  w.fieldStr("rev", rev);
+  w.fieldStr("sdk", ESP.getSdkVersion());
+  w.endObject();
+
+  w.key("time");
+  w.beginObject();
+  writeTsMsField(w);
+  w.endObject();
+
+  w.endObject();
+  sendJson(w);
+}
+
+// Per-stage core, utilization and output queue. busy_pct covers the last
+// PIPELINE_STATS_WINDOW_MS window, peak_pct the busiest window so far.
+static void writePipeline(JsonWriter &w) {
+  w.key("pipeline");
+  w.beginObject();
+  w.fieldStr("mode", PIPELINE_NET_TASK ? "tasks" : "cooperative");
+  w.fieldUInt("window_ms", PIPELINE_STATS_WINDOW_MS);
+  for (size_t i = 0; i < kPipeStageCount; i++) {
+    const StageMeter &m = pipeMeters[i];
+    const StageWindow &win = pipeWindows[i];
+    w.key(kPipeStageNames[i]);
+    w.beginObject();
+    if (m.core() < 0) w.fieldNull("core");
+    else w.fieldInt("core", m.core());
+    w.fieldFixed("busy_pct", win.busyPermille(), 1);
+    w.fieldFixed("peak_pct", win.peakPermille(), 1);
+    w.fieldUInt("items_per_s", win.itemsPerSec());
+    if (i == kPipeCapture) {
+      w.fieldUInt("out_depth", bleRawRing.size());
+      w.fieldUInt("out_capacity", bleRawRing.capacity());
+      w.fieldUInt("out_drops", bleRawRing.dropCount());
+    } else if (i == kPipeWorker) {
+      w.fieldUInt("out_depth", queue.count());
+      w.fieldUInt("out_bytes", queue.bytesUsed());
+      w.fieldUInt("out_capacity_bytes", queue.capacityBytes());
+      w.fieldUInt("out_drops", eventDropCount);
+    }
+    w.endObject();
+  }
+  w.endObject();
 }
 
 static void handleMetrics() {
-  String out = "{";
-  out += "\"queue_depth\":" + String(queue.size());
-  out += ",\"drops\":" + String(eventDropCount);
-  out += ",\"ble_seen\":" + String(bleSeenCount);
-  out += ",\"ingest_ok\":" + String(ingestOkCount);
-  out += ",\"ingest_err\":" + String(ingestErrCount);
-  out += ",\"event_queue_depth\":" + String(queue.size());
-  out += ",\"event_drop_count\":" + String(eventDropCount);
-  out += ",\"event_invalid_count\":" + String(eventInvalidCount);
-  out += ",\"ingest_ok_count\":" + String(ingestOkCount);
-  out += ",\"ingest_err_count\":" + String(ingestErrCount);
-  out += ",\"last_ingest_ok_ms\":" + String(lastIngestOkMs);
-  out += ",\"last_ingest_err_ms\":" + String(lastIngestErrMs);
-  out += ",\"ble_seen_count\":" + String(bleSeenCount);
-  out += ",\"ble_dedupe_count\":" + String(bleDedupeCount);
-  out += ",\"ble_ring_overwrite\":" + String(bleRingOverwriteCount);
-  out += ",\"ble_scan_restarts\":" + String(bleScanRestartCount);
-  out += ",\"ble_scan_stalls\":" + String(bleScanStallCount);
-  out += ",\"loop_max_ms\":" + String(loopMaxMs);
-  out += ",\"ble_min_heap\":" + String(bleMinHeap);
-  out += ",\"wifi_ap_seen_count\":" + String(wifiApSeenCount);
-  out += ",\"wifi_ap_dedupe_count\":" + String(wifiApDedupeCount);
-  out += ",\"wifi_ap_drop_count\":" + String(wifiApDropCount);
-  out += ",\"wifi_ap_scan_count\":" + String(wifiApScanCount);
-  out += "}";
-  server.send(200, "application/json", out);
+  JsonWriter w = streamWriter();
+  w.beginObject();
+  w.fieldUInt("queue_depth", queue.count());
+  w.fieldUInt("drops", eventDropCount);
+  w.fieldUInt("ble_seen", bleSeenCount);
+  w.fieldUInt("ingest_ok", ingestOkCount);
+  w.fieldUInt("ingest_err", ingestErrCount);
+  w.fieldUInt("event_queue_depth", queue.count());
+  w.fieldUInt("event_queue_bytes", queue.bytesUsed());
+  w.fieldUInt("event_queue_bytes_hwm", queue.bytesHighWater());
+  w.fieldUInt("event_queue_capacity_bytes", queue.capacityBytes());
+  w.fieldUInt("event_drop_count", eventDropCount);
+  w.fieldUInt("event_oversize_count", eventOversizeCount);
+  w.key("event_classes");
+  w.beginObject();
+  for (size_t c = kEventClassCount; c-- > 0;) {
+    EventClass cls = (EventClass)c;
+    const RecordRing &ring = queue.ring(cls);
+    const EventQueues::Stats &st = queue.stats(cls);
+    w.key(eventClassName(cls));
+    w.beginObject();
+    w.fieldUInt("depth", ring.count());
+    w.fieldUInt("bytes", ring.bytesUsed());
+    w.fieldUInt("bytes_hwm", ring.bytesHighWater());
+    w.fieldUInt("capacity_bytes", ring.capacityBytes());
+    w.fieldUInt("queued", st.queued);
+    w.fieldUInt("dropped", st.dropped);
+    w.fieldUInt("evicted", st.evicted);
+    w.fieldStr("policy", dropPolicyName(queue.policy(cls)));
+    if (queue.policy(cls) == DropPolicy::kSample) w.fieldUInt("sample_n", queue.sampleN(cls));
+    w.endObject();
+  }
+  w.endObject();
+#if SPILL_ENABLE
+  const SpillLog::Stats &spill = spillLog.stats();
+  w.fieldBool("spill_ready", spillReady);
+  w.fieldUInt("spill_pending_bytes", spillLog.pendingBytes());
+  w.fieldUInt("spill_segments", spillReady ? spillLog.segmentCount() : 0);
+  w.fieldUInt("spill_appended", spill.appended);
+  w.fieldUInt("spill_replayed", spill.replayed);
+  w.fieldUInt("spill_written_bytes", spill.writtenBytes);
+  w.fieldUInt("spill_dropped_segments", spill.droppedSegments);
+  w.fieldUInt("spill_dropped_bytes", spill.droppedBytes);
+  w.fieldUInt("spill_crc_errors", spill.crcErrors);
+  w.fieldUInt("spill_oversized", spill.oversized);
+  w.fieldUInt("spill_write_errors", spill.writeErrors);
+#endif
+  w.fieldUInt("ingest_ok_count", ingestOkCount);
+  w.fieldUInt("ingest_err_count", ingestErrCount);
+  w.fieldUInt("last_ingest_ok_ms", lastIngestOkMs);
+  w.fieldUInt("last_ingest_err_ms", lastIngestErrMs);
+  w.fieldUInt("ingest_batch_limit", ingestBatch.limit());
+  w.fieldUInt("ingest_latency_avg_ms", ingestBatch.avgLatencyMs());
+  w.fieldUInt("ingest_raw_bytes", ingestRawBytesTotal);
+  w.fieldUInt("ingest_wire_bytes", ingestWireBytesTotal);
+  writeRatioField(w, "ingest_compression_ratio", ingestRawBytesTotal, ingestWireBytesTotal);
+  w.fieldUInt("ingest_compressed_count", ingestCompressedCount);
+  w.fieldUInt("ingest_cbor_count", ingestCborCount);
+  w.fieldUInt("ingest_conn_opens", ingestConnOpenCount);
+  w.fieldUInt("ingest_conn_reuses", ingestConnReuseCount);
+  w.fieldUInt("ingest_handshake_ms_total", ingestHandshakeMsTotal);
+  w.fieldUInt("ingest_handshake_ms_saved", ingestHandshakeSavedMs);
+  w.fieldUInt("ingest_pipelined_requests", ingestPipelinedCount);
+  w.fieldUInt("ingest_stale_conn_retries", ingestStaleRetryCount);
+  w.fieldUInt("ingest_partial_acks", ingestPartialAckCount);
+  for (size_t i = 0; i < kIngestFailureCount; i++) {
+    char key[24];
+    snprintf(key, sizeof(key), "ingest_fail_%s", ingestFailureName((IngestFailure)i));
+    w.fieldUInt(key, ingestFailCounts[i]);
+  }
+  w.fieldUInt("ingest_quarantined", quarantineCount);
+  w.fieldUInt("ingest_acked_events", ingestAckedCount);
+  w.fieldUInt("mqtt_publishes", mqttPublishCount);
+  w.fieldUInt("mqtt_pings", mqttPingCount);
+  w.fieldUInt("mqtt_inflight_peak", mqttInflightPeak);
+  w.fieldUInt("udp_datagrams", udpDatagramCount);
+  w.fieldUInt("udp_observations", udpPacker.observations());
+  w.fieldUInt("udp_skipped", udpSkippedCount);
+  w.fieldUInt("udp_send_errors", udpSendErrCount);
+  w.fieldUInt("ble_seen_count", bleSeenCount);
+  w.fieldUInt("ble_dedupe_count", bleDedupeCount);
+  w.fieldUInt("ble_ring_overwrite", bleTable.evictions());
+  w.fieldUInt("ble_table_size", bleTable.size());
+  w.fieldUInt("ble_table_capacity", bleTable.capacity());
+  w.fieldUInt("ble_admitted_new", bleSampler.stats().admittedNew);
+  w.fieldUInt("ble_suppressed_device", bleSampler.stats().suppressedDevice);
+  w.fieldUInt("ble_suppressed_global", bleSampler.stats().suppressedGlobal);
+  w.fieldUInt("ble_fp_count", bleFpCount);
+  w.fieldUInt("ble_addr_rotations", bleAddrRotationCount);
+  w.fieldUInt("ble_digest_events", bleDigestEventCount);
+#if BLE_COALESCE
+  w.fieldUInt("ble_coalesced", bleCoalescedCount);
+#endif
+  w.fieldUInt("ble_digest_devices", bleDigestDeviceCount);
+  w.fieldUInt("ble_raw_drops", bleRawRing.dropCount());
+  w.fieldUInt("ble_raw_overruns", bleRawRing.overrunCount());
+  w.fieldUInt("ble_raw_hwm", bleRawRing.highWater());
+  w.fieldUInt("ble_raw_capacity", bleRawRing.capacity());
+  w.fieldUInt("ble_scan_restarts", bleScanRestartCount);
+  w.fieldUInt("ble_scan_stalls", bleScanStallCount);
+  writePipeline(w);
+  w.fieldUInt("loop_max_ms", loopMaxMs);
+  Histogram::Snapshot snap;
+  loopHist.snapshot(snap);
+  w.fieldUInt("loop_p99_us", Histogram::quantile(snap, 0.99));
+  ingestPostHist.snapshot(snap);
+  w.fieldUInt("ingest_post_p99_ms", Histogram::quantile(snap, 0.99));
+  w.fieldUInt("ingest_post_avg_ms", snap.count > 0 ? snap.sum / snap.count : 0);
+  queueResidenceHist.snapshot(snap);
+  w.fieldUInt("queue_residence_p99_ms", Histogram::quantile(snap, 0.99));
+  bleCallbackHist.snapshot(snap);
+  w.fieldUInt("ble_callback_p99_us", Histogram::quantile(snap, 0.99));
+  w.fieldUInt("ble_min_heap", bleMinHeap);
+  w.fieldUInt("wifi_ap_seen_count", wifiApSeenCount);
+  w.fieldUInt("wifi_ap_dedupe_count", wifiApDedupeCount);
+  w.fieldUInt("wifi_ap_drop_count", wifiApDropCount);
+  w.fieldUInt("wifi_ap_scan_count", wifiApScanCount);
+  w.fieldUInt("wifi_event_drops", wifiEventRing.dropCount());
+#if OUI_INDEX_ENABLE
+  w.fieldUInt("oui_index_entries", ouiIndex.entryCount());
+  w.fieldUInt("oui_index_vendors", ouiIndex.vendorCount());
+  w.fieldUInt("oui_index_bytes", ouiIndex.sizeBytes());
+#endif
+  w.endObject();
+  sendJson(w);
+}
+
+// Prometheus text exposition of the main counters and the hot-path
+// histograms. Bucket bounds are powers of two in the recorded unit, scaled
+// to seconds.
+static void handleMetricsProm() {
+  PromWriter p(responseBuf, sizeof(responseBuf));
+  p.setSink(streamResponseChunk, const_cast<char *>(kPromType));
+  p.gauge("node_uptime_seconds", "Seconds since boot.", millis() / 1000);
+  p.gauge("node_free_heap_bytes", "Free heap.", ESP.getFreeHeap());
+  p.gauge("node_event_queue_depth", "Events waiting for ingest.", queue.count());
+  p.gauge("node_event_queue_bytes", "Bytes used by the event queue.", queue.bytesUsed());
+  p.counter("node_events_dropped_total", "Events dropped with the queue full.", eventDropCount);
+  const char *classNames[kEventClassCount];
+  int64_t classDepth[kEventClassCount];
+  uint64_t classDropped[kEventClassCount];
+  uint64_t classEvicted[kEventClassCount];
+  for (size_t c = 0; c < kEventClassCount; c++) {
+    EventClass cls = (EventClass)c;
+    classNames[c] = eventClassName(cls);
+    classDepth[c] = queue.ring(cls).count();
+    classDropped[c] = queue.stats(cls).dropped;
+    classEvicted[c] = queue.stats(cls).evicted;
+  }
+  p.gauges("node_event_class_queue_depth", "Events waiting for ingest, by class.", "class", classNames,
+           classDepth, kEventClassCount);
+  p.counters("node_event_class_dropped_total", "Arriving events dropped with their class full.", "class",
+             classNames, classDropped, kEventClassCount);
+  p.counters("node_event_class_evicted_total", "Queued events evicted for newer ones.", "class",
+             classNames, classEvicted, kEventClassCount);
+  p.counter("node_ingest_ok_total", "Acknowledged ingest POSTs.", ingestOkCount);
+  p.counter("node_ingest_err_total", "Failed ingest POSTs.", ingestErrCount);
+  const char *failNames[kIngestFailureCount];
+  uint64_t failCounts[kIngestFailureCount];
+  for (size_t i = 0; i < kIngestFailureCount; i++) {
+    failNames[i] = ingestFailureName((IngestFailure)i);
+    failCounts[i] = ingestFailCounts[i];
+  }
+  p.counters("node_ingest_failures_total", "Failed ingest POSTs, by cause.", "kind", failNames, failCounts,
+             kIngestFailureCount);
+  p.counter("node_ingest_quarantined_total", "Events the ingest server refused, set aside.",
+            quarantineCount);
+  p.counter("node_mqtt_publishes_total", "Batches published to the MQTT broker.", mqttPublishCount);
+  p.counter("node_udp_datagrams_total", "UDP telemetry datagrams sent.", udpDatagramCount);
+  p.counter("node_udp_skipped_total", "BLE observations not sent over UDP.", udpSkippedCount);
+  p.counter("node_ingest_raw_bytes_total", "Event bytes sent before compression.", ingestRawBytesTotal);
+  p.counter("node_ingest_wire_bytes_total", "Event bytes sent on the wire.", ingestWireBytesTotal);
+  p.counter("node_ble_seen_total", "BLE adverts processed.", bleSeenCount);
+#if BLE_COALESCE
+  p.counter("node_ble_coalesced_total", "ble.seen events folded into a queued one.", bleCoalescedCount);
+#endif
+  p.counter("node_ble_raw_drops_total", "BLE adverts dropped with the raw ring full.",
+            bleRawRing.dropCount());
+  p.counter("node_ble_scan_restarts_total", "BLE scan restarts.", bleScanRestartCount);
+  p.counter("node_wifi_ap_seen_total", "Wi-Fi AP sightings emitted.", wifiApSeenCount);
+  int64_t stageBusy[kPipeStageCount];
+  for (size_t i = 0; i < kPipeStageCount; i++) stageBusy[i] = pipeWindows[i].busyPermille();
+  p.gauges("node_pipeline_busy_permille", "Pipeline stage busy time over the last window, per mille.",
+           "stage", kPipeStageNames, stageBusy, kPipeStageCount);
+
+  Histogram::Snapshot snap;
+  ingestPostHist.snapshot(snap);
+  p.histogram("node_ingest_post_seconds", "Ingest POST latency, send to response.", snap, 3);
+  queueResidenceHist.snapshot(snap);
+  p.histogram("node_queue_residence_seconds", "Sampled time from enqueue to acknowledged ingest.",
+              snap, 3);
+  bleCallbackHist.snapshot(snap);
+  p.histogram("node_ble_callback_seconds", "BLE advert callback duration.", snap, 6);
+  loopHist.snapshot(snap);
+  p.histogram("node_loop_seconds", "Main loop pass duration.", snap, 6);
+
+  sendWriter(p, 200, kPromType);
 }
 
 static void handleConfig() {
-  String out = "{";
-  out += "\"node_id\":\"" + nodeId + "\"";
-  out += ",\"fw_version\":\"" + String(FW_VERSION) + "\"";
-  out += ",\"ingest_url\":\"" + ingestUrl + "\"";
-  out += ",\"wifi_ssid\":\"" + runtimeSsid + "\"";
-  out += ",\"wifi_pass_masked\":\"" + maskSecret(runtimePass) + "\"";
-  out += ",\"hostname\":\"" + hostname + "\"";
-  out += ",\"event_schema_version\":" + String(EVENT_SCHEMA_VERSION);
-  out += ",\"ingest_batch_size\":" + String(INGEST_BATCH_SIZE);
-  out += ",\"announce_interval_ms\":" + String(ANNOUNCE_INTERVAL_MS);
-  out += ",\"wifi_passive_scan\":" + String(WIFI_PASSIVE_SCAN);
-  out += ",\"wifi_scan_interval_ms\":" + String(WIFI_SCAN_INTERVAL_MS);
-  out += ",\"wifi_scan_passive_ms\":" + String(WIFI_SCAN_PASSIVE_MS);
-  out += ",\"ble_scan_interval\":" + String(BLE_SCAN_INTERVAL_MS);
-  out += ",\"ble_scan_window\":" + String(BLE_SCAN_WINDOW_MS);
-  out += "}";
-  server.send(200, "application/json", out);
+  JsonWriter w = streamWriter();
+  w.beginObject();
+  w.fieldText("node_id", nodeId);
+  w.fieldStr("fw_version", FW_VERSION);
+  w.fieldText("ingest_url", ingestUrl);
+  w.fieldText("wifi_ssid", runtimeSsid);
+  w.fieldStr("wifi_pass_masked", runtimePass.length() > 0 ? "***" : "");
+  w.fieldText("hostname", hostname);
+  w.fieldUInt("event_schema_version", EVENT_SCHEMA_VERSION);
+  w.fieldUInt("boot_epoch", bootEpoch);
+  w.fieldUInt("ingest_batch_size", INGEST_BATCH_SIZE);
+  w.fieldBool("ingest_adaptive_batch", INGEST_ADAPTIVE_BATCH);
+  w.fieldUInt("ingest_batch_max", INGEST_BATCH_MAX);
+  w.fieldUInt("ingest_max_batch_bytes", INGEST_MAX_BATCH_BYTES);
+  w.fieldBool("ingest_compress", INGEST_COMPRESS);
+  w.fieldStr("ingest_format", ingestUseCbor() ? "cbor" : "json");
+  w.fieldUInt("ingest_pipeline_depth", INGEST_PIPELINE_DEPTH);
+  w.fieldStr("uplink", uplinkName(uplinkMode));
+  w.fieldUInt("mqtt_inflight", MQTT_INFLIGHT);
+  w.fieldText("udp_collector", udpCollector);
+  w.fieldUInt("announce_interval_ms", ANNOUNCE_INTERVAL_MS);
+  w.fieldUInt("wifi_passive_scan", WIFI_PASSIVE_SCAN);
+  w.fieldUInt("wifi_scan_interval_ms", WIFI_SCAN_INTERVAL_MS);
+  w.fieldUInt("wifi_scan_passive_ms", WIFI_SCAN_PASSIVE_MS);
+  w.fieldUInt("ble_scan_interval", BLE_SCAN_INTERVAL_MS);
+  w.fieldUInt("ble_scan_window", BLE_SCAN_WINDOW_MS);
+  w.fieldStr("ble_mode", bleDigestMode ? "digest" : "raw");
+  w.fieldUInt("ble_digest_window_ms", bleDigestWindowMs);
+  w.fieldBool("ble_coalesce", BLE_COALESCE);
+  w.endObject();
+  sendJson(w);
 }
 
 static void handleWhoami() {
-  String dns0 = ipToString(WiFi.dnsIP(0));
-  String dns1 = ipToString(WiFi.dnsIP(1));
-  String out = "{";
-  out += "\"ok\":true";
-  out += ",\"node_id\":\"" + nodeId + "\"";
-  out += ",\"ip\":\"" + ipToString(WiFi.localIP()) + "\"";
-  out += ",\"gw\":\"" + ipToString(WiFi.gatewayIP()) + "\"";
-  out += ",\"mask\":\"" + ipToString(WiFi.subnetMask()) + "\"";
-  out += ",\"dns\":[\"" + dns0 + "\",\"" + dns1 + "\"]";
-  out += ",\"rssi\":" + String(WiFi.RSSI());
-  out += ",\"mac\":\"" + WiFi.macAddress() + "\"";
-  out += ",\"hostname\":\"" + hostname + "\"";
-  out += ",\"chip\":\"" + String(ESP.getChipModel()) + "\"";
-  out += ",\"fw_version\":\"" + String(FW_VERSION) + "\"";
-  out += ",\"wifi_state\":\"" + wifiState + "\"";
+  JsonWriter w = responseWriter();
+  w.beginObject();
+  w.fieldBool("ok", true);
+  w.fieldText("node_id", nodeId);
+  writeIpField(w, "ip", WiFi.localIP());
+  writeIpField(w, "gw", WiFi.gatewayIP());
+  writeIpField(w, "mask", WiFi.subnetMask());
+  writeDnsField(w);
+  w.fieldInt("rssi", WiFi.RSSI());
+  writeStationMacField(w, "mac");
+  w.fieldText("hostname", hostname);
+  w.fieldStr("chip", ESP.getChipModel());
+  w.fieldStr("fw_version", FW_VERSION);
+  w.fieldText("wifi_state", wifiState);
   if (lastDisconnectReason >= 0) {
-    out += ",\"wifi_reason\":" + String(lastDisconnectReason);
+    w.fieldInt("wifi_reason", lastDisconnectReason);
   }
   if (lastAuthMode.length() > 0) {
-    out += ",\"wifi_auth\":\"" + lastAuthMode + "\"";
+    w.fieldText("wifi_auth", lastAuthMode);
   }
-  out += ",\"ts_ms\":" + String((unsigned long)(esp_timer_get_time() / 1000ULL));
-  out += ",\"uptime_ms\":" + String(millis());
-  out += "}";
-  server.send(200, "application/json", out);
+  writeTsMsField(w);
+  w.fieldUInt("uptime_ms", millis());
+  w.endObject();
+  sendJson(w);
 }
 
 static void handleWifi() {
-  String dns0 = ipToString(WiFi.dnsIP(0));
-  String dns1 = ipToString(WiFi.dnsIP(1));
-  String out = "{";
-  out += "\"ok\":true";
-  out += ",\"connected\":" + jsonBool(WiFi.isConnected());
-  out += ",\"state\":\"" + wifiState + "\"";
-  out += ",\"ssid\":\"" + String(WiFi.SSID()) + "\"";
-  out += ",\"ip\":\"" + ipToString(WiFi.localIP()) + "\"";
-  out += ",\"gw\":\"" + ipToString(WiFi.gatewayIP()) + "\"";
-  out += ",\"mask\":\"" + ipToString(WiFi.subnetMask()) + "\"";
-  out += ",\"dns\":[\"" + dns0 + "\",\"" + dns1 + "\"]";
-  out += ",\"rssi\":" + String(WiFi.RSSI());
-  out += ",\"mac\":\"" + WiFi.macAddress() + "\"";
+  JsonWriter w = responseWriter();
+  w.beginObject();
+  w.fieldBool("ok", true);
+  w.fieldBool("connected", WiFi.isConnected());
+  w.fieldText("state", wifiState);
+  w.fieldText("ssid", runtimeSsid);
+  writeIpField(w, "ip", WiFi.localIP());
+  writeIpField(w, "gw", WiFi.gatewayIP());
+  writeIpField(w, "mask", WiFi.subnetMask());
+  writeDnsField(w);
+  w.fieldInt("rssi", WiFi.RSSI());
+  writeStationMacField(w, "mac");
   if (lastDisconnectReason >= 0) {
-    out += ",\"reason\":" + String(lastDisconnectReason);
+    w.fieldInt("reason", lastDisconnectReason);
   }
   if (lastAuthMode.length() > 0) {
-    out += ",\"auth\":\"" + lastAuthMode + "\"";
+    w.fieldText("auth", lastAuthMode);
+  }
+  w.endObject();
+  sendJson(w);
+}
+
+static void writeBleLatestItem(JsonWriter &w, const BleDeviceEntry &obs) {
+  char mac[18];
+  size_t macLen = formatMac(mac, obs.addr, false);
+  w.beginObject();
+  w.fieldStr("mac", mac, macLen);
+  w.fieldInt("rssi", obs.rssi);
+  w.fieldStr("name", obs.name, obs.name_len);
+  uint16_t vendorId = bleVendorId(obs.addr, obs.addr_type);
+  writeVendorField(w, vendorId);
+  char vendor[48];
+  if (vendorId != OuiIndex::kNone && ouiVendorName(vendorId, vendor, sizeof(vendor)) > 0) {
+    w.fieldStr("vendor", vendor);
   }
-  out += "}";
-  server.send(200, "application/json", out);
+  w.fieldUInt("mfg_len", obs.mfg_len);
+  w.fieldUInt("svc_count", obs.svc_count);
+  w.fieldUInt("flags", obs.adv_flags);
+  w.fieldUInt("last_seen_ms", obs.last_seen_ms);
+  w.fieldUInt("seen_count", obs.seen_count);
+  w.fieldUInt("admitted", obs.admitted);
+  w.fieldUInt("suppressed", obs.suppressed);
+  if (obs.has_fp) {
+    char fp[65];
+    sha256Hex(obs.fp_stable, fp);
+    w.fieldStr("fp_stable", fp, 64);
+  }
+  w.endObject();
 }
 
+// An item at its largest (escaped name and vendor, fingerprint) still fits
+// an empty response buffer.
+static const size_t kBleLatestItemMaxBytes = 768;
+static_assert(HTTP_RESPONSE_CHUNK_BYTES > kBleLatestItemMaxBytes,
+              "HTTP_RESPONSE_CHUNK_BYTES cannot hold a /ble/latest item");
+
 static void handleBleLatest() {
+  BleLatestQuery q;
   int limit = server.hasArg("limit") ? server.arg("limit").toInt() : 50;
   if (limit <= 0) limit = 1;
   if (limit > (int)BLE_OBS_CAPACITY) limit = BLE_OBS_CAPACITY;
+  q.limit = (uint16_t)limit;
+  if (server.hasArg("since_ms")) {
+    q.hasSince = true;
+    q.sinceMs = strtoul(server.arg("since_ms").c_str(), nullptr, 10);
+  }
+  if (server.hasArg("min_rssi")) {
+    q.minRssi = (int16_t)server.arg("min_rssi").toInt();
+  }
+  if (server.hasArg("cursor")) {
+    if (!bleParseCursor(server.arg("cursor").c_str(), q.cursorMs, q.cursorKey)) {
+      respond(400, "{\"ok\":false,\"err\":\"bad_cursor\"}");
+      return;
+    }
+    q.hasCursor = true;
+  }
 
-  String out = "{";
-  out += "\"items\":[";
-  int emitted = 0;
-  for (int i = 0; i < (int)bleRingCount && emitted < limit; i++) {
-    size_t idx = (bleRingHead + BLE_OBS_CAPACITY - 1 - i) % BLE_OBS_CAPACITY;
-    BleObservation &obs = bleRing[idx];
-    if (obs.mac.length() == 0) continue;
-    if (emitted > 0) out += ",";
-    out += "{";
-    out += jsonKV("mac", obs.mac);
-    out += "," + jsonKV("rssi", String(obs.rssi), false);
-    out += "," + jsonKV("name", obs.name);
-    out += "," + jsonKV("mfg_len", String(obs.mfg_len), false);
-    out += "," + jsonKV("svc_count", String(obs.svc_count), false);
-    out += "," + jsonKV("flags", String(obs.adv_flags), false);
-    out += "," + jsonKV("last_seen_ms", String(obs.last_seen_ms), false);
-    out += "," + jsonKV("seen_count", String(obs.seen_count), false);
-    out += "}";
-    emitted++;
+  JsonWriter w = streamWriter();
+  w.beginObject();
+  // Pollers pass this back as since_ms to fetch only what changed.
+  w.fieldUInt("now_ms", millis());
+  w.key("items");
+  w.beginArray();
+  uint32_t nextMs = 0;
+  uint64_t nextKey = 0;
+  // The table is walked one buffer at a time. Items render with the sink
+  // off, so a full buffer ends the walk after the last item that fit rather
+  // than flushing (and releasing the state lock) with an entry in hand. The
+  // buffer is then flushed and the walk resumes from that item, like a
+  // client passing next_cursor.
+  bool more = false;
+  for (;;) {
+    bool full = false;
+    uint16_t written = 0;
+    w.setSink(nullptr, nullptr);
+    more = bleQueryLatest(
+        bleTable, q,
+        [&](uint64_t key, const BleDeviceEntry &obs) {
+          if (full) return;
+          JsonWriter::Mark before = w.mark();
+          writeBleLatestItem(w, obs);
+          if (w.overflowed()) {
+            w.rewind(before);
+            full = true;
+            return;
+          }
+          written++;
+          q.cursorMs = obs.last_seen_ms;
+          q.cursorKey = key;
+        },
+        nextMs, nextKey);
+    w.setSink(streamResponseChunk, const_cast<char *>(kJsonType));
+    if (!full) break;
+    q.limit -= written;
+    if (written > 0) q.hasCursor = true;
+    if ((written == 0 && w.size() == 0) || !w.flush()) {
+      // Client gone (or an item that fits nowhere): end the page here.
+      more = true;
+      nextMs = q.cursorMs;
+      nextKey = q.cursorKey;
+      break;
+    }
+  }
+  w.endArray();
+  if (more) {
+    char cursor[kBleCursorMax];
+    size_t cursorLen = bleFormatCursor(cursor, nextMs, nextKey);
+    w.fieldStr("next_cursor", cursor, cursorLen);
   }
-  out += "]}";
-  server.send(200, "application/json", out);
+  w.endObject();
+  sendJson(w);
 }
 
 static void handleBleStats() {
-  String out = "{";
-  out += "\"enabled\":true";
-  out += ",\"scanning\":" + jsonBool(bleScan && bleScan->isScanning());
-  out += ",\"scan_interval\":" + String(BLE_SCAN_INTERVAL_MS);
-  out += ",\"scan_window\":" + String(BLE_SCAN_WINDOW_MS);
-  out += ",\"seen_count\":" + String(bleSeenCount);
-  out += ",\"dedupe_count\":" + String(bleDedupeCount);
-  out += ",\"ring_overwrite\":" + String(bleRingOverwriteCount);
-  out += ",\"scan_restarts\":" + String(bleScanRestartCount);
-  out += ",\"scan_stalls\":" + String(bleScanStallCount);
-  out += ",\"last_result_ms\":" + String(lastBleResultMs);
-  out += ",\"last_restart_ms\":" + String(lastBleRestartMs);
-  out += "}";
-  server.send(200, "application/json", out);
+  JsonWriter w = responseWriter();
+  w.beginObject();
+  w.fieldBool("enabled", true);
+  w.fieldBool("scanning", bleScan && bleScan->isScanning());
+  w.fieldUInt("scan_interval", BLE_SCAN_INTERVAL_MS);
+  w.fieldUInt("scan_window", BLE_SCAN_WINDOW_MS);
+  w.fieldUInt("seen_count", bleSeenCount);
+  w.fieldUInt("dedupe_count", bleDedupeCount);
+  w.fieldUInt("ring_overwrite", bleTable.evictions());
+  w.fieldUInt("table_size", bleTable.size());
+  w.fieldUInt("fp_count", bleFpCount);
+  w.fieldUInt("addr_rotations", bleAddrRotationCount);
+  w.fieldUInt("admitted_new", bleSampler.stats().admittedNew);
+  w.fieldUInt("suppressed_device", bleSampler.stats().suppressedDevice);
+  w.fieldUInt("suppressed_global", bleSampler.stats().suppressedGlobal);
+  w.fieldUInt("global_tokens", bleSampler.globalTokens());
+  w.fieldUInt("active_devices", bleSampler.activeDevices());
+  w.fieldUInt("device_interval_ms", bleSampler.deviceIntervalMs());
+  w.fieldStr("mode", bleDigestMode ? "digest" : "raw");
+  w.fieldUInt("digest_window_ms", bleDigestWindowMs);
+  w.fieldUInt("raw_drops", bleRawRing.dropCount());
+  w.fieldUInt("raw_overruns", bleRawRing.overrunCount());
+  w.fieldUInt("raw_depth", bleRawRing.size());
+  w.fieldUInt("scan_restarts", bleScanRestartCount);
+  w.fieldUInt("scan_stalls", bleScanStallCount);
+  w.fieldUInt("last_result_ms", lastBleResultMs);
+  w.fieldUInt("last_restart_ms", lastBleRestartMs);
+  w.endObject();
+  sendJson(w);
+}
+
+#if LOOP_PROFILE_ENABLE
+static void writeProfileStats(JsonWriter &w, const LoopProfiler::Stats &st,
+                              const Histogram::Snapshot &hist) {
+  uint32_t perUs = loopProfiler.cyclesPerUs();
+  w.fieldUInt("count", st.count);
+  w.fieldUInt("min_us", st.minCycles / perUs);
+  w.fieldUInt("avg_us", st.count > 0 ? st.sumCycles / st.count / perUs : 0);
+  w.fieldUInt("max_us", st.maxCycles / perUs);
+  w.fieldUInt("p99_us", Histogram::quantile(hist, 0.99));
+  w.fieldUInt("over_budget", st.overBudget);
+}
+
+// GET /debug/profile reports per-stage loop timing since the last reset;
+// reset=1 (GET or POST) clears it after the report is rendered.
+static void handleDebugProfile() {
+  JsonWriter w = streamWriter();
+  Histogram::Snapshot hist;
+  w.beginObject();
+  w.fieldBool("ok", true);
+  w.fieldUInt("cpu_mhz", loopProfiler.cyclesPerUs());
+  w.fieldUInt("budget_us", loopProfiler.budgetUs());
+  w.fieldUInt("window_ms", millis() - loopProfileResetMs);
+  w.key("loop");
+  w.beginObject();
+  loopProfiler.passHistogram(hist);
+  writeProfileStats(w, loopProfiler.pass(), hist);
+  w.endObject();
+  w.key("stages");
+  w.beginArray();
+  for (size_t i = 0; i < loopProfiler.stageCount(); i++) {
+    w.beginObject();
+    w.fieldStr("name", loopProfiler.stageName(i));
+    loopProfiler.stageHistogram(i, hist);
+    writeProfileStats(w, loopProfiler.stage(i), hist);
+    w.fieldUInt("blamed", loopProfiler.stage(i).blamed);
+    w.endObject();
+  }
+  w.endArray();
+  w.endObject();
+  sendJson(w);
+  if (server.arg("reset") == "1") {
+    loopProfiler.reset();
+    loopProfileResetMs = millis();
+  }
+}
+#endif
+
+// GET /debug/quarantine lists the events the ingest server refused, newest
+// first; clear=1 (GET or POST) empties the list after it is rendered.
+static void handleDebugQuarantine() {
+  JsonWriter w = streamWriter();
+  // Entries may be added while the response is flushed, so the listing
+  // counts back from the newest one at the start, and each entry is copied
+  // before it is rendered.
+  static QuarantineEntry shownEntry;
+  const uint32_t newest = quarantineCount;
+  uint32_t shown = min<uint32_t>(newest - quarantineCleared, QUARANTINE_SLOTS);
+  unsigned long now = millis();
+  w.beginObject();
+  w.fieldBool("ok", true);
+  w.fieldUInt("total", newest);
+  w.fieldUInt("slots", QUARANTINE_SLOTS);
+  w.key("events");
+  w.beginArray();
+  for (uint32_t i = 0; i < shown; i++) {
+    uint32_t n = newest - 1 - i;
+    if (quarantineCount - n > QUARANTINE_SLOTS) break;  // overwritten meanwhile
+    shownEntry = quarantine[n % QUARANTINE_SLOTS];
+    const QuarantineEntry &q = shownEntry;
+    w.beginObject();
+    w.fieldUInt("age_ms", now - q.ms);
+    w.fieldStr("class", eventClassName((EventClass)q.cls));
+    w.fieldInt("status", q.status);
+    w.fieldStr("kind", ingestFailureName(classifyIngestStatus(q.status)));
+    w.fieldUInt("len", q.len);
+    // As a string: the server may have refused it for not parsing.
+    w.fieldStr("event", q.event, q.kept);
+    w.fieldBool("truncated", q.kept < q.len);
+    w.endObject();
+  }
+  w.endArray();
+  w.endObject();
+  sendJson(w);
+  if (server.arg("clear") == "1") quarantineCleared = newest;
+}
+
+static void setBleMode(bool digest, uint32_t windowMs) {
+  if (windowMs < 1000) windowMs = 1000;
+  bleDigestMode = digest;
+  bleDigestWindowMs = windowMs;
+  bleDigestWindowStart = millis();
+  for (uint16_t h = bleTable.front(); h != bleTable.npos; h = bleTable.next(h)) {
+    bleDigestReset(bleTable.at(h));
+  }
+}
+
+// POST /ble/mode?mode=raw|digest&window_ms=N switches between per-advert
+// events and periodic digests; the choice survives reboots.
+static void handleBleMode() {
+  if (server.method() == HTTP_POST) {
+    bool digest = bleDigestMode;
+    if (server.hasArg("mode")) {
+      String mode = server.arg("mode");
+      if (mode == "digest") {
+        digest = true;
+      } else if (mode == "raw") {
+        digest = false;
+      } else {
+        respond(400, "{\"ok\":false,\"err\":\"mode must be raw or digest\"}");
+        return;
+      }
+    }
+    uint32_t windowMs = server.hasArg("window_ms") ? (uint32_t)server.arg("window_ms").toInt()
+                                                   : bleDigestWindowMs;
+    setBleMode(digest, windowMs);
+    prefs.begin("ble", false);
+    prefs.putUChar("digest", bleDigestMode ? 1 : 0);
+    prefs.putUInt("window_ms", bleDigestWindowMs);
+    prefs.end();
+  }
+  JsonWriter w = responseWriter();
+  w.beginObject();
+  w.fieldBool("ok", true);
+  w.fieldStr("mode", bleDigestMode ? "digest" : "raw");
+  w.fieldUInt("window_ms", bleDigestWindowMs);
+  w.endObject();
+  sendJson(w);
+}
+
+// GET /uplink reports the uplink for queued events;
+// POST /uplink?mode=http|mqtt&mqtt_url=URL changes it and persists it across
+// reboots. The broker's user and password are not reported back.
+static void handleUplink() {
+  if (server.method() == HTTP_POST) {
+    Uplink mode = uplinkMode;
+    String arg = server.arg("mode");
+    if (arg == "http") {
+      mode = Uplink::kHttp;
+    } else if (arg == "mqtt") {
+      mode = Uplink::kMqtt;
+    } else if (arg.length() > 0) {
+      respond(400, "{\"ok\":false,\"err\":\"mode must be http or mqtt\"}");
+      return;
+    }
+    String url = server.hasArg("mqtt_url") ? server.arg("mqtt_url") : mqttUrl;
+    url.trim();
+    MqttUrl parsed;
+    if ((mode == Uplink::kMqtt || url.length() > 0) && !parseMqttUrl(url.c_str(), parsed)) {
+      respond(400, "{\"ok\":false,\"err\":\"mqtt_url must be mqtt[s]://[user[:pass]@]host[:port][/prefix]\"}");
+      return;
+    }
+    uplinkMode = mode;
+    mqttUrl = url;
+    prefs.begin("uplink", false);
+    prefs.putUChar("mqtt", uplinkMode == Uplink::kMqtt ? 1 : 0);
+    prefs.putString("mqtt_url", mqttUrl);
+    prefs.end();
+  }
+  MqttUrl target;
+  const bool valid = parseMqttUrl(mqttUrl.c_str(), target);
+  JsonWriter w = responseWriter();
+  w.beginObject();
+  w.fieldBool("ok", true);
+  w.fieldStr("uplink", uplinkName(uplinkMode));
+  w.fieldText("ingest_url", ingestUrl);
+  w.key("mqtt");
+  w.beginObject();
+  w.fieldBool("configured", valid);
+  if (valid) {
+    w.fieldStr("host", target.host);
+    w.fieldUInt("port", target.port);
+    w.fieldBool("tls", target.tls);
+    w.fieldStr("user", target.user);
+    w.fieldStr("topic_prefix", target.prefix);
+  }
+  w.fieldBool("session_up", uplinkActive == Uplink::kMqtt && mqttSessionUp);
+  w.fieldUInt("inflight", MQTT_INFLIGHT);
+  w.fieldUInt("keepalive_s", MQTT_KEEPALIVE_S);
+  w.fieldUInt("fail_count", mqttFailCount);
+  w.endObject();
+  w.endObject();
+  sendJson(w);
+}
+
+// GET /udp reports the UDP telemetry channel;
+// POST /udp?collector=host[:port] points it at a collector, or turns it off
+// with an empty value, and persists that across reboots.
+static void handleUdp() {
+  if (server.method() == HTTP_POST && server.hasArg("collector")) {
+    String spec = server.arg("collector");
+    spec.trim();
+    if (!setUdpCollector(spec)) {
+      respond(400, "{\"ok\":false,\"err\":\"collector must be host[:port]\"}");
+      return;
+    }
+    prefs.begin("udp", false);
+    prefs.putString("collector", udpCollector);
+    prefs.end();
+  }
+  JsonWriter w = responseWriter();
+  w.beginObject();
+  w.fieldBool("ok", true);
+  w.fieldBool("enabled", udpTelemetryOn());
+  w.fieldText("collector", udpCollector);
+  if (udpTelemetryOn()) {
+    w.fieldStr("host", udpHost);
+    w.fieldUInt("port", udpPort);
+    w.fieldBool("resolved", udpResolved);
+  }
+  w.fieldUInt("mtu", UDP_MTU);
+  w.fieldUInt("per_datagram", udpPacker.capacity());
+  w.fieldUInt("flush_ms", UDP_FLUSH_MS);
+  w.fieldBool("mirror_http", UDP_MIRROR_HTTP);
+  w.fieldUInt("epoch", bootEpoch);
+  w.fieldUInt("seq", udpPacker.lastSeq());
+  w.fieldUInt("observations", udpPacker.observations());
+  w.fieldUInt("datagrams", udpDatagramCount);
+  w.fieldUInt("skipped", udpSkippedCount);
+  w.fieldUInt("send_errors", udpSendErrCount);
+  w.endObject();
+  sendJson(w);
+}
+
+static void saveQueuePolicy(EventClass cls) {
+  char key[8];
+  prefs.begin("queue", false);
+  snprintf(key, sizeof(key), "drop%u", (unsigned)cls);
+  prefs.putUChar(key, (uint8_t)queue.policy(cls));
+  snprintf(key, sizeof(key), "n%u", (unsigned)cls);
+  prefs.putUShort(key, queue.sampleN(cls));
+  prefs.end();
+}
+
+// GET /queue/policy lists the drop policy of each event class;
+// POST /queue/policy?class=control|status|telemetry&policy=drop-newest|drop-oldest|sample&n=N
+// changes one.
+static void handleQueuePolicy() {
+  if (server.method() == HTTP_POST) {
+    EventClass cls = kEventTelemetry;
+    if (!parseEventClass(server.arg("class").c_str(), cls)) {
+      respond(400, "{\"ok\":false,\"err\":\"class must be control, status or telemetry\"}");
+      return;
+    }
+    DropPolicy policy = queue.policy(cls);
+    if (server.hasArg("policy") && !parseDropPolicy(server.arg("policy").c_str(), policy)) {
+      respond(400, "{\"ok\":false,\"err\":\"policy must be drop-newest, drop-oldest or sample\"}");
+      return;
+    }
+    long n = server.hasArg("n") ? server.arg("n").toInt() : queue.sampleN(cls);
+    queue.setPolicy(cls, policy, (uint16_t)constrain(n, 1L, 65535L));
+    saveQueuePolicy(cls);
+  }
+  JsonWriter w = responseWriter();
+  w.beginObject();
+  w.fieldBool("ok", true);
+  w.key("classes");
+  w.beginObject();
+  for (size_t c = kEventClassCount; c-- > 0;) {
+    EventClass cls = (EventClass)c;
+    w.key(eventClassName(cls));
+    w.beginObject();
+    w.fieldStr("policy", dropPolicyName(queue.policy(cls)));
+    w.fieldUInt("sample_n", queue.sampleN(cls));
+    w.fieldUInt("capacity_bytes", queue.ring(cls).capacityBytes());
+    w.endObject();
+  }
+  w.endObject();
+  w.endObject();
+  sendJson(w);
 }
 
 static String parseHostFromUrl(const String &url) {
@@ -722,122 +1854,268 @@ static bool bodyFlag(const String &body, const char *key, bool defaultValue) {
   return defaultValue;
 }
 
+struct ProbeHttpResult {
+  String url;
+  int code = 0;
+  unsigned long ms = 0;
+};
+
+static ProbeHttpResult probeHttpGet(const String &url) {
+  ProbeHttpResult result;
+  result.url = url;
+  HTTPClient http;
+  http.setTimeout(PROBE_HTTP_TIMEOUT_MS);
+  unsigned long start = millis();
+  http.begin(url);
+  result.code = http.GET();
+  http.end();
+  result.ms = millis() - start;
+  return result;
+}
+
+static void writeProbeHttp(JsonWriter &w, const ProbeHttpResult &r) {
+  w.beginObject();
+  w.fieldText("url", r.url);
+  w.fieldInt("code", r.code);
+  w.fieldBool("ok", r.code >= 200 && r.code < 500);
+  w.fieldUInt("ms", r.ms);
+  w.endObject();
+}
+
+static ProbeHttpResultFields probeHttpFields(const ProbeHttpResult &r) {
+  return ProbeHttpResultFields{eventText(r.url), r.code, r.code >= 200 && r.code < 500, (uint32_t)r.ms};
+}
+
+// POST /probe queues a job and answers with its id at once. The probe task
+// runs it, with a DNS lookup and HTTP GETs that each block for up to
+// PROBE_HTTP_TIMEOUT_MS, and GET /probe/result?job=N reports it. Job N keeps
+// slot N % PROBE_JOB_SLOTS until a newer job takes it over.
+enum class ProbeState : uint8_t { kQueued, kRunning, kDone };
+
+struct ProbeJob {
+  uint32_t id = 0;  // 0: slot never used
+  ProbeState state = ProbeState::kQueued;
+  bool doDns = false;
+  bool doHttpIngest = false;
+  bool doHttpSelf = false;
+  bool emit = false;
+  unsigned long queuedMs = 0;
+  String dnsHost;
+  IPAddress resolved;
+  bool dnsOk = false;
+  unsigned long dnsMs = 0;
+  ProbeHttpResult ingest;  // url set when queued
+  ProbeHttpResult self;
+};
+
+static ProbeJob probeJobs[PROBE_JOB_SLOTS];
+static uint32_t probeNextJobId = 1;
+static TaskHandle_t probeTask = nullptr;
+
+static const char *probeStateName(ProbeState state) {
+  switch (state) {
+    case ProbeState::kQueued:
+      return "queued";
+    case ProbeState::kRunning:
+      return "running";
+    default:
+      return "done";
+  }
+}
+
 static void handleProbe() {
+  uint32_t id = probeNextJobId;
+  ProbeJob &job = probeJobs[id % PROBE_JOB_SLOTS];
+  if (job.id != 0 && job.state != ProbeState::kDone) {
+    respond(503, "{\"ok\":false,\"err\":\"probe_busy\"}");
+    return;
+  }
   String body = server.hasArg("plain") ? server.arg("plain") : "";
-  bool doDns = bodyFlag(body, "dns", true);
-  bool doHttpIngest = bodyFlag(body, "http_ingest", true);
-  bool doHttpSelf = bodyFlag(body, "http_self", false);
-  bool emit = bodyFlag(body, "emit", true);
-
-  String data = "{";
-  String dnsData = "{";
-  bool hasDns = false;
-  String httpData = "{";
-  bool hasHttp = false;
-
-  if (doDns) {
-    unsigned long start = millis();
-    IPAddress resolved;
-    String host = parseHostFromUrl(ingestUrl);
-    bool ok = WiFi.hostByName(host.c_str(), resolved);
-    unsigned long ms = millis() - start;
-    data += "\"dns\":{";
-    data += "\"host\":\"" + host + "\"";
-    data += ",\"ok\":" + jsonBool(ok);
-    data += ",\"ms\":" + String(ms);
-    data += ",\"ip\":\"" + (ok ? ipToString(resolved) : "") + "\"";
-    data += "}";
-
-    dnsData += "\"host\":\"" + host + "\"";
-    dnsData += ",\"ok\":" + jsonBool(ok);
-    dnsData += ",\"ms\":" + String(ms);
-    dnsData += ",\"ip\":\"" + (ok ? ipToString(resolved) : "") + "\"";
-    dnsData += "}";
-    hasDns = true;
-  }
-
-  if (doHttpIngest) {
-    if (data.length() > 1) data += ",";
-    String base = baseUrlFromIngest(ingestUrl);
-    String url = base + "/health";
-    HTTPClient http;
-    http.setTimeout(PROBE_HTTP_TIMEOUT_MS);
-    unsigned long start = millis();
-    http.begin(url);
-    int code = http.GET();
-    http.end();
-    unsigned long ms = millis() - start;
-    data += "\"http_ingest\":{";
-    data += "\"url\":\"" + url + "\"";
-    data += ",\"code\":" + String(code);
-    data += ",\"ok\":" + jsonBool(code >= 200 && code < 500);
-    data += ",\"ms\":" + String(ms);
-    data += "}";
-
-    if (hasHttp) httpData += ",";
-    httpData += "\"ingest\":{";
-    httpData += "\"url\":\"" + url + "\"";
-    httpData += ",\"code\":" + String(code);
-    httpData += ",\"ok\":" + jsonBool(code >= 200 && code < 500);
-    httpData += ",\"ms\":" + String(ms);
-    httpData += "}";
-    hasHttp = true;
-  }
-
-  if (doHttpSelf) {
-    if (data.length() > 1) data += ",";
-    String url = String("http://") + ipToString(WiFi.localIP()) + "/health";
-    HTTPClient http;
-    http.setTimeout(PROBE_HTTP_TIMEOUT_MS);
-    unsigned long start = millis();
-    http.begin(url);
-    int code = http.GET();
-    http.end();
-    unsigned long ms = millis() - start;
-    data += "\"http_self\":{";
-    data += "\"url\":\"" + url + "\"";
-    data += ",\"code\":" + String(code);
-    data += ",\"ok\":" + jsonBool(code >= 200 && code < 500);
-    data += ",\"ms\":" + String(ms);
-    data += "}";
-
-    if (hasHttp) httpData += ",";
-    httpData += "\"self\":{";
-    httpData += "\"url\":\"" + url + "\"";
-    httpData += ",\"code\":" + String(code);
-    httpData += ",\"ok\":" + jsonBool(code >= 200 && code < 500);
-    httpData += ",\"ms\":" + String(ms);
-    httpData += "}";
-    hasHttp = true;
-  }
-
-  data += "}";
-
-  if (emit) {
-    if (hasDns) {
-      enqueueEvent(buildEvent("probe.net", dnsData));
+  job = ProbeJob();
+  job.id = id;
+  job.doDns = bodyFlag(body, "dns", true);
+  job.doHttpIngest = bodyFlag(body, "http_ingest", true);
+  job.doHttpSelf = bodyFlag(body, "http_self", false);
+  job.emit = bodyFlag(body, "emit", true);
+  job.queuedMs = millis();
+  if (job.doDns) job.dnsHost = parseHostFromUrl(ingestUrl);
+  if (job.doHttpIngest) job.ingest.url = baseUrlFromIngest(ingestUrl) + "/health";
+  if (job.doHttpSelf) {
+    char ip[16];
+    IPAddress local = WiFi.localIP();
+    formatIpv4(ip, local[0], local[1], local[2], local[3]);
+    job.self.url = String("http://") + ip + "/health";
+  }
+  probeNextJobId++;
+  xTaskNotifyGive(probeTask);
+
+  JsonWriter w = responseWriter();
+  w.beginObject();
+  w.fieldBool("ok", true);
+  w.fieldUInt("job", id);
+  w.fieldStr("state", probeStateName(job.state));
+  w.endObject();
+  sendJson(w, 202);
+}
+
+static void handleProbeResult() {
+  uint32_t id = server.hasArg("job") ? strtoul(server.arg("job").c_str(), nullptr, 10)
+                                     : probeNextJobId - 1;
+  const ProbeJob &job = probeJobs[id % PROBE_JOB_SLOTS];
+  if (id == 0 || job.id != id) {
+    respond(404, "{\"ok\":false,\"err\":\"unknown_job\"}");
+    return;
+  }
+
+  JsonWriter w = responseWriter();
+  w.beginObject();
+  w.fieldBool("ok", true);
+  w.fieldUInt("job", job.id);
+  w.fieldStr("state", probeStateName(job.state));
+  w.fieldUInt("age_ms", millis() - job.queuedMs);
+  if (job.state == ProbeState::kDone) {
+    if (job.doDns) {
+      w.key("dns");
+      w.beginObject();
+      w.fieldText("host", job.dnsHost);
+      w.fieldBool("ok", job.dnsOk);
+      w.fieldUInt("ms", job.dnsMs);
+      if (job.dnsOk) {
+        writeIpField(w, "ip", job.resolved);
+      } else {
+        w.fieldStr("ip", "");
+      }
+      w.endObject();
+    }
+    if (job.doHttpIngest) {
+      w.key("http_ingest");
+      writeProbeHttp(w, job.ingest);
     }
-    if (hasHttp) {
-      enqueueEvent(buildEvent("probe.http", httpData));
+    if (job.doHttpSelf) {
+      w.key("http_self");
+      writeProbeHttp(w, job.self);
     }
   }
-
-  server.send(200, "application/json", data);
+  w.endObject();
+  sendJson(w);
 }
 
-static void registerStatusRoutes() {
-  server.on("/health", HTTP_GET, handleHealth);
-  server.on("/metrics", HTTP_GET, handleMetrics);
-  server.on("/config", HTTP_GET, handleConfig);
-  server.on("/probe", HTTP_POST, handleProbe);
-  server.on("/whoami", HTTP_GET, handleWhoami);
-  server.on("/wifi", HTTP_GET, handleWifi);
-  server.on("/ble/latest", HTTP_GET, handleBleLatest);
-  server.on("/ble/stats", HTTP_GET, handleBleStats);
+static void emitProbeEvents(const ProbeJob &job) {
+  if (job.doDns) {
+    ProbeNetEvent ev;
+    ev.host = eventText(job.dnsHost);
+    ev.ok = job.dnsOk;
+    ev.ms = job.dnsMs;
+    char ip[16];
+    const IPAddress &r = job.resolved;
+    ev.ip = EventText{ip, job.dnsOk ? formatIpv4(ip, r[0], r[1], r[2], r[3]) : 0};
+    commitEvent(ev);
+  }
+  if (job.doHttpIngest || job.doHttpSelf) {
+    ProbeHttpEvent ev;
+    if (job.doHttpIngest) ev.ingest.set(probeHttpFields(job.ingest));
+    if (job.doHttpSelf) ev.self.set(probeHttpFields(job.self));
+    commitEvent(ev);
+  }
 }
 
-static String sanitizeHostname(const String &raw) {
-  String out;
+// Runs the oldest queued job on a copy, without the state lock, and stores
+// the result. False when nothing is queued.
+static bool runNextProbeJob() {
+  ProbeJob job;
+  size_t slot = 0;
+  {
+    StateLock lock;
+    for (size_t i = 0; i < PROBE_JOB_SLOTS; i++) {
+      const ProbeJob &j = probeJobs[i];
+      if (j.id != 0 && j.state == ProbeState::kQueued && (job.id == 0 || j.id < job.id)) {
+        job = j;
+        slot = i;
+      }
+    }
+    if (job.id == 0) return false;
+    probeJobs[slot].state = ProbeState::kRunning;
+  }
+
+  if (job.doDns) {
+    unsigned long start = millis();
+    job.dnsOk = WiFi.hostByName(job.dnsHost.c_str(), job.resolved);
+    job.dnsMs = millis() - start;
+  }
+  if (job.doHttpIngest) job.ingest = probeHttpGet(job.ingest.url);
+  if (job.doHttpSelf) job.self = probeHttpGet(job.self.url);
+
+  // handleProbe() leaves a running job's slot alone.
+  StateLock lock;
+  job.state = ProbeState::kDone;
+  probeJobs[slot] = job;
+  if (job.emit) emitProbeEvents(job);
+  return true;
+}
+
+static void probeTaskMain(void *) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    while (runNextProbeJob()) {
+    }
+  }
+}
+
+static void registerStatusRoutes() {
+  route("/health", HTTP_GET, handleHealth);
+  route("/metrics", HTTP_GET, handleMetrics);
+  route("/metrics/prom", HTTP_GET, handleMetricsProm);
+  route("/config", HTTP_GET, handleConfig);
+  route("/probe", HTTP_POST, handleProbe);
+  route("/probe/result", HTTP_GET, handleProbeResult);
+  route("/whoami", HTTP_GET, handleWhoami);
+  route("/wifi", HTTP_GET, handleWifi);
+  route("/ble/latest", HTTP_GET, handleBleLatest);
+  route("/ble/stats", HTTP_GET, handleBleStats);
+  route("/ble/mode", HTTP_ANY, handleBleMode);
+  route("/queue/policy", HTTP_ANY, handleQueuePolicy);
+  route("/uplink", HTTP_ANY, handleUplink);
+  route("/udp", HTTP_ANY, handleUdp);
+  route("/debug/quarantine", HTTP_ANY, handleDebugQuarantine);
+#if LOOP_PROFILE_ENABLE
+  route("/debug/profile", HTTP_ANY, handleDebugProfile);
+#endif
+}
+
+// The web server polls for clients on its own task, one priority above the
+// loop task and on the same core, so a handler waiting for the state lock
+// takes it as soon as a loop pass releases it.
+static const UBaseType_t kHttpTaskPriority = 2;
+static const UBaseType_t kProbeTaskPriority = 1;
+
+#if PIPELINE_NET_TASK
+// The network stage sits on the protocol core under the Wi-Fi, lwIP and
+// NimBLE tasks, which all run at higher priorities.
+static const UBaseType_t kNetTaskPriority = 1;
+static TaskHandle_t netTask = nullptr;
+static void netTaskMain(void *);
+#endif
+
+static void httpTaskMain(void *) {
+  for (;;) {
+    server.handleClient();
+    vTaskDelay(pdMS_TO_TICKS(HTTP_TASK_POLL_MS));
+  }
+}
+
+static void startTasks() {
+  xTaskCreatePinnedToCore(probeTaskMain, "probe", PROBE_TASK_STACK_BYTES, nullptr, kProbeTaskPriority,
+                          &probeTask, ARDUINO_RUNNING_CORE);
+  xTaskCreatePinnedToCore(httpTaskMain, "http", HTTP_TASK_STACK_BYTES, nullptr, kHttpTaskPriority,
+                          nullptr, ARDUINO_RUNNING_CORE);
+#if PIPELINE_NET_TASK
+  xTaskCreatePinnedToCore(netTaskMain, "net", PIPELINE_NET_STACK_BYTES, nullptr, kNetTaskPriority,
+                          &netTask, PIPELINE_NET_CORE);
+#endif
+}
+
+static String sanitizeHostname(const String &raw) {
+  String out;
   out.reserve(raw.length());
   for (size_t i = 0; i < raw.length(); i++) {
     char c = raw[i];
@@ -885,33 +2163,49 @@ static void handleWifiEvent(WiFiEvent_t event, WiFiEventInfo_t info) {
   const WiFiEvent_t kScanDone = (WiFiEvent_t)SYSTEM_EVENT_SCAN_DONE;
 #endif
 
+  WifiEventRecord rec = {WifiEventKind::kScanDone, 0};
   if (event == kStaDisconnected) {
-    lastDisconnectReason = info.wifi_sta_disconnected.reason;
-    wifiState = "backoff";
-    wifiFailCount = min<uint8_t>(wifiFailCount + 1, 6);
-    nextWifiAttemptMs = millis() + computeWifiBackoffMs();
-    wifiConnectStartMs = 0;
-    emitWifiStatus();
-    return;
-  }
-
-  if (event == kStaGotIp) {
-    wifiState = "connected";
-    wifiFailCount = 0;
-    refreshAuthMode();
-    emitWifiStatus();
-    emitAnnounce();
-    return;
-  }
-
-  if (event == kStaConnected) {
-    wifiState = "connecting";
-    emitWifiStatus();
+    rec = {WifiEventKind::kDisconnected, (uint16_t)info.wifi_sta_disconnected.reason};
+  } else if (event == kStaGotIp) {
+    rec.kind = WifiEventKind::kGotIp;
+  } else if (event == kStaConnected) {
+    rec.kind = WifiEventKind::kConnected;
+  } else if (event != kScanDone) {
     return;
   }
+  // A full ring drops the event; the worker still notices the link change
+  // by polling WiFi.isConnected().
+  wifiEventRing.push(rec);
+}
 
-  if (event == kScanDone) {
-    handleWifiScanDone();
+// Worker side of handleWifiEvent(), under the state lock.
+static void drainWifiEvents() {
+  WifiEventRecord rec;
+  while (wifiEventRing.pop(rec)) {
+    switch (rec.kind) {
+      case WifiEventKind::kDisconnected:
+        lastDisconnectReason = rec.reason;
+        wifiState = "backoff";
+        wifiFailCount = min<uint8_t>(wifiFailCount + 1, 6);
+        nextWifiAttemptMs = millis() + computeWifiBackoffMs();
+        wifiConnectStartMs = 0;
+        emitWifiStatus();
+        break;
+      case WifiEventKind::kGotIp:
+        wifiState = "connected";
+        wifiFailCount = 0;
+        refreshAuthMode();
+        emitWifiStatus();
+        emitAnnounce();
+        break;
+      case WifiEventKind::kConnected:
+        wifiState = "connecting";
+        emitWifiStatus();
+        break;
+      case WifiEventKind::kScanDone:
+        handleWifiScanDone();
+        break;
+    }
   }
 }
 
@@ -919,8 +2213,8 @@ static void startCaptivePortal() {
   WiFi.mode(WIFI_AP);
   String apName = "SODS-Node-Setup-" + String((uint32_t)ESP.getEfuseMac(), HEX);
   WiFi.softAP(apName.c_str());
-  server.on("/", HTTP_GET, handlePortalRoot);
-  server.on("/save", HTTP_POST, handlePortalSave);
+  route("/", HTTP_GET, handlePortalRoot);
+  route("/save", HTTP_POST, handlePortalSave);
   if (!serverStarted) {
     server.begin();
     serverStarted = true;
@@ -946,6 +2240,43 @@ static void loadRuntimeConfig() {
   runtimeSsid = prefs.getString("ssid", "");
   runtimePass = prefs.getString("pass", "");
   prefs.end();
+
+  prefs.begin("uplink", true);
+  uplinkMode = prefs.getUChar("mqtt", UPLINK_MQTT) != 0 ? Uplink::kMqtt : Uplink::kHttp;
+  mqttUrl = prefs.getString("mqtt_url", MQTT_URL);
+  prefs.end();
+
+  prefs.begin("udp", true);
+  udpCollector = prefs.getString("collector", UDP_COLLECTOR);
+  prefs.end();
+
+  prefs.begin("ble", true);
+  bleDigestMode = prefs.getUChar("digest", BLE_DIGEST_MODE) != 0;
+  bleDigestWindowMs = prefs.getUInt("window_ms", BLE_DIGEST_WINDOW_MS);
+  prefs.end();
+
+  static const uint8_t kDefaultDrop[kEventClassCount] = {EVENT_CLASS_TELEMETRY_DROP, EVENT_CLASS_STATUS_DROP,
+                                                         EVENT_CLASS_CONTROL_DROP};
+  prefs.begin("queue", true);
+  for (size_t c = 0; c < kEventClassCount; c++) {
+    char key[8];
+    snprintf(key, sizeof(key), "drop%u", (unsigned)c);
+    uint8_t policy = prefs.getUChar(key, kDefaultDrop[c]);
+    if (policy > (uint8_t)DropPolicy::kSample) policy = kDefaultDrop[c];
+    snprintf(key, sizeof(key), "n%u", (unsigned)c);
+    queue.setPolicy((EventClass)c, (DropPolicy)policy, prefs.getUShort(key, EVENT_CLASS_SAMPLE_N));
+  }
+  prefs.end();
+}
+
+// Counts this boot before any event is built. 0 never goes out, so it
+// stays free for events queued by firmware without epochs.
+static void advanceBootEpoch() {
+  prefs.begin("sys", false);
+  bootEpoch = prefs.getUInt("epoch", 0) + 1;
+  if (bootEpoch == 0) bootEpoch = 1;
+  prefs.putUInt("epoch", bootEpoch);
+  prefs.end();
 }
 
 static void ensureWiFi() {
@@ -1019,22 +2350,694 @@ static unsigned long computeBackoffMs() {
   return base + jitter;
 }
 
-static void logBatchIfNeeded(size_t batch) {
-  for (size_t i = 0; i < batch; i++) {
-    EventEntry &entry = queue.at(i);
-    if (!entry.logged) {
-      Serial.println(entry.json);
-      entry.logged = true;
+static void logBatchIfNeeded(EventClass cls, size_t batch) {
+  RecordRing &ring = queue.ring(cls);
+  size_t off = ring.begin();
+  for (size_t i = 0; i < batch && off != RecordRing::npos; i++) {
+    RecordRing::View v = ring.view(off);
+    if (!(v.flags & kEventFlagLogged)) {
+      Serial.write(reinterpret_cast<const uint8_t *>(v.data), v.len);
+      Serial.println();
+      ring.setFlags(off, v.flags | kEventFlagLogged);
+    }
+    off = ring.next(off);
+  }
+}
+
+// Body bytes of the planned records: a bare record, or "[rec,rec,...]".
+static size_t ingestBodyBytes(const RecordRing &ring, const BatchController::Plan &plan) {
+  return plan.count == 1 ? ring.view(plan.first).len : plan.bytes;
+}
+
+#if INGEST_CBOR
+// Transcodes the planned records into one CBOR body. Returns nullptr when a
+// record cannot be transcoded or the result does not fit; the batch then goes
+// out as JSON.
+static const uint8_t *encodeCborBatch(const RecordRing &ring, const BatchController::Plan &plan,
+                                      size_t &bodyBytes) {
+  ingestCbor.begin(plan.count);
+  size_t off = plan.first;
+  for (size_t i = 0; i < plan.count; i++) {
+    if (i > 0) off = ring.after(off);
+    RecordRing::View v = ring.view(off);
+    if (!ingestCbor.add(v.data, v.len)) return nullptr;
+  }
+  size_t n = ingestCbor.finish();
+  if (n == 0) return nullptr;
+  bodyBytes = n;
+  return ingestCborBuf;
+}
+#endif
+
+#if INGEST_COMPRESS
+// gzips the batch body: `body` when it is already in one buffer, else the
+// JSON gathered out of the queue. Returns the compressed body, or nullptr
+// when the body is too small or does not shrink.
+static const uint8_t *compressBatch(const RecordRing &ring, const BatchController::Plan &plan,
+                                    const uint8_t *body, size_t bodyBytes, size_t &wireBytes) {
+  if (bodyBytes < INGEST_COMPRESS_MIN_BYTES) return nullptr;
+  if (!body) {
+    if (plan.count == 1) {
+      memcpy(ingestRawBuf, ring.view(plan.first).data, bodyBytes);
+    } else {
+      RecordBatchReader reader(ring, plan.count, plan.first);
+      reader.read(reinterpret_cast<char *>(ingestRawBuf), bodyBytes);
     }
+    body = ingestRawBuf;
+  }
+  size_t gz = ingestDeflate.gzip(body, bodyBytes, ingestWireBuf, sizeof(ingestWireBuf));
+  if (gz == 0 || gz >= bodyBytes) return nullptr;
+  wireBytes = gz;
+  return ingestWireBuf;
+}
+#endif
+
+static void ingestClose() {
+  if (ingestClient) ingestClient->stop();
+  ingestConnected = false;
+  mqttSessionUp = false;
+  mqttPingPending = false;
+  mqttReader.reset();
+  ingestRxLen = 0;
+  ingestRxPos = 0;
+}
+
+// Re-parses the target only when the configured URL changes.
+static bool ingestPrepareTarget() {
+  if (ingestTargetUrl == ingestUrl) return ingestTargetValid;
+  ingestClose();
+  ingestTargetUrl = ingestUrl;
+  ingestTargetValid = parseHttpUrl(ingestUrl.c_str(), ingestTarget);
+  return ingestTargetValid;
+}
+
+// Opens the ingest connection, to the HTTP server or the MQTT broker.
+static bool ingestOpen(const char *host, uint16_t port, bool tls) {
+  if (tls) {
+    // Same trust model as HTTPClient without a CA bundle.
+    ingestTlsClient.setInsecure();
+    ingestClient = &ingestTlsClient;
+  } else {
+    ingestClient = &ingestPlainClient;
+  }
+  unsigned long start = millis();
+  bool connected;
+  {
+    // A TLS handshake can take seconds.
+    StateUnlock unlocked;
+    connected = ingestClient->connect(host, port, INGEST_TIMEOUT_MS);
+  }
+  if (!connected) {
+    ingestClient->stop();
+    return false;
+  }
+  ingestClient->setNoDelay(true);
+  ingestHandshakeMsTotal += millis() - start;
+  ingestConnOpenCount++;
+  ingestConnected = true;
+  return true;
+}
+
+static bool ingestEnsureConnected(bool &reused) {
+  reused = false;
+  if (ingestConnected && ingestClient->connected() &&
+      millis() - ingestLastUseMs < INGEST_KEEPALIVE_IDLE_MS) {
+    reused = true;
+    return true;
+  }
+  ingestClose();
+  return ingestOpen(ingestTarget.host, ingestTarget.port, ingestTarget.tls);
+}
+
+static bool ingestWrite(const void *data, size_t len) {
+  const uint8_t *p = static_cast<const uint8_t *>(data);
+  while (len > 0) {
+    size_t n = ingestClient->write(p, len);
+    if (n == 0) return false;
+    p += n;
+    len -= n;
+  }
+  return true;
+}
+
+// Writes the planned records as the body after `head`, which shares the
+// first segment. The records are read straight from the queue arena, so they
+// must be held in flight.
+static bool writeQueuedBody(const RecordRing &ring, const BatchController::Plan &plan,
+                            char *chunk, size_t chunkBytes, size_t head) {
+  if (plan.count == 1) {
+    RecordRing::View v = ring.view(plan.first);
+    if (head + v.len <= chunkBytes) {
+      memcpy(chunk + head, v.data, v.len);
+      return ingestWrite(chunk, head + v.len);
+    }
+    return ingestWrite(chunk, head) && ingestWrite(v.data, v.len);
+  }
+  RecordBatchReader reader(ring, plan.count, plan.first);
+  size_t n = head + reader.read(chunk + head, chunkBytes - head);
+  while (n > 0) {
+    if (!ingestWrite(chunk, n)) return false;
+    n = reader.read(chunk, chunkBytes);
+  }
+  return true;
+}
+
+// Writes one POST for the planned records and fills in how `f` went out. A
+// JSON body is streamed out of the queue arena; CBOR and gzip bodies are
+// built in one buffer first. Runs with the state lock released: the records
+// are held in flight, so only pushes can race it, and those never touch them.
+static bool writeIngestBatch(const RecordRing &ring, const BatchController::Plan &plan,
+                             IngestInFlight &f, bool useCbor) {
+  const uint8_t *body = nullptr;
+  f.wireBytes = f.rawBytes;
+  f.cbor = false;
+  f.gzip = false;
+#if INGEST_CBOR
+  if (useCbor) {
+    body = encodeCborBatch(ring, plan, f.wireBytes);
+    f.cbor = body != nullptr;
+  }
+#else
+  (void)useCbor;
+#endif
+#if INGEST_COMPRESS
+  const uint8_t *gzBody = compressBatch(ring, plan, body, f.wireBytes, f.wireBytes);
+  if (gzBody) {
+    body = gzBody;
+    f.gzip = true;
+  }
+#endif
+  char chunk[1024];
+  size_t n = formatPostHead(chunk, sizeof(chunk), ingestTarget,
+                            f.cbor ? "application/cbor" : "application/json",
+                            f.gzip ? "gzip" : nullptr, f.wireBytes);
+  if (n == 0) return false;
+  if (!body) return writeQueuedBody(ring, plan, chunk, sizeof(chunk), n);
+  // A small body shares the head's segment.
+  if (n + f.wireBytes <= sizeof(chunk)) {
+    memcpy(chunk + n, body, f.wireBytes);
+    return ingestWrite(chunk, n + f.wireBytes);
+  }
+  return ingestWrite(chunk, n) && ingestWrite(body, f.wireBytes);
+}
+
+// Returns the HTTP status, or an HTTPC_ERROR_* code on transport failure.
+static int readIngestResponse(HttpResponseParser &parser, unsigned long deadline) {
+  parser.reset();
+  for (;;) {
+    if (ingestRxPos < ingestRxLen) {
+      ingestRxPos += parser.feed(ingestRx + ingestRxPos, ingestRxLen - ingestRxPos);
+      if (parser.done()) return parser.status();
+      if (parser.failed()) return HTTPC_ERROR_NO_HTTP_SERVER;
+      continue;
+    }
+    if (ingestClient->available() > 0) {
+      int n = ingestClient->read(reinterpret_cast<uint8_t *>(ingestRx), sizeof(ingestRx));
+      if (n > 0) {
+        ingestRxLen = (size_t)n;
+        ingestRxPos = 0;
+        continue;
+      }
+    }
+    if (!ingestClient->connected()) {
+      parser.finishOnClose();
+      return parser.done() ? parser.status() : HTTPC_ERROR_CONNECTION_LOST;
+    }
+    if ((long)(millis() - deadline) >= 0) return HTTPC_ERROR_READ_TIMEOUT;
+    delay(1);
+  }
+}
+
+// Number of leading records of batch `f` that `ack` covers: up to and
+// including the one carrying its (epoch, seq), or none when no record does.
+// The batch must be at the front of its class queue.
+static size_t ingestAckedPrefix(const IngestInFlight &f, const EventId &ack) {
+  const RecordRing &ring = queue.ring(f.cls);
+  size_t off = ring.begin();
+  for (size_t i = 0; i < f.count && off != RecordRing::npos; i++) {
+    RecordRing::View v = ring.view(off);
+    EventId id;
+    if (eventRecordId(reinterpret_cast<const char *>(v.data), v.len, id) && id == ack) return i + 1;
+    off = ring.next(off);
+  }
+  return 0;
+}
+
+// Sets the front record of `cls` aside after the server refused it on its
+// own with `status`, so the records behind it go out.
+static void quarantineFront(EventClass cls, int status) {
+  RecordRing::View v = queue.ring(cls).view(queue.ring(cls).begin());
+  QuarantineEntry &q = quarantine[quarantineCount % QUARANTINE_SLOTS];
+  q.ms = millis();
+  q.status = (int16_t)status;
+  q.cls = (uint8_t)cls;
+  q.len = (uint16_t)v.len;
+  q.kept = (uint16_t)min<size_t>(v.len, sizeof(q.event));
+  memcpy(q.event, v.data, q.kept);
+  quarantineCount++;
+  quarantineRun++;
+  queue.pop(cls);
+  queueResidence[cls].onDrop();
+}
+
+// One round on the ingest connection: writes up to INGEST_PIPELINE_DEPTH
+// batches back to back, each from the class queue.pick() chooses, then reads
+// their responses in order and pops what each acknowledges: the whole batch,
+// or the prefix named by ack_epoch/ack_seq (lib/node-core/ingest_ack.h). A
+// batch is held under the state lock, so the drop policies cannot evict its
+// records mid-flight, and the lock is released while it is written straight
+// from the queue arena and while responses are read. Stops at the first failure; responses still
+// pending for later pipelined batches are abandoned with the connection.
+// `retryable` is set when a reused connection failed before any response
+// arrived, i.e. the server had already closed it and nothing was processed.
+// A batch refused for its content is bisected (lib/node-core/ingest_failure.h):
+// while suspects remain at the front of a class, its batches go out one per
+// round, each half the size of the last refused one, and a lone refused
+// record is quarantined. `bisected` is set when the failure was one of these
+// steps, which the caller does not back off from.
+static int ingestExchange(EventClass &failedClass, size_t &failedBatch, unsigned long &failedMs,
+                          bool &retryable, bool &bisected) {
+  retryable = false;
+  bisected = false;
+  failedClass = (EventClass)queue.top();
+  failedBatch = 1;
+  failedMs = 0;
+  bool reused = false;
+  if (!ingestEnsureConnected(reused)) return HTTPC_ERROR_CONNECTION_REFUSED;
+
+  IngestInFlight inflight[INGEST_PIPELINE_DEPTH];
+  size_t sent = 0;
+  int code = 0;
+  while (sent < INGEST_PIPELINE_DEPTH) {
+    // Records queued while the lock was released count too.
+    size_t first[kEventClassCount];
+    uint8_t pending = 0;
+    for (size_t c = 0; c < kEventClassCount; c++) {
+      first[c] = queue.firstUnheld((EventClass)c);
+      if (first[c] == RecordRing::npos) continue;
+      // A bisecting class sends from the front only.
+      if (ingestBisect[c].active(queue.frontSerial((EventClass)c)) &&
+          first[c] != queue.ring((EventClass)c).begin()) {
+        continue;
+      }
+      pending |= 1u << c;
+    }
+    if (!pending) break;
+    IngestInFlight &f = inflight[sent];
+    f.picked = queue.pickState();
+    EventClass cls = (EventClass)queue.pick(pending);
+    const RecordRing &ring = queue.ring(cls);
+    size_t limit = ingestBisect[cls].limit(queue.frontSerial(cls));
+    BatchController::Plan plan = ingestBatch.plan(ring, first[cls], limit > 0 ? limit : (size_t)-1);
+    f.cls = cls;
+    f.count = plan.count;
+    f.rawBytes = ingestBodyBytes(ring, plan);
+    f.sentMs = millis();
+    queue.hold(cls, plan.count);
+    bool useCbor = ingestUseCbor();
+    bool written;
+    {
+      StateUnlock unlocked;
+      written = writeIngestBatch(ring, plan, f, useCbor);
+    }
+    if (f.cbor) ingestCborCount++;
+    if (f.gzip) ingestCompressedCount++;
+    if (!written) {
+      queue.restorePickState(f.picked);
+      code = HTTPC_ERROR_SEND_PAYLOAD_FAILED;
+      break;
+    }
+    sent++;
+  }
+  if (sent == 0) {
+    queue.releaseHolds();
+    retryable = reused;
+    ingestClose();
+    return code;
+  }
+  if (reused) {
+    ingestConnReuseCount++;
+    if (ingestConnOpenCount > 0) ingestHandshakeSavedMs += ingestHandshakeMsTotal / ingestConnOpenCount;
+  }
+  if (sent > 1) ingestPipelinedCount += sent - 1;
+
+  HttpResponseParser parser;
+  // Classes with records left unacknowledged ahead of a later batch. That
+  // batch is no longer at the front of its queue, so it stays queued even if
+  // acknowledged and goes out again; the server drops the repeats by
+  // (node_id, epoch, seq).
+  uint8_t blocked = 0;
+  for (size_t i = 0; i < sent; i++) {
+    IngestInFlight &f = inflight[i];
+    int status;
+    {
+      StateUnlock unlocked;
+      status = readIngestResponse(parser, millis() + INGEST_TIMEOUT_MS);
+    }
+    unsigned long ms = millis() - f.sentMs;
+    const bool ok = status >= 200 && status < 300;
+    const bool heldBack = blocked & (1u << f.cls);
+    size_t acked = ok ? f.count : 0;
+    EventId ack;
+    if (heldBack) {
+      acked = 0;
+    } else if (status > 0 && parseIngestAck(parser.body(), parser.bodyLen(), ack)) {
+      acked = ingestAckedPrefix(f, ack);
+    }
+    unsigned long ackMs = millis();
+    for (size_t r = 0; r < acked; r++) {
+      queue.pop(f.cls);
+      queueResidence[f.cls].onPop(ackMs, queueResidenceHist);
+    }
+    ingestAckedCount += acked;
+    if (!ok) {
+      retryable = reused && i == 0 && status < 0 && !parser.started();
+#if INGEST_CBOR
+      if (status == 415 && f.cbor) ingestCborRejected = true;  // resent as JSON
+#endif
+      failedClass = f.cls;
+      failedBatch = f.count - acked;
+      failedMs = ms;
+      queue.restorePickState(f.picked);
+      queue.releaseHolds();
+      ingestClose();
+      if (ingestStatusBlamesRecords(status) && !heldBack && failedBatch > 0) {
+        if (quarantineRun < QUARANTINE_MAX_RUN) {
+          bisected = true;
+          if (ingestBisect[f.cls].onRefused(queue.frontSerial(f.cls), failedBatch)) {
+            quarantineFront(f.cls, status);
+          }
+        } else {
+          // Refusing this much is no longer about single records.
+          ingestBisect[f.cls].reset();
+        }
+      }
+      return status;
+    }
+    if (acked > 0) quarantineRun = 0;
+    if (acked < f.count) blocked |= 1u << f.cls;
+    if (acked < f.count && !heldBack) {
+      // The server stored only part of the batch; send less next time. The
+      // rest goes out in the next round.
+      ingestPartialAckCount++;
+      ingestBatch.onFailure();
+    } else {
+      ingestBatch.onSuccess(f.count, ms, queue.count());
+    }
+    ingestPostHist.record(ms);
+    ingestRawBytesTotal += f.rawBytes;
+    ingestWireBytesTotal += f.wireBytes;
+    ingestOkCount++;
+    failCount = 0;
+    markIngestOk();
+    if (lastIngestErr.length() > 0 || (millis() - lastIngestOkEventMs) > 60000) {
+      emitIngestOk(f, ms);
+    }
+  }
+  queue.releaseHolds();
+  ingestLastUseMs = millis();
+  if (code != 0 || !parser.keepAlive()) ingestClose();
+  return code != 0 ? code : 200;
+}
+
+// Re-parses the broker URL only when it changes.
+static bool mqttPrepareTarget() {
+  if (mqttTargetUrl == mqttUrl) return mqttTargetValid;
+  ingestClose();
+  mqttTargetUrl = mqttUrl;
+  mqttTargetValid = parseMqttUrl(mqttUrl.c_str(), mqttTarget);
+  return mqttTargetValid;
+}
+
+// Reads the next broker packet into mqttReader, resuming one that arrived
+// in part. Returns 0, or an HTTPC_ERROR_* code; with `deadline` now it only
+// takes what has already arrived.
+static int readMqttPacket(unsigned long deadline) {
+  if (mqttReader.done()) mqttReader.reset();
+  for (;;) {
+    if (ingestRxPos < ingestRxLen) {
+      ingestRxPos += mqttReader.feed(reinterpret_cast<const uint8_t *>(ingestRx) + ingestRxPos,
+                                     ingestRxLen - ingestRxPos);
+      if (mqttReader.done()) return 0;
+      if (mqttReader.failed()) return HTTPC_ERROR_NO_HTTP_SERVER;
+      continue;
+    }
+    if (ingestClient->available() > 0) {
+      int n = ingestClient->read(reinterpret_cast<uint8_t *>(ingestRx), sizeof(ingestRx));
+      if (n > 0) {
+        ingestRxLen = (size_t)n;
+        ingestRxPos = 0;
+        continue;
+      }
+    }
+    if (!ingestClient->connected()) return HTTPC_ERROR_CONNECTION_LOST;
+    if ((long)(millis() - deadline) >= 0) return HTTPC_ERROR_READ_TIMEOUT;
+    delay(1);
+  }
+}
+
+static const char *mqttReadError(int rc) {
+  return rc == HTTPC_ERROR_READ_TIMEOUT ? "mqtt_timeout"
+         : rc == HTTPC_ERROR_CONNECTION_LOST ? "mqtt_conn_lost"
+                                              : "mqtt_protocol";
+}
+
+// Opens the broker session when there is none: connect, CONNECT with a
+// clean session, CONNACK. Returns nullptr once it is up, or the error.
+static const char *mqttEnsureSession() {
+  if (mqttSessionUp && ingestClient->connected()) return nullptr;
+  ingestClose();
+  if (!ingestOpen(mqttTarget.host, mqttTarget.port, mqttTarget.tls)) return "mqtt_connect_failed";
+  uint8_t packet[192];
+  size_t n = mqttConnect(packet, sizeof(packet), nodeId.c_str(), mqttTarget.user, mqttTarget.pass,
+                         MQTT_KEEPALIVE_S);
+  int rc = HTTPC_ERROR_SEND_HEADER_FAILED;
+  if (n > 0) {
+    StateUnlock unlocked;
+    if (ingestWrite(packet, n)) rc = readMqttPacket(millis() + INGEST_TIMEOUT_MS);
+  }
+  if (rc != 0) {
+    ingestClose();
+    return rc == HTTPC_ERROR_SEND_HEADER_FAILED ? "mqtt_write_failed" : mqttReadError(rc);
+  }
+  if (mqttReader.type() != kMqttConnack || mqttReader.connackCode() != 0) {
+    ingestClose();
+    return "mqtt_connack_refused";
+  }
+  mqttSessionUp = true;
+  ingestLastUseMs = millis();
+  return nullptr;
+}
+
+// Keeps an idle session open between rounds: reads what the broker sent
+// and pings it once half the keep-alive interval has passed without
+// traffic. A ping left unanswered for the whole interval ends the session.
+static void mqttKeepAlive() {
+  if (!mqttSessionUp) return;
+  int rc;
+  while ((rc = readMqttPacket(millis())) == 0) {
+    if (mqttReader.type() == kMqttPingresp) mqttPingPending = false;
+  }
+  if (rc != HTTPC_ERROR_READ_TIMEOUT) {
+    ingestClose();
+    return;
+  }
+  unsigned long idle = millis() - ingestLastUseMs;
+  if (mqttPingPending) {
+    if (idle >= MQTT_KEEPALIVE_S * 1000UL) ingestClose();
+    return;
+  }
+  if (idle < MQTT_KEEPALIVE_S * 500UL) return;
+  uint8_t ping[2];
+  size_t n = mqttPingreq(ping, sizeof(ping));
+  bool written;
+  {
+    StateUnlock unlocked;
+    written = ingestWrite(ping, n);
+  }
+  if (!written) {
+    ingestClose();
+    return;
   }
+  mqttPingPending = true;
+  mqttPingCount++;
+  ingestLastUseMs = millis();
+}
+
+// Writes one QoS 1 PUBLISH of the planned records. Runs with the state lock
+// released, like writeIngestBatch().
+static bool writeMqttPublish(const RecordRing &ring, const BatchController::Plan &plan,
+                             const char *topic, uint16_t packetId, size_t len) {
+  uint8_t chunk[1024];
+  size_t n = mqttPublishHead(chunk, sizeof(chunk), topic, packetId, len);
+  if (n == 0) return false;
+  return writeQueuedBody(ring, plan, reinterpret_cast<char *>(chunk), sizeof(chunk), n);
+}
+
+// One round on the broker session. Keeps up to MQTT_INFLIGHT batches
+// published and awaiting PUBACK, topping the window up as each is
+// acknowledged, for at most 4 * MQTT_INFLIGHT batches. A broker sends QoS 1
+// PUBACKs in publish order, so each acknowledges the oldest batch in
+// flight, which is popped as after an HTTP 2xx. Batches are held under the
+// state lock as in ingestExchange(), and the lock is released for socket
+// I/O. Payloads are the batch as queued: JSON, since
+// an MQTT 3.1.1 PUBLISH has no content type to announce CBOR or gzip. Any
+// failure ends the session; the batches in flight go out again on the next
+// one and the server drops the repeats by (node_id, epoch, seq). Returns
+// nullptr, or the error for ingest.err.
+static const char *mqttExchange(EventClass &failedClass, size_t &failedBatch, unsigned long &failedMs) {
+  failedClass = (EventClass)queue.top();
+  failedBatch = 1;
+  failedMs = 0;
+  const char *err = mqttEnsureSession();
+  if (err) return err;
+
+  IngestInFlight window[MQTT_INFLIGHT];
+  uint16_t ids[MQTT_INFLIGHT];
+  size_t head = 0;
+  size_t inFlight = 0;
+  size_t published = 0;
+  for (;;) {
+    while (inFlight < MQTT_INFLIGHT && published < 4 * MQTT_INFLIGHT) {
+      uint8_t pending = 0;
+      for (size_t c = 0; c < kEventClassCount; c++) {
+        if (queue.firstUnheld((EventClass)c) != RecordRing::npos) pending |= 1u << c;
+      }
+      if (!pending) break;
+      size_t slot = (head + inFlight) % MQTT_INFLIGHT;
+      IngestInFlight &f = window[slot];
+      f.picked = queue.pickState();
+      EventClass cls = (EventClass)queue.pick(pending);
+      const RecordRing &ring = queue.ring(cls);
+      BatchController::Plan plan = ingestBatch.plan(ring, queue.firstUnheld(cls));
+      f.cls = cls;
+      f.count = plan.count;
+      f.rawBytes = ingestBodyBytes(ring, plan);
+      f.wireBytes = f.rawBytes;
+      f.cbor = false;
+      f.gzip = false;
+      f.sentMs = millis();
+      queue.hold(cls, plan.count);
+      if (++mqttPacketId == 0) mqttPacketId = 1;
+      ids[slot] = mqttPacketId;
+      char topic[160];
+      snprintf(topic, sizeof(topic), "%s/%s/%s", mqttTarget.prefix, nodeId.c_str(), eventClassName(cls));
+      bool written;
+      {
+        StateUnlock unlocked;
+        written = writeMqttPublish(ring, plan, topic, ids[slot], f.rawBytes);
+      }
+      if (!written) {
+        err = "mqtt_write_failed";
+        break;
+      }
+      inFlight++;
+      published++;
+      mqttPublishCount++;
+      if (inFlight > mqttInflightPeak) mqttInflightPeak = inFlight;
+    }
+    if (err || inFlight == 0) break;
+
+    int rc;
+    {
+      StateUnlock unlocked;
+      rc = readMqttPacket(millis() + INGEST_TIMEOUT_MS);
+    }
+    if (rc != 0) {
+      err = mqttReadError(rc);
+      break;
+    }
+    if (mqttReader.type() == kMqttPingresp) {
+      mqttPingPending = false;
+      continue;
+    }
+    if (mqttReader.type() != kMqttPuback || mqttReader.packetId() != ids[head]) {
+      err = "mqtt_protocol";
+      break;
+    }
+    IngestInFlight &f = window[head];
+    unsigned long ackMs = millis();
+    unsigned long ms = ackMs - f.sentMs;
+    for (size_t r = 0; r < f.count; r++) {
+      queue.pop(f.cls);
+      queueResidence[f.cls].onPop(ackMs, queueResidenceHist);
+    }
+    ingestAckedCount += f.count;
+    ingestBatch.onSuccess(f.count, ms, queue.count());
+    ingestPostHist.record(ms);
+    ingestRawBytesTotal += f.rawBytes;
+    ingestWireBytesTotal += f.wireBytes;
+    ingestOkCount++;
+    mqttFailCount = 0;
+    markIngestOk();
+    if (lastIngestErr.length() > 0 || (millis() - lastIngestOkEventMs) > 60000) {
+      emitIngestOk(f, ms);
+    }
+    ingestLastUseMs = ackMs;
+    head = (head + 1) % MQTT_INFLIGHT;
+    inFlight--;
+  }
+  if (err) {
+    // The oldest batch not acknowledged, or the one that failed to go out.
+    const IngestInFlight &f = window[head];
+    failedClass = f.cls;
+    failedBatch = f.count;
+    failedMs = millis() - f.sentMs;
+    queue.restorePickState(f.picked);
+    ingestClose();
+  }
+  queue.releaseHolds();
+  return err;
+}
+
+static void recordIngestErr(const String &err, unsigned long ms) {
+  ingestErrCount++;
+  markIngestErr(err);
+  if (lastIngestErr.length() == 0 || lastIngestErr != err ||
+      (millis() - lastIngestErrEventMs) > 60000) {
+    emitIngestErr(err, ms);
+  }
+}
+
+// The MQTT uplink's part of trySendQueued(). After a failed round, the next
+// session opens after the Wi-Fi reconnect backoff (retryBackoffMs()).
+static void trySendMqtt(EventClass front) {
+  EventClass cls = front;
+  size_t batch = 1;
+  unsigned long ms = 0;
+  const char *err = nullptr;
+  if (!WiFi.isConnected()) {
+    ingestClose();
+  } else if (!mqttPrepareTarget()) {
+    err = mqttUrl.length() == 0 ? "mqtt_url_missing" : "mqtt_url_invalid";
+    markIngestErr(err);
+  } else {
+    err = mqttExchange(cls, batch, ms);
+    if (!err) return;
+    ingestFailCounts[(size_t)IngestFailure::kTransport]++;
+    recordIngestErr(err, ms);
+  }
+  logBatchIfNeeded(cls, batch);
+  mqttFailCount = min<uint8_t>(mqttFailCount + 1, 6);
+  nextSendAtMs = millis() + retryBackoffMs(mqttFailCount);
 }
 
 static void trySendQueued() {
+  if (uplinkActive != uplinkMode) {
+    ingestClose();
+    uplinkActive = uplinkMode;
+  }
+  if (uplinkActive == Uplink::kMqtt && WiFi.isConnected()) mqttKeepAlive();
   if (queue.empty()) return;
   if (millis() < nextSendAtMs) return;
+  EventClass front = (EventClass)queue.top();
+  if (uplinkActive == Uplink::kMqtt) {
+    trySendMqtt(front);
+    return;
+  }
 
   if (ingestUrl.length() == 0) {
-    logBatchIfNeeded(1);
+    logBatchIfNeeded(front, 1);
     failCount = min<uint8_t>(failCount + 1, 6);
     nextSendAtMs = millis() + computeBackoffMs();
     markIngestErr("ingest_url_missing");
@@ -1042,148 +3045,397 @@ static void trySendQueued() {
   }
 
   if (!WiFi.isConnected()) {
-    logBatchIfNeeded(1);
+    ingestClose();
+    logBatchIfNeeded(front, 1);
     nextSendAtMs = millis() + computeBackoffMs();
     failCount = min<uint8_t>(failCount + 1, 6);
     return;
   }
 
-  size_t batch = min(queue.size(), (size_t)INGEST_BATCH_SIZE);
-  String payload;
-  if (batch <= 1) {
-    payload = queue.front().json;
-  } else {
-    payload = "[";
-    for (size_t i = 0; i < batch; i++) {
-      if (i > 0) payload += ",";
-      payload += queue.at(i).json;
-    }
-    payload += "]";
+  if (!ingestPrepareTarget()) {
+    logBatchIfNeeded(front, 1);
+    failCount = min<uint8_t>(failCount + 1, 6);
+    nextSendAtMs = millis() + computeBackoffMs();
+    markIngestErr("ingest_url_invalid");
+    return;
   }
 
-  HTTPClient http;
-  http.setTimeout(INGEST_TIMEOUT_MS);
-  http.begin(ingestUrl);
-  http.addHeader("Content-Type", "application/json");
-  unsigned long start = millis();
-  int code = http.POST(payload);
-  unsigned long ms = millis() - start;
-  bool ok = (code >= 200 && code < 300);
-  http.end();
+  EventClass cls = front;
+  size_t batch = 1;
+  unsigned long ms = 0;
+  bool retryable = false;
+  bool bisected = false;
+  int code = ingestExchange(cls, batch, ms, retryable, bisected);
+  if (retryable && !queue.empty()) {
+    ingestStaleRetryCount++;
+    code = ingestExchange(cls, batch, ms, retryable, bisected);
+  }
+  if (code >= 200 && code < 300) return;
 
-  if (ok) {
-    for (size_t i = 0; i < batch; i++) {
-      queue.pop();
-    }
-    failCount = 0;
-    ingestOkCount++;
-    markIngestOk();
-    if (lastIngestErr.length() > 0 || (millis() - lastIngestOkEventMs) > 60000) {
-      emitIngestOk((uint32_t)batch, ms);
-    }
-  } else {
-    logBatchIfNeeded(batch);
+  ingestFailCounts[(size_t)classifyIngestStatus(code)]++;
+  logBatchIfNeeded(cls, batch);
+  if (!bisected) {
+    ingestBatch.onFailure();
     failCount = min<uint8_t>(failCount + 1, 6);
     nextSendAtMs = millis() + computeBackoffMs();
-    ingestErrCount++;
-    String err = String(code);
-    markIngestErr(err);
-    if (lastIngestErr.length() == 0 || lastIngestErr != err ||
-        (millis() - lastIngestErrEventMs) > 60000) {
-      emitIngestErr(err, ms);
+  }
+  recordIngestErr(String(code), ms);
+}
+
+// Looks up the UDP collector for flushUdpTelemetry(): once, and again after
+// a failed send, at most once a WIFI_RETRY_BASE_MS. The state lock is
+// released around the lookup; an answer for a collector /udp replaced
+// meanwhile is dropped.
+static void resolveUdpCollector() {
+  if (!udpTelemetryOn() || udpResolved || (long)(millis() - udpResolveAtMs) < 0 || !WiFi.isConnected()) {
+    return;
+  }
+  char host[sizeof(udpHost)];
+  memcpy(host, udpHost, sizeof(host));
+  IPAddress addr;
+  bool ok;
+  {
+    StateUnlock unlocked;
+    ok = WiFi.hostByName(host, addr) == 1;
+  }
+  if (strcmp(host, udpHost) != 0 || udpResolved) return;
+  if (ok) {
+    udpAddr = addr;
+    udpResolved = true;
+  } else {
+    udpResolveAtMs = millis() + WIFI_RETRY_BASE_MS;
+  }
+}
+
+// Network stage: resolveUdpCollector() and one trySendQueued() under the
+// state lock, which both release around socket I/O. True when it delivered events and more are waiting, so
+// the caller can go again right away.
+static bool runNetStage() {
+  StateLock lock;
+  resolveUdpCollector();
+  uint32_t startUs = micros();
+  uint32_t acked = ingestAckedCount;
+  trySendQueued();
+  acked = ingestAckedCount - acked;
+  pipeMeters[kPipeNet].add(micros() - startUs, acked);
+  pipeMeters[kPipeNet].setCore(xPortGetCoreID());
+  return acked > 0 && !queue.empty();
+}
+
+#if PIPELINE_NET_TASK
+static void netTaskMain(void *) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(PIPELINE_NET_IDLE_MS));
+    while (runNetStage()) {
     }
   }
 }
+#endif
 
-static bool bleMatches(const BleObservation &obs, const String &mac, uint8_t advFlags) {
-  if (obs.mac != mac) return false;
-  if (obs.adv_flags != advFlags) return false;
-  return true;
+// Devices with stable material are keyed by fp_stable, so a device rotating
+// its random address keeps one entry; the entry tracks the latest address.
+static BleDeviceEntry &recordBleObservation(uint64_t key, const BleRawObservation &raw,
+                                            const BleAdvSummary &adv, const uint8_t *fpStable,
+                                            bool &inserted) {
+  BleDeviceEntry &obs = *bleTable.upsert(key, inserted);
+  if (inserted) {
+    obs.has_fp = fpStable != nullptr;
+    if (fpStable) memcpy(obs.fp_stable, fpStable, sizeof(obs.fp_stable));
+  } else if (memcmp(obs.addr, raw.addr, sizeof(obs.addr)) != 0 || obs.addr_type != raw.addr_type) {
+    bleAddrRotationCount++;
+  }
+  memcpy(obs.addr, raw.addr, sizeof(obs.addr));
+  obs.addr_type = raw.addr_type;
+  if (bleDigestMode) {
+    bleDigestObserve(obs, raw.rssi, adv.flags, adv.svc_count, raw.ts_ms);
+  }
+  if (!inserted && obs.adv_flags == adv.flags && raw.ts_ms - obs.last_seen_ms <= BLE_DEDUPE_MS) {
+    obs.rssi = raw.rssi;
+    obs.last_seen_ms = raw.ts_ms;
+    obs.seen_count++;
+    bleDedupeCount++;
+    return obs;
+  }
+  obs.rssi = raw.rssi;
+  obs.mfg_len = adv.mfg_len;
+  obs.svc_count = adv.svc_count;
+  obs.adv_flags = adv.flags;
+  obs.name_len = adv.name_len < kBleNameMax ? adv.name_len : kBleNameMax;
+  if (obs.name_len > 0) memcpy(obs.name, adv.name, obs.name_len);
+  obs.last_seen_ms = raw.ts_ms;
+  obs.seen_count++;
+  return obs;
 }
 
-static void recordBleObservation(const String &mac, const String &name, int rssi,
-                                 uint8_t svcCount, uint8_t mfgLen, uint8_t advFlags) {
-  unsigned long now = millis();
-  for (size_t i = 0; i < bleRingCount; i++) {
-    size_t idx = (bleRingHead + BLE_OBS_CAPACITY - 1 - i) % BLE_OBS_CAPACITY;
-    BleObservation &obs = bleRing[idx];
-    if (obs.mac.length() == 0) continue;
-    if (bleMatches(obs, mac, advFlags)) {
-      if (now - obs.last_seen_ms <= BLE_DEDUPE_MS) {
-        obs.rssi = rssi;
-        obs.last_seen_ms = now;
-        obs.seen_count++;
-        bleDedupeCount++;
-        return;
-      }
-      obs.rssi = rssi;
-      obs.name = name;
-      obs.svc_count = svcCount;
-      obs.mfg_len = mfgLen;
-      obs.adv_flags = advFlags;
-      obs.last_seen_ms = now;
-      obs.seen_count++;
-      return;
+#if BLE_COALESCE
+// Folds the event into the device's queued ble.seen while that one is still
+// unsent: the record is rewritten with the latest RSSI and time, the RSSI
+// range and the count, keeping its seq. Otherwise the event is queued with
+// BLE_COALESCE_SLACK_BYTES of trailing spaces so it has room to grow.
+static bool commitBleSeen(uint64_t key, BleSeenEvent &ev) {
+  static_assert(eventJsonMax(kBleSeenEvent) + BLE_COALESCE_SLACK_BYTES < EVENT_MAX_BYTES,
+                "ble.seen and its slack can outgrow EVENT_MAX_BYTES");
+  char buf[EVENT_MAX_BYTES];
+  uint32_t ts = (uint32_t)(esp_timer_get_time() / 1000ULL);
+  bool inserted = false;
+  BleQueuedSeen &q = *bleQueued.upsert(key, inserted);
+  if (!inserted && queue.editable(kEventTelemetry, q.ref)) {
+    ev.count.set(q.count + 1);
+    ev.rssi_min.set(min<int32_t>(q.rssiMin, ev.rssi));
+    ev.rssi_max.set(max<int32_t>(q.rssiMax, ev.rssi));
+    EventEnvelope env = {EVENT_SCHEMA_VERSION, ts, eventText(nodeId), q.seq, bootEpoch};
+    JsonWriter w(buf, sizeof(buf));
+    if (eventEncodeJson(w, kBleSeenEvent, env, &ev) &&
+        queue.rewrite(kEventTelemetry, q.ref, w.c_str(), w.size())) {
+      q.count++;
+      q.rssiMin = (int8_t)ev.rssi_min.value;
+      q.rssiMax = (int8_t)ev.rssi_max.value;
+      bleCoalescedCount++;
+      return true;
     }
+    // Grown past its slack: start a new event.
+  }
+  ev.count.set(1);
+  ev.rssi_min.set(ev.rssi);
+  ev.rssi_max.set(ev.rssi);
+  EventEnvelope env = {EVENT_SCHEMA_VERSION, ts, eventText(nodeId), ++eventSeq, bootEpoch};
+  JsonWriter w(buf, sizeof(buf));
+  if (!eventEncodeJson(w, kBleSeenEvent, env, &ev)) {
+    eventOversizeCount++;
+    bleQueued.erase(key);
+    return false;
+  }
+  size_t len = w.size();
+  memset(buf + len, ' ', BLE_COALESCE_SLACK_BYTES);
+  uint32_t before = queue.lastPushed(kEventTelemetry).serial;
+  bool queued = enqueueEvent(buf, len + BLE_COALESCE_SLACK_BYTES, kEventTelemetry);
+  EventQueues::Ref ref = queue.lastPushed(kEventTelemetry);
+  if (!queued || ref.serial == before) {
+    // Spilled or dropped, so there is nothing to fold into.
+    bleQueued.erase(key);
+    return queued;
+  }
+  q = BleQueuedSeen{ref, eventSeq, 1, (int8_t)ev.rssi, (int8_t)ev.rssi};
+  return true;
+}
+#endif
+
+// Hands the pending observations to the stack as one datagram. That does
+// not wait on the network, so it runs under the state lock: the address is
+// the one resolveUdpCollector() cached, and a datagram sent before there is
+// one counts as a send error. A failed send has the name resolved again.
+static void flushUdpTelemetry() {
+  size_t len = udpPacker.finish(millis());
+  if (len == 0) return;
+  if (udpResolved && udpOut.beginPacket(udpAddr, udpPort) && udpOut.write(udpBuf, len) == len &&
+      udpOut.endPacket()) {
+    udpDatagramCount++;
+    return;
+  }
+  udpSendErrCount++;
+  if (udpResolved) {
+    udpResolved = false;
+    udpResolveAtMs = millis() + WIFI_RETRY_BASE_MS;
+  }
+}
+
+static void udpTelemetryObserve(const BleRawObservation &raw, uint8_t flags) {
+  if (!WiFi.isConnected()) {
+    udpPacker.skip();
+    udpSkippedCount++;
+    return;
   }
+  if (!udpPacker.add(raw.addr, raw.addr_type, raw.rssi, flags, raw.ts_ms)) {
+    flushUdpTelemetry();
+    udpPacker.add(raw.addr, raw.addr_type, raw.rssi, flags, raw.ts_ms);
+  }
+}
+
+// Sends a partly filled datagram once its oldest observation has waited
+// UDP_FLUSH_MS, or drops it when Wi-Fi went away meanwhile.
+static void serviceUdpTelemetry() {
+  if (udpPacker.pending() == 0) return;
+  if (!WiFi.isConnected()) {
+    udpSkippedCount += udpPacker.pending();
+    udpPacker.discard();
+  } else if (millis() - udpPacker.oldestMs() >= UDP_FLUSH_MS) {
+    flushUdpTelemetry();
+  }
+}
+
+// Consumer side of the NimBLE handoff, in two steps on the worker.
+// prepareBleObservation() parses and fingerprints an advert with the state
+// lock released: it only reads the advert. processBleObservation() then
+// applies it under the lock, which every task touching the observation
+// table, rate limiter, eventSeq or the event queue takes first.
+struct BleDrainItem {
+  BleRawObservation raw;
+  BleAdvSummary adv;
+  bool hasFp;
+  uint8_t fpStable[Sha256::kDigestBytes];
+};
+
+static void prepareBleObservation(BleDrainItem &item) {
+  bleParseAdv(item.raw.payload, item.raw.payload_len, item.adv);
+  item.hasFp = false;
+#if BLE_FINGERPRINT
+  item.hasFp = bleStableFingerprint(item.raw.payload, item.raw.payload_len, item.adv, item.fpStable);
+#endif
+}
 
-  BleObservation &slot = bleRing[bleRingHead];
-  if (bleRingCount == BLE_OBS_CAPACITY) {
-    bleRingOverwriteCount++;
+static void processBleObservation(const BleDrainItem &item) {
+  const BleRawObservation &raw = item.raw;
+  const BleAdvSummary &adv = item.adv;
+  const uint8_t *fpStable = item.fpStable;
+  const bool hasFp = item.hasFp;
+  lastBleResultMs = raw.ts_ms;
+#if BLE_FINGERPRINT
+  if (hasFp) bleFpCount++;
+#endif
+  // Every advert updates the table; only admitted ones become events.
+  uint64_t key = hasFp ? bleFingerprintKey(fpStable) : bleAddrKey(raw.addr, raw.addr_type);
+  bool inserted = false;
+  BleDeviceEntry &dev = recordBleObservation(key, raw, adv, hasFp ? fpStable : nullptr, inserted);
+  if (udpTelemetryOn()) udpTelemetryObserve(raw, adv.flags);
+  if (bleDigestMode) {
+    return;
+  }
+  if (udpTelemetryOn() && !UDP_MIRROR_HTTP) {
+    return;  // the collector has it
+  }
+  if (!bleSampler.admit(dev, inserted, raw.ts_ms)) {
+    return;
+  }
+  bleSeenCount++;
+
+  BleSeenEvent ev;
+  memcpy(ev.addr.b, raw.addr, 6);
+  ev.rssi = raw.rssi;
+  ev.addr_type = eventText(bleAddrTypeName(raw.addr_type));
+  setVendorId(ev.vendor_id, bleVendorId(raw.addr, raw.addr_type));
+  ev.flags = adv.flags;
+#if BLE_FINGERPRINT
+  if (hasFp) {
+    memcpy(ev.fp_stable.value.b, fpStable, Sha256::kDigestBytes);
+    ev.fp_stable.state = EventPresence::kSet;
   } else {
-    bleRingCount++;
+    ev.fp_stable.setNull();
   }
-  slot.mac = mac;
-  slot.name = name;
-  slot.rssi = rssi;
-  slot.mfg_len = mfgLen;
-  slot.svc_count = svcCount;
-  slot.adv_flags = advFlags;
-  slot.last_seen_ms = now;
-  slot.seen_count = 1;
-  bleRingHead = (bleRingHead + 1) % BLE_OBS_CAPACITY;
+  bleAddrFingerprint(raw.addr, raw.addr_type, ev.fp_addr.value.b);
+  ev.fp_addr.state = EventPresence::kSet;
+#endif
+#if BLE_COALESCE
+  commitBleSeen(key, ev);
+#else
+  (void)key;
+  commitEvent(ev);
+#endif
 }
 
-class AdvertisedCallback : public NimBLEAdvertisedDeviceCallbacks {
-  void onResult(NimBLEAdvertisedDevice *device) override {
-    unsigned long now = millis();
-    lastBleResultMs = now;
-    if (now - bleSecondStart >= 1000) {
-      bleSecondStart = now;
-      bleCountThisSecond = 0;
-    }
-    if (bleCountThisSecond >= BLE_MAX_PER_SECOND) {
-      return;
-    }
-    bleCountThisSecond++;
-    bleSeenCount++;
-
-    String addr = device->getAddress().toString().c_str();
-    addr.toLowerCase();
-    String addrType = "unknown";
-    switch (device->getAddressType()) {
-      case BLE_ADDR_PUBLIC: addrType = "public"; break;
-      case BLE_ADDR_RANDOM: addrType = "random"; break;
-      default: break;
-    }
+static void beginBleDigest(JsonWriter &devices) {
+  devices.reset();
+  devices.beginArray();
+}
+
+static void commitBleDigest(JsonWriter &devices, unsigned long now, uint32_t part) {
+  devices.endArray();
+  if (devices.overflowed()) {
+    eventOversizeCount++;
+    return;
+  }
+  BleDigestEvent ev;
+  ev.window_start_ms = bleDigestWindowStart;
+  ev.window_ms = now - bleDigestWindowStart;
+  ev.part = part;
+  ev.devices = EventRaw{devices.c_str(), devices.size()};
+  if (commitEvent(kBleDigestEvent, &ev, bleDigestBuf, sizeof(bleDigestBuf))) bleDigestEventCount++;
+}
 
-    String name = device->getName().c_str();
-    uint8_t advFlags = device->getAdvFlags();
-    uint8_t svcCount = device->getServiceUUIDCount();
-    uint8_t mfgLen = (uint8_t)device->getManufacturerData().length();
+// Reports every device heard during the window, most recently seen first,
+// split over as many ble.digest events as BLE_DIGEST_EVENT_BYTES requires.
+static void emitBleDigest(unsigned long now) {
+  JsonWriter w(bleDigestDevicesBuf, sizeof(bleDigestDevicesBuf));
+  uint32_t part = 0;
+  size_t inEvent = 0;
+  for (uint16_t h = bleTable.front(); h != bleTable.npos; h = bleTable.next(h)) {
+    BleDeviceEntry &dev = bleTable.at(h);
+    if (!bleDigestPending(dev)) continue;
+    if (inEvent == 0) beginBleDigest(w);
+    JsonWriter::Mark before = w.mark();
+    bleDigestWriteDevice(w, dev, bleDigestWindowStart);
+    // Leave room to close the array.
+    if ((w.overflowed() || w.remaining() < 1) && inEvent > 0) {
+      w.rewind(before);
+      commitBleDigest(w, now, part);
+      part++;
+      beginBleDigest(w);
+      inEvent = 0;
+      bleDigestWriteDevice(w, dev, bleDigestWindowStart);
+    }
+    inEvent++;
+    bleDigestDeviceCount++;
+    bleDigestReset(dev);
+  }
+  if (inEvent > 0) commitBleDigest(w, now, part);
+  bleDigestWindowStart = now;
+}
 
-    recordBleObservation(addr, name, device->getRSSI(), svcCount, mfgLen, advFlags);
+static void serviceBleDigest() {
+  if (!bleDigestMode) return;
+  unsigned long now = millis();
+  if (now - bleDigestWindowStart < bleDigestWindowMs) return;
+  emitBleDigest(now);
+}
 
-    String data = "{";
-    data += jsonKV("addr", addr);
-    data += "," + jsonKV("rssi", String(device->getRSSI()), false);
-    data += "," + jsonKV("addr_type", addrType);
-    data += "," + jsonKV("flags", String(advFlags), false);
-    data += "}";
+// Adverts taken off the raw ring per lock hold.
+static const size_t kBleDrainBatch = 16;
+static BleDrainItem bleDrainItems[kBleDrainBatch];
+
+// Drains up to BLE_DRAIN_PER_LOOP adverts a batch at a time: prepared with
+// the state lock released, then applied in one WorkerSlice. The last slice
+// also sends an aged UDP telemetry datagram.
+static void drainBleObservations(uint32_t &busyUs) {
+  size_t drained = 0;
+  size_t n;
+  do {
+    uint32_t startUs = micros();
+    n = 0;
+    while (n < kBleDrainBatch && drained < BLE_DRAIN_PER_LOOP && bleRawRing.pop(bleDrainItems[n].raw)) {
+      prepareBleObservation(bleDrainItems[n]);
+      n++;
+      drained++;
+    }
+    busyUs += micros() - startUs;
+    LOOP_PROFILE_LAP(kStageBleDrain);
+    WorkerSlice slice(busyUs);
+    for (size_t i = 0; i < n; i++) processBleObservation(bleDrainItems[i]);
+    if (n < kBleDrainBatch || drained == BLE_DRAIN_PER_LOOP) serviceUdpTelemetry();
+    LOOP_PROFILE_LAP(kStageBleDrain);
+  } while (n == kBleDrainBatch && drained < BLE_DRAIN_PER_LOOP);
+}
 
-    String extra = jsonKV("mac", addr) + "," +
-                   jsonKV("rssi", String(device->getRSSI()), false);
-    enqueueEvent(buildEvent("ble.seen", data, extra));
+// Runs on the NimBLE host task: copy the advert out and return. A full ring
+// drops the advert and is counted by the ring itself.
+class AdvertisedCallback : public NimBLEAdvertisedDeviceCallbacks {
+  void onResult(NimBLEAdvertisedDevice *device) override {
+    uint32_t startUs = micros();
+    BleRawObservation raw;
+    raw.ts_ms = millis();
+    // NimBLE keeps addresses little-endian; store most significant first.
+    NimBLEAddress address = device->getAddress();
+    const uint8_t *native = address.getNative();
+    for (int i = 0; i < 6; i++) raw.addr[i] = native[5 - i];
+    raw.addr_type = device->getAddressType();
+    raw.rssi = (int8_t)device->getRSSI();
+    size_t len = device->getPayloadLength();
+    if (len > kBleRawPayloadMax) len = kBleRawPayloadMax;
+    raw.payload_len = (uint8_t)len;
+    memcpy(raw.payload, device->getPayload(), len);
+    bleRawRing.push(raw);
+    uint32_t busyUs = micros() - startUs;
+    bleCallbackHist.record(busyUs);
+    pipeMeters[kPipeCapture].add(busyUs, 1);
+    pipeMeters[kPipeCapture].setCore(xPortGetCoreID());
   }
 };
 
@@ -1220,15 +3472,19 @@ void setup() {
   delay(100);
 
   randomSeed((uint32_t)esp_random());
+  stateMutex = xSemaphoreCreateMutex();
   registerStatusRoutes();
   WiFi.onEvent(handleWifiEvent);
   loadRuntimeConfig();
+  advanceBootEpoch();
 
   String compileNodeId = String(NODE_ID);
   nodeId = storedNodeId.length() > 0
                ? storedNodeId
                : (compileNodeId.length() > 0 ? compileNodeId : String(kDefaultNodeId));
   hostname = sanitizeHostname(nodeId);
+  udpPacker.begin(bootEpoch, nodeId.c_str());
+  setUdpCollector(udpCollector);
 
   String compileIngest = String(INGEST_URL);
   ingestUrl = storedIngestUrl.length() > 0
@@ -1263,64 +3519,132 @@ void setup() {
     serverStarted = true;
   }
 
+#if SPILL_ENABLE
+  startSpill();
+#endif
+#if OUI_INDEX_ENABLE
+  ouiIndex.begin(ouiIndexStart, (size_t)(ouiIndexEnd - ouiIndexStart));
+#endif
+#if LOOP_PROFILE_ENABLE
+  loopProfiler.begin(kLoopStageNames, kStageCount, ESP.getCpuFreqMHz(), LOOP_PROFILE_BUDGET_US);
+#endif
   startBLE();
   emitBootEvent();
+  startTasks();
 }
 
-void loop() {
-  unsigned long loopStart = millis();
+static uint32_t eventsQueuedTotal() {
+  uint32_t n = 0;
+  for (size_t c = 0; c < kEventClassCount; c++) n += queue.stats((EventClass)c).queued;
+  return n;
+}
 
-  if (serverStarted) {
-    server.handleClient();
+// Closes utilization windows and, with its own task, wakes the network
+// stage when events are waiting and ingest is not backing off.
+static void servicePipeline() {
+  uint32_t now = micros();
+  for (size_t i = 0; i < kPipeStageCount; i++) pipeWindows[i].sample(pipeMeters[i], now);
+#if PIPELINE_NET_TASK
+  if (!queue.empty() && millis() >= nextSendAtMs) xTaskNotifyGive(netTask);
+#endif
+}
+
+// Worker stage: one pass of Wi-Fi, BLE and status upkeep, turning adverts
+// from the raw ring into queued events.
+// Worker stage: one pass over the worker's jobs. The state lock is taken
+// per slice of the pass rather than for all of it, so the network stage can
+// plan and pop batches, and HTTP handlers render, in between.
+static void runWorkerStage() {
+  unsigned long loopStart = millis();
+  uint32_t loopStartUs = micros();
+  uint32_t busyUs = 0;
+  uint32_t queuedBefore;
+  LOOP_PROFILE_BEGIN();
+
+  {
+    WorkerSlice slice(busyUs);
+    queuedBefore = eventsQueuedTotal();
+    drainWifiEvents();
+    ensureWiFi();
+    LOOP_PROFILE_LAP(kStageWifi);
   }
+  drainBleObservations(busyUs);
+  {
+    WorkerSlice slice(busyUs);
+    serviceBleDigest();
+    LOOP_PROFILE_LAP(kStageBleDigest);
+    ensureBleScan();
+    LOOP_PROFILE_LAP(kStageBleScan);
+    ensureMdns();
+    LOOP_PROFILE_LAP(kStageMdns);
+    startWifiScanPassive();
+    LOOP_PROFILE_LAP(kStageWifiScan);
+
+    if (wifiState == "connecting" && !WiFi.isConnected() &&
+        wifiConnectStartMs > 0 &&
+        (millis() - wifiConnectStartMs) > WIFI_CONNECT_TIMEOUT_MS) {
+      WiFi.disconnect();
+      wifiFailCount = min<uint8_t>(wifiFailCount + 1, 6);
+      nextWifiAttemptMs = millis() + computeWifiBackoffMs();
+      wifiState = "backoff";
+      wifiConnectStartMs = 0;
+      emitWifiStatus();
+    }
 
-  ensureWiFi();
-  ensureBleScan();
-  ensureMdns();
-  startWifiScanPassive();
+    bool wifiConnected = WiFi.isConnected();
+    String ipStr = wifiConnected ? WiFi.localIP().toString() : "";
+    bool ipChanged = (ipStr != lastIpStr);
+    if (wifiConnected != lastWifiConnected || (wifiConnected && ipChanged)) {
+      lastWifiConnected = wifiConnected;
+      lastIpStr = ipStr;
+      if (wifiConnected) {
+        emitWifiStatus();
+        emitAnnounce();
+      }
+    }
 
-  if (wifiState == "connecting" && !WiFi.isConnected() &&
-      wifiConnectStartMs > 0 &&
-      (millis() - wifiConnectStartMs) > WIFI_CONNECT_TIMEOUT_MS) {
-    WiFi.disconnect();
-    wifiFailCount = min<uint8_t>(wifiFailCount + 1, 6);
-    nextWifiAttemptMs = millis() + computeWifiBackoffMs();
-    wifiState = "backoff";
-    wifiConnectStartMs = 0;
-    emitWifiStatus();
-  }
+    unsigned long now = millis();
+    if (now - lastHeartbeatMs >= 10000) {
+      lastHeartbeatMs = now;
+      emitHeartbeat();
+    }
 
-  bool wifiConnected = WiFi.isConnected();
-  String ipStr = wifiConnected ? WiFi.localIP().toString() : "";
-  bool ipChanged = (ipStr != lastIpStr);
-  if (wifiConnected != lastWifiConnected || (wifiConnected && ipChanged)) {
-    lastWifiConnected = wifiConnected;
-    lastIpStr = ipStr;
-    if (wifiConnected) {
-      emitWifiStatus();
+    if (wifiConnected && (now - lastAnnounceMs >= ANNOUNCE_INTERVAL_MS)) {
       emitAnnounce();
     }
-  }
 
-  unsigned long now = millis();
-  if (now - lastHeartbeatMs >= 10000) {
-    lastHeartbeatMs = now;
-    emitHeartbeat();
+    LOOP_PROFILE_LAP(kStageStatus);
   }
 
-  if (wifiConnected && (now - lastAnnounceMs >= ANNOUNCE_INTERVAL_MS)) {
-    emitAnnounce();
+#if SPILL_ENABLE
+  {
+    WorkerSlice slice(busyUs);
+    serviceSpill();
+    LOOP_PROFILE_LAP(kStageSpill);
   }
-
-  trySendQueued();
+#endif
 
   uint32_t heap = ESP.getFreeHeap();
+  WorkerSlice slice(busyUs);
   if (bleMinHeap == 0 || heap < bleMinHeap) {
     bleMinHeap = heap;
   }
 
   unsigned long loopMs = millis() - loopStart;
   if (loopMs > loopMaxMs) loopMaxMs = loopMs;
+  loopHist.record(micros() - loopStartUs);
+  LOOP_PROFILE_LAP(kStageHeap);
+  LOOP_PROFILE_END();
+  pipeMeters[kPipeWorker].add(busyUs, eventsQueuedTotal() - queuedBefore);
+  pipeMeters[kPipeWorker].setCore(xPortGetCoreID());
+  servicePipeline();
+}
 
+void loop() {
+  runWorkerStage();
+#if !PIPELINE_NET_TASK
+  // One core: the network stage takes its turn after each worker pass.
+  runNetStage();
+#endif
   delay(1);
 }
@@ -0,0 +1,39 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+# Builds and runs the host-side benchmarks in host/bench with optimizations.
+# Numbers are for relative before/after comparison; absolute rates on the
+# ESP32 are lower.
+
+APP_ROOT="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+CXX="${CXX:-c++}"
+OUT_DIR="${OUT_DIR:-$APP_ROOT/.pio/host}"
+FILTER="${1:-}"
+
+mkdir -p "$OUT_DIR"
+LIB_SRCS=("$APP_ROOT"/lib/node-core/*.cpp)
+CXXFLAGS=(-std=gnu++17 -O2 -Wall -Wextra -pthread
+  -I "$APP_ROOT/lib/node-core" -I "$APP_ROOT/host/bench")
+LDLIBS=()
+# zlib, when installed, is used as a reference decoder/encoder.
+if echo '#include <zlib.h>' | "$CXX" -E -x c++ - >/dev/null 2>&1; then
+  CXXFLAGS+=(-DHOST_HAVE_ZLIB=1)
+  LDLIBS+=(-lz)
+fi
+# The OUI index is generated, not checked in; build both variants when Python
+# is available so the OUI benchmark can run against the real data.
+if command -v python3 >/dev/null 2>&1 &&
+  python3 "$APP_ROOT/tools/oui_index.py" --quiet --out "$OUT_DIR/oui.idx" \
+    --vendors-out "$OUT_DIR/oui-vendors.tsv" &&
+  python3 "$APP_ROOT/tools/oui_index.py" --quiet --no-names --out "$OUT_DIR/oui-ids.idx"; then
+  CXXFLAGS+=(-DHOST_OUI_DIR="\"$OUT_DIR\"")
+fi
+
+for bench_src in "$APP_ROOT"/host/bench/bench_*.cpp; do
+  name="$(basename "$bench_src" .cpp)"
+  if [[ -n "$FILTER" && "$name" != *"$FILTER"* ]]; then
+    continue
+  fi
+  "$CXX" "${CXXFLAGS[@]}" -o "$OUT_DIR/$name" "$bench_src" "${LIB_SRCS[@]}" ${LDLIBS[@]+"${LDLIBS[@]}"}
+  "$OUT_DIR/$name"
+done
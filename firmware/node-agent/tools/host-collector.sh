@@ -0,0 +1,21 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+# Builds and runs the UDP telemetry collector (host/collector) with the local
+# C++ compiler. Point a node at it with POST /udp?collector=<this-host>:8788.
+# Arguments go to the collector, e.g.:
+#   ./tools/host-collector.sh --drop-pct 5 --reorder-pct 5
+#   ./tools/host-collector.sh --port 9000 --stats-ms 1000
+
+APP_ROOT="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+CXX="${CXX:-c++}"
+OUT_DIR="${OUT_DIR:-$APP_ROOT/.pio/host}"
+
+mkdir -p "$OUT_DIR"
+SRCS=("$APP_ROOT/host/collector/collector_main.cpp" "$APP_ROOT/host/replay/udp_collector.cpp"
+  "$APP_ROOT/lib/node-core/udp_telemetry.cpp")
+CXXFLAGS=(-std=gnu++17 -O2 -g -Wall -Wextra -pthread
+  -I "$APP_ROOT/lib/node-core" -I "$APP_ROOT/host/replay")
+
+"$CXX" "${CXXFLAGS[@]}" -o "$OUT_DIR/collector" "${SRCS[@]}"
+exec "$OUT_DIR/collector" "$@"
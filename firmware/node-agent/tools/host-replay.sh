@@ -0,0 +1,47 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+# Builds src/main.cpp as a native program against the stand-ins in
+# host/stubs and runs the replay harness (host/replay). Arguments go to the
+# harness, e.g.:
+#   ./tools/host-replay.sh --devices 500 --duration-ms 120000
+#   ./tools/host-replay.sh --trace my.trace --sink-fail-pct 20
+# Extra firmware config goes in REPLAY_DEFINES, e.g. "-DEVENT_QUEUE_BYTES=8192".
+
+APP_ROOT="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+CXX="${CXX:-c++}"
+OUT_DIR="${OUT_DIR:-$APP_ROOT/.pio/host}"
+
+mkdir -p "$OUT_DIR"
+SRCS=("$APP_ROOT/src/main.cpp" "$APP_ROOT"/lib/node-core/*.cpp "$APP_ROOT"/host/stubs/*.cpp
+  "$APP_ROOT"/host/replay/*.cpp)
+CXXFLAGS=(-std=gnu++17 -O2 -g -Wall -Wno-unused-parameter -pthread
+  -I "$APP_ROOT/host/stubs" -I "$APP_ROOT/include" -I "$APP_ROOT/lib/node-core"
+  -I "$APP_ROOT/host/replay" -DFW_VERSION="\"host\"")
+LDLIBS=()
+if echo '#include <zlib.h>' | "$CXX" -E -x c++ - >/dev/null 2>&1; then
+  CXXFLAGS+=(-DHOST_HAVE_ZLIB=1)
+  LDLIBS+=(-lz)
+fi
+# Embed the ids-only OUI index the way the device build does, through the
+# same linker symbols.
+if command -v python3 >/dev/null 2>&1 &&
+  python3 "$APP_ROOT/tools/oui_index.py" --quiet --no-names --out "$OUT_DIR/oui-ids.idx"; then
+  cat >"$OUT_DIR/oui_blob.S" <<ASM
+  .section .rodata
+  .global _binary_src_oui_idx_start
+  .global _binary_src_oui_idx_end
+_binary_src_oui_idx_start:
+  .incbin "$OUT_DIR/oui-ids.idx"
+_binary_src_oui_idx_end:
+  .section .note.GNU-stack,"",@progbits
+ASM
+  SRCS+=("$OUT_DIR/oui_blob.S")
+else
+  CXXFLAGS+=(-DOUI_INDEX_ENABLE=0)
+fi
+# shellcheck disable=SC2206
+CXXFLAGS+=(${REPLAY_DEFINES:-})
+
+"$CXX" "${CXXFLAGS[@]}" -o "$OUT_DIR/replay" "${SRCS[@]}" ${LDLIBS[@]+"${LDLIBS[@]}"}
+exec "$OUT_DIR/replay" "$@"
@@ -0,0 +1,26 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+# Builds and runs the stand-in ingest server (host/sink) with the local C++
+# compiler. Point a node's ingest_url at http://<this-host>:8787/v1/ingest.
+# Arguments go to the server, e.g.:
+#   ./tools/host-sink.sh --partial-pct 30 --drop-pct 5
+#   ./tools/host-sink.sh --port 9000 --fail-pct 20
+
+APP_ROOT="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+CXX="${CXX:-c++}"
+OUT_DIR="${OUT_DIR:-$APP_ROOT/.pio/host}"
+
+mkdir -p "$OUT_DIR"
+SRCS=("$APP_ROOT/host/sink/sink_main.cpp" "$APP_ROOT/host/replay/ingest_sink.cpp"
+  "$APP_ROOT/lib/node-core/cbor_batch.cpp" "$APP_ROOT/lib/node-core/json_writer.cpp")
+CXXFLAGS=(-std=gnu++17 -O2 -g -Wall -Wextra -pthread
+  -I "$APP_ROOT/lib/node-core" -I "$APP_ROOT/host/replay")
+LDLIBS=()
+if echo '#include <zlib.h>' | "$CXX" -E -x c++ - >/dev/null 2>&1; then
+  CXXFLAGS+=(-DHOST_HAVE_ZLIB=1)
+  LDLIBS+=(-lz)
+fi
+
+"$CXX" "${CXXFLAGS[@]}" -o "$OUT_DIR/sink" "${SRCS[@]}" ${LDLIBS[@]+"${LDLIBS[@]}"}
+exec "$OUT_DIR/sink" "$@"
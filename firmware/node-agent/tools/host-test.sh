@@ -0,0 +1,47 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+# Builds and runs the host-side unit tests for lib/node-core with the local
+# C++ compiler (no PlatformIO or ESP32 toolchain required).
+
+APP_ROOT="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+CXX="${CXX:-c++}"
+OUT_DIR="${OUT_DIR:-$APP_ROOT/.pio/host}"
+FILTER="${1:-}"
+
+mkdir -p "$OUT_DIR"
+LIB_SRCS=("$APP_ROOT"/lib/node-core/*.cpp)
+CXXFLAGS=(-std=gnu++17 -O1 -g -Wall -Wextra -pthread
+  -I "$APP_ROOT/lib/node-core" -I "$APP_ROOT/host/test")
+LDLIBS=()
+# zlib, when installed, is used as a reference decoder/encoder.
+if echo '#include <zlib.h>' | "$CXX" -E -x c++ - >/dev/null 2>&1; then
+  CXXFLAGS+=(-DHOST_HAVE_ZLIB=1)
+  LDLIBS+=(-lz)
+fi
+# The OUI index is generated, not checked in; build both variants when Python
+# is available so the OUI tests can run against the real data.
+if command -v python3 >/dev/null 2>&1 &&
+  python3 "$APP_ROOT/tools/oui_index.py" --quiet --out "$OUT_DIR/oui.idx" \
+    --vendors-out "$OUT_DIR/oui-vendors.tsv" &&
+  python3 "$APP_ROOT/tools/oui_index.py" --quiet --no-names --out "$OUT_DIR/oui-ids.idx"; then
+  CXXFLAGS+=(-DHOST_OUI_DIR="\"$OUT_DIR\"")
+fi
+
+failed=0
+for test_src in "$APP_ROOT"/host/test/test_*.cpp; do
+  name="$(basename "$test_src" .cpp)"
+  if [[ -n "$FILTER" && "$name" != *"$FILTER"* ]]; then
+    continue
+  fi
+  "$CXX" "${CXXFLAGS[@]}" -o "$OUT_DIR/$name" "$test_src" "${LIB_SRCS[@]}" ${LDLIBS[@]+"${LDLIBS[@]}"}
+  if ! "$OUT_DIR/$name"; then
+    failed=1
+  fi
+done
+
+if [[ "$failed" -ne 0 ]]; then
+  echo "host tests FAILED" >&2
+  exit 1
+fi
+echo "host tests OK"
@@ -0,0 +1,33 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+# Compares the HTTP and MQTT uplinks on the replay harness (host/replay) in
+# real time: events/s acknowledged and publish/POST-to-ack latency, with the
+# sink answering as a server RTT_MS away (default 30) under more BLE load
+# than one POST per round trip can carry. With MQTT_URL set, the MQTT run
+# publishes to that broker instead of the sink, e.g.:
+#   ./tools/host-uplink-bench.sh
+#   RTT_MS=80 ./tools/host-uplink-bench.sh
+#   MQTT_URL=mqtt://127.0.0.1:1883 ./tools/host-uplink-bench.sh   # local mosquitto
+
+APP_ROOT="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+OUT_DIR="${OUT_DIR:-$APP_ROOT/.pio/host/uplink-bench}"
+RTT_MS="${RTT_MS:-30}"
+DURATION_MS="${DURATION_MS:-10000}"
+
+# A sampler that lets most adverts through, and a queue with room for the
+# backlog instead of the spill log.
+REPLAY_DEFINES="-DBLE_MAX_PER_SECOND=3000 -DBLE_DEVICE_INTERVAL_MS=0 -DBLE_COALESCE=0
+  -DEVENT_QUEUE_BYTES=262144 -DSPILL_ENABLE=0 ${REPLAY_DEFINES:-}"
+export OUT_DIR REPLAY_DEFINES
+# Builds the harness; writing the trace out is all the run does.
+"$APP_ROOT/tools/host-replay.sh" --write-trace /dev/null
+
+ARGS=(--realtime --devices 3000 --duration-ms "$DURATION_MS" --drain-ms 20000 --sink-rtt-ms "$RTT_MS")
+for uplink in http mqtt; do
+  run=("${ARGS[@]}" --uplink "$uplink")
+  if [[ "$uplink" == mqtt && -n "${MQTT_URL:-}" ]]; then
+    run+=(--mqtt-url "$MQTT_URL")
+  fi
+  "$OUT_DIR/replay" "${run[@]}" | grep -E '^  (uplink|ingest latency|drops)'
+done
@@ -0,0 +1,238 @@
+#!/usr/bin/env python3
+"""Builds the compact OUI vendor index embedded in the node-agent firmware.
+
+Reads OUI/oui_combined.txt (and fills gaps from the IEEE data/resources/oui.txt)
+and writes the binary layout read by lib/node-core/oui_index.h:
+
+  header (40 bytes, little-endian)
+    0  magic "OUIX"
+    4  u8  format version (1)
+    5  u8  key block shift  (entries per key block = 1 << shift)
+    6  u8  name block shift (names per name block = 1 << shift)
+    7  u8  token count (<= 128)
+    8  u32 entry count
+    12 u32 vendor count
+    16 u32 index id (CRC-32 of the key sections; identifies the id mapping)
+    20 u32 key block table offset   (u32 first_oui, u32 entry data offset)
+    24 u32 entry data offset        (varint oui delta, short vendor id)
+    28 u32 name block table offset  (u32 name data offset)
+    32 u32 name data offset         (u8 shared prefix, u8 suffix len, bytes)
+    36 u32 token table offset       (u8 len, bytes; byte 0x80 + i expands to token i)
+
+The first entry of each key block has no delta. A short vendor id is one byte
+below 0x80, otherwise two bytes big-endian with the top bit set. With
+--no-names the three name sections are empty and lookups only yield ids.
+
+Vendor names are shortened (legal-form suffixes stripped, ASCII-folded,
+truncated), deduplicated, token-compressed and front-coded in sorted order;
+the vendor id is the position in that order, with or without --no-names. Ids
+are only meaningful together with the index id, so --vendors-out writes the
+id -> name table the server side needs to resolve ids from events.
+"""
+import argparse
+import binascii
+import collections
+import re
+import struct
+import sys
+import unicodedata
+from pathlib import Path
+
+
+APP_ROOT = Path(__file__).resolve().parent.parent
+REPO_ROOT = APP_ROOT.parent.parent
+
+DEFAULT_SOURCES = [
+    REPO_ROOT / "OUI" / "oui_combined.txt",
+    REPO_ROOT / "data" / "resources" / "oui.txt",
+]
+
+MAGIC = b"OUIX"
+FORMAT_VERSION = 1
+HEADER_SIZE = 40
+KEY_BLOCK_SHIFT = 5
+NAME_BLOCK_SHIFT = 4
+MAX_TOKENS = 128
+
+LEGAL_SUFFIX = re.compile(
+    r"[\s,]+(inc|incorporated|ltd|limited|llc|l\.l\.c|co|corp|corporation|company|gmbh|ag|ab|"
+    r"sa|s\.a|s\.a\.s|sas|srl|s\.r\.l|bv|b\.v|nv|oy|as|a/s|plc|pty|pte|kg|co\.?,?\s*ltd|"
+    r"gmbh\s*&\s*co\.?\s*kg)\.?$",
+    re.I,
+)
+WORD = re.compile(r"[A-Za-z]{3,} ?")
+IEEE_LINE = re.compile(r"^([0-9A-F]{2})-([0-9A-F]{2})-([0-9A-F]{2})\s+\(hex\)\s+(.+)$", re.I)
+COMBINED_LINE = re.compile(r"^([0-9A-F]{2})[-:]?([0-9A-F]{2})[-:]?([0-9A-F]{2})\s+(.+)$", re.I)
+
+
+def load_sources(paths: list[Path]) -> dict[int, str]:
+    """Earlier sources win; later ones only fill OUIs that are still missing."""
+    mapping: dict[int, str] = {}
+    for path in paths:
+        if not path.exists():
+            continue
+        with path.open("r", encoding="utf-8", errors="ignore") as f:
+            for raw in f:
+                line = raw.strip()
+                if not line or line.startswith("#"):
+                    continue
+                m = IEEE_LINE.match(line) or COMBINED_LINE.match(line)
+                if not m:
+                    continue
+                key = int(m.group(1) + m.group(2) + m.group(3), 16)
+                vendor = m.group(4).split("\t")[-1].strip()
+                if vendor and key not in mapping:
+                    mapping[key] = vendor
+    return mapping
+
+
+def short_name(vendor: str, max_len: int) -> str:
+    ascii_name = unicodedata.normalize("NFKD", vendor).encode("ascii", "ignore").decode()
+    name = " ".join(ascii_name.split())
+    prev = None
+    while prev != name:
+        prev = name
+        name = LEGAL_SUFFIX.sub("", name).strip(" ,.")
+    if not name:
+        name = " ".join(ascii_name.split())
+    if len(name) > max_len:
+        name = name[:max_len].rstrip(" ,.-&")
+    return name or "?"
+
+
+def pick_tokens(names: list[str]) -> list[str]:
+    counts: collections.Counter[str] = collections.Counter()
+    for name in names:
+        for m in WORD.finditer(name):
+            if m.start() == 0 or not name[m.start() - 1].isalpha():
+                counts[m.group()] += 1
+    ranked = sorted(counts.items(), key=lambda kv: (-(len(kv[0]) - 1) * kv[1], kv[0]))
+    return [word for word, count in ranked[:MAX_TOKENS] if count > 1 and len(word) > 2]
+
+
+def encode_name(name: str, tokens: dict[str, int]) -> bytes:
+    out = bytearray()
+    i = 0
+    while i < len(name):
+        m = WORD.match(name, i) if i == 0 or not name[i - 1].isalpha() else None
+        if m:
+            word = m.group()
+            if word in tokens:
+                out.append(0x80 + tokens[word])
+                i += len(word)
+                continue
+            if word.endswith(" ") and word[:-1] in tokens:
+                out.append(0x80 + tokens[word[:-1]])
+                i += len(word) - 1
+                continue
+        out.append(ord(name[i]) & 0x7F)
+        i += 1
+    return bytes(out[:255])
+
+
+def varint(value: int) -> bytes:
+    out = bytearray()
+    while value >= 0x80:
+        out.append((value & 0x7F) | 0x80)
+        value >>= 7
+    out.append(value)
+    return bytes(out)
+
+
+def short_id(value: int) -> bytes:
+    if value < 0x80:
+        return bytes([value])
+    return bytes([0x80 | (value >> 8), value & 0xFF])
+
+
+def build_index(mapping: dict[int, str], name_max: int, names: bool = True) -> tuple[bytes, list[str]]:
+    display = {key: short_name(vendor, name_max) for key, vendor in mapping.items()}
+    unique = sorted(set(display.values()))
+    tokens = pick_tokens(unique)
+    token_ids = {word: i for i, word in enumerate(tokens)}
+    encoded = {name: encode_name(name, token_ids) for name in unique}
+    # Sort on the encoded bytes so neighbours share the longest prefixes.
+    order = sorted(unique, key=lambda name: encoded[name])
+    vendor_id = {name: i for i, name in enumerate(order)}
+    if len(order) > 0x7FFF:
+        raise ValueError(f"too many vendors for a short id: {len(order)}")
+
+    name_blocks = bytearray()
+    name_data = bytearray()
+    prev = b""
+    for i, name in enumerate(order if names else []):
+        enc = encoded[name]
+        if i % (1 << NAME_BLOCK_SHIFT) == 0:
+            name_blocks += struct.pack("<I", len(name_data))
+            shared = 0
+        else:
+            shared = 0
+            while shared < min(len(enc), len(prev)) and enc[shared] == prev[shared]:
+                shared += 1
+        name_data += bytes([shared, len(enc) - shared]) + enc[shared:]
+        prev = enc
+
+    key_blocks = bytearray()
+    key_data = bytearray()
+    keys = sorted(display)
+    prev_key = 0
+    for i, key in enumerate(keys):
+        if i % (1 << KEY_BLOCK_SHIFT) == 0:
+            key_blocks += struct.pack("<II", key, len(key_data))
+        else:
+            key_data += varint(key - prev_key)
+        key_data += short_id(vendor_id[display[key]])
+        prev_key = key
+
+    token_table = bytearray()
+    for word in tokens if names else []:
+        raw = word.encode("ascii")
+        token_table += bytes([len(raw)]) + raw
+
+    sections = [bytes(key_blocks), bytes(key_data), bytes(name_blocks), bytes(name_data), bytes(token_table)]
+    offsets = []
+    body = bytearray()
+    for section in sections:
+        while len(body) % 4:
+            body.append(0)
+        offsets.append(HEADER_SIZE + len(body))
+        body += section
+    index_id = binascii.crc32(key_blocks + key_data) & 0xFFFFFFFF
+    header = MAGIC + struct.pack(
+        "<BBBBIII5I", FORMAT_VERSION, KEY_BLOCK_SHIFT, NAME_BLOCK_SHIFT, len(tokens) if names else 0,
+        len(keys), len(order), index_id, *offsets)
+    assert len(header) == HEADER_SIZE
+    return header + bytes(body), order
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--out", required=True, type=Path, help="binary index to write")
+    parser.add_argument("--source", action="append", type=Path,
+                        help="OUI source file (repeatable; default: OUI/oui_combined.txt, data/resources/oui.txt)")
+    parser.add_argument("--name-max", type=int, default=32, help="truncate vendor names to this many chars")
+    parser.add_argument("--no-names", action="store_true", help="ids only; leave the name sections empty")
+    parser.add_argument("--vendors-out", type=Path, help="also write an id<TAB>name table")
+    parser.add_argument("--quiet", action="store_true")
+    args = parser.parse_args()
+
+    mapping = load_sources(args.source or DEFAULT_SOURCES)
+    if len(mapping) < 1000:
+        print(f"oui_index: too few OUI entries ({len(mapping)}); check sources", file=sys.stderr)
+        return 1
+    blob, vendors = build_index(mapping, args.name_max, not args.no_names)
+    args.out.parent.mkdir(parents=True, exist_ok=True)
+    args.out.write_bytes(blob)
+    if args.vendors_out:
+        with args.vendors_out.open("w", encoding="utf-8") as f:
+            for i, name in enumerate(vendors):
+                f.write(f"{i}\t{name}\n")
+    if not args.quiet:
+        index_id = struct.unpack_from("<I", blob, 16)[0]
+        print(f"oui_index: {len(mapping)} OUIs, {len(vendors)} vendors, {len(blob)} bytes, "
+              f"id {index_id:08x} -> {args.out}")
+    return 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
@@ -0,0 +1,40 @@
+"""PlatformIO pre-build step: regenerates src/oui.idx (embedded through
+board_build.embed_files) when the OUI sources, the generator or the
+OUI_INDEX_NAMES build flag changed."""
+import subprocess
+import sys
+from pathlib import Path
+
+Import("env")  # noqa: F821  (provided by PlatformIO)
+
+APP_ROOT = Path(env.subst("$PROJECT_DIR"))  # noqa: F821
+REPO_ROOT = APP_ROOT.parent.parent
+GENERATOR = APP_ROOT / "tools" / "oui_index.py"
+OUT = APP_ROOT / "src" / "oui.idx"
+INPUTS = [GENERATOR, REPO_ROOT / "OUI" / "oui_combined.txt", REPO_ROOT / "data" / "resources" / "oui.txt"]
+
+
+def wants_names() -> bool:
+    flags = env.GetProjectOption("build_flags", "")  # noqa: F821
+    if isinstance(flags, (list, tuple)):
+        flags = " ".join(flags)
+    return "OUI_INDEX_NAMES=1" in flags
+
+
+def up_to_date(names: bool) -> bool:
+    if not OUT.exists():
+        return False
+    built = OUT.stat().st_mtime
+    if any(p.exists() and p.stat().st_mtime > built for p in INPUTS):
+        return False
+    header = OUT.read_bytes()[:8]
+    # Byte 7 is the token count, which is only non-zero when names are embedded.
+    return len(header) == 8 and (header[7] > 0) == names
+
+
+names = wants_names()
+if not up_to_date(names):
+    cmd = [sys.executable, str(GENERATOR), "--out", str(OUT)]
+    if not names:
+        cmd.append("--no-names")
+    subprocess.check_call(cmd)
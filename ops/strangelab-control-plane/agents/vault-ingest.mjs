@@ -23,6 +23,7 @@ const PORT = Number(process.env.PORT || 8088);
 const DATA_ROOT = process.env.VAULT_DATA_ROOT || "/var/sods/vault";
 const BLE_IDENTITY_ENABLED = process.env.BLE_IDENTITY_ENABLED !== "0";
 const BLE_REGISTRY_DB = process.env.BLE_REGISTRY_DB || "/var/lib/strangelab/registry.sqlite";
+const DEDUPE_KEYS = Number(process.env.INGEST_DEDUPE_KEYS || 200000);
 
 let bleRegistry = null;
 let bleIdentityInitError = "";
@@ -114,6 +115,7 @@ app.get("/health", (_req, res) => {
     service: "vault-ingest",
     port: PORT,
     root: DATA_ROOT,
+    dedupe: { keys: recentKeys.size, max_keys: DEDUPE_KEYS, duplicates: duplicateCount },
     ble_identity: {
       enabled: BLE_IDENTITY_ENABLED,
       active: Boolean(getBleRegistry()),
@@ -123,25 +125,133 @@ app.get("/health", (_req, res) => {
   });
 });
 
-app.post("/v1/ingest", (req, res) => {
-  const event = req.body;
-  if (!event || typeof event !== "object") {
-    return res.status(400).json({ ok: false, error: "event object required" });
+function validateEvent(event) {
+  if (!event || typeof event !== "object" || Array.isArray(event)) {
+    return "event object required";
   }
   const hasType = typeof event.type === "string" && event.type.length > 0;
   const hasSrc = typeof event.src === "string" && event.src.length > 0;
   const hasTs = Number.isFinite(Number(event.ts_ms));
   if (!hasType || !hasSrc || !hasTs || typeof event.data === "undefined") {
-    return res.status(400).json({ ok: false, error: "missing required fields: type, src, ts_ms, data" });
+    return "missing required fields: type, src, ts_ms, data";
   }
+  return "";
+}
 
-  try {
-    const file = appendEvent(event);
-    const derived = deriveBleEvents(event);
-    for (const extra of derived) {
-      appendEvent(extra);
+// Recently stored (node, epoch, seq) keys, oldest first. Nodes resend a batch
+// whose response they never saw, so repeats of a stored event are skipped.
+const recentKeys = new Set();
+let duplicateCount = 0;
+
+function eventKey(event) {
+  const seq = Number(event?.seq);
+  if (!Number.isInteger(seq)) return "";
+  const epoch = Number.isInteger(Number(event?.epoch)) ? Number(event.epoch) : 0;
+  return `${event.node_id ?? event.src}|${epoch}|${seq}`;
+}
+
+function isDuplicate(event) {
+  const key = eventKey(event);
+  if (!key || !recentKeys.has(key)) return false;
+  duplicateCount += 1;
+  return true;
+}
+
+// Called once the event is on disk: a failed append leaves the key out, so
+// the node's resend is stored rather than skipped.
+function rememberEvent(event) {
+  const key = eventKey(event);
+  if (!key) return;
+  recentKeys.add(key);
+  if (recentKeys.size > DEDUPE_KEYS) {
+    recentKeys.delete(recentKeys.values().next().value);
+  }
+}
+
+// ack_epoch/ack_seq name the last event of the request that is stored, so
+// the node pops exactly the events up to it (firmware/node-agent README,
+// Ingest Acknowledgements).
+function ackFields(event) {
+  const seq = Number(event?.seq);
+  if (!Number.isInteger(seq)) return {};
+  return { ack_epoch: Number.isInteger(Number(event?.epoch)) ? Number(event.epoch) : 0, ack_seq: seq };
+}
+
+function storeEvent(event) {
+  if (isDuplicate(event)) return { file: "", derivedCount: 0, duplicate: true };
+  const file = appendEvent(event);
+  rememberEvent(event);
+  const derived = deriveBleEvents(event);
+  for (const extra of derived) {
+    appendEvent(extra);
+  }
+  return { file, derivedCount: derived.length, duplicate: false };
+}
+
+// Accepts a single event object or a batch (JSON array) of events. Batches are
+// validated up front and stored in order; events already stored under the
+// same (node_id, epoch, seq) are skipped, so a node can safely retry.
+// gzip/deflate request bodies are inflated by express.json. Any other body
+// type (a node sending CBOR) is answered 415 rather than parsed as an empty
+// object, so the node switches to JSON instead of blaming its events.
+app.post("/v1/ingest", (req, res) => {
+  if (!req.is("application/json")) {
+    return res.status(415).json({ ok: false, error: "unsupported content type", accept: "application/json" });
+  }
+  const body = req.body;
+  if (Array.isArray(body)) {
+    if (body.length === 0) {
+      return res.status(400).json({ ok: false, error: "empty batch" });
+    }
+    for (let i = 0; i < body.length; i += 1) {
+      const error = validateEvent(body[i]);
+      if (error) {
+        return res.status(400).json({ ok: false, error, index: i });
+      }
+    }
+    let done = 0;
+    try {
+      let derivedCount = 0;
+      let duplicates = 0;
+      let file = "";
+      for (const event of body) {
+        const stored = storeEvent(event);
+        if (stored.duplicate) duplicates += 1;
+        else file = stored.file;
+        derivedCount += stored.derivedCount;
+        done += 1;
+      }
+      return res.json({
+        ok: true,
+        stored: true,
+        count: body.length,
+        duplicates,
+        file,
+        derived_count: derivedCount,
+        ...ackFields(body[body.length - 1]),
+      });
+    } catch (error) {
+      // The events before the failing one are stored; acknowledge them.
+      const ack = done > 0 ? ackFields(body[done - 1]) : {};
+      return res.status(500).json({ ok: false, error: String(error?.message || error), ...ack });
     }
-    return res.json({ ok: true, stored: true, file, derived_count: derived.length });
+  }
+
+  const error = validateEvent(body);
+  if (error) {
+    return res.status(400).json({ ok: false, error });
+  }
+
+  try {
+    const { file, derivedCount, duplicate } = storeEvent(body);
+    return res.json({
+      ok: true,
+      stored: true,
+      duplicates: duplicate ? 1 : 0,
+      file,
+      derived_count: derivedCount,
+      ...ackFields(body),
+    });
   } catch (error) {
     return res.status(500).json({ ok: false, error: String(error?.message || error) });
   }
@@ -0,0 +1,100 @@
+import test from "node:test";
+import assert from "node:assert/strict";
+import { spawn } from "node:child_process";
+import fs from "node:fs";
+import net from "node:net";
+import os from "node:os";
+import path from "node:path";
+import { fileURLToPath } from "node:url";
+
+const AGENT = path.join(path.dirname(fileURLToPath(import.meta.url)), "vault-ingest.mjs");
+
+function freePort() {
+  return new Promise((resolve, reject) => {
+    const server = net.createServer();
+    server.once("error", reject);
+    server.listen(0, "127.0.0.1", () => {
+      const { port } = server.address();
+      server.close(() => resolve(port));
+    });
+  });
+}
+
+async function startAgent(dataRoot) {
+  const port = await freePort();
+  const child = spawn(process.execPath, [AGENT], {
+    env: { ...process.env, HOST: "127.0.0.1", PORT: String(port), VAULT_DATA_ROOT: dataRoot, BLE_IDENTITY_ENABLED: "0" },
+    stdio: ["ignore", "pipe", "inherit"],
+  });
+  await new Promise((resolve, reject) => {
+    child.once("exit", (code) => reject(new Error(`vault-ingest exited with ${code}`)));
+    child.stdout.on("data", (chunk) => {
+      if (String(chunk).includes("listening")) resolve();
+    });
+  });
+  return { child, base: `http://127.0.0.1:${port}` };
+}
+
+async function postBatch(base, batch) {
+  const res = await fetch(`${base}/v1/ingest`, {
+    method: "POST",
+    headers: { "content-type": "application/json" },
+    body: JSON.stringify(batch),
+  });
+  return { status: res.status, body: await res.json() };
+}
+
+function readSeqs(dataRoot, day) {
+  const file = path.join(dataRoot, "events", day, "ingest.ndjson");
+  if (!fs.existsSync(file)) return [];
+  return fs.readFileSync(file, "utf8").trim().split("\n").map((line) => JSON.parse(line).seq);
+}
+
+test("an event whose write failed is stored when the batch is resent", async (t) => {
+  const dataRoot = fs.mkdtempSync(path.join(os.tmpdir(), "vault-ingest-test-"));
+  const { child, base } = await startAgent(dataRoot);
+  t.after(() => child.kill());
+
+  const event = (seq, ts) => ({ type: "node.heartbeat", src: "node-1", node_id: "node-1", epoch: 7, seq, ts_ms: ts, data: {} });
+  const dayOne = Date.UTC(2026, 0, 1, 12);
+  const dayTwo = Date.UTC(2026, 0, 2, 12);
+  const batch = [event(1, dayOne), event(2, dayOne), event(3, dayTwo)];
+
+  // A file where the second day's directory belongs makes the third append throw.
+  fs.mkdirSync(path.join(dataRoot, "events"), { recursive: true });
+  const blocker = path.join(dataRoot, "events", "2026-01-02");
+  fs.writeFileSync(blocker, "");
+  const failed = await postBatch(base, batch);
+  assert.equal(failed.status, 500);
+  assert.equal(failed.body.ack_seq, 2);
+
+  fs.unlinkSync(blocker);
+  const replayed = await postBatch(base, batch);
+  assert.equal(replayed.status, 200);
+  assert.equal(replayed.body.duplicates, 2);
+  assert.equal(replayed.body.ack_seq, 3);
+  assert.deepEqual(readSeqs(dataRoot, "2026-01-01"), [1, 2]);
+  assert.deepEqual(readSeqs(dataRoot, "2026-01-02"), [3]);
+});
+
+test("a non-JSON body is refused with 415 and stores nothing", async (t) => {
+  const dataRoot = fs.mkdtempSync(path.join(os.tmpdir(), "vault-ingest-test-"));
+  const { child, base } = await startAgent(dataRoot);
+  t.after(() => child.kill());
+
+  // A CBOR batch of one map, {"seq": 1}; express.json leaves it unparsed.
+  const res = await fetch(`${base}/v1/ingest`, {
+    method: "POST",
+    headers: { "content-type": "application/cbor" },
+    body: Buffer.from([0x81, 0xa1, 0x63, 0x73, 0x65, 0x71, 0x01]),
+  });
+  assert.equal(res.status, 415);
+  assert.equal((await res.json()).accept, "application/json");
+
+  // The node resends the batch as JSON, which is stored.
+  const ts = Date.UTC(2026, 0, 1, 12);
+  const event = { type: "node.heartbeat", src: "node-1", node_id: "node-1", epoch: 7, seq: 1, ts_ms: ts, data: {} };
+  const stored = await postBatch(base, [event]);
+  assert.equal(stored.status, 200);
+  assert.deepEqual(readSeqs(dataRoot, "2026-01-01"), [1]);
+});